@@ -136,7 +136,7 @@ bool BinaryOp::tick3( const ArrayBase *in1_base, const ArrayBase *in2_base )
   const ArrayBase::Size in1_size = in1_base->getSize();
   const ArrayBase::Size in2_size = in2_base->getSize();
 
-  CountPtr< Block< Out > > bop;
+  LocalCountPtr< Block< Out > > bop;
   CountPtr< Array< Out > > out;
 
   if( in1_size.getDims() == 0 )
@@ -425,6 +425,11 @@ bool BinaryOp::tick( void )
   throw Exception() << "Param 'op' was not set or is broken.";
 }
 
+bool BinaryOp::isPure( void ) const
+{
+  return true;
+}
+
 void BinaryOp::gc_clear( void )
 {
   Base::gc_clear();
@@ -126,6 +126,11 @@ bool ROI::tick( void )
   return true;
 }
 
+bool ROI::isPure( void ) const
+{
+  return true;
+}
+
  //
 } // namespace RPGML
 
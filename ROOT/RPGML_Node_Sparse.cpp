@@ -73,6 +73,11 @@ bool Sparse::tick( void )
   return true;
 }
 
+bool Sparse::isPure( void ) const
+{
+  return true;
+}
+
  //
 } // namespace RPGML
 
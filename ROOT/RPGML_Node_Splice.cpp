@@ -269,6 +269,11 @@ bool Splice::tick( void )
 
 
 
+  return true;
+}
+
+bool Splice::isPure( void ) const
+{
   return true;
 }
 
@@ -82,28 +82,20 @@ bool TextFileReader::tick( void )
   GET_OUTPUT_INIT( OUTPUT_OUT , out , String, 0, nullptr );
   GET_OUTPUT_INIT( OUTPUT_LAST, last, bool  , 0, nullptr );
 
-  CountPtr< const StringArray > filename;
-  try
+  // Checked before, so a missing filename does not throw NotReady every frame
+  const Input *const filename_input = getInput( INPUT_FILENAME );
+  if( default_output && filename_input->isConnected() && !filename_input->isReady() )
   {
-    GET_INPUT_AS_DIMS( INPUT_FILENAME, _filename, String, 0 );
-    filename = _filename;
-  }
-  catch( const NotReady & )
-  {
-    if( default_output )
-    {
-      //cerr << getIdentifier() << ": Filename not ready: using default" << endl;
-      (**out) = (**default_output);
-      getOutput( OUTPUT_FILENAME_OUT )->setData( const_cast< StringArray* >( filename.get() ) );
-      setAllOutputChanged();
-      return true;
-    }
-    else
-    {
-      throw;
-    }
+    //cerr << getIdentifier() << ": Filename not ready: using default" << endl;
+    (**out) = (**default_output);
+    getOutput( OUTPUT_FILENAME_OUT )->setData( CountPtr< ArrayBase >() );
+    setAllOutputChanged();
+    return true;
   }
 
+  GET_INPUT_AS_DIMS( INPUT_FILENAME, _filename, String, 0 );
+  CountPtr< const StringArray > filename = _filename;
+
   if( rewind && (**rewind) )
   {
     m_last_filename.clear();
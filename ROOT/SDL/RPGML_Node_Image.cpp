@@ -21,6 +21,8 @@
 // RPGML_LDFLAGS=`sdl2-config --libs` -lSDL2_image
 
 #include <SDL2/SDL_image.h>
+#include <RPGML/Atomic.h>
+#include <RPGML/Semaphore.h>
 #include <algorithm>
 #include <iostream>
 
@@ -29,8 +31,194 @@ using namespace std;
 namespace RPGML {
 namespace SDL {
 
+namespace Image_impl {
+
+//! Converts rows of a surface to 8 bit red, green, blue and alpha, planar or interleaved
+struct Unpacker
+{
+  const SDL_Surface *image;
+  //! Byte offsets of red, green, blue and alpha within a pixel, if has_offsets
+  Uint8 offsets[ 4 ];
+  bool has_offsets;
+  bool has_alpha;
+  //! First element of each channel, out[ 3 ] may be null
+  uint8_t *out[ 4 ];
+  //! In elements, same for all channels
+  stride_t out_stride[ 2 ];
+
+  void unpack( index_t y0, index_t y1 ) const
+  {
+    const SDL_PixelFormat *const format = image->format;
+    const index_t width = index_t( image->w );
+    const index_t bpp   = format->BytesPerPixel;
+    const stride_t sx   = out_stride[ 0 ];
+
+    for( index_t y=y0; y<y1; ++y )
+    {
+      const uint8_t *p = (const uint8_t*)( image->pixels ) + size_t( y ) * size_t( image->pitch );
+      const stride_t o = stride_t( y ) * out_stride[ 1 ];
+      uint8_t *const r = out[ 0 ] + o;
+      uint8_t *const g = out[ 1 ] + o;
+      uint8_t *const b = out[ 2 ] + o;
+      uint8_t *const a = ( out[ 3 ] ? out[ 3 ] + o : 0 );
+
+      if( has_offsets )
+      {
+        for( index_t x=0; x<width; ++x, p += bpp )
+        {
+          const stride_t i = stride_t( x ) * sx;
+          r[ i ] = p[ offsets[ 0 ] ];
+          g[ i ] = p[ offsets[ 1 ] ];
+          b[ i ] = p[ offsets[ 2 ] ];
+          if( a ) a[ i ] = ( has_alpha ? p[ offsets[ 3 ] ] : 255 );
+        }
+      }
+      else
+      {
+        // Palettes and packed 15/16 bit formats
+        for( index_t x=0; x<width; ++x, p += bpp )
+        {
+          const Uint32 pixel = ( bpp == 1 ? Uint32( p[ 0 ] ) : Uint32( *(const Uint16*)p ) );
+          Uint8 rgba[ 4 ];
+          SDL_GetRGBA( pixel, format, &rgba[ 0 ], &rgba[ 1 ], &rgba[ 2 ], &rgba[ 3 ] );
+          const stride_t i = stride_t( x ) * sx;
+          r[ i ] = rgba[ 0 ];
+          g[ i ] = rgba[ 1 ];
+          b[ i ] = rgba[ 2 ];
+          if( a ) a[ i ] = rgba[ 3 ];
+        }
+      }
+    }
+  }
+};
+
+//! Row tiles of one Unpacker, claimed by the ticking thread and by workers alike
+class UnpackJob : public JobQueue::Job
+{
+  typedef JobQueue::Job Base;
+public:
+  UnpackJob( GarbageCollector *_gc, const Unpacker *unpacker, index_t height, index_t tile_rows )
+  : Base( _gc, JobQueue::End-1 ) // before any GraphNode
+  , m_unpacker( unpacker )
+  , m_height( height )
+  , m_tile_rows( tile_rows )
+  , m_num_tiles( ( height + tile_rows - 1 ) / tile_rows )
+  , m_next( 0 )
+  , m_done( 0 )
+  {}
+
+  virtual ~UnpackJob( void )
+  {}
+
+  index_t getNumTiles( void ) const
+  {
+    return m_num_tiles;
+  }
+
+  //! Unpacks tiles until none are left to claim, m_unpacker is not used after that
+  void unpackTiles( void )
+  {
+    for(;;)
+    {
+      const index_t tile = m_next++;
+      if( tile >= m_num_tiles ) return;
+
+      const index_t y0 = tile * m_tile_rows;
+      m_unpacker->unpack( y0, std::min( y0 + m_tile_rows, m_height ) );
+
+      if( ++m_done == m_num_tiles ) ++m_all_done;
+    }
+  }
+
+  //! Blocks until all tiles are unpacked, the ones claimed by workers included
+  void wait( void )
+  {
+    if( m_num_tiles > 0 ) --m_all_done;
+  }
+
+protected:
+  virtual size_t doit( CountPtr< JobQueue > )
+  {
+    unpackTiles();
+    return 0;
+  }
+
+private:
+  const Unpacker *const m_unpacker;
+  const index_t m_height;
+  const index_t m_tile_rows;
+  const index_t m_num_tiles;
+  Atomic< index_t > m_next;
+  Atomic< index_t > m_done;
+  Semaphore m_all_done;
+};
+
+//! Unpacks in row tiles, idle workers help, the calling thread never waits for a tile nobody works on
+static
+void unpack( GarbageCollector *gc, const CountPtr< JobQueue > &workers, const Unpacker &unpacker, index_t tile_rows )
+{
+  const index_t height = index_t( unpacker.image->h );
+
+  CountPtr< UnpackJob > job = new UnpackJob( gc, &unpacker, height, tile_rows );
+
+  if( !workers.isNull() )
+  {
+    const index_t helpers = std::min( job->getNumTiles(), index_t( 16 ) );
+    for( index_t i=1; i<helpers; ++i )
+    {
+      workers->addJob( job );
+    }
+  }
+
+  job->unpackTiles();
+  job->wait();
+}
+
+//! @brief ArrayData sharing the elements of an interleaved rgba Array
+/*!
+ * Holds a reference on the rgba Array, so its elements stay valid as long as any channel view uses this.
+ * The size is [ 4 * width, height ], like cv's MatArrayData, so views select a channel with setSparse().
+ */
+class RGBAArrayData : public ArrayData< uint8_t >
+{
+  typedef ArrayData< uint8_t > Base;
+public:
+  explicit
+  RGBAArrayData( GarbageCollector *_gc, UInt8Array *rgba, const index_t *s )
+  : Base( _gc, 2, s )
+  , m_rgba( rgba )
+  {
+    Base::setElements( m_rgba->elements(), Base::calc_size( 2, s ) );
+  }
+
+  virtual ~RGBAArrayData( void )
+  {}
+
+  virtual void gc_clear( void )
+  {
+    Base::gc_clear();
+    Base::setElements( 0, 0 );
+    m_rgba.reset();
+  }
+
+  virtual void gc_getChildren( Children &children ) const
+  {
+    Base::gc_getChildren( children );
+    children << m_rgba;
+  }
+
+private:
+  CountPtr< UInt8Array > m_rgba;
+};
+
+} // namespace Image_impl
+
+using namespace Image_impl;
+
 Image::Image( GarbageCollector *_gc, const String &identifier, const RPGML::SharedObject *so )
 : Node( _gc, identifier, so, NUM_INPUTS, NUM_OUTPUTS, NUM_PARAMS )
+, m_tile_rows( 64 )
+, m_interleaved( false )
 {
   DEFINE_INPUT ( INPUT_FILENAME    , "filename"  );
   DEFINE_OUTPUT_INIT( OUTPUT_RED   , "red"  , uint8_t, 2 );
@@ -38,6 +226,9 @@ Image::Image( GarbageCollector *_gc, const String &identifier, const RPGML::Shar
   DEFINE_OUTPUT_INIT( OUTPUT_BLUE  , "blue" , uint8_t, 2 );
   DEFINE_OUTPUT_INIT( OUTPUT_WIDTH , "width" , int, 0 );
   DEFINE_OUTPUT_INIT( OUTPUT_HEIGHT, "height", int, 0 );
+  DEFINE_OUTPUT_INIT( OUTPUT_RGBA  , "rgba" , uint8_t, 3 );
+  DEFINE_PARAM ( PARAM_INTERLEAVED, "interleaved", Image::set_interleaved );
+  DEFINE_PARAM ( PARAM_TILE_ROWS  , "tile_rows"  , Image::set_tile_rows );
 
   IMG_Init( IMG_INIT_JPG | IMG_INIT_PNG | IMG_INIT_TIF );
 }
@@ -50,7 +241,22 @@ const char *Image::getName( void ) const
   return "SDL.Image";
 }
 
-bool Image::tick( void )
+void Image::set_interleaved( const Value &value, index_t, int, const index_t * )
+{
+  m_interleaved = value.save_cast< bool >();
+}
+
+void Image::set_tile_rows( const Value &value, index_t, int, const index_t * )
+{
+  const int tile_rows = value.save_cast< int >();
+  if( tile_rows < 1 )
+  {
+    throw Exception() << "Param 'tile_rows' must be at least 1, is " << tile_rows;
+  }
+  m_tile_rows = index_t( tile_rows );
+}
+
+bool Image::tick( CountPtr< JobQueue >, CountPtr< JobQueue > workers )
 {
   if( !hasAnyInputChanged() ) return true;
 
@@ -66,18 +272,6 @@ bool Image::tick( void )
 
 //  cerr << "Loaded image '" << (**filename) << "'" << endl;
 
-  if( m_image->format->BitsPerPixel != 24 && m_image->format->BitsPerPixel != 32 )
-  {
-    m_image.set( SDL_ConvertSurfaceFormat( m_image, SDL_PIXELFORMAT_RGBA8888, 0 ) );
-  }
-
-  if( m_image->format->BitsPerPixel != 24 && m_image->format->BitsPerPixel != 32 )
-  {
-    throw Exception()
-      << "Internal: Image loader returned something other than 24 or 32 bits per pixel."
-      ;
-  }
-
   //SDL_LockSurface_Guard lock_image( m_image );
   const SDL_PixelFormat *const format = m_image->format;
   const int width  = m_image->w;
@@ -86,6 +280,13 @@ bool Image::tick( void )
   uint8_t *const pixels = (uint8_t*)( m_image->pixels );
   const index_t bpp = format->BytesPerPixel;
 
+  if( bpp < 1 || bpp > 4 )
+  {
+    throw Exception()
+      << "Internal: Image loader returned " << bpp << " bytes per pixel."
+      ;
+  }
+
   GET_OUTPUT_AS( OUTPUT_WIDTH , o_width , int );
   GET_OUTPUT_AS( OUTPUT_HEIGHT, o_height, int );
 
@@ -101,29 +302,82 @@ bool Image::tick( void )
     getOutput( OUTPUT_HEIGHT )->setChanged();
   }
 
-  union
+  Unpacker unpacker;
+  unpacker.image = m_image;
+  unpacker.has_offsets = ( bpp == 3 || bpp == 4 );
+  unpacker.has_alpha = ( format->Amask != 0 );
+
+  if( unpacker.has_offsets )
   {
-    Uint8 u8[ 4 ];
-    Uint32 u32;
-  } static_offsets;
-  for( Uint8 i=0; i<4; ++i ) static_offsets.u8[ i ] = i;
+    union
+    {
+      Uint8 u8[ 4 ];
+      Uint32 u32;
+    } static_offsets;
+    for( Uint8 i=0; i<4; ++i ) static_offsets.u8[ i ] = i;
+
+    SDL_GetRGBA(
+        static_offsets.u32
+      , m_image->format
+      , &unpacker.offsets[ 0 ]
+      , &unpacker.offsets[ 1 ]
+      , &unpacker.offsets[ 2 ]
+      , &unpacker.offsets[ 3 ]
+      );
+  }
 
-  Uint8 offsets[ 4 ];
-  SDL_GetRGBA(
-      static_offsets.u32
-    , m_image->format
-    , &offsets[ 0 ]
-    , &offsets[ 1 ]
-    , &offsets[ 2 ]
-    , &offsets[ 3 ]
-    );
-
-  // Wrap image per component
   index_t  size  [ 2 ] = { index_t( width ), index_t( height ) };
-  stride_t stride[ 2 ] = { stride_t( bpp ) , stride_t( pitch ) };
-  for( index_t c=0; c<3; ++c )
+
+  if( m_interleaved )
+  {
+    const index_t rgba_size[ 3 ] = { 4, index_t( width ), index_t( height ) };
+    CountPtr< UInt8Array > rgba = new UInt8Array( getGC(), 3, rgba_size );
+    uint8_t *const rgba_pixels = rgba->elements();
+
+    for( index_t c=0; c<4; ++c ) unpacker.out[ c ] = rgba_pixels + c;
+    unpacker.out_stride[ 0 ] = 4;
+    unpacker.out_stride[ 1 ] = 4 * width;
+    unpack( getGC(), workers, unpacker, m_tile_rows );
+
+    getOutput( OUTPUT_RGBA )->setData( rgba );
+    getOutput( OUTPUT_RGBA )->setChanged();
+
+    // Red, green and blue are views on rgba, every 4th element starting at their channel
+    const index_t data_size[ 2 ] = { 4 * index_t( width ), index_t( height ) };
+    CountPtr< RGBAArrayData > data = new RGBAArrayData( getGC(), rgba, data_size );
+    for( index_t c=0; c<3; ++c )
+    {
+      CountPtr< UInt8Array > view = new UInt8Array( getGC(), data );
+      view->setSparse( 0, 4, c );
+      getOutput( OUTPUT_RED+c )->setData( view );
+    }
+  }
+  else if( unpacker.has_offsets )
   {
-    getOutput( OUTPUT_RED+c )->setData( new UInt8Array( getGC(), pixels + offsets[ c ], 2, size, stride ) );
+    // Wrap image per component
+    stride_t stride[ 2 ] = { stride_t( bpp ) , stride_t( pitch ) };
+    for( index_t c=0; c<3; ++c )
+    {
+      getOutput( OUTPUT_RED+c )->setData( new UInt8Array( getGC(), pixels + unpacker.offsets[ c ], 2, size, stride ) );
+    }
+  }
+  else
+  {
+    CountPtr< UInt8Array > channels[ 3 ];
+    for( index_t c=0; c<3; ++c )
+    {
+      channels[ c ] = new UInt8Array( getGC(), 2, size );
+      unpacker.out[ c ] = channels[ c ]->elements();
+    }
+    unpacker.out[ 3 ] = 0;
+    unpacker.out_stride[ 0 ] = 1;
+    unpacker.out_stride[ 1 ] = width;
+    unpack( getGC(), workers, unpacker, m_tile_rows );
+
+    for( index_t c=0; c<3; ++c )
+    {
+      getOutput( OUTPUT_RED+c )->setData( channels[ c ] );
+    }
   }
 
   getOutput( OUTPUT_RED   )->setChanged();
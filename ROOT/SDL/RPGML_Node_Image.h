@@ -35,11 +35,14 @@ public:
 
   virtual const char *getName( void ) const;
 
-  virtual bool tick( void );
+  virtual bool tick( CountPtr< JobQueue > main_thread, CountPtr< JobQueue > workers );
 
   virtual void gc_clear( void );
   virtual void gc_getChildren( Children &children ) const;
 
+  void set_interleaved( const Value &value, index_t index, int n_coords, const index_t *coords );
+  void set_tile_rows( const Value &value, index_t index, int n_coords, const index_t *coords );
+
 private:
   typedef NodeParam< Image > NParam;
 
@@ -56,15 +59,20 @@ private:
     OUTPUT_BLUE ,
     OUTPUT_WIDTH,
     OUTPUT_HEIGHT,
+    OUTPUT_RGBA ,
     NUM_OUTPUTS
   };
 
   enum Params
   {
+    PARAM_INTERLEAVED,
+    PARAM_TILE_ROWS,
     NUM_PARAMS
   };
 
   SDL_Surface_Guard m_image;
+  index_t m_tile_rows;
+  bool m_interleaved;
 };
 
  } // namespace SDL {
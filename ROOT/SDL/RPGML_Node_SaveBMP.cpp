@@ -23,20 +23,148 @@
 #include "RPGML_SDL.h"
 #include <SDL2/SDL_image.h>
 #include <algorithm>
+#include <iostream>
+#include <sstream>
 
 using namespace std;
 
 namespace RPGML {
 namespace SDL {
 
+namespace SaveBMP_impl {
+
+  static
+  SDL_Surface *create_surface( int width, int height )
+  {
+    int bpp = 0;
+    Uint32 red_mask = 0;
+    Uint32 green_mask = 0;
+    Uint32 blue_mask = 0;
+    Uint32 alpha_mask = 0;
+
+    if(
+      !SDL_PixelFormatEnumToMasks(
+           SDL_PIXELFORMAT_RGBA8888, &bpp
+         , &red_mask, &green_mask, &blue_mask, &alpha_mask
+         )
+    )
+    {
+      throw SaveBMP::Exception()
+        << "Could not create masks for SDL_PIXELFORMAT_RGBA8888"
+        << ": " << SDL_GetError()
+        ;
+    }
+
+    if( bpp != 32 )
+    {
+      throw SaveBMP::Exception() << "Internal: bpp is not 32, is " << bpp;
+    }
+
+    SDL_Surface *const surface =
+      SDL_CreateRGBSurface(
+          0, width, height, bpp
+        , red_mask, green_mask, blue_mask, alpha_mask
+        );
+
+    if( !surface )
+    {
+      throw SaveBMP::Exception() << "Could not create SDL Surface: " << SDL_GetError();
+    }
+
+    return surface;
+  }
+
+  static inline
+  bool fits( const SDL_Surface *surface, int width, int height )
+  {
+    return surface && surface->w == width && surface->h == height;
+  }
+
+  /*! @brief Packs the planar channels into the 32 bit pixels of surface
+   *
+   * Same as SDL_MapRGB() for the 8 bit per channel formats created by
+   * create_surface(), but without the per-pixel call, so the inner loop
+   * vectorizes for dense rows.
+   */
+  static
+  void pack_rgb(
+      SDL_Surface *surface
+    , const UInt8Array *red
+    , const UInt8Array *green
+    , const UInt8Array *blue
+    )
+  {
+    const SDL_PixelFormat *const format = surface->format;
+    const Uint32 alpha   = format->Amask;
+    const Uint8  r_shift = format->Rshift;
+    const Uint8  g_shift = format->Gshift;
+    const Uint8  b_shift = format->Bshift;
+
+    Uint8 *const pixels_bytes = (Uint8*)surface->pixels;
+    const int pitch = surface->pitch;
+
+    const index_t width  = red->getSizeX();
+    const index_t height = red->getSizeY();
+
+    const stride_t *const r_stride = red  ->getStride();
+    const stride_t *const g_stride = green->getStride();
+    const stride_t *const b_stride = blue ->getStride();
+
+    const bool dense_rows =
+         r_stride[ 0 ] == 1
+      && g_stride[ 0 ] == 1
+      && b_stride[ 0 ] == 1
+      ;
+
+    for( index_t y=0; y<height; ++y )
+    {
+      Uint32 *const p = (Uint32*)( pixels_bytes + int( y ) * pitch );
+      const uint8_t *const r = red  ->elements() + stride_t( y ) * r_stride[ 1 ];
+      const uint8_t *const g = green->elements() + stride_t( y ) * g_stride[ 1 ];
+      const uint8_t *const b = blue ->elements() + stride_t( y ) * b_stride[ 1 ];
+
+      if( dense_rows )
+      {
+        for( index_t x=0; x<width; ++x )
+        {
+          p[ x ] =
+              alpha
+            | ( Uint32( r[ x ] ) << r_shift )
+            | ( Uint32( g[ x ] ) << g_shift )
+            | ( Uint32( b[ x ] ) << b_shift )
+            ;
+        }
+      }
+      else
+      {
+        for( index_t x=0; x<width; ++x )
+        {
+          const stride_t sx = stride_t( x );
+          p[ x ] =
+              alpha
+            | ( Uint32( r[ sx * r_stride[ 0 ] ] ) << r_shift )
+            | ( Uint32( g[ sx * g_stride[ 0 ] ] ) << g_shift )
+            | ( Uint32( b[ sx * b_stride[ 0 ] ] ) << b_shift )
+            ;
+        }
+      }
+    }
+  }
+
+} // namespace SaveBMP_impl
+
 SaveBMP::SaveBMP( GarbageCollector *_gc, const String &identifier, const RPGML::SharedObject *so )
 : Node( _gc, identifier, so, NUM_INPUTS, NUM_OUTPUTS, NUM_PARAMS )
+, m_queue_depth( 2 )
+, m_async( false )
 {
   DEFINE_INPUT ( INPUT_FILENAME, "filename"  );
   DEFINE_INPUT ( INPUT_RED  , "red"  );
   DEFINE_INPUT ( INPUT_GREEN, "green"  );
   DEFINE_INPUT ( INPUT_BLUE , "blue"  );
   DEFINE_OUTPUT( OUTPUT_OUT, "out" );
+  DEFINE_PARAM ( PARAM_ASYNC      , "async"      , SaveBMP::set_async );
+  DEFINE_PARAM ( PARAM_QUEUE_DEPTH, "queue_depth", SaveBMP::set_queue_depth );
 }
 
 SaveBMP::~SaveBMP( void )
@@ -50,15 +178,57 @@ const char *SaveBMP::getName( void ) const
 void SaveBMP::gc_clear( void )
 {
   Base::gc_clear();
+  m_writer.reset();
 }
 
 void SaveBMP::gc_getChildren( Children &children ) const
 {
   Base::gc_getChildren( children );
+  children << m_writer;
+}
+
+void SaveBMP::set_async( const Value &value, index_t, int, const index_t * )
+{
+  m_async = value.save_cast< bool >();
+  // Flushes and joins a running writer
+  if( !m_async ) m_writer.reset();
+}
+
+void SaveBMP::set_queue_depth( const Value &value, index_t, int, const index_t * )
+{
+  const int depth = value.save_cast< int >();
+  if( depth < 1 )
+  {
+    throw Exception() << "Param 'queue_depth' must be at least 1, is " << depth;
+  }
+  m_queue_depth = index_t( depth );
+  m_writer.reset();
+}
+
+SDL_Surface *SaveBMP::getSurface( int width, int height )
+{
+  using namespace SaveBMP_impl;
+
+  if( !fits( m_surface, width, height ) )
+  {
+    m_surface.set( create_surface( width, height ) );
+  }
+  return m_surface;
 }
 
 bool SaveBMP::tick( void )
 {
+  using namespace SaveBMP_impl;
+
+  if( !m_writer.isNull() )
+  {
+    const std::string error = m_writer->takeError();
+    if( !error.empty() )
+    {
+      throw Exception() << "Could not write BMP: " << error;
+    }
+  }
+
   if( !hasAnyInputChanged() ) return true;
   setAllOutputChanged();
 
@@ -87,74 +257,180 @@ bool SaveBMP::tick( void )
       ;
   }
 
-  int bpp = 0;
-  Uint32 red_mask = 0;
-  Uint32 green_mask = 0;
-  Uint32 blue_mask = 0;
-  Uint32 alpha_mask = 0;
+  const int width  = int( size[ 0 ] );
+  const int height = int( size[ 1 ] );
 
-  if(
-    !SDL_PixelFormatEnumToMasks(
-         SDL_PIXELFORMAT_RGBA8888, &bpp
-       , &red_mask, &green_mask, &blue_mask, &alpha_mask
-       )
-  )
+  if( m_async )
   {
-    throw Exception()
-      << "Could not create masks for SDL_PIXELFORMAT_RGBA8888"
-      << ": " << SDL_GetError()
-      ;
-  }
+    if( m_writer.isNull() )
+    {
+      m_writer = new Writer( getGC(), m_queue_depth );
+    }
 
-  if( bpp != 32 )
+    SDL_Surface *const surface = m_writer->acquire( width, height );
+    {
+      SDL_LockSurface_Guard lock( surface );
+      pack_rgb( surface, red, green, blue );
+    }
+    // Ownership passes to the writer
+    m_writer->push( surface, (**filename) );
+  }
+  else
   {
-    throw Exception() << "Internal: bpp is not 32, is " << bpp;
+    SDL_Surface *const surface = getSurface( width, height );
+    {
+      SDL_LockSurface_Guard lock( surface );
+      pack_rgb( surface, red, green, blue );
+    }
+
+    if( 0 != SDL_SaveBMP( surface, (**filename).c_str() ) )
+    {
+      throw Exception() << "Could not write BMP: " << SDL_GetError();
+    }
   }
 
-  const index_t width = size[ 0 ];
-  const index_t height = size[ 1 ];
+  getOutput( OUTPUT_OUT )->setData( const_cast< StringArray* >( filename ) );
+  return true;
+}
 
-  SDL_Surface_Guard surface(
-    SDL_CreateRGBSurface(
-        0, width, height, bpp
-      , red_mask, green_mask, blue_mask, alpha_mask
-      )
-    );
+SaveBMP::Writer::Writer( GarbageCollector *_gc, index_t depth )
+: Thread( _gc, false )
+, m_num_more_errors( 0 )
+, m_free_slots( Semaphore::value_t( depth ) )
+{
+  start();
+}
+
+SaveBMP::Writer::~Writer( void )
+{
+  stop();
+}
 
-  if( !surface.get() )
+void SaveBMP::Writer::stop( void )
+{
+  if( !isRunning() ) return;
+
+  // A null surface ends run(), after all queued surfaces were written
+  {
+    Mutex::ScopedLock lock( &m_lock );
+    Entry end;
+    end.surface = 0;
+    m_todo.push_back( end );
+  }
+  ++m_filled;
+  join();
+
+  for( size_t i=0; i<m_spare.size(); ++i )
+  {
+    SDL_FreeSurface( m_spare[ i ] );
+  }
+  m_spare.clear();
+
+  // No tick() follows that could throw it
+  const std::string error = takeError();
+  if( !error.empty() )
   {
-    throw Exception() << "Could not create SDL Surface: " << SDL_GetError();
+    std::cerr << "error: SDL.SaveBMP: Could not write BMP: " << error << std::endl;
   }
+}
 
-  SDL_LockSurface_Guard lock( surface );
-  const SDL_PixelFormat *const format = surface->format;
-  Uint8 *const pixels_bytes = (Uint8*)surface->pixels;
-  const int pitch = surface->pitch;
+SDL_Surface *SaveBMP::Writer::acquire( int width, int height )
+{
+  using namespace SaveBMP_impl;
 
-  UInt8Array::const_iterator r = red  ->begin();
-  UInt8Array::const_iterator g = green->begin();
-  UInt8Array::const_iterator b = blue ->begin();
+  --m_free_slots;
 
-  for( index_t y=0; y<height; ++y )
+  SDL_Surface *surface = 0;
   {
-    Uint32 *const p = (Uint32*)( pixels_bytes + y * pitch );
-    for( index_t x=0; x<width; ++x, ++r, ++g, ++b )
+    Mutex::ScopedLock lock( &m_lock );
+    if( !m_spare.empty() )
     {
-      p[ x ] = SDL_MapRGB( format, (*r), (*g), (*b) );
+      surface = m_spare.back();
+      m_spare.pop_back();
     }
   }
 
-  if( 0 != SDL_SaveBMP( surface, (**filename).c_str() ) )
+  if( !fits( surface, width, height ) )
   {
-    throw Exception() << "Could not write BMP: " << SDL_GetError();
+    if( surface ) SDL_FreeSurface( surface );
+    try
+    {
+      surface = create_surface( width, height );
+    }
+    catch( ... )
+    {
+      ++m_free_slots;
+      throw;
+    }
   }
 
-  getOutput( OUTPUT_OUT )->setData( const_cast< StringArray* >( filename ) );
-  return true;
+  return surface;
+}
+
+void SaveBMP::Writer::push( SDL_Surface *surface, const String &filename )
+{
+  {
+    Mutex::ScopedLock lock( &m_lock );
+    Entry entry;
+    entry.surface = surface;
+    entry.filename = filename;
+    m_todo.push_back( entry );
+  }
+  ++m_filled;
+}
+
+std::string SaveBMP::Writer::takeError( void )
+{
+  Mutex::ScopedLock lock( &m_lock );
+  std::string ret;
+  ret.swap( m_error );
+  if( m_num_more_errors > 0 )
+  {
+    std::ostringstream more;
+    more << " (and " << m_num_more_errors << " more failed writes)";
+    ret += more.str();
+    m_num_more_errors = 0;
+  }
+  return ret;
+}
+
+size_t SaveBMP::Writer::run( void )
+{
+  for(;;)
+  {
+    --m_filled;
+
+    Entry entry;
+    {
+      Mutex::ScopedLock lock( &m_lock );
+      entry = m_todo.front();
+      m_todo.pop_front();
+    }
+
+    if( !entry.surface ) return 0;
+
+    if( 0 != SDL_SaveBMP( entry.surface, entry.filename.c_str() ) )
+    {
+      Mutex::ScopedLock lock( &m_lock );
+      if( m_error.empty() )
+      {
+        m_error = std::string( entry.filename.c_str() ) + ": " + SDL_GetError();
+      }
+      else
+      {
+        ++m_num_more_errors;
+      }
+    }
+
+    {
+      Mutex::ScopedLock lock( &m_lock );
+      m_spare.push_back( entry.surface );
+    }
+    ++m_free_slots;
+  }
 }
 
  } // namespace SDL {
 } // namespace RPGML
 
 RPGML_CREATE_NODE( SaveBMP, SDL:: )
-
@@ -19,6 +19,14 @@
 #define RPGML_Node_SDL_SaveBMP_h
 
 #include <RPGML/Node.h>
+#include <RPGML/Thread.h>
+#include <RPGML/Semaphore.h>
+#include <RPGML/Mutex.h>
+#include "RPGML_SDL.h"
+
+#include <deque>
+#include <vector>
+#include <string>
 
 namespace RPGML {
 namespace SDL {
@@ -39,7 +47,8 @@ public:
   virtual void gc_clear( void );
   virtual void gc_getChildren( Children &children ) const;
 
-  void set_foo( const Value &value, index_t index, int n_coords, const index_t *coords );
+  void set_async( const Value &value, index_t index, int n_coords, const index_t *coords );
+  void set_queue_depth( const Value &value, index_t index, int n_coords, const index_t *coords );
 
 private:
   typedef NodeParam< SaveBMP > NParam;
@@ -55,14 +64,65 @@ private:
 
   enum Outputs
   {
-    OUTPUT_OUT,
+    OUTPUT_OUT, //!< The filename once written, with Param 'async' only once queued, see Writer
     NUM_OUTPUTS
   };
 
   enum Params
   {
+    PARAM_ASYNC,
+    PARAM_QUEUE_DEPTH,
     NUM_PARAMS
   };
+
+  /*! @brief Writes filled surfaces in the background, at most depth are in flight
+   *
+   * Errors are reported by SaveBMP::tick() through takeError(). Errors still
+   * pending when the Writer stops, e.g. after the last frame or with the Node
+   * destroyed, are written to std::cerr.
+   */
+  class Writer : public Thread
+  {
+    typedef Thread Base;
+  public:
+    explicit
+    Writer( GarbageCollector *_gc, index_t depth );
+    virtual ~Writer( void );
+
+    //! Blocks until a slot is free, returns a surface of that size, owned by the caller until push()
+    SDL_Surface *acquire( int width, int height );
+    //! Queues the surface for writing, takes ownership
+    void push( SDL_Surface *surface, const String &filename );
+    //! Returns and clears the error text of the first failed write, with the number of further failed writes
+    std::string takeError( void );
+
+  protected:
+    virtual size_t run( void );
+
+  private:
+    struct Entry
+    {
+      SDL_Surface *surface;
+      String filename;
+    };
+
+    void stop( void );
+
+    std::deque< Entry > m_todo;
+    std::vector< SDL_Surface* > m_spare;
+    std::string m_error;
+    index_t m_num_more_errors; // failed writes after the one in m_error
+    Semaphore m_free_slots;
+    Semaphore m_filled;
+    Mutex m_lock;
+  };
+
+  SDL_Surface *getSurface( int width, int height );
+
+  SDL_Surface_Guard m_surface;
+  CountPtr< Writer > m_writer;
+  index_t m_queue_depth;
+  bool m_async;
 };
 
  } // namespace SDL {
@@ -25,6 +25,7 @@
 namespace RPGML {
 namespace core {
 
+//! Blocks only live during one Node execution, so they are held by LocalCountPtr
 class BlockBase : public Refcounted
 {
   typedef Refcounted Base;
@@ -176,7 +177,7 @@ private:
 
 template< class ToType >
 static inline
-CountPtr< Block< ToType > > createCastBlock( const ArrayBase *from )
+LocalCountPtr< Block< ToType > > createCastBlock( const ArrayBase *from )
 {
   if( TypeOf< ToType >::E == from->getType().getEnum() )
   {
@@ -207,7 +208,7 @@ CountPtr< Block< ToType > > createCastBlock( const ArrayBase *from )
 }
 
 static inline
-CountPtr< BlockBase > createCastBlock( const ArrayBase *from, const Type &to )
+LocalCountPtr< BlockBase > createCastBlock( const ArrayBase *from, const Type &to )
 {
   if( from->getType() == to )
   {
@@ -265,7 +266,7 @@ class BinaryOpBlock : public Block< OutType >
   typedef Block< OutType > Base;
 public:
   explicit
-  BinaryOpBlock( const CountPtr< BlockBase > &in1, const CountPtr< BlockBase > &in2, const Op &op = Op() )
+  BinaryOpBlock( const LocalCountPtr< BlockBase > &in1, const LocalCountPtr< BlockBase > &in2, const Op &op = Op() )
   : m_in1( in1->getAs< Block< InType1 > >() )
   , m_in2( in2->getAs< Block< InType2 > >() )
   , m_buffer1( 0, 1 )
@@ -314,8 +315,8 @@ public:
   }
 
 private:
-  const CountPtr< Block< InType1 > > m_in1;
-  const CountPtr< Block< InType2 > > m_in2;
+  const LocalCountPtr< Block< InType1 > > m_in1;
+  const LocalCountPtr< Block< InType2 > > m_in2;
   Array< InType1 > m_buffer1;
   Array< InType2 > m_buffer2;
   Op m_op;
@@ -327,7 +328,7 @@ class BinaryOpBlockScalar1 : public Block< OutType >
   typedef Block< OutType > Base;
 public:
   explicit
-  BinaryOpBlockScalar1( const InType1 &in1, const CountPtr< BlockBase > &in2, const Op &op = Op() )
+  BinaryOpBlockScalar1( const InType1 &in1, const LocalCountPtr< BlockBase > &in2, const Op &op = Op() )
   : m_in1( in1 )
   , m_in2( in2->getAs< Block< InType2 > >() )
   , m_buffer2( 0, 1 )
@@ -365,7 +366,7 @@ public:
 
 private:
   const InType1                      m_in1;
-  const CountPtr< Block< InType2 > > m_in2;
+  const LocalCountPtr< Block< InType2 > > m_in2;
   Array< InType2 > m_buffer2;
   Op m_op;
 };
@@ -376,7 +377,7 @@ class BinaryOpBlockScalar2 : public Block< OutType >
   typedef Block< OutType > Base;
 public:
   explicit
-  BinaryOpBlockScalar2( const CountPtr< BlockBase > &in1, const InType2 &in2, const Op &op = Op() )
+  BinaryOpBlockScalar2( const LocalCountPtr< BlockBase > &in1, const InType2 &in2, const Op &op = Op() )
   : m_in1( in1->getAs< Block< InType1 > >() )
   , m_in2( in2 )
   , m_buffer1( 0, 1 )
@@ -413,7 +414,7 @@ public:
   }
 
 private:
-  const CountPtr< Block< InType1 > > m_in1;
+  const LocalCountPtr< Block< InType1 > > m_in1;
   const InType2                      m_in2;
   Array< InType1 > m_buffer1;
   Op m_op;
@@ -230,6 +230,11 @@ bool At::tick( void )
   return true;
 }
 
+bool At::isPure( void ) const
+{
+  return true;
+}
+
 void At::gc_clear( void )
 {
   Base::gc_clear();
@@ -90,6 +90,11 @@ bool Cast::tick( void )
   return true;
 }
 
+bool Cast::isPure( void ) const
+{
+  return true;
+}
+
  } // namespace core {
 } // namespace RPGML
 
@@ -85,6 +85,11 @@ bool Constant::tick( void )
   return true;
 }
 
+bool Constant::isPure( void ) const
+{
+  return true;
+}
+
 void Constant::gc_clear( void )
 {
   Base::gc_clear();
@@ -263,6 +263,11 @@ bool ConstantArray::tick( void )
   return true;
 }
 
+bool ConstantArray::isPure( void ) const
+{
+  return true;
+}
+
 void ConstantArray::gc_clear( void )
 {
   Base::gc_clear();
@@ -114,6 +114,11 @@ bool Get::tick( void )
   return true;
 }
 
+bool Get::isPure( void ) const
+{
+  return true;
+}
+
 void Get::gc_clear( void )
 {
   Base::gc_clear();
@@ -58,6 +58,11 @@ bool Identity::tick( void )
   return true;
 }
 
+bool Identity::isPure( void ) const
+{
+  return true;
+}
+
  } // namespace core {
 } // namespace RPGML
 
@@ -63,7 +63,7 @@ class IfThenElseBlock : public Block< RetType >
   typedef Block< RetType > Base;
 public:
   explicit
-  IfThenElseBlock( const CountPtr< BlockBase > &in_if, const CountPtr< BlockBase > &in_then, const CountPtr< BlockBase > &in_else )
+  IfThenElseBlock( const LocalCountPtr< BlockBase > &in_if, const LocalCountPtr< BlockBase > &in_then, const LocalCountPtr< BlockBase > &in_else )
   : m_in_if  ( in_if  ->getAs< Block< bool    > >() )
   , m_in_then( in_then->getAs< Block< RetType > >() )
   , m_in_else( in_else->getAs< Block< RetType > >() )
@@ -118,9 +118,9 @@ public:
   }
 
 private:
-  const CountPtr< Block< bool    > > m_in_if  ;
-  const CountPtr< Block< RetType > > m_in_then;
-  const CountPtr< Block< RetType > > m_in_else;
+  const LocalCountPtr< Block< bool    > > m_in_if  ;
+  const LocalCountPtr< Block< RetType > > m_in_then;
+  const LocalCountPtr< Block< RetType > > m_in_else;
 
   Array< bool    > m_buffer_if  ;
   Array< RetType > m_buffer_then;
@@ -140,9 +140,9 @@ bool IfThenElse::tick2( const ArrayBase *in_if, const ArrayBase *in_then, const
   GET_OUTPUT_INIT( OUTPUT_OUT, out, RetType, size.getDims(), size.getCoords() );
 
   const Type ret_type( TypeOf< RetType >::E );
-  CountPtr< Block< bool    > > cast_if   = createCastBlock< bool >( in_if );
-  CountPtr< Block< RetType > > cast_then = createCastBlock< RetType >( in_then );
-  CountPtr< Block< RetType > > cast_else = createCastBlock< RetType >( in_else );
+  LocalCountPtr< Block< bool    > > cast_if   = createCastBlock< bool >( in_if );
+  LocalCountPtr< Block< RetType > > cast_then = createCastBlock< RetType >( in_then );
+  LocalCountPtr< Block< RetType > > cast_else = createCastBlock< RetType >( in_else );
 
   const bool then_is_scalar = ( in_then->getDims() == 0 );
   const bool else_is_scalar = ( in_else->getDims() == 0 );
@@ -288,6 +288,11 @@ bool IfThenElse::tick( void )
   return true;
 }
 
+bool IfThenElse::isPure( void ) const
+{
+  return true;
+}
+
  } // namespace core {
 } // namespace RPGML
 
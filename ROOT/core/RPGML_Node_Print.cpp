@@ -17,7 +17,7 @@
  */
 #include "RPGML_Node_Print.h"
 
-#include <iostream>
+#include <RPGML/Log.h>
 
 namespace RPGML {
 namespace core {
@@ -41,7 +41,8 @@ const char *Print::getName( void ) const
 bool Print::tick( void )
 {
   GET_INPUT_BASE( INPUT_IN, in_base );
-  in_base->print( std::cout, true );
+  Log::Entry entry;
+  in_base->print( entry.stream(), true );
   return true;
 }
 
@@ -173,6 +173,11 @@ bool Ramp::tick( void )
   return true;
 }
 
+bool Ramp::isPure( void ) const
+{
+  return true;
+}
+
  } // namespace core {
 } // namespace RPGML
 
@@ -80,6 +80,11 @@ bool ToString::tick( void )
   return true;
 }
 
+bool ToString::isPure( void ) const
+{
+  return true;
+}
+
  } // namespace core {
 } // namespace RPGML
 
@@ -31,16 +31,21 @@ namespace cv {
 VideoCapture::VideoCapture( GarbageCollector *_gc, const String &identifier, const RPGML::SharedObject *so )
 : Node( _gc, identifier, so, NUM_INPUTS, NUM_OUTPUTS, NUM_PARAMS )
 , m_device( -1 )
+, m_ring( 1 )
 {
   DEFINE_INPUT ( INPUT_DEVICE  , "device"   );
   DEFINE_INPUT ( INPUT_FILENAME, "filename" );
   DEFINE_OUTPUT( OUTPUT_RED  , "red"   );
   DEFINE_OUTPUT( OUTPUT_GREEN, "green" );
   DEFINE_OUTPUT( OUTPUT_BLUE , "blue"  );
+  DEFINE_PARAM ( PARAM_RING, "ring", VideoCapture::set_ring );
 }
 
 VideoCapture::~VideoCapture( void )
-{}
+{
+  // The Reader uses m_capture
+  m_reader.reset();
+}
 
 const char *VideoCapture::getName( void ) const
 {
@@ -50,11 +55,31 @@ const char *VideoCapture::getName( void ) const
 void VideoCapture::gc_clear( void )
 {
   Base::gc_clear();
+  m_reader.reset();
+  m_handed_out.clear();
+  m_spare.clear();
 }
 
 void VideoCapture::gc_getChildren( Children &children ) const
 {
   Base::gc_getChildren( children );
+  children << m_reader;
+  for( size_t i=0; i<m_handed_out.size(); ++i )
+  {
+    children << m_handed_out[ i ].data;
+  }
+}
+
+void VideoCapture::set_ring( const Value &value, index_t, int, const index_t * )
+{
+  const int ring = value.save_cast< int >();
+  if( ring < 0 )
+  {
+    throw Exception() << "Param 'ring' must not be negative, is " << ring;
+  }
+  m_ring = index_t( ring );
+  // Frames already read ahead are dropped
+  m_reader.reset();
 }
 
 bool VideoCapture::tick( void )
@@ -74,6 +99,7 @@ bool VideoCapture::tick( void )
 
   if( filename && m_filename != (**filename) )
   {
+    m_reader.reset();
     m_filename = (**filename);
     try
     {
@@ -110,6 +136,7 @@ bool VideoCapture::tick( void )
     {
       try
       {
+        m_reader.reset();
         m_device = device;
         m_capture.open( m_device );
         if( !m_capture.isOpened() )
@@ -128,19 +155,14 @@ bool VideoCapture::tick( void )
   }
 
   ::cv::Mat frame;
-  try
+  if( !read( frame ) )
   {
-    if( !m_capture.read( frame ) )
-    {
-      throw ExitRequest() << "No more frames";
-    }
-  }
-  catch( const ::cv::Exception &e )
-  {
-    throw Exception() << "Opening VideoCapture failed: " << e.what();
+    throw ExitRequest() << "No more frames";
   }
 
-  CountPtr< ArrayArray > channels = createArrays( getGC(), frame );
+  // The channels are views on frame, no pixels are copied
+  CountPtr< Collectable > data;
+  CountPtr< ArrayArray > channels = createArrayViews( getGC(), frame, &data );
 
   if( channels->size() == 1 )
   {
@@ -165,9 +187,171 @@ bool VideoCapture::tick( void )
   getOutput( OUTPUT_GREEN )->setChanged();
   getOutput( OUTPUT_BLUE  )->setChanged();
 
+  if( !data.isNull() )
+  {
+    HandedOut handed_out;
+    handed_out.frame = frame;
+    handed_out.data  = data;
+    m_handed_out.push_back( handed_out );
+  }
+
+  recycle();
+
+  return true;
+}
+
+bool VideoCapture::read( ::cv::Mat &frame )
+{
+  if( m_ring > 0 )
+  {
+    if( m_reader.isNull() )
+    {
+      m_reader = new Reader( getGC(), &m_capture, m_ring );
+    }
+    return m_reader->pop( frame );
+  }
+
+  if( !m_spare.empty() )
+  {
+    frame = m_spare.back();
+    m_spare.pop_back();
+  }
+
+  try
+  {
+    return m_capture.read( frame );
+  }
+  catch( const ::cv::Exception &e )
+  {
+    throw Exception() << "Reading from VideoCapture failed: " << e.what();
+  }
+}
+
+void VideoCapture::recycle( void )
+{
+  // Only referenced from here means no Array uses the frame anymore, its buffer can be read into again
+  size_t n = 0;
+  for( size_t i=0; i<m_handed_out.size(); ++i )
+  {
+    HandedOut &handed_out = m_handed_out[ i ];
+    if( handed_out.data->refCount() == 1 )
+    {
+      handed_out.data.reset();
+      if( !m_reader.isNull() )
+      {
+        m_reader->recycle( handed_out.frame );
+      }
+      else
+      {
+        m_spare.push_back( handed_out.frame );
+      }
+    }
+    else
+    {
+      if( n != i ) m_handed_out[ n ] = handed_out;
+      ++n;
+    }
+  }
+  m_handed_out.resize( n );
+}
+
+VideoCapture::Reader::Reader( GarbageCollector *_gc, ::cv::VideoCapture *capture, index_t depth )
+: Thread( _gc, false )
+, m_free_slots( Semaphore::value_t( depth ) )
+, m_capture( capture )
+, m_stop( false )
+{
+  start();
+}
+
+VideoCapture::Reader::~Reader( void )
+{
+  stop();
+}
+
+void VideoCapture::Reader::stop( void )
+{
+  if( !isRunning() ) return;
+
+  {
+    Mutex::ScopedLock lock( &m_lock );
+    m_stop = true;
+  }
+  // Wakes run() when it waits for a free slot
+  ++m_free_slots;
+  join();
+}
+
+bool VideoCapture::Reader::pop( ::cv::Mat &frame )
+{
+  --m_filled;
+
+  Entry entry;
+  {
+    Mutex::ScopedLock lock( &m_lock );
+    entry = m_read.front();
+    if( entry.ok ) m_read.pop_front();
+  }
+
+  if( !entry.ok )
+  {
+    // run() has ended, the entry stays for further calls
+    ++m_filled;
+    if( !entry.error.empty() )
+    {
+      throw Exception() << "Reading from VideoCapture failed: " << entry.error;
+    }
+    return false;
+  }
+
+  frame = entry.frame;
+  ++m_free_slots;
   return true;
 }
 
+void VideoCapture::Reader::recycle( const ::cv::Mat &frame )
+{
+  Mutex::ScopedLock lock( &m_lock );
+  m_spare.push_back( frame );
+}
+
+size_t VideoCapture::Reader::run( void )
+{
+  for(;;)
+  {
+    --m_free_slots;
+
+    Entry entry;
+    {
+      Mutex::ScopedLock lock( &m_lock );
+      if( m_stop ) return 0;
+      if( !m_spare.empty() )
+      {
+        entry.frame = m_spare.back();
+        m_spare.pop_back();
+      }
+    }
+
+    try
+    {
+      entry.ok = m_capture->read( entry.frame );
+    }
+    catch( const ::cv::Exception &e )
+    {
+      entry.ok = false;
+      entry.error = e.what();
+    }
+
+    {
+      Mutex::ScopedLock lock( &m_lock );
+      m_read.push_back( entry );
+    }
+    ++m_filled;
+
+    if( !entry.ok ) return 0;
+  }
+}
+
  } // namespace cv {
 } // namespace RPGML
 
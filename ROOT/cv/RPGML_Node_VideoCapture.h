@@ -19,8 +19,15 @@
 #define RPGML_Node_cv_VideoCapture_h
 
 #include <RPGML/Node.h>
+#include <RPGML/Thread.h>
+#include <RPGML/Semaphore.h>
+#include <RPGML/Mutex.h>
 #include <opencv2/highgui/highgui.hpp>
 
+#include <deque>
+#include <vector>
+#include <string>
+
 namespace RPGML {
 namespace cv {
 
@@ -40,6 +47,8 @@ public:
   virtual void gc_clear( void );
   virtual void gc_getChildren( Children &children ) const;
 
+  void set_ring( const Value &value, index_t index, int n_coords, const index_t *coords );
+
 private:
   typedef NodeParam< VideoCapture > NParam;
 
@@ -60,13 +69,63 @@ private:
 
   enum Params
   {
-    PARAM_FOO,
+    PARAM_RING,
     NUM_PARAMS
   };
 
+  //! @brief Reads frames from the capture ahead of tick(), at most depth are waiting
+  class Reader : public Thread
+  {
+    typedef Thread Base;
+  public:
+    explicit
+    Reader( GarbageCollector *_gc, ::cv::VideoCapture *capture, index_t depth );
+    virtual ~Reader( void );
+
+    //! Blocks until the next frame was read, returns false at the end of the stream
+    bool pop( ::cv::Mat &frame );
+    //! Hands back a frame whose buffer is not used anymore, the next read may reuse it
+    void recycle( const ::cv::Mat &frame );
+
+  protected:
+    virtual size_t run( void );
+
+  private:
+    struct Entry
+    {
+      ::cv::Mat frame;
+      std::string error;
+      bool ok;
+    };
+
+    void stop( void );
+
+    std::deque< Entry > m_read;
+    std::vector< ::cv::Mat > m_spare;
+    Semaphore m_free_slots;
+    Semaphore m_filled;
+    Mutex m_lock;
+    ::cv::VideoCapture *m_capture;
+    bool m_stop;
+  };
+
+  //! A frame handed out as views, with the ArrayData shared by the views
+  struct HandedOut
+  {
+    ::cv::Mat frame;
+    CountPtr< Collectable > data;
+  };
+
+  bool read( ::cv::Mat &frame );
+  void recycle( void );
+
   ::cv::VideoCapture m_capture;
+  CountPtr< Reader > m_reader;
+  std::vector< HandedOut > m_handed_out;
+  std::vector< ::cv::Mat > m_spare;
   String m_filename;
   int    m_device;
+  index_t m_ring;
 };
 
  } // namespace cv {
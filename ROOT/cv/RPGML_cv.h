@@ -134,6 +134,108 @@ CountPtr< ArrayArray > createArrays( GarbageCollector *gc, const ::cv::Mat &mat
       throw Exception() << "RPGML.cv.createArray( Mat ): Unsupported Mat type";
   }
 }
+
+//! @brief ArrayData sharing the buffer of a ::cv::Mat
+/*!
+ * Holds a reference on the Mat, so its pixels stay valid as long as any Array uses this.
+ * The size is [ row length in elements, i.e. including interleaved channels and padding, rows ].
+ */
+template< class Element >
+class MatArrayData : public ArrayData< Element >
+{
+  typedef ArrayData< Element > Base;
+public:
+  explicit
+  MatArrayData( GarbageCollector *_gc, const ::cv::Mat &mat, const index_t *s )
+  : Base( _gc, 2, s )
+  , m_mat( mat )
+  {
+    Base::setElements( m_mat.ptr< Element >(), Base::calc_size( 2, s ) );
+  }
+
+  virtual ~MatArrayData( void )
+  {}
+
+  virtual void gc_clear( void )
+  {
+    Base::gc_clear();
+    Base::setElements( 0, 0 );
+    m_mat = ::cv::Mat();
+  }
+
+  const ::cv::Mat &getMat( void ) const { return m_mat; }
+
+private:
+  ::cv::Mat m_mat;
+};
+
+template< class Element >
+CountPtr< ArrayArray > createArrayViews_t( GarbageCollector *gc, const ::cv::Mat &mat, CountPtr< Collectable > *data_ret )
+{
+  if( mat.depth() != ::cv::DataDepth< Element >::value )
+  {
+    throw Exception() << "RPGML.cv.createArrayViews_t( Mat ): Element type does not match the Mat type";
+  }
+  if( mat.channels() < 1 )
+  {
+    throw Exception() << "RPGML.cv.createArrayViews_t( Mat ) expects Mat to have at least one channel";
+  }
+
+  typedef Array< Element > ArrayType;
+
+  const index_t channels = index_t( mat.channels() );
+  const index_t cols     = index_t( mat.cols );
+  const index_t rows     = index_t( mat.rows );
+
+  const index_t data_size[ 2 ] = { index_t( mat.step1() ), rows };
+  CountPtr< MatArrayData< Element > > data = new MatArrayData< Element >( gc, mat, data_size );
+
+  // Channel c starts at element c of each pixel, every channels'th element belongs to it
+  const index_t roi_x[ 2 ] = { 0, 0 };
+  const index_t roi_s[ 2 ] = { cols * channels, rows };
+
+  CountPtr< ArrayArray > ret = new ArrayArray( gc, 1, channels );
+  for( index_t c=0; c<channels; ++c )
+  {
+    CountPtr< ArrayType > view = new ArrayType( gc, data );
+    view->setROI( 2, roi_x, roi_s );
+    view->setSparse( 0, stride_t( channels ), c );
+    ret->at( c ) = view;
+  }
+
+  if( data_ret ) (*data_ret) = data;
+
+  return ret;
+}
+
+//! @brief Like createArrays(), but the returned channels are strided views on the pixels of mat, no copy is made
+/*!
+ * If data_ret is given, it receives the ArrayData shared by all views.
+ * Its refCount() drops to 1 once no Array uses mat anymore, so mat's buffer may then be reused.
+ * Falls back to createArrays() for Mats that cannot be viewed as 2D with whole-element row steps.
+ */
+CountPtr< ArrayArray > createArrayViews( GarbageCollector *gc, const ::cv::Mat &mat, CountPtr< Collectable > *data_ret = 0 )
+{
+  if( mat.dims != 2 || mat.step[ 0 ] != mat.step1() * mat.elemSize1() )
+  {
+    if( data_ret ) data_ret->reset();
+    return createArrays( gc, mat );
+  }
+
+  switch( mat.depth() )
+  {
+    case ::cv::DataDepth< uint8_t  >::value: return createArrayViews_t< uint8_t  >( gc, mat, data_ret );
+    case ::cv::DataDepth< int8_t   >::value: return createArrayViews_t< int8_t   >( gc, mat, data_ret );
+    case ::cv::DataDepth< uint16_t >::value: return createArrayViews_t< uint16_t >( gc, mat, data_ret );
+    case ::cv::DataDepth< int16_t  >::value: return createArrayViews_t< int16_t  >( gc, mat, data_ret );
+    case ::cv::DataDepth< int      >::value: return createArrayViews_t< int      >( gc, mat, data_ret );
+    case ::cv::DataDepth< float    >::value: return createArrayViews_t< float    >( gc, mat, data_ret );
+    case ::cv::DataDepth< double   >::value: return createArrayViews_t< double   >( gc, mat, data_ret );
+    default:
+      throw Exception() << "RPGML.cv.createArrayViews( Mat ): Unsupported Mat type";
+  }
+}
+
 } // namespace cv
 } // namespace RPGML
 
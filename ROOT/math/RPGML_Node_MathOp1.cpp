@@ -103,6 +103,11 @@ bool MathOp1::tick( void )
   return true;
 }
 
+bool MathOp1::isPure( void ) const
+{
+  return true;
+}
+
  } // namespace math {
 } // namespace RPGML
 
@@ -38,6 +38,8 @@ public:
 
   virtual bool tick( void );
 
+  virtual bool isPure( void ) const;
+
   virtual void gc_clear( void );
   virtual void gc_getChildren( Children &children ) const;
 
@@ -0,0 +1,153 @@
+/* This file is part of RPGML.
+ *
+ * Copyright (c) 2014, Gunnar Payer, All rights reserved.
+ *
+ * RPGML is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3.0 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.
+ */
+#include "RPGML_Node_SavePPM.h"
+
+// RPGML_CXXFLAGS=
+// RPGML_LDFLAGS=
+
+#include <RPGML/Guard.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cerrno>
+#include <cstring>
+
+using namespace std;
+
+namespace RPGML {
+namespace util {
+
+SavePPM::SavePPM( GarbageCollector *_gc, const String &identifier, const RPGML::SharedObject *so )
+: Node( _gc, identifier, so, NUM_INPUTS, NUM_OUTPUTS, NUM_PARAMS )
+{
+  DEFINE_INPUT ( INPUT_FILENAME, "filename" );
+  DEFINE_INPUT ( INPUT_RED  , "red"   );
+  DEFINE_INPUT ( INPUT_GREEN, "green" );
+  DEFINE_INPUT ( INPUT_BLUE , "blue"  );
+  DEFINE_OUTPUT( OUTPUT_OUT , "out"   );
+  DEFINE_PARAM ( PARAM_RAW  , "raw", SavePPM::set_raw );
+}
+
+SavePPM::~SavePPM( void )
+{}
+
+const char *SavePPM::getName( void ) const
+{
+  return "util.SavePPM";
+}
+
+void SavePPM::gc_clear( void )
+{
+  Base::gc_clear();
+}
+
+void SavePPM::gc_getChildren( Children &children ) const
+{
+  Base::gc_getChildren( children );
+}
+
+void SavePPM::set_raw( const Value &value, index_t, int, const index_t * )
+{
+  m_raw = value.save_cast< bool >();
+}
+
+bool SavePPM::tick( void )
+{
+  if( !hasAnyInputChanged() ) return true;
+  setAllOutputChanged();
+
+  GET_INPUT_AS_DIMS( INPUT_FILENAME, filename, String, 0 );
+  GET_INPUT_AS_DIMS( INPUT_RED  , red  , uint8_t, 2 );
+  GET_INPUT_AS_DIMS( INPUT_GREEN, green, uint8_t, 2 );
+  GET_INPUT_AS_DIMS( INPUT_BLUE , blue , uint8_t, 2 );
+
+  const ArrayBase::Size size = red->getSize();
+
+  if( green->getSize() != size || blue->getSize() != size )
+  {
+    throw Exception()
+      << "Sizes of Inputs 'red', 'green' and 'blue' must match"
+      << ": 'red' is " << size
+      << ", 'green' is " << green->getSize()
+      << ", 'blue' is " << blue->getSize()
+      ;
+  }
+
+  const index_t width  = size[ 0 ];
+  const index_t height = size[ 1 ];
+
+  // Interleave row by row, the packed buffer is kept across ticks
+  m_packed.resize( size_t( width ) * height * 3 );
+
+  const stride_t *const r_stride = red  ->getStride();
+  const stride_t *const g_stride = green->getStride();
+  const stride_t *const b_stride = blue ->getStride();
+
+  for( index_t y=0; y<height; ++y )
+  {
+    uint8_t *const p = &m_packed[ size_t( y ) * width * 3 ];
+    const uint8_t *const r = red  ->elements() + stride_t( y ) * r_stride[ 1 ];
+    const uint8_t *const g = green->elements() + stride_t( y ) * g_stride[ 1 ];
+    const uint8_t *const b = blue ->elements() + stride_t( y ) * b_stride[ 1 ];
+
+    for( index_t x=0; x<width; ++x )
+    {
+      const stride_t sx = stride_t( x );
+      p[ 3*x+0 ] = r[ sx * r_stride[ 0 ] ];
+      p[ 3*x+1 ] = g[ sx * g_stride[ 0 ] ];
+      p[ 3*x+2 ] = b[ sx * b_stride[ 0 ] ];
+    }
+  }
+
+  Guard< FILE, int > file( ::fopen( (**filename), "wb" ), ::fclose );
+  if( !file )
+  {
+    throw Exception()
+      << "Could not open file '" << (**filename) << "' for writing"
+      << ": " << ::strerror( errno )
+      ;
+  }
+
+  if( !m_raw )
+  {
+    if( 0 > ::fprintf( file, "P6\n%u %u\n255\n", unsigned( width ), unsigned( height ) ) )
+    {
+      throw Exception()
+        << "Could not write PPM header to '" << (**filename) << "'"
+        << ": " << ::strerror( errno )
+        ;
+    }
+  }
+
+  if( !m_packed.empty() && 1 != ::fwrite( &m_packed[ 0 ], m_packed.size(), 1, file ) )
+  {
+    throw Exception()
+      << "Could not write to already opened file '" << (**filename) << "'"
+      << ": " << ::strerror( errno )
+      ;
+  }
+
+  getOutput( OUTPUT_OUT )->setData( const_cast< StringArray* >( filename ) );
+  return true;
+}
+
+ } // namespace util {
+} // namespace RPGML
+
+RPGML_CREATE_NODE( SavePPM, util:: )
+
@@ -0,0 +1,79 @@
+/* This file is part of RPGML.
+ *
+ * Copyright (c) 2014, Gunnar Payer, All rights reserved.
+ *
+ * RPGML is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3.0 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.
+ */
+#ifndef RPGML_Node_util_SavePPM_h
+#define RPGML_Node_util_SavePPM_h
+
+#include <RPGML/Node.h>
+
+#include <vector>
+
+namespace RPGML {
+namespace util {
+
+//! @brief Writes planar red, green and blue channels as binary PPM (P6) or headerless raw RGB, without SDL
+class SavePPM : public Node
+{
+  typedef Node Base;
+public:
+  EXCEPTION_BASE( Exception );
+
+  SavePPM( GarbageCollector *gc, const String &identifier, const SharedObject *so );
+  virtual ~SavePPM( void );
+
+  virtual const char *getName( void ) const;
+
+  virtual bool tick( void );
+
+  virtual void gc_clear( void );
+  virtual void gc_getChildren( Children &children ) const;
+
+  void set_raw( const Value &value, index_t index, int n_coords, const index_t *coords );
+
+private:
+  typedef NodeParam< SavePPM > NParam;
+
+  enum Inputs
+  {
+    INPUT_FILENAME,
+    INPUT_RED  ,
+    INPUT_GREEN,
+    INPUT_BLUE ,
+    NUM_INPUTS
+  };
+
+  enum Outputs
+  {
+    OUTPUT_OUT,
+    NUM_OUTPUTS
+  };
+
+  enum Params
+  {
+    PARAM_RAW,
+    NUM_PARAMS
+  };
+
+  std::vector< uint8_t > m_packed;
+  bool m_raw = false;
+};
+
+ } // namespace util {
+} // namespace RPGML
+
+#endif
+
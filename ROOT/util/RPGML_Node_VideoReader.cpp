@@ -0,0 +1,475 @@
+/* This file is part of RPGML.
+ *
+ * Copyright (c) 2015, Gunnar Payer, All rights reserved.
+ *
+ * RPGML is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3.0 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.
+ */
+#include "RPGML_Node_VideoReader.h"
+
+// RPGML_CXXFLAGS=
+// RPGML_LDFLAGS=
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+using namespace std;
+
+namespace RPGML {
+namespace util {
+
+namespace VideoReader_impl {
+
+static
+int dont_close( FILE * )
+{
+  return 0;
+}
+
+static
+bool ends_with( const String &s, const char *suffix )
+{
+  const size_t n = ::strlen( suffix );
+  return s.length() >= n && 0 == ::strcmp( s.c_str() + s.length() - n, suffix );
+}
+
+//! Reads a line without the '\n', returns false at the end of file before any character
+static
+bool read_line( FILE *file, std::string &line )
+{
+  line.clear();
+  int c;
+  while( EOF != ( c = ::fgetc( file ) ) )
+  {
+    if( c == '\n' ) return true;
+    line += char( c );
+  }
+  return !line.empty();
+}
+
+//! Planar or interleaved frame bytes to separate channels
+static
+void unpack( const VideoFormat &format, const uint8_t *frame, uint8_t *r, uint8_t *g, uint8_t *b )
+{
+  const index_t w = format.width;
+  const index_t h = format.height;
+  const size_t plane = size_t( w ) * h;
+
+  switch( format.chroma )
+  {
+    case VideoFormat::CHROMA_MONO:
+      std::copy( frame, frame + plane, r );
+      break;
+
+    case VideoFormat::CHROMA_RGB:
+      for( size_t i=0; i<plane; ++i, frame += 3 )
+      {
+        r[ i ] = frame[ 0 ];
+        g[ i ] = frame[ 1 ];
+        b[ i ] = frame[ 2 ];
+      }
+      break;
+
+    case VideoFormat::CHROMA_420:
+    case VideoFormat::CHROMA_422:
+    case VideoFormat::CHROMA_444:
+      {
+        // Chroma subsampling shifts per dimension
+        const int sx = ( format.chroma == VideoFormat::CHROMA_444 ? 0 : 1 );
+        const int sy = ( format.chroma == VideoFormat::CHROMA_420 ? 1 : 0 );
+        const size_t cw = ( size_t( w ) + size_t( sx ) ) >> sx;
+        const size_t ch = ( size_t( h ) + size_t( sy ) ) >> sy;
+        const uint8_t *const Y = frame;
+        const uint8_t *const U = Y + plane;
+        const uint8_t *const V = U + cw * ch;
+
+        for( index_t y=0; y<h; ++y )
+        {
+          const uint8_t *const y_row = Y + size_t( y ) * w;
+          const uint8_t *const u_row = U + size_t( y >> sy ) * cw;
+          const uint8_t *const v_row = V + size_t( y >> sy ) * cw;
+          const size_t o = size_t( y ) * w;
+          for( index_t x=0; x<w; ++x )
+          {
+            video_impl::yuv2rgb( y_row[ x ], u_row[ x >> sx ], v_row[ x >> sx ], r[ o+x ], g[ o+x ], b[ o+x ] );
+          }
+        }
+      }
+      break;
+  }
+}
+
+} // namespace VideoReader_impl
+
+using namespace VideoReader_impl;
+
+VideoReader::VideoReader( GarbageCollector *_gc, const String &identifier, const RPGML::SharedObject *so )
+: Node( _gc, identifier, so, NUM_INPUTS, NUM_OUTPUTS, NUM_PARAMS )
+, m_format_name( "auto" )
+, m_width( 0 )
+, m_height( 0 )
+, m_read_ahead_depth( 2 )
+, m_frame_index( 0 )
+, m_y4m( false )
+{
+  DEFINE_INPUT ( INPUT_FILENAME, "filename" );
+  DEFINE_OUTPUT_INIT( OUTPUT_RED  , "red"  , uint8_t, 2 );
+  DEFINE_OUTPUT_INIT( OUTPUT_GREEN, "green", uint8_t, 2 );
+  DEFINE_OUTPUT_INIT( OUTPUT_BLUE , "blue" , uint8_t, 2 );
+  DEFINE_OUTPUT_INIT( OUTPUT_FRAME, "frame", int, 0 );
+  DEFINE_PARAM ( PARAM_FORMAT    , "format"    , VideoReader::set_format );
+  DEFINE_PARAM ( PARAM_WIDTH     , "width"     , VideoReader::set_width );
+  DEFINE_PARAM ( PARAM_HEIGHT    , "height"    , VideoReader::set_height );
+  DEFINE_PARAM ( PARAM_READ_AHEAD, "read_ahead", VideoReader::set_read_ahead );
+}
+
+VideoReader::~VideoReader( void )
+{
+  // ReadAhead uses m_file
+  m_read_ahead.reset();
+}
+
+const char *VideoReader::getName( void ) const
+{
+  return "util.VideoReader";
+}
+
+void VideoReader::gc_clear( void )
+{
+  Base::gc_clear();
+  m_read_ahead.reset();
+  m_file.clear();
+}
+
+void VideoReader::gc_getChildren( Children &children ) const
+{
+  Base::gc_getChildren( children );
+  children << m_read_ahead;
+}
+
+void VideoReader::set_format( const Value &value, index_t, int, const index_t * )
+{
+  if( !value.isString() )
+  {
+    throw Exception() << "Param 'format' must be set with a string, is " << value.getType();
+  }
+
+  const String format = value.getString();
+  if( format != "auto" && format != "y4m" && format != "rgb" && format != "gray" )
+  {
+    throw Exception()
+      << "Param 'format' must be one of \"auto\", \"y4m\", \"rgb\" or \"gray\", is \"" << format << "\""
+      ;
+  }
+  m_format_name = format;
+}
+
+void VideoReader::set_width( const Value &value, index_t, int, const index_t * )
+{
+  const int width = value.save_cast< int >();
+  if( width < 0 )
+  {
+    throw Exception() << "Param 'width' must not be negative, is " << width;
+  }
+  m_width = index_t( width );
+}
+
+void VideoReader::set_height( const Value &value, index_t, int, const index_t * )
+{
+  const int height = value.save_cast< int >();
+  if( height < 0 )
+  {
+    throw Exception() << "Param 'height' must not be negative, is " << height;
+  }
+  m_height = index_t( height );
+}
+
+void VideoReader::set_read_ahead( const Value &value, index_t, int, const index_t * )
+{
+  const int depth = value.save_cast< int >();
+  if( depth < 0 )
+  {
+    throw Exception() << "Param 'read_ahead' must not be negative, is " << depth;
+  }
+  m_read_ahead_depth = index_t( depth );
+}
+
+void VideoReader::open( const String &filename )
+{
+  m_read_ahead.reset();
+  m_file.clear();
+  m_filename.clear();
+  m_frame_index = 0;
+
+  const bool is_stdin = ( filename == "-" );
+
+  m_y4m =
+       m_format_name == "y4m"
+    || ( m_format_name == "auto" && ( is_stdin || ends_with( filename, ".y4m" ) ) )
+    ;
+
+  if( is_stdin )
+  {
+    m_file.set( stdin, dont_close );
+  }
+  else
+  {
+    m_file.set( ::fopen( filename.c_str(), "rb" ), ::fclose );
+    if( m_file.isNull() )
+    {
+      throw Exception()
+        << "Could not open file '" << filename << "' for reading"
+        << ": " << ::strerror( errno )
+        ;
+    }
+  }
+
+  m_format = VideoFormat();
+
+  if( m_y4m )
+  {
+    std::string header;
+    if( !read_line( m_file, header ) || 0 != header.compare( 0, 10, "YUV4MPEG2 " ) )
+    {
+      throw Exception() << "'" << filename << "' is not a YUV4MPEG2 stream";
+    }
+    m_format.parseTags( header.c_str() + 10 );
+    if( m_format.chroma == VideoFormat::CHROMA_RGB )
+    {
+      throw Exception() << "Unsupported color space 'rgb' in YUV4MPEG2 stream '" << filename << "'";
+    }
+  }
+  else
+  {
+    // Raw frames: The layout comes from the params or from the sidecar header "<filename>.hdr"
+    if( m_width > 0 && m_height > 0 )
+    {
+      m_format.width  = m_width;
+      m_format.height = m_height;
+      m_format.chroma = ( m_format_name == "gray" ? VideoFormat::CHROMA_MONO : VideoFormat::CHROMA_RGB );
+    }
+    else
+    {
+      if( is_stdin )
+      {
+        throw Exception() << "Params 'width' and 'height' are required for reading raw frames from stdin";
+      }
+
+      const std::string header_filename = std::string( filename.c_str() ) + ".hdr";
+      Guard< FILE, int > header_file( ::fopen( header_filename.c_str(), "r" ), ::fclose );
+      std::string header;
+      if( !header_file || !read_line( header_file, header ) )
+      {
+        throw Exception()
+          << "Could not read sidecar header '" << header_filename << "'"
+          << ", set params 'width' and 'height' for headerless raw frames"
+          ;
+      }
+      m_format.chroma = VideoFormat::CHROMA_RGB;
+      m_format.parseTags( header.c_str() );
+      if( m_format_name == "gray" ) m_format.chroma = VideoFormat::CHROMA_MONO;
+      if( m_format_name == "rgb"  ) m_format.chroma = VideoFormat::CHROMA_RGB;
+      if( m_format.isYUV() )
+      {
+        throw Exception() << "Sidecar header '" << header_filename << "' must specify Crgb or Cgray";
+      }
+    }
+  }
+
+  m_filename = filename;
+}
+
+bool VideoReader::readFrame( std::vector< uint8_t > &frame )
+{
+  if( m_y4m )
+  {
+    // Each frame starts with a "FRAME" line, which may contain parameters
+    std::string line;
+    if( !read_line( m_file, line ) ) return false;
+    if( 0 != line.compare( 0, 5, "FRAME" ) )
+    {
+      throw Exception() << "Expected FRAME in '" << m_filename << "'";
+    }
+  }
+
+  const size_t frame_bytes = m_format.frameBytes();
+  frame.resize( frame_bytes );
+
+  const size_t n = ::fread( &frame[ 0 ], 1, frame_bytes, m_file );
+  if( n == 0 && !m_y4m && ::feof( m_file ) ) return false;
+  if( n != frame_bytes )
+  {
+    throw Exception()
+      << "Truncated frame " << m_frame_index << " in '" << m_filename << "'"
+      << ": expected " << frame_bytes << " bytes, got " << n
+      ;
+  }
+
+  return true;
+}
+
+bool VideoReader::tick( void )
+{
+  GET_INPUT_AS_DIMS( INPUT_FILENAME, filename, String, 0 );
+
+  if( m_file.isNull() || m_filename != (**filename) )
+  {
+    open( (**filename) );
+  }
+
+  bool got_frame = false;
+  if( m_read_ahead_depth > 0 )
+  {
+    if( m_read_ahead.isNull() )
+    {
+      m_read_ahead = new ReadAhead( getGC(), this, m_read_ahead_depth );
+    }
+    got_frame = m_read_ahead->pop( m_frame );
+  }
+  else
+  {
+    got_frame = readFrame( m_frame );
+  }
+
+  if( !got_frame )
+  {
+    throw ExitRequest() << "End of video stream '" << m_filename << "'";
+  }
+
+  const index_t size[ 2 ] = { m_format.width, m_format.height };
+
+  GET_OUTPUT_INIT( OUTPUT_RED  , red  , uint8_t, 2, size );
+  GET_OUTPUT_INIT( OUTPUT_FRAME, frame, int    , 0, nullptr );
+
+  if( m_format.chroma == VideoFormat::CHROMA_MONO )
+  {
+    unpack( m_format, &m_frame[ 0 ], red->elements(), 0, 0 );
+    getOutput( OUTPUT_GREEN )->setData( red );
+    getOutput( OUTPUT_BLUE  )->setData( red );
+  }
+  else
+  {
+    // After mono frames green and blue still share red's Array, initData() would reuse it
+    if( getOutput( OUTPUT_GREEN )->getData() == red ) getOutput( OUTPUT_GREEN )->setData( CountPtr< ArrayBase >() );
+    if( getOutput( OUTPUT_BLUE  )->getData() == red ) getOutput( OUTPUT_BLUE  )->setData( CountPtr< ArrayBase >() );
+    GET_OUTPUT_INIT( OUTPUT_GREEN, green, uint8_t, 2, size );
+    GET_OUTPUT_INIT( OUTPUT_BLUE , blue , uint8_t, 2, size );
+    unpack( m_format, &m_frame[ 0 ], red->elements(), green->elements(), blue->elements() );
+  }
+
+  (**frame) = m_frame_index++;
+
+  setAllOutputChanged();
+  return true;
+}
+
+VideoReader::ReadAhead::ReadAhead( GarbageCollector *_gc, VideoReader *reader, index_t depth )
+: Thread( _gc, false )
+, m_free_slots( Semaphore::value_t( depth ) )
+, m_reader( reader )
+, m_stop( false )
+{
+  start();
+}
+
+VideoReader::ReadAhead::~ReadAhead( void )
+{
+  stop();
+}
+
+void VideoReader::ReadAhead::stop( void )
+{
+  if( !isRunning() ) return;
+
+  {
+    Mutex::ScopedLock lock( &m_lock );
+    m_stop = true;
+  }
+  // Wakes run() when it waits for a free slot
+  ++m_free_slots;
+  join();
+}
+
+bool VideoReader::ReadAhead::pop( std::vector< uint8_t > &frame )
+{
+  --m_filled;
+
+  Mutex::ScopedLock lock( &m_lock );
+  Entry &entry = m_read.front();
+
+  if( !entry.ok )
+  {
+    // run() has ended, the entry stays for further calls
+    ++m_filled;
+    if( !entry.error.empty() )
+    {
+      throw Exception() << entry.error;
+    }
+    return false;
+  }
+
+  // Swapping hands the previous frame's buffer back for reuse
+  frame.swap( entry.frame );
+  m_spare.push_back( std::vector< uint8_t >() );
+  m_spare.back().swap( entry.frame );
+  m_read.pop_front();
+  ++m_free_slots;
+  return true;
+}
+
+size_t VideoReader::ReadAhead::run( void )
+{
+  for(;;)
+  {
+    --m_free_slots;
+
+    Entry entry;
+    {
+      Mutex::ScopedLock lock( &m_lock );
+      if( m_stop ) return 0;
+      if( !m_spare.empty() )
+      {
+        entry.frame.swap( m_spare.back() );
+        m_spare.pop_back();
+      }
+    }
+
+    try
+    {
+      entry.ok = m_reader->readFrame( entry.frame );
+    }
+    catch( const RPGML::Exception &e )
+    {
+      entry.ok = false;
+      entry.error = e.what();
+    }
+
+    {
+      Mutex::ScopedLock lock( &m_lock );
+      m_read.push_back( Entry() );
+      m_read.back().frame.swap( entry.frame );
+      m_read.back().error.swap( entry.error );
+      m_read.back().ok = entry.ok;
+    }
+    ++m_filled;
+
+    if( !entry.ok ) return 0;
+  }
+}
+
+ } // namespace util {
+} // namespace RPGML
+
+RPGML_CREATE_NODE( VideoReader, util:: )
+
@@ -0,0 +1,139 @@
+/* This file is part of RPGML.
+ *
+ * Copyright (c) 2015, Gunnar Payer, All rights reserved.
+ *
+ * RPGML is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3.0 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.
+ */
+#ifndef RPGML_Node_util_VideoReader_h
+#define RPGML_Node_util_VideoReader_h
+
+#include <RPGML/Node.h>
+#include <RPGML/Thread.h>
+#include <RPGML/Semaphore.h>
+#include <RPGML/Mutex.h>
+#include <RPGML/Guard.h>
+#include "RPGML_video.h"
+
+#include <cstdio>
+#include <deque>
+#include <vector>
+#include <string>
+
+namespace RPGML {
+namespace util {
+
+//! @brief Reads Y4M or raw RGB/gray video from a file or stdin ("-"), without SDL or OpenCV
+class VideoReader : public Node
+{
+  typedef Node Base;
+public:
+  EXCEPTION_BASE( Exception );
+
+  VideoReader( GarbageCollector *gc, const String &identifier, const SharedObject *so );
+  virtual ~VideoReader( void );
+
+  virtual const char *getName( void ) const;
+
+  virtual bool tick( void );
+
+  virtual void gc_clear( void );
+  virtual void gc_getChildren( Children &children ) const;
+
+  void set_format( const Value &value, index_t index, int n_coords, const index_t *coords );
+  void set_width( const Value &value, index_t index, int n_coords, const index_t *coords );
+  void set_height( const Value &value, index_t index, int n_coords, const index_t *coords );
+  void set_read_ahead( const Value &value, index_t index, int n_coords, const index_t *coords );
+
+private:
+  typedef NodeParam< VideoReader > NParam;
+
+  enum Inputs
+  {
+    INPUT_FILENAME,
+    NUM_INPUTS
+  };
+
+  enum Outputs
+  {
+    OUTPUT_RED  ,
+    OUTPUT_GREEN,
+    OUTPUT_BLUE ,
+    OUTPUT_FRAME,
+    NUM_OUTPUTS
+  };
+
+  enum Params
+  {
+    PARAM_FORMAT,
+    PARAM_WIDTH,
+    PARAM_HEIGHT,
+    PARAM_READ_AHEAD,
+    NUM_PARAMS
+  };
+
+  //! @brief Reads frames ahead of tick(), at most depth are waiting
+  class ReadAhead : public Thread
+  {
+    typedef Thread Base;
+  public:
+    explicit
+    ReadAhead( GarbageCollector *_gc, VideoReader *reader, index_t depth );
+    virtual ~ReadAhead( void );
+
+    //! Blocks until the next frame was read, returns false at the end of the stream
+    bool pop( std::vector< uint8_t > &frame );
+
+  protected:
+    virtual size_t run( void );
+
+  private:
+    struct Entry
+    {
+      std::vector< uint8_t > frame;
+      std::string error;
+      bool ok;
+    };
+
+    void stop( void );
+
+    std::deque< Entry > m_read;
+    std::vector< std::vector< uint8_t > > m_spare;
+    Semaphore m_free_slots;
+    Semaphore m_filled;
+    Mutex m_lock;
+    VideoReader *m_reader;
+    bool m_stop;
+  };
+
+  void open( const String &filename );
+  bool readFrame( std::vector< uint8_t > &frame );
+
+  Guard< FILE, int > m_file;
+  String m_filename;
+  String m_format_name;
+  VideoFormat m_format;
+  CountPtr< ReadAhead > m_read_ahead;
+  std::vector< uint8_t > m_frame;
+  index_t m_width;
+  index_t m_height;
+  index_t m_read_ahead_depth;
+  int m_frame_index;
+  bool m_y4m;
+};
+
+ } // namespace util {
+} // namespace RPGML
+
+#endif
+
@@ -0,0 +1,318 @@
+/* This file is part of RPGML.
+ *
+ * Copyright (c) 2015, Gunnar Payer, All rights reserved.
+ *
+ * RPGML is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3.0 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.
+ */
+#include "RPGML_Node_VideoWriter.h"
+
+// RPGML_CXXFLAGS=
+// RPGML_LDFLAGS=
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+using namespace std;
+
+namespace RPGML {
+namespace util {
+
+namespace VideoWriter_impl {
+
+static
+int dont_close( FILE * )
+{
+  return 0;
+}
+
+static
+bool ends_with( const String &s, const char *suffix )
+{
+  const size_t n = ::strlen( suffix );
+  return s.length() >= n && 0 == ::strcmp( s.c_str() + s.length() - n, suffix );
+}
+
+//! Copies a possibly strided 2D channel into dense, interleaved bytes, every step'th byte
+static
+void pack( const UInt8Array *in, uint8_t *out, size_t step )
+{
+  const index_t w = in->getSize()[ 0 ];
+  const index_t h = in->getSize()[ 1 ];
+  const stride_t *const stride = in->getStride();
+
+  for( index_t y=0; y<h; ++y )
+  {
+    const uint8_t *const row = in->elements() + stride_t( y ) * stride[ 1 ];
+    uint8_t *const o = out + size_t( y ) * w * step;
+    for( index_t x=0; x<w; ++x )
+    {
+      o[ size_t( x ) * step ] = row[ stride_t( x ) * stride[ 0 ] ];
+    }
+  }
+}
+
+} // namespace VideoWriter_impl
+
+using namespace VideoWriter_impl;
+
+VideoWriter::VideoWriter( GarbageCollector *_gc, const String &identifier, const RPGML::SharedObject *so )
+: Node( _gc, identifier, so, NUM_INPUTS, NUM_OUTPUTS, NUM_PARAMS )
+, m_format_name( "auto" )
+, m_fps( 25 )
+, m_y4m( false )
+{
+  DEFINE_INPUT ( INPUT_FILENAME, "filename" );
+  DEFINE_INPUT ( INPUT_RED  , "red"   );
+  DEFINE_INPUT ( INPUT_GREEN, "green" );
+  DEFINE_INPUT ( INPUT_BLUE , "blue"  );
+  DEFINE_OUTPUT( OUTPUT_OUT , "out"   );
+  DEFINE_PARAM ( PARAM_FORMAT, "format", VideoWriter::set_format );
+  DEFINE_PARAM ( PARAM_FPS   , "fps"   , VideoWriter::set_fps );
+}
+
+VideoWriter::~VideoWriter( void )
+{}
+
+const char *VideoWriter::getName( void ) const
+{
+  return "util.VideoWriter";
+}
+
+void VideoWriter::gc_clear( void )
+{
+  Base::gc_clear();
+  m_file.clear();
+}
+
+void VideoWriter::gc_getChildren( Children &children ) const
+{
+  Base::gc_getChildren( children );
+}
+
+void VideoWriter::set_format( const Value &value, index_t, int, const index_t * )
+{
+  if( !value.isString() )
+  {
+    throw Exception() << "Param 'format' must be set with a string, is " << value.getType();
+  }
+
+  const String format = value.getString();
+  if( format != "auto" && format != "y4m" && format != "rgb" && format != "gray" )
+  {
+    throw Exception()
+      << "Param 'format' must be one of \"auto\", \"y4m\", \"rgb\" or \"gray\", is \"" << format << "\""
+      ;
+  }
+  m_format_name = format;
+}
+
+void VideoWriter::set_fps( const Value &value, index_t, int, const index_t * )
+{
+  const int fps = value.save_cast< int >();
+  if( fps < 1 )
+  {
+    throw Exception() << "Param 'fps' must be at least 1, is " << fps;
+  }
+  m_fps = fps;
+}
+
+void VideoWriter::open( const String &filename, const VideoFormat &format )
+{
+  m_file.clear();
+  m_filename.clear();
+
+  const bool is_stdout = ( filename == "-" );
+
+  if( is_stdout )
+  {
+    m_file.set( stdout, dont_close );
+  }
+  else
+  {
+    m_file.set( ::fopen( filename.c_str(), "wb" ), ::fclose );
+    if( m_file.isNull() )
+    {
+      throw Exception()
+        << "Could not open file '" << filename << "' for writing"
+        << ": " << ::strerror( errno )
+        ;
+    }
+  }
+
+  const std::string tags = format.tags();
+
+  if( m_y4m )
+  {
+    if( 0 > ::fprintf( m_file, "YUV4MPEG2 %s\n", tags.c_str() ) )
+    {
+      throw Exception()
+        << "Could not write YUV4MPEG2 header to '" << filename << "'"
+        << ": " << ::strerror( errno )
+        ;
+    }
+  }
+  else if( !is_stdout )
+  {
+    // Raw frames get the layout in the sidecar header "<filename>.hdr"
+    const std::string header_filename = std::string( filename.c_str() ) + ".hdr";
+    Guard< FILE, int > header_file( ::fopen( header_filename.c_str(), "w" ), ::fclose );
+    if( !header_file || 0 > ::fprintf( header_file, "%s\n", tags.c_str() ) )
+    {
+      throw Exception()
+        << "Could not write sidecar header '" << header_filename << "'"
+        << ": " << ::strerror( errno )
+        ;
+    }
+  }
+
+  m_filename = filename;
+  m_format = format;
+}
+
+bool VideoWriter::tick( void )
+{
+  if( !hasAnyInputChanged() ) return true;
+  setAllOutputChanged();
+
+  GET_INPUT_AS_DIMS( INPUT_FILENAME, filename, String, 0 );
+  GET_INPUT_AS_DIMS( INPUT_RED, red, uint8_t, 2 );
+  GET_INPUT_AS_DIMS_IF_CONNECTED( INPUT_GREEN, green, uint8_t, 2 );
+  GET_INPUT_AS_DIMS_IF_CONNECTED( INPUT_BLUE , blue , uint8_t, 2 );
+
+  const ArrayBase::Size size = red->getSize();
+
+  // Gray, when asked for or when only 'red' is connected
+  const bool gray = ( m_format_name == "gray" || ( !green && !blue ) );
+
+  if( !gray )
+  {
+    if( !green || !blue )
+    {
+      throw Exception() << "Inputs 'green' and 'blue' must both be connected for color frames";
+    }
+    if( green->getSize() != size || blue->getSize() != size )
+    {
+      throw Exception()
+        << "Sizes of Inputs 'red', 'green' and 'blue' must match"
+        << ": 'red' is " << size
+        << ", 'green' is " << green->getSize()
+        << ", 'blue' is " << blue->getSize()
+        ;
+    }
+  }
+
+  VideoFormat format;
+  format.width   = size[ 0 ];
+  format.height  = size[ 1 ];
+  format.fps_num = m_fps;
+  format.fps_den = 1;
+
+  if( m_file.isNull() || m_filename != (**filename) )
+  {
+    m_y4m =
+         m_format_name == "y4m"
+      || ( m_format_name == "auto" && ( (**filename) == "-" || ends_with( (**filename), ".y4m" ) ) )
+      ;
+
+    if( gray )
+    {
+      format.chroma = VideoFormat::CHROMA_MONO;
+    }
+    else
+    {
+      // RGB in Y4M is stored without chroma subsampling
+      format.chroma = ( m_y4m ? VideoFormat::CHROMA_444 : VideoFormat::CHROMA_RGB );
+    }
+
+    open( (**filename), format );
+  }
+  else if( format.width != m_format.width || format.height != m_format.height )
+  {
+    throw Exception()
+      << "Frame size must not change within a stream: '" << m_filename << "'"
+      << " was started with " << m_format.width << "x" << m_format.height
+      << ", frame is " << size
+      ;
+  }
+  else if( gray != ( m_format.chroma == VideoFormat::CHROMA_MONO ) )
+  {
+    throw Exception() << "Frames must not switch between gray and color within a stream: '" << m_filename << "'";
+  }
+
+  // Pack the whole frame, so it is written with one fwrite()
+  const size_t plane = size_t( format.width ) * format.height;
+  m_packed.resize( m_format.frameBytes() );
+  uint8_t *const packed = ( m_packed.empty() ? 0 : &m_packed[ 0 ] );
+
+  switch( m_format.chroma )
+  {
+    case VideoFormat::CHROMA_MONO:
+      pack( red, packed, 1 );
+      break;
+
+    case VideoFormat::CHROMA_RGB:
+      pack( red  , packed+0, 3 );
+      pack( green, packed+1, 3 );
+      pack( blue , packed+2, 3 );
+      break;
+
+    case VideoFormat::CHROMA_444:
+      {
+        // Pack as RGB planes first, then convert in place
+        uint8_t *const Y = packed;
+        uint8_t *const U = Y + plane;
+        uint8_t *const V = U + plane;
+        pack( red  , Y, 1 );
+        pack( green, U, 1 );
+        pack( blue , V, 1 );
+        for( size_t i=0; i<plane; ++i )
+        {
+          video_impl::rgb2yuv( Y[ i ], U[ i ], V[ i ], Y[ i ], U[ i ], V[ i ] );
+        }
+      }
+      break;
+
+    default:
+      throw Exception() << "Internal: Unexpected color space";
+  }
+
+  if( m_y4m && 0 > ::fputs( "FRAME\n", m_file ) )
+  {
+    throw Exception()
+      << "Could not write to '" << m_filename << "'"
+      << ": " << ::strerror( errno )
+      ;
+  }
+
+  if( !m_packed.empty() && 1 != ::fwrite( packed, m_packed.size(), 1, m_file ) )
+  {
+    throw Exception()
+      << "Could not write to '" << m_filename << "'"
+      << ": " << ::strerror( errno )
+      ;
+  }
+
+  // Readers, e.g. at the other end of a pipe, get each frame as soon as it is complete
+  ::fflush( m_file );
+
+  getOutput( OUTPUT_OUT )->setData( const_cast< StringArray* >( filename ) );
+  return true;
+}
+
+ } // namespace util {
+} // namespace RPGML
+
+RPGML_CREATE_NODE( VideoWriter, util:: )
+
@@ -0,0 +1,91 @@
+/* This file is part of RPGML.
+ *
+ * Copyright (c) 2015, Gunnar Payer, All rights reserved.
+ *
+ * RPGML is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3.0 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.
+ */
+#ifndef RPGML_Node_util_VideoWriter_h
+#define RPGML_Node_util_VideoWriter_h
+
+#include <RPGML/Node.h>
+#include <RPGML/Guard.h>
+#include "RPGML_video.h"
+
+#include <cstdio>
+#include <vector>
+
+namespace RPGML {
+namespace util {
+
+//! @brief Appends frames as Y4M or raw RGB/gray video to a file or stdout ("-"), without SDL or OpenCV
+class VideoWriter : public Node
+{
+  typedef Node Base;
+public:
+  EXCEPTION_BASE( Exception );
+
+  VideoWriter( GarbageCollector *gc, const String &identifier, const SharedObject *so );
+  virtual ~VideoWriter( void );
+
+  virtual const char *getName( void ) const;
+
+  virtual bool tick( void );
+
+  virtual void gc_clear( void );
+  virtual void gc_getChildren( Children &children ) const;
+
+  void set_format( const Value &value, index_t index, int n_coords, const index_t *coords );
+  void set_fps( const Value &value, index_t index, int n_coords, const index_t *coords );
+
+private:
+  typedef NodeParam< VideoWriter > NParam;
+
+  enum Inputs
+  {
+    INPUT_FILENAME,
+    INPUT_RED  ,
+    INPUT_GREEN,
+    INPUT_BLUE ,
+    NUM_INPUTS
+  };
+
+  enum Outputs
+  {
+    OUTPUT_OUT,
+    NUM_OUTPUTS
+  };
+
+  enum Params
+  {
+    PARAM_FORMAT,
+    PARAM_FPS,
+    NUM_PARAMS
+  };
+
+  void open( const String &filename, const VideoFormat &format );
+
+  Guard< FILE, int > m_file;
+  String m_filename;
+  String m_format_name;
+  VideoFormat m_format;
+  std::vector< uint8_t > m_packed;
+  int m_fps;
+  bool m_y4m;
+};
+
+ } // namespace util {
+} // namespace RPGML
+
+#endif
+
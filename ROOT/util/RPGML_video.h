@@ -0,0 +1,173 @@
+/* This file is part of RPGML.
+ *
+ * Copyright (c) 2015, Gunnar Payer, All rights reserved.
+ *
+ * RPGML is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3.0 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.
+ */
+#ifndef RPGML_util_video_h
+#define RPGML_util_video_h
+
+#include <RPGML/Exception.h>
+#include <RPGML/types.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <sstream>
+#include <vector>
+
+namespace RPGML {
+namespace util {
+
+//! @brief Frame layout of a Y4M (YUV4MPEG2) or raw video stream
+struct VideoFormat
+{
+  enum Chroma
+  {
+    CHROMA_MONO,
+    CHROMA_RGB,
+    CHROMA_420,
+    CHROMA_422,
+    CHROMA_444
+  };
+
+  VideoFormat( void )
+  : width( 0 )
+  , height( 0 )
+  , chroma( CHROMA_420 )
+  , fps_num( 25 )
+  , fps_den( 1 )
+  {}
+
+  //! Bytes of one frame, without the Y4M "FRAME" line
+  size_t frameBytes( void ) const
+  {
+    const size_t plane = size_t( width ) * height;
+    const size_t cw = ( width  + 1 ) / 2;
+    const size_t ch = ( height + 1 ) / 2;
+    switch( chroma )
+    {
+      case CHROMA_MONO: return plane;
+      case CHROMA_RGB : return plane * 3;
+      case CHROMA_420 : return plane + 2 * cw * ch;
+      case CHROMA_422 : return plane + 2 * cw * height;
+      case CHROMA_444 : return plane * 3;
+    }
+    return 0;
+  }
+
+  bool isYUV( void ) const
+  {
+    return chroma == CHROMA_420 || chroma == CHROMA_422 || chroma == CHROMA_444;
+  }
+
+  //! Parses Y4M style tags ("W640 H480 F25:1 C420jpeg ..."), unknown tags are ignored
+  void parseTags( const char *tags )
+  {
+    std::istringstream in( tags );
+    std::string tag;
+    while( in >> tag )
+    {
+      const char *const value = tag.c_str()+1;
+      switch( tag[ 0 ] )
+      {
+        case 'W': width  = index_t( ::strtoul( value, 0, 10 ) ); break;
+        case 'H': height = index_t( ::strtoul( value, 0, 10 ) ); break;
+        case 'F':
+          if( 2 != ::sscanf( value, "%d:%d", &fps_num, &fps_den ) || fps_num < 1 || fps_den < 1 )
+          {
+            throw Exception() << "Invalid frame rate tag '" << tag << "'";
+          }
+          break;
+        case 'C':
+          if     ( 0 == ::strncmp( value, "420", 3 ) ) chroma = CHROMA_420;
+          else if( 0 == ::strcmp ( value, "422"    ) ) chroma = CHROMA_422;
+          else if( 0 == ::strcmp ( value, "444"    ) ) chroma = CHROMA_444;
+          else if( 0 == ::strcmp ( value, "mono"   ) ) chroma = CHROMA_MONO;
+          else if( 0 == ::strcmp ( value, "gray"   ) ) chroma = CHROMA_MONO;
+          else if( 0 == ::strcmp ( value, "rgb"    ) ) chroma = CHROMA_RGB;
+          else throw Exception() << "Unsupported color space tag '" << tag << "'";
+          break;
+        default:
+          break;
+      }
+    }
+
+    if( width < 1 || height < 1 )
+    {
+      throw Exception() << "Missing or invalid width or height in '" << tags << "'";
+    }
+  }
+
+  //! Y4M style tags, the inverse of parseTags()
+  std::string tags( void ) const
+  {
+    const char *c = "";
+    switch( chroma )
+    {
+      case CHROMA_MONO: c = "mono"    ; break;
+      case CHROMA_RGB : c = "rgb"     ; break;
+      case CHROMA_420 : c = "420jpeg" ; break;
+      case CHROMA_422 : c = "422"     ; break;
+      case CHROMA_444 : c = "444"     ; break;
+    }
+    std::ostringstream out;
+    out << "W" << width << " H" << height << " F" << fps_num << ":" << fps_den << " Ip A1:1 C" << c;
+    return out.str();
+  }
+
+  index_t width;
+  index_t height;
+  Chroma chroma;
+  int fps_num;
+  int fps_den;
+};
+
+namespace video_impl {
+
+static inline
+uint8_t clamp8( int v )
+{
+  return uint8_t( v < 0 ? 0 : ( v > 255 ? 255 : v ) );
+}
+
+//! BT.601 limited range to RGB, fixed point
+static inline
+void yuv2rgb( int y, int u, int v, uint8_t &r, uint8_t &g, uint8_t &b )
+{
+  const int c = 298 * ( y - 16 );
+  const int d = u - 128;
+  const int e = v - 128;
+  r = clamp8( ( c           + 409 * e + 128 ) >> 8 );
+  g = clamp8( ( c - 100 * d - 208 * e + 128 ) >> 8 );
+  b = clamp8( ( c + 516 * d           + 128 ) >> 8 );
+}
+
+//! RGB to BT.601 limited range, fixed point
+static inline
+void rgb2yuv( int r, int g, int b, uint8_t &y, uint8_t &u, uint8_t &v )
+{
+  y = clamp8( ( (  66 * r + 129 * g +  25 * b + 128 ) >> 8 ) +  16 );
+  u = clamp8( ( ( -38 * r -  74 * g + 112 * b + 128 ) >> 8 ) + 128 );
+  v = clamp8( ( ( 112 * r -  94 * g -  18 * b + 128 ) >> 8 ) + 128 );
+}
+
+} // namespace video_impl
+
+} // namespace util
+} // namespace RPGML
+
+#endif
+
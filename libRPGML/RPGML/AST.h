@@ -109,6 +109,8 @@ public:
   {}
   virtual ~Visitor( void ) {}
 
+  static const index_t max_recursion_depth = 100;
+
   virtual void visit( const Node *node )
   {
     node->invite( this );
@@ -154,7 +156,7 @@ public:
     try
     {
       ++m_rd;
-      if( m_rd > 100 ) throw "Maximum recursion depth reached";
+      if( m_rd > max_recursion_depth ) throw "Maximum recursion depth reached";
       visit( node );
       --m_rd;
     }
@@ -208,6 +210,8 @@ protected:
     Visitor *m_parent;
   };
 
+public:
+  //! @brief Already carries the Location of the failing Node, passed on unchanged
   class CallLocException : public ParseException
   {
     typedef ParseException Base;
@@ -0,0 +1,206 @@
+/* This file is part of RPGML.
+ *
+ * Copyright (c) 2014, Gunnar Payer, All rights reserved.
+ *
+ * RPGML is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3.0 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.
+ */
+#include "Affinity.h"
+
+#include <fstream>
+#include <cstring>
+#include <cstdlib>
+#include <algorithm>
+#include <map>
+#include <sched.h>
+#include <pthread.h>
+#include <dirent.h>
+
+namespace RPGML {
+
+namespace Affinity_impl {
+
+  //! Parses a list like "0-3,8,10-11", as in /sys and taskset, CPUs must be below CPU_SETSIZE
+  static
+  bool parse_cpu_list( const std::string &list, std::vector< int > &cpus )
+  {
+    const char *s = list.c_str();
+    while( *s && *s != '\n' )
+    {
+      char *end = 0;
+      const long first = std::strtol( s, &end, 10 );
+      if( end == s || first < 0 ) return false;
+      long last = first;
+      s = end;
+      if( '-' == *s )
+      {
+        ++s;
+        last = std::strtol( s, &end, 10 );
+        if( end == s || last < first ) return false;
+        s = end;
+      }
+      // Checked before expanding, "0-999999999" must not fill memory
+      if( first >= CPU_SETSIZE || last >= CPU_SETSIZE ) return false;
+      for( long cpu = first; cpu <= last; ++cpu ) cpus.push_back( int( cpu ) );
+      if( ',' == *s ) ++s;
+      else if( *s && *s != '\n' ) return false;
+    }
+    return true;
+  }
+
+} // namespace Affinity_impl
+
+using namespace Affinity_impl;
+
+//! Read once, never changes
+class Affinity::Topology
+{
+public:
+  Topology( void )
+  : num_nodes( 1 )
+  {
+    cpu_set_t set;
+    CPU_ZERO( &set );
+    if( 0 == sched_getaffinity( 0, sizeof( set ), &set ) )
+    {
+      for( int cpu = 0; cpu < CPU_SETSIZE; ++cpu )
+      {
+        if( CPU_ISSET( cpu, &set ) ) allowed.push_back( cpu );
+      }
+    }
+
+    DIR *const dir = ::opendir( "/sys/devices/system/node" );
+    if( !dir ) return;
+
+    int max_node = 0;
+    for( dirent *entry = ::readdir( dir ); entry; entry = ::readdir( dir ) )
+    {
+      if( 0 != std::strncmp( entry->d_name, "node", 4 ) ) continue;
+      char *end = 0;
+      const long node = std::strtol( entry->d_name + 4, &end, 10 );
+      if( end == entry->d_name + 4 || *end ) continue;
+
+      std::ifstream in( ( std::string( "/sys/devices/system/node/" ) + entry->d_name + "/cpulist" ).c_str() );
+      std::string list;
+      std::getline( in, list );
+      std::vector< int > cpus;
+      if( !parse_cpu_list( list, cpus ) ) continue;
+
+      for( size_t i = 0; i < cpus.size(); ++i ) node_of_cpu[ cpus[ i ] ] = int( node );
+      max_node = std::max( max_node, int( node ) );
+    }
+    ::closedir( dir );
+
+    num_nodes = index_t( max_node + 1 );
+  }
+
+  int getNode( int cpu ) const
+  {
+    const std::map< int, int >::const_iterator i = node_of_cpu.find( cpu );
+    return ( i != node_of_cpu.end() ? i->second : 0 );
+  }
+
+  std::vector< int > allowed;
+  std::map< int, int > node_of_cpu;
+  index_t num_nodes;
+};
+
+__thread int Affinity::s_thread_node = -1;
+
+const Affinity::Topology &Affinity::getTopology( void )
+{
+  static const Topology topology;
+  return topology;
+}
+
+index_t Affinity::getNumNodes( void )
+{
+  return getTopology().num_nodes;
+}
+
+int Affinity::getNodeOfCpu( int cpu )
+{
+  return getTopology().getNode( cpu );
+}
+
+void Affinity::getCpus( const std::string &spec, index_t num_threads, std::vector< int > &cpus )
+{
+  cpus.clear();
+  if( spec.empty() || spec == "none" ) return;
+
+  const Topology &topology = getTopology();
+
+  std::vector< int > order;
+  if( spec == "compact" || spec == "scatter" )
+  {
+    if( topology.allowed.empty() ) throw Exception() << "Could not get the CPUs of this process";
+
+    // CPUs per node, in ascending order
+    std::vector< std::vector< int > > by_node( topology.num_nodes );
+    for( size_t i = 0; i < topology.allowed.size(); ++i )
+    {
+      const int cpu = topology.allowed[ i ];
+      by_node[ size_t( topology.getNode( cpu ) ) ].push_back( cpu );
+    }
+
+    if( spec == "compact" )
+    {
+      for( size_t n = 0; n < by_node.size(); ++n )
+      {
+        order.insert( order.end(), by_node[ n ].begin(), by_node[ n ].end() );
+      }
+    }
+    else
+    {
+      for( size_t k = 0; order.size() < topology.allowed.size(); ++k )
+      {
+        for( size_t n = 0; n < by_node.size(); ++n )
+        {
+          if( k < by_node[ n ].size() ) order.push_back( by_node[ n ][ k ] );
+        }
+      }
+    }
+  }
+  else
+  {
+    if( !parse_cpu_list( spec, order ) || order.empty() )
+    {
+      throw Exception()
+        << "Invalid affinity '" << spec << "', expected none, compact, scatter"
+        << " or a CPU list like 0-3,8 with CPUs up to " << CPU_SETSIZE-1
+        ;
+    }
+  }
+
+  cpus.reserve( num_threads );
+  for( index_t i = 0; i < num_threads; ++i )
+  {
+    cpus.push_back( order[ i % order.size() ] );
+  }
+}
+
+void Affinity::pinCurrentThread( int cpu )
+{
+  cpu_set_t set;
+  CPU_ZERO( &set );
+  CPU_SET( cpu, &set );
+  const int err = pthread_setaffinity_np( pthread_self(), sizeof( set ), &set );
+  if( 0 != err )
+  {
+    throw Exception() << "Could not pin thread to CPU " << cpu << ": " << std::strerror( err );
+  }
+
+  s_thread_node = ( getNumNodes() > 1 ? getNodeOfCpu( cpu ) : -1 );
+}
+
+} // namespace RPGML
@@ -0,0 +1,76 @@
+/* This file is part of RPGML.
+ *
+ * Copyright (c) 2014, Gunnar Payer, All rights reserved.
+ *
+ * RPGML is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3.0 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.
+ */
+/*! @file Affinity.h
+ * @brief CPU pinning of worker threads and their NUMA nodes
+ *
+ * The NUMA topology is read from /sys/devices/system/node, without it all
+ * CPUs are on node 0. Linux places memory on the node of the thread that
+ * first touches it, so Arrays allocated by a pinned worker are local to its
+ * node. Jobs remember that node as their home and the JobQueue prefers to
+ * give them to workers on it, see JobQueue::Job::setHome().
+ */
+#ifndef RPGML_Affinity_h
+#define RPGML_Affinity_h
+
+#include "Exception.h"
+#include "types.h"
+
+#include <vector>
+#include <string>
+
+namespace RPGML {
+
+class Affinity
+{
+public:
+  EXCEPTION_BASE( Exception );
+
+  /*! @brief The CPU for each of num_threads workers, empty for no pinning
+   *
+   * spec is "none", "compact" (fill one NUMA node after the other),
+   * "scatter" (alternate between the NUMA nodes) or a CPU list like
+   * "0-3,8,10-11", that is used round robin. Only CPUs this process may
+   * run on are used by the policies.
+   */
+  static void getCpus( const std::string &spec, index_t num_threads, std::vector< int > &cpus );
+
+  //! @brief Number of NUMA nodes, at least 1
+  static index_t getNumNodes( void );
+
+  //! @brief NUMA node of cpu, 0 if unknown
+  static int getNodeOfCpu( int cpu );
+
+  //! @brief Pins the calling thread to cpu
+  static void pinCurrentThread( int cpu );
+
+  /*! @brief NUMA node of the calling thread
+   *
+   * -1 if it is not pinned or there is only one NUMA node.
+   */
+  static int getThreadNode( void ) { return s_thread_node; }
+
+private:
+  class Topology;
+  static const Topology &getTopology( void );
+
+  static __thread int s_thread_node;
+};
+
+} // namespace RPGML
+
+#endif
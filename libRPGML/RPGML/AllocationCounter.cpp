@@ -0,0 +1,46 @@
+/* This file is part of RPGML.
+ *
+ * Copyright (c) 2014, Gunnar Payer, All rights reserved.
+ *
+ * RPGML is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3.0 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.
+ */
+#include "AllocationCounter.h"
+
+namespace RPGML {
+
+bool AllocationCounter::s_enabled = false;
+__thread AllocationCounter::Slot *AllocationCounter::s_thread_slot = 0;
+AllocationCounter::Slot AllocationCounter::s_slots[ MaxThreads ];
+Atomic< index_t > AllocationCounter::s_num_slots;
+
+AllocationCounter::Slot *AllocationCounter::getThreadSlot( void )
+{
+  if( s_num_slots.get() >= MaxThreads ) return 0;
+  const index_t i = s_num_slots++;
+  if( i >= MaxThreads ) return 0;
+  return ( s_thread_slot = &s_slots[ i ] );
+}
+
+uint64_t AllocationCounter::getAllocatedBytes( void )
+{
+  const index_t n = s_num_slots.get();
+  uint64_t bytes = 0;
+  for( index_t i( 0 ), end( n < MaxThreads ? n : MaxThreads ); i < end; ++i )
+  {
+    bytes += s_slots[ i ].bytes.load_relaxed();
+  }
+  return bytes;
+}
+
+} // namespace RPGML
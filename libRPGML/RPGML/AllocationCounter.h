@@ -0,0 +1,94 @@
+/* This file is part of RPGML.
+ *
+ * Copyright (c) 2014, Gunnar Payer, All rights reserved.
+ *
+ * RPGML is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3.0 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.
+ */
+/*! @file AllocationCounter.h
+ * @brief Per thread counts of operator new, for the Profiler and the Metrics
+ *
+ * operator new (see rpgml/main.cpp) calls count() once per allocation. Each
+ * thread writes only its own slot, one cache line each, so counting needs
+ * no lock and no atomic read-modify-write. The Profiler reads the
+ * allocations of the calling thread around each Node execution, the
+ * Metrics sum the bytes of all slots from any thread.
+ *
+ * Counting starts with the first enable(), before that count() only tests
+ * isEnabled(). Threads beyond MaxThreads are not counted.
+ */
+#ifndef RPGML_AllocationCounter_h
+#define RPGML_AllocationCounter_h
+
+#include "Atomic.h"
+#include "types.h"
+
+#include <cstddef>
+#include <stdint.h>
+
+namespace RPGML {
+
+class AllocationCounter
+{
+public:
+  static bool isEnabled( void ) { return s_enabled; }
+
+  //! @brief Called by the Profiler and the Metrics, when they are enabled
+  static void enable( void ) { s_enabled = true; }
+
+  //! @brief To be called by operator new
+  static void count( size_t bytes )
+  {
+    if( !s_enabled ) return;
+    Slot *slot = s_thread_slot;
+    if( !slot ) slot = getThreadSlot();
+    if( !slot ) return;
+    slot->allocations.add_relaxed( 1 );
+    slot->bytes.add_relaxed( bytes );
+  }
+
+  //! @brief Allocations of the calling thread so far
+  static uint64_t getThreadAllocations( void )
+  {
+    const Slot *const slot = s_thread_slot;
+    return ( slot ? slot->allocations.load_relaxed() : 0 );
+  }
+
+  //! @brief Bytes allocated by all threads so far
+  static uint64_t getAllocatedBytes( void );
+
+  static const index_t MaxThreads = 256;
+
+private:
+  AllocationCounter( void );
+
+  //! Written only by its thread, one cache line each
+  struct Slot
+  {
+    Atomic< uint64_t > allocations;
+    Atomic< uint64_t > bytes;
+    char padding[ 64 - 2*sizeof( Atomic< uint64_t > ) ];
+  };
+
+  //! 0, if all slots are taken
+  static Slot *getThreadSlot( void );
+
+  static bool s_enabled;
+  static __thread Slot *s_thread_slot;
+  static Slot s_slots[ MaxThreads ];
+  static Atomic< index_t > s_num_slots;
+};
+
+} // namespace RPGML
+
+#endif
@@ -0,0 +1,249 @@
+/* This file is part of RPGML.
+ *
+ * Copyright (c) 2014, Gunnar Payer, All rights reserved.
+ *
+ * RPGML is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3.0 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.
+ */
+#include "AllocationTracker.h"
+
+#include "GarbageCollector.h"
+#include "Node.h"
+#include "make_printable.h"
+
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <algorithm>
+#include <functional>
+#include <vector>
+#include <typeinfo>
+#include <cstdlib>
+#include <cxxabi.h>
+
+namespace RPGML {
+
+namespace AllocationTracker_impl {
+
+  struct Totals
+  {
+    Totals( void ) : objects( 0 ), bytes( 0 ) {}
+    uint64_t objects;
+    uint64_t bytes;
+  };
+
+  typedef std::map< std::string, Totals > TotalsMap;
+  typedef std::pair< std::string, Totals > TotalsEntry;
+
+  static
+  bool more_bytes( const TotalsEntry &a, const TotalsEntry &b )
+  {
+    if( a.second.bytes != b.second.bytes ) return a.second.bytes > b.second.bytes;
+    return a.second.objects > b.second.objects;
+  }
+
+  static
+  std::string type_name( const Collectable *c )
+  {
+    const char *const mangled = typeid( *c ).name();
+    int status = 0;
+    char *const demangled = abi::__cxa_demangle( mangled, 0, 0, &status );
+    if( !demangled ) return mangled;
+    const std::string ret( demangled );
+    std::free( demangled );
+    return ret;
+  }
+
+  //! Type and, for Nodes and Ports, the identifier, one line
+  static
+  std::string describe( const Collectable *c )
+  {
+    std::ostringstream s;
+    s << type_name( c );
+    if( const Node *const node = dynamic_cast< const Node* >( c ) )
+    {
+      s << " '" << make_printable( node->getIdentifier() ) << "'";
+    }
+    else if( const Port *const port = dynamic_cast< const Port* >( c ) )
+    {
+      s << " '";
+      if( port->getParent() ) s << make_printable( port->getParent()->getIdentifier() ) << ".";
+      s << make_printable( port->getIdentifier() ) << "'";
+    }
+    return s.str();
+  }
+
+  static
+  void write_totals( std::ostream &o, const char *title, const char *column, const TotalsMap &totals )
+  {
+    std::vector< TotalsEntry > sorted( totals.begin(), totals.end() );
+    std::sort( sorted.begin(), sorted.end(), more_bytes );
+
+    o
+      << title << ":\n"
+      << std::setw( 10 ) << "objects" << std::setw( 14 ) << "bytes" << "  " << column << "\n"
+      ;
+    for( size_t i = 0; i < sorted.size(); ++i )
+    {
+      o
+        << std::setw( 10 ) << sorted[ i ].second.objects
+        << std::setw( 14 ) << sorted[ i ].second.bytes
+        << "  " << sorted[ i ].first << "\n"
+        ;
+    }
+  }
+
+  //! Retention paths are cut after this many Collectables
+  static const index_t MaxRetentionDepth = 32;
+
+} // namespace AllocationTracker_impl
+
+using namespace AllocationTracker_impl;
+
+bool AllocationTracker::s_enabled = false;
+__thread AllocationTracker::Site AllocationTracker::s_thread_site = AllocationTracker::Untracked;
+
+AllocationTracker &AllocationTracker::global( void )
+{
+  static AllocationTracker tracker;
+  return tracker;
+}
+
+AllocationTracker::AllocationTracker( void )
+: m_num_sites( index_t( OutsideNodes ) + 1 )
+, m_growth( 0 )
+{}
+
+AllocationTracker::~AllocationTracker( void )
+{
+  // Collectables destroyed after this must not touch the counters
+  s_enabled = false;
+}
+
+void AllocationTracker::enable( bool enabled )
+{
+  s_enabled = enabled;
+}
+
+AllocationTracker::Site AllocationTracker::getSite( const Node *node )
+{
+  Mutex::ScopedLock lock( &m_lock );
+
+  const std::map< const Node*, Site >::const_iterator i = m_node_sites.find( node );
+  if( i != m_node_sites.end() ) return i->second;
+
+  Site site = OutsideNodes;
+  const index_t n = m_num_sites.get();
+  if( n < MaxSites )
+  {
+    site = Site( n );
+    m_names[ n ] = std::string( make_printable( node->getIdentifier() ).get() ) + " (" + node->getName() + ")";
+    ++m_num_sites; // after the name, frameDone() reads it without locking
+  }
+  m_node_sites[ node ] = site;
+  return site;
+}
+
+std::string AllocationTracker::getSiteName( Site site ) const
+{
+  if( Untracked == site ) return "(created while disabled)";
+  if( OutsideNodes == site ) return "(outside of Nodes)";
+  return m_names[ site ];
+}
+
+void AllocationTracker::setGrowthReport( std::ostream *o )
+{
+  m_growth = o;
+  if( m_growth ) (*m_growth) << "# frame\tobjects\tbytes\tsite\n";
+}
+
+void AllocationTracker::frameDone( uint64_t frame )
+{
+  if( !m_growth ) return;
+
+  for( index_t s( OutsideNodes ), end( m_num_sites.get() ); s < end; ++s )
+  {
+    SiteCounters &site = m_sites[ s ];
+    const int64_t objects = site.objects.get();
+    const int64_t bytes = site.bytes.get();
+    if( objects == site.last_objects && bytes == site.last_bytes ) continue;
+
+    (*m_growth)
+      << frame
+      << '\t' << objects - site.last_objects
+      << '\t' << bytes - site.last_bytes
+      << '\t' << getSiteName( Site( s ) )
+      << '\n'
+      ;
+    site.last_objects = objects;
+    site.last_bytes = bytes;
+  }
+  m_growth->flush();
+}
+
+void AllocationTracker::writeReport( std::ostream &o, GarbageCollector *gc, index_t num_largest ) const
+{
+  std::vector< const Collectable* > objects;
+  std::vector< index_t > retainers;
+  gc->getRetainers( objects, retainers );
+
+  TotalsMap by_site;
+  TotalsMap by_type;
+  std::vector< std::pair< size_t, index_t > > largest;
+
+  for( size_t i = 0; i < objects.size(); ++i )
+  {
+    const Collectable *const c = objects[ i ];
+    const size_t bytes = c->getAllocatedBytes();
+
+    Totals &site = by_site[ getSiteName( c->getAllocationSite() ) ];
+    ++site.objects;
+    site.bytes += bytes;
+
+    Totals &type = by_type[ type_name( c ) ];
+    ++type.objects;
+    type.bytes += bytes;
+
+    if( bytes > 0 ) largest.push_back( std::make_pair( bytes, index_t( i ) ) );
+  }
+
+  write_totals( o, "Live Collectables by creator", "creator", by_site );
+  write_totals( o, "Live Collectables by type", "type", by_type );
+
+  const size_t n = std::min( largest.size(), size_t( num_largest ) );
+  std::partial_sort( largest.begin(), largest.begin() + ptrdiff_t( n ), largest.end(), std::greater< std::pair< size_t, index_t > >() );
+
+  o << "Largest arrays, retained by (up to a root):\n";
+  for( size_t l = 0; l < n; ++l )
+  {
+    const index_t i = largest[ l ].second;
+    const Collectable *const c = objects[ i ];
+    o
+      << std::setw( 14 ) << largest[ l ].first << "  " << describe( c )
+      << ", created by " << getSiteName( c->getAllocationSite() ) << "\n"
+      ;
+
+    index_t depth = 0;
+    for( index_t r = retainers[ i ]; r != unknown; r = retainers[ r ] )
+    {
+      if( ++depth > MaxRetentionDepth )
+      {
+        o << std::setw( 16 ) << "" << "...\n";
+        break;
+      }
+      o << std::setw( 16 ) << "" << describe( objects[ r ] ) << "\n";
+    }
+  }
+}
+
+} // namespace RPGML
@@ -0,0 +1,165 @@
+/* This file is part of RPGML.
+ *
+ * Copyright (c) 2014, Gunnar Payer, All rights reserved.
+ *
+ * RPGML is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3.0 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.
+ */
+/*! @file AllocationTracker.h
+ * @brief Which Nodes create the Collectables, that stay alive
+ *
+ * When enabled, every Collectable remembers its site: the Node that was
+ * executed by the creating thread, see Scope, or "outside of Nodes". Live
+ * objects and ArrayData bytes are counted per site, and the growth of each
+ * site is written at the end of every frame. Memory that grows across frames
+ * shows up there, with the Node responsible for it.
+ *
+ * writeReport() groups all live Collectables by site and by type and lists
+ * the largest ArrayData with the path, that retains them, from the roots of
+ * the GarbageCollector.
+ *
+ * When disabled, creating a Collectable only tests isEnabled().
+ */
+#ifndef RPGML_AllocationTracker_h
+#define RPGML_AllocationTracker_h
+
+#include "Atomic.h"
+#include "Mutex.h"
+#include "types.h"
+
+#include <iosfwd>
+#include <string>
+#include <map>
+#include <stdint.h>
+
+namespace RPGML {
+
+class Node;
+class GarbageCollector;
+
+class AllocationTracker
+{
+public:
+  //! @brief The process wide AllocationTracker, disabled by default
+  static AllocationTracker &global( void );
+
+  static bool isEnabled( void ) { return s_enabled; }
+
+  //! @brief Only Collectables created while enabled are counted
+  void enable( bool enabled = true );
+
+  //! @brief Index of the creator of a Collectable
+  typedef uint16_t Site;
+  static const Site Untracked = 0; //!< created while disabled
+  static const Site OutsideNodes = 1; //!< also used when all sites are taken
+  static const index_t MaxSites = 4096;
+
+  //! @brief Attributes Collectables created by the calling thread to node, while in scope
+  class Scope
+  {
+  public:
+    explicit
+    Scope( const Node *node )
+    : m_prev( s_thread_site )
+    {
+      if( s_enabled ) s_thread_site = global().getSite( node );
+    }
+
+    ~Scope( void )
+    {
+      s_thread_site = m_prev;
+    }
+
+  private:
+    Scope( const Scope & );
+    Scope &operator=( const Scope & );
+    const Site m_prev;
+  };
+
+  //! @brief Called by the constructors of Collectable, returns its site
+  static Site created( void )
+  {
+    if( !s_enabled ) return Untracked;
+    const Site site = ( s_thread_site != Untracked ? s_thread_site : Site( OutsideNodes ) );
+    ++global().m_sites[ site ].objects;
+    return site;
+  }
+
+  //! @brief Called by the destructor of Collectable
+  static void destroyed( Site site )
+  {
+    if( !s_enabled || site == Untracked ) return;
+    --global().m_sites[ site ].objects;
+  }
+
+  //! @brief Called by ArrayData, when its elements change
+  static void resized( Site site, size_t bytes_before, size_t bytes_after )
+  {
+    if( !s_enabled || site == Untracked || bytes_before == bytes_after ) return;
+    global().m_sites[ site ].bytes += int64_t( bytes_after ) - int64_t( bytes_before );
+  }
+
+  /*! @brief Writes the growth per site, if a growth report is set
+   *
+   * Called by the Graph at the end of every frame, frames never overlap.
+   */
+  void frameDone( uint64_t frame );
+
+  /*! @brief Lines "<frame> <objects> <bytes> <site>", for every site that changed in a frame
+   *
+   * Separated by tabs, o must outlive the execution of the Graph, 0 for none.
+   */
+  void setGrowthReport( std::ostream *o );
+
+  /*! @brief Live Collectables of gc by site and by type, and the largest ArrayData with their retention path
+   *
+   * Must only be called while no Node is executed.
+   */
+  void writeReport( std::ostream &o, GarbageCollector *gc, index_t num_largest = 10 ) const;
+
+  //! @brief Name of site
+  std::string getSiteName( Site site ) const;
+
+private:
+  AllocationTracker( void );
+  ~AllocationTracker( void );
+  AllocationTracker( const AllocationTracker & );
+  AllocationTracker &operator=( const AllocationTracker & );
+
+  struct SiteCounters
+  {
+    SiteCounters( void ) : objects( 0 ), bytes( 0 ), last_objects( 0 ), last_bytes( 0 ) {}
+    Atomic< int64_t > objects;
+    Atomic< int64_t > bytes;
+    int64_t last_objects; //!< only used by frameDone()
+    int64_t last_bytes;
+  };
+
+  Site getSite( const Node *node );
+
+  static bool s_enabled;
+  static __thread Site s_thread_site;
+
+  SiteCounters m_sites[ MaxSites ];
+  std::string m_names[ MaxSites ];
+  Atomic< index_t > m_num_sites;
+
+  Mutex m_lock;
+  std::map< const Node*, Site > m_node_sites;
+
+  std::ostream *m_growth;
+};
+
+} // namespace RPGML
+
+#endif
@@ -20,6 +20,7 @@
 
 #include "ArrayBase.h"
 #include "GarbageCollector.h"
+#include "AllocationTracker.h"
 #include "types.h"
 #include "SaveBool.h"
 
@@ -482,7 +483,9 @@ public:
   }
 
   virtual ~ArrayData( void )
-  {}
+  {
+    AllocationTracker::resized( getAllocationSite(), ArrayData::getAllocatedBytes(), 0 );
+  }
 
   virtual void gc_clear( void )
   {
@@ -494,6 +497,11 @@ public:
     Base::gc_getChildren( children );
   }
 
+  virtual size_t getAllocatedBytes( void ) const
+  {
+    return size_t( m_capacity ) * sizeof( Element );
+  }
+
   pointer first( void )
   {
     return m_elements;
@@ -569,6 +577,7 @@ protected:
 
   void setElements( pointer _elements, index_t _capacity )
   {
+    AllocationTracker::resized( getAllocationSite(), ArrayData::getAllocatedBytes(), size_t( _capacity ) * sizeof( Element ) );
     m_elements = _elements;
     m_capacity = _capacity;
   }
@@ -126,6 +126,27 @@ public:
     return ret ^ x;
   }
 
+  //! Not atomic, only for values no other thread accesses meanwhile
+  T add_unsynchronized( T x )
+  {
+    m_value += x;
+    return m_value;
+  }
+
+  //! Not atomic as a whole, only for values written by one thread and read by others with load_relaxed()
+  T add_relaxed( T x )
+  {
+    const T ret = __atomic_load_n( &m_value, __ATOMIC_RELAXED ) + x;
+    __atomic_store_n( &m_value, ret, __ATOMIC_RELAXED );
+    return ret;
+  }
+
+  //! Without ordering, e.g. for counters written by another thread
+  T load_relaxed( void ) const
+  {
+    return __atomic_load_n( &m_value, __ATOMIC_RELAXED );
+  }
+
   //! Returns whether write was successful
   bool compare_and_swap( T oldval, T newval )
   {
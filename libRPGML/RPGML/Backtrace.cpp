@@ -32,6 +32,7 @@
 #include <cstring>
 #include <cerrno>
 #include <cstdio>
+#include <cstdlib>
 
 #include <dlfcn.h>
 
@@ -39,15 +40,14 @@ using namespace std;
 
 namespace RPGML {
 
-Backtrace::Backtrace( void )
-: m_backtrace_n( ::backtrace( m_backtrace_buffer, BACKTRACE_BUFFER_SIZE ) )
-{}
-
-Backtrace::~Backtrace( void )
-{}
-
 namespace Backtrace_impl {
 
+  static bool enabled_from_environment( void )
+  {
+    const char *const env = ::getenv( "RPGML_BACKTRACE" );
+    return env && *env && 0 != strcmp( env, "0" );
+  }
+
   static void free_charpp( char **p )
   {
     ::free( p );
@@ -55,6 +55,15 @@ namespace Backtrace_impl {
 
 } // namespace Backtrace_impl
 
+bool Backtrace::s_enabled = Backtrace_impl::enabled_from_environment();
+
+Backtrace::Backtrace( void )
+: m_backtrace_n( s_enabled ? ::backtrace( m_backtrace_buffer, BACKTRACE_BUFFER_SIZE ) : 0 )
+{}
+
+Backtrace::~Backtrace( void )
+{}
+
 void Backtrace::print( std::ostream &o ) const
 {
   // cxxabi.h
@@ -62,6 +71,8 @@ void Backtrace::print( std::ostream &o ) const
 
 //  ::backtrace_symbols_fd( m_backtrace_buffer, m_backtrace_n, STDERR_FILENO );
 
+  if( empty() ) return;
+
   Guard< char* > strings( ::backtrace_symbols( m_backtrace_buffer, m_backtrace_n ), Backtrace_impl::free_charpp );
 
   for( int i=0; i<m_backtrace_n; ++i )
@@ -139,9 +150,10 @@ void Backtrace::copy( Backtrace &dest ) const
 {
   std::copy(
       m_backtrace_buffer
-    , m_backtrace_buffer + BACKTRACE_BUFFER_SIZE
+    , m_backtrace_buffer + m_backtrace_n
     , dest.m_backtrace_buffer
     );
+  dest.m_backtrace_n = m_backtrace_n;
 }
 
 } // namespace RPGML
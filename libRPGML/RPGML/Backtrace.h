@@ -22,6 +22,13 @@
 
 namespace RPGML {
 
+/*! @brief The call stack at construction, if enabled
+ *
+ * Every Exception has one, so capturing is disabled by default: it costs
+ * more than throwing itself. It is enabled by setEnabled() or by setting the
+ * environment variable RPGML_BACKTRACE to anything but "0". When disabled,
+ * the Backtrace is empty and print() prints nothing.
+ */
 class Backtrace
 {
 public:
@@ -31,7 +38,13 @@ public:
   void print( std::ostream &o ) const;
   void copy( Backtrace &dest ) const;
 
+  bool empty( void ) const { return 0 == m_backtrace_n; }
+
+  static bool isEnabled( void ) { return s_enabled; }
+  static void setEnabled( bool enabled = true ) { s_enabled = enabled; }
+
 private:
+  static bool s_enabled;
   static const int BACKTRACE_BUFFER_SIZE = 64;
   void *m_backtrace_buffer[ BACKTRACE_BUFFER_SIZE ];
   int m_backtrace_n;
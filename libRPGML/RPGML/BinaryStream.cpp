@@ -0,0 +1,222 @@
+/* This file is part of RPGML.
+ * 
+ * Copyright (c) 2014, Gunnar Payer, All rights reserved.
+ * 
+ * RPGML is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3.0 of the License, or (at your option) any later version.
+ * 
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ * 
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.
+ */
+#include "BinaryStream.h"
+
+#include "StringUnifier.h"
+#include "fnv1a.h"
+
+#include <sstream>
+#include <cstdio>
+#include <cstring>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+namespace RPGML {
+
+FileStamp::FileStamp( void )
+: size( 0 )
+, mtime_sec( 0 )
+, mtime_nsec( 0 )
+{}
+
+bool FileStamp::stat( const String &filename )
+{
+  struct ::stat st;
+  if( 0 != ::stat( filename.c_str(), &st ) ) return false;
+  size       = uint64_t( st.st_size );
+  mtime_sec  = int64_t( st.st_mtim.tv_sec );
+  mtime_nsec = int64_t( st.st_mtim.tv_nsec );
+  return true;
+}
+
+bool FileStamp::operator==( const FileStamp &other ) const
+{
+  return
+       size       == other.size
+    && mtime_sec  == other.mtime_sec
+    && mtime_nsec == other.mtime_nsec
+    ;
+}
+
+BinaryWriter::BinaryWriter( void )
+{}
+
+BinaryWriter::~BinaryWriter( void )
+{}
+
+void BinaryWriter::put_raw( const void *p, size_t n )
+{
+  m_out.append( static_cast< const char* >( p ), n );
+}
+
+void BinaryWriter::put_string( const String &s )
+{
+  if( !s.get() )
+  {
+    put_bool( false );
+    return;
+  }
+  put_bool( true );
+  put_size( s.length() );
+  put_raw( s.get(), s.length() );
+}
+
+void BinaryWriter::put_value( const Value &value )
+{
+  put_u8( uint8_t( value.getEnum() ) );
+  switch( value.getEnum() )
+  {
+    case Type::NIL   : break;
+    case Type::BOOL  : put_bool( value.getBool() ); break;
+    case Type::UINT8 : put( value.getUInt8 () ); break;
+    case Type::INT8  : put( value.getInt8  () ); break;
+    case Type::UINT16: put( value.getUInt16() ); break;
+    case Type::INT16 : put( value.getInt16 () ); break;
+    case Type::UINT32: put( value.getUInt32() ); break;
+    case Type::INT32 : put( value.getInt32 () ); break;
+    case Type::UINT64: put( value.getUInt64() ); break;
+    case Type::INT64 : put( value.getInt64 () ); break;
+    case Type::FLOAT : put( value.getFloat () ); break;
+    case Type::DOUBLE: put( value.getDouble() ); break;
+    case Type::STRING: put_string( value.getString() ); break;
+    default:
+      throw Exception()
+        << "Cannot serialize a Value of type " << value.getTypeName()
+        ;
+  }
+}
+
+bool BinaryWriter::writeFile( const String &filename ) const
+{
+  std::ostringstream tmp;
+  tmp << filename << ".tmp." << getpid();
+  const std::string tmp_filename = tmp.str();
+
+  FILE *const file = fopen( tmp_filename.c_str(), "wb" );
+  if( !file ) return false;
+
+  bool ok = ( m_out.size() == fwrite( m_out.data(), 1, m_out.size(), file ) );
+  ok = ( 0 == fclose( file ) ) && ok;
+  ok = ok && ( 0 == rename( tmp_filename.c_str(), filename.c_str() ) );
+  if( !ok ) unlink( tmp_filename.c_str() );
+  return ok;
+}
+
+uint64_t BinaryWriter::hash( const char *s, size_t n )
+{
+  return fnv1a( s, n );
+}
+
+BinaryReader::BinaryReader( const std::string &in, size_t pos, StringUnifier *unifier )
+: m_in( in )
+, m_pos( pos )
+, m_unifier( unifier )
+{}
+
+BinaryReader::~BinaryReader( void )
+{}
+
+void BinaryReader::get_raw( void *p, size_t n )
+{
+  if( m_pos > m_in.size() || n > m_in.size() - m_pos )
+  {
+    throw Exception() << "Unexpected end of data";
+  }
+  std::memcpy( p, m_in.data() + m_pos, n );
+  m_pos += n;
+}
+
+size_t BinaryReader::get_size( void )
+{
+  const size_t n = size_t( get_u32() );
+  // Reject corrupted sizes before anything is allocated
+  if( n > m_in.size() - m_pos )
+  {
+    throw Exception() << "Unexpected end of data";
+  }
+  return n;
+}
+
+String BinaryReader::get_string( void )
+{
+  if( !get_bool() ) return String();
+  const size_t len = get_size();
+  const std::string str( m_in.data() + m_pos, len );
+  m_pos += len;
+  return unify( str );
+}
+
+String BinaryReader::unify( const std::string &s ) const
+{
+  if( m_unifier ) return String( m_unifier->unify( s ) );
+  return String( s );
+}
+
+Value BinaryReader::get_value( void )
+{
+  const Type::Enum type = Type::Enum( get_u8() );
+  switch( type )
+  {
+    case Type::NIL   : return Value();
+    case Type::BOOL  : return Value( get_bool() );
+    case Type::UINT8 : return Value( get< uint8_t  >() );
+    case Type::INT8  : return Value( get< int8_t   >() );
+    case Type::UINT16: return Value( get< uint16_t >() );
+    case Type::INT16 : return Value( get< int16_t  >() );
+    case Type::UINT32: return Value( get< uint32_t >() );
+    case Type::INT32 : return Value( get< int32_t  >() );
+    case Type::UINT64: return Value( get< uint64_t >() );
+    case Type::INT64 : return Value( get< int64_t  >() );
+    case Type::FLOAT : return Value( get< float    >() );
+    case Type::DOUBLE: return Value( get< double   >() );
+    case Type::STRING: return Value( get_string() );
+    default:
+      throw Exception() << "Invalid Value type " << int( type );
+  }
+}
+
+bool BinaryReader::readFile( const String &filename, std::string &contents )
+{
+  FILE *const file = fopen( filename.c_str(), "rb" );
+  if( !file ) return false;
+  return readAll( file, contents );
+}
+
+bool BinaryReader::readAll( FILE *file, std::string &contents )
+{
+  contents.clear();
+  struct stat st;
+  if( 0 == ::fstat( ::fileno( file ), &st ) && S_ISREG( st.st_mode ) )
+  {
+    contents.reserve( size_t( st.st_size ) );
+  }
+
+  char buffer[ 4096 ];
+  size_t n = 0;
+  while( 0 != ( n = fread( buffer, 1, sizeof( buffer ), file ) ) )
+  {
+    contents.append( buffer, n );
+  }
+
+  const bool ok = !ferror( file );
+  fclose( file );
+  return ok;
+}
+
+} // namespace RPGML
@@ -0,0 +1,152 @@
+/* This file is part of RPGML.
+ * 
+ * Copyright (c) 2014, Gunnar Payer, All rights reserved.
+ * 
+ * RPGML is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3.0 of the License, or (at your option) any later version.
+ * 
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ * 
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.
+ */
+/*! @file BinaryStream.h
+ * @brief Host byte order serialization for cache and snapshot files
+ *
+ * The files are only meant to be read back on the same kind of machine,
+ * so values are written in host byte order. Callers put a byte order
+ * marker into their headers.
+ */
+#ifndef RPGML_BinaryStream_h
+#define RPGML_BinaryStream_h
+
+#include "String.h"
+#include "Value.h"
+
+#include <string>
+#include <cstdio>
+#include <stdint.h>
+
+namespace RPGML {
+
+class StringUnifier;
+
+//! @brief Size and modification time of a file, to detect changes
+struct FileStamp
+{
+  FileStamp( void );
+
+  //! @brief Returns false, if filename does not exist
+  bool stat( const String &filename );
+
+  bool operator==( const FileStamp &other ) const;
+  bool operator!=( const FileStamp &other ) const { return !( (*this) == other ); }
+
+  uint64_t size;
+  int64_t mtime_sec;
+  int64_t mtime_nsec;
+};
+
+class BinaryWriter
+{
+public:
+  EXCEPTION_BASE( Exception );
+
+  BinaryWriter( void );
+  virtual ~BinaryWriter( void );
+
+  void put_raw( const void *p, size_t n );
+
+  template< class T >
+  void put( const T &x )
+  {
+    put_raw( &x, sizeof( x ) );
+  }
+
+  void put_u8  ( uint8_t  x ) { put( x ); }
+  void put_u32 ( uint32_t x ) { put( x ); }
+  void put_i32 ( int32_t  x ) { put( x ); }
+  void put_bool( bool     x ) { put_u8( x ? 1 : 0 ); }
+  void put_size( size_t   n ) { put_u32( uint32_t( n ) ); }
+
+  //! @brief Distinguishes the Null-String from the empty String
+  virtual void put_string( const String &s );
+
+  //! @brief Only primitive and String Values are supported
+  void put_value( const Value &value );
+
+  const std::string &getOut( void ) const { return m_out; }
+
+  /*! @brief Writes the output to filename
+   *
+   * Writes to a temporary file first and renames it, so concurrent readers
+   * never see a partial file. Returns false on failure.
+   */
+  bool writeFile( const String &filename ) const;
+
+  //! @brief 64 bit FNV-1a, see fnv1a()
+  static uint64_t hash( const char *s, size_t n );
+
+private:
+  std::string m_out;
+};
+
+class BinaryReader
+{
+public:
+  EXCEPTION_BASE( Exception );
+
+  //! @brief If unifier is not 0, all Strings read are unified
+  explicit
+  BinaryReader( const std::string &in, size_t pos = 0, StringUnifier *unifier = 0 );
+  virtual ~BinaryReader( void );
+
+  //! @brief Throws Exception, if in is too short
+  void get_raw( void *p, size_t n );
+
+  template< class T >
+  T get( void )
+  {
+    T x;
+    get_raw( &x, sizeof( x ) );
+    return x;
+  }
+
+  uint8_t  get_u8  ( void ) { return get< uint8_t  >(); }
+  uint32_t get_u32 ( void ) { return get< uint32_t >(); }
+  int32_t  get_i32 ( void ) { return get< int32_t  >(); }
+  bool     get_bool( void ) { return 0 != get_u8(); }
+
+  //! @brief Element counts, each element takes at least one byte
+  size_t get_size( void );
+
+  virtual String get_string( void );
+
+  Value get_value( void );
+
+  bool atEnd( void ) const { return m_pos == m_in.size(); }
+  size_t getPos( void ) const { return m_pos; }
+
+  //! @brief Returns false, if filename could not be read
+  static bool readFile( const String &filename, std::string &contents );
+
+  //! @brief Reads the remaining contents of file and closes it
+  static bool readAll( FILE *file, std::string &contents );
+
+protected:
+  String unify( const std::string &s ) const;
+
+private:
+  const std::string &m_in;
+  size_t m_pos;
+  StringUnifier *const m_unifier;
+};
+
+} // namespace RPGML
+
+#endif
@@ -0,0 +1,1396 @@
+/* This file is part of RPGML.
+ *
+ * Copyright (c) 2014, Gunnar Payer, All rights reserved.
+ *
+ * RPGML is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3.0 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.
+ */
+#include "Bytecode.h"
+
+#include "AST.h"
+#include "InterpretingASTVisitor.h"
+#include "Scope.h"
+#include "Frame.h"
+#include "Node.h"
+#include "Array.h"
+#include "Sequence.h"
+#include "Location.h"
+#include "ParseException.h"
+#include "ParserEnums.h"
+
+#include <ostream>
+#include <iomanip>
+#include <algorithm>
+
+namespace RPGML {
+
+namespace Bytecode_impl {
+
+/*! @brief Translates one Function body or statement into Bytecode
+ *
+ * Tracks the Frames the code will create at run time as levels. The
+ * variables of an exact level are known in order, so lookups into it are
+ * resolved to indices. A level stops being exact as soon as a declaration
+ * is not executed unconditionally.
+ */
+class Compiler : public AST::Visitor
+{
+public:
+  Compiler( Bytecode *code, bool in_function )
+  : m_code( code )
+  , m_in_function( in_function )
+  , m_dst( unknown )
+  , m_next_register( 0 )
+  , m_next_loop( 0 )
+  , m_call_loc( unknown )
+  {}
+
+  virtual ~Compiler( void )
+  {}
+
+  //! @brief Adds the level of a Frame that exists before execute()
+  index_t pushLevel( bool exact )
+  {
+    m_levels.push_back( Level( exact ) );
+    const index_t n = index_t( m_levels.size() );
+    if( n > m_code->m_num_levels ) m_code->m_num_levels = n;
+    return n-1;
+  }
+
+  void declared( const String &identifier )
+  {
+    Level &level = m_levels.back();
+    if( level.conditional > 0 )
+    {
+      level.exact = false;
+    }
+    else if( level.exact && unknown == find( level, identifier ) )
+    {
+      level.identifiers.push_back( identifier );
+    }
+  }
+
+  void statement( const AST::Node *node )
+  {
+    const index_t mark = m_next_register;
+    node->invite( this );
+    m_next_register = mark;
+  }
+
+  virtual void visit( const AST::ConstantExpression *node )
+  {
+    emit( node, Bytecode::CONST, m_dst );
+  }
+
+  virtual void visit( const AST::ThisExpression *node )
+  {
+    emit( node, Bytecode::THIS, m_dst );
+  }
+
+  virtual void visit( const AST::ArrayConstantExpression *node )
+  {
+    interpret( node, m_dst );
+  }
+
+  virtual void visit( const AST::FrameConstantExpression *node )
+  {
+    interpret( node, m_dst );
+  }
+
+  virtual void visit( const AST::ParenthisSequenceExpression *node )
+  {
+    if( node->sequence )
+    {
+      into( node->sequence, m_dst );
+    }
+    else
+    {
+      emit( node, Bytecode::SEQUENCE_EMPTY, m_dst );
+    }
+  }
+
+  virtual void visit( const AST::ExpressionSequenceExpression *node )
+  {
+    const index_t n = index_t( node->expressions.size() );
+    const index_t first = allocate( n );
+
+    for( index_t i=0; i<n; ++i )
+    {
+      into( node->expressions[ i ], first+i );
+    }
+
+    emit( node, Bytecode::SEQUENCE_VALUES, m_dst, first, n );
+  }
+
+  virtual void visit( const AST::FromToStepSequenceExpression *node )
+  {
+    const index_t first = allocate( 3 );
+    into( node->from, first );
+    into( node->to  , first+1 );
+    if( node->step ) into( node->step, first+2 );
+
+    emit( node, Bytecode::SEQUENCE_RANGE, m_dst, first, ( node->step ? 1 : 0 ) );
+  }
+
+  virtual void visit( const AST::LookupVariableExpression *node )
+  {
+    const index_t id = intern( node->identifier );
+
+    if( node->at_root )
+    {
+      emit( node, Bytecode::LOOKUP_ROOT, m_dst, 0, id );
+      return;
+    }
+
+    index_t level = 0;
+    index_t index = 0;
+    switch( resolve( node->identifier, level, index ) )
+    {
+      case SLOT   : emit( node, Bytecode::GET         , m_dst, level, index ); break;
+      case DYNAMIC: emit( node, Bytecode::LOOKUP      , m_dst, level, id    ); break;
+      case OUTER  : emit( node, Bytecode::LOOKUP_OUTER, m_dst, 0    , id    ); break;
+    }
+  }
+
+  virtual void visit( const AST::FunctionCallExpression *node )
+  {
+    const index_t n_args = node->args->size();
+    const index_t first = allocate( 1+n_args );
+
+    into( node->function, first );
+    for( index_t i=0; i<n_args; ++i )
+    {
+      into( node->args->at( i )->value, first+1+i );
+    }
+
+    emit( node, Bytecode::CALL, m_dst, first, n_args );
+  }
+
+  virtual void visit( const AST::DotExpression *node )
+  {
+    const index_t left = expression( node->left );
+    emit( node, Bytecode::DOT, m_dst, left );
+  }
+
+  virtual void visit( const AST::FrameAccessExpression *node )
+  {
+    const index_t left = expression( node->left );
+    emit( node, Bytecode::FRAME_ACCESS, m_dst, left );
+  }
+
+  virtual void visit( const AST::ArrayAccessExpression *node )
+  {
+    interpret( node, m_dst );
+  }
+
+  virtual void visit( const AST::UnaryExpression *node )
+  {
+    const index_t arg = expression( node->arg );
+    emit( node, Bytecode::UNARY, m_dst, arg );
+  }
+
+  virtual void visit( const AST::BinaryExpression *node )
+  {
+    const index_t left  = expression( node->left );
+    const index_t right = expression( node->right );
+    emit( node, Bytecode::BINARY, m_dst, left, right );
+  }
+
+  virtual void visit( const AST::IfThenElseExpression *node )
+  {
+    const index_t condition = expression( node->condition );
+    const index_t select = emit( node, Bytecode::SELECT, condition );
+
+    // Scalar condition: only one of the values is evaluated
+    into( node->then_value, m_dst );
+    const index_t then_done = emit( node, Bytecode::JUMP );
+    m_code->m_ops[ select ].b = here();
+    into( node->else_value, m_dst );
+    const index_t else_done = emit( node, Bytecode::JUMP );
+
+    // Output condition: both are, for an IfThenElse-Node
+    m_code->m_ops[ select ].c = here();
+    const index_t values = allocate( 2 );
+    into( node->then_value, values );
+    into( node->else_value, values+1 );
+    emit( node, Bytecode::IF_THEN_ELSE, m_dst, condition, values );
+
+    m_code->m_ops[ then_done ].a = here();
+    m_code->m_ops[ else_done ].a = here();
+  }
+
+  virtual void visit( const AST::TypeExpression *node )
+  {
+    interpret( node, m_dst );
+  }
+
+  virtual void visit( const AST::DimensionsExpression *node )
+  {
+    interpret( node, m_dst );
+  }
+
+  virtual void visit( const AST::CastExpression *node )
+  {
+    interpret( node, m_dst );
+  }
+
+  virtual void visit( const AST::CompoundStatement *node )
+  {
+    index_t level = unknown;
+    if( node->creates_own_frame )
+    {
+      level = pushLevel( true );
+      emit( node, Bytecode::ENTER, level );
+    }
+
+    for( size_t i=0; i<node->statements.size(); ++i )
+    {
+      statement( node->statements[ i ] );
+    }
+
+    if( node->creates_own_frame )
+    {
+      emit( node, Bytecode::LEAVE, level );
+      m_levels.pop_back();
+    }
+  }
+
+  virtual void visit( const AST::FunctionDefinitionStatement *node )
+  {
+    interpret( node, unknown );
+    declared( node->identifier );
+  }
+
+  virtual void visit( const AST::ConnectStatement *node )
+  {
+    index_t outer = pushCallLoc( node->output->loc );
+    const index_t output = expression( node->output );
+    m_call_loc = outer;
+
+    outer = pushCallLoc( node->input->loc );
+    const index_t input = expression( node->input );
+    m_call_loc = outer;
+
+    emit( node, Bytecode::CONNECT, output, input );
+  }
+
+  virtual void visit( const AST::AssignIdentifierStatement *node )
+  {
+    const index_t value = expression( node->value );
+
+    index_t level = 0;
+    index_t index = 0;
+    switch( resolve( node->identifier, level, index ) )
+    {
+      case SLOT   : emit( node, Bytecode::ASSIGN       , value, level, index ); break;
+      case DYNAMIC: emit( node, Bytecode::ASSIGN_LOOKUP, value, level ); break;
+      case OUTER  : emit( node, Bytecode::ASSIGN_OUTER , value ); break;
+    }
+  }
+
+  virtual void visit( const AST::AssignDotStatement *node )
+  {
+    interpret( node, unknown );
+  }
+
+  virtual void visit( const AST::AssignBracketStatement *node )
+  {
+    interpret( node, unknown );
+  }
+
+  virtual void visit( const AST::IfStatement *node )
+  {
+    const index_t condition = expression( node->condition );
+    const index_t branch = emit( node, Bytecode::BRANCH, condition );
+
+    const index_t level = index_t( m_levels.size()-1 );
+    ++m_levels[ level ].conditional;
+
+    statement( node->then_body );
+    if( node->else_body )
+    {
+      const index_t then_done = emit( node, Bytecode::JUMP );
+      m_code->m_ops[ branch ].b = here();
+      statement( node->else_body );
+      m_code->m_ops[ then_done ].a = here();
+    }
+    else
+    {
+      m_code->m_ops[ branch ].b = here();
+    }
+
+    --m_levels[ level ].conditional;
+  }
+
+  virtual void visit( const AST::NOPStatement * )
+  {}
+
+  virtual void visit( const AST::ForSequenceStatement *node )
+  {
+    loop( node, Bytecode::FOR_SEQUENCE, expression( node->sequence ) );
+  }
+
+  virtual void visit( const AST::ForContainerStatement *node )
+  {
+    loop( node, Bytecode::FOR_CONTAINER, expression( node->container ) );
+  }
+
+  virtual void visit( const AST::ExpressionStatement *node )
+  {
+    expression( node->expr );
+  }
+
+  virtual void visit( const AST::VariableCreationStatement *node )
+  {
+    const index_t value = allocate( 1 );
+    if( node->value ) into( node->value, value );
+
+    emit( node, Bytecode::CREATE_VALUE, value, ( node->value ? 1 : 0 ) );
+    declare( node, node->identifier, value );
+  }
+
+  virtual void visit( const AST::VariableConstructionStatement *node )
+  {
+    const index_t outer = pushCallLoc( node->loc );
+    const index_t value = expression( node->value );
+    m_call_loc = outer;
+
+    declare( node, node->identifier, value );
+  }
+
+  virtual void visit( const AST::ReturnStatement *node )
+  {
+    if( !m_in_function )
+    {
+      // Has to end the interpretation of the whole script
+      throw Bytecode::Exception() << "'return' outside of a Function is not compiled";
+    }
+
+    emit( node, Bytecode::RETURN, expression( node->value ) );
+  }
+
+private:
+  typedef Bytecode::Code Code;
+  typedef Bytecode::Op Op;
+
+  struct Level
+  {
+    explicit
+    Level( bool _exact )
+    : exact( _exact )
+    , conditional( 0 )
+    {}
+
+    std::vector< String > identifiers; //!< variables of the Frame by index, while exact
+    bool exact;
+    index_t conditional; //!< number of enclosing conditional statements of this level
+  };
+
+  enum Resolved
+  {
+      SLOT    //!< level and index
+    , DYNAMIC //!< searched by name, starting at level
+    , OUTER   //!< searched by name outside of all levels
+  };
+
+  static index_t find( const Level &level, const String &identifier )
+  {
+    for( index_t i = index_t( level.identifiers.size() ); i-- > 0; )
+    {
+      if( level.identifiers[ i ] == identifier ) return i;
+    }
+    return unknown;
+  }
+
+  Resolved resolve( const String &identifier, index_t &level, index_t &index ) const
+  {
+    for( level = index_t( m_levels.size() ); level-- > 0; )
+    {
+      const Level &l = m_levels[ level ];
+      if( !l.exact ) return DYNAMIC;
+
+      index = find( l, identifier );
+      if( unknown != index ) return SLOT;
+    }
+    level = 0;
+    return OUTER;
+  }
+
+  index_t intern( const String &identifier )
+  {
+    std::vector< String > &identifiers = m_code->m_identifiers;
+    const index_t n = index_t( identifiers.size() );
+    for( index_t i=0; i<n; ++i )
+    {
+      if( identifiers[ i ] == identifier ) return i;
+    }
+    identifiers.push_back( identifier );
+    return n;
+  }
+
+  index_t here( void ) const
+  {
+    return m_code->size();
+  }
+
+  index_t emit( const AST::Node *node, Code code, index_t a=0, index_t b=0, index_t c=0 )
+  {
+    Op op;
+    op.code = code;
+    op.a = a;
+    op.b = b;
+    op.c = c;
+    op.depth = getRD();
+    op.call_loc = m_call_loc;
+    op.node = node;
+    m_code->m_ops.push_back( op );
+    return here()-1;
+  }
+
+  index_t allocate( index_t n )
+  {
+    const index_t first = m_next_register;
+    m_next_register += n;
+    if( m_next_register > m_code->m_num_registers ) m_code->m_num_registers = m_next_register;
+    return first;
+  }
+
+  void into( const AST::Node *node, index_t dst )
+  {
+    const index_t old_dst = m_dst;
+    const index_t mark = m_next_register;
+    m_dst = dst;
+    node->invite( this );
+    m_dst = old_dst;
+    m_next_register = mark;
+  }
+
+  index_t expression( const AST::Node *node )
+  {
+    const index_t dst = allocate( 1 );
+    into( node, dst );
+    return dst;
+  }
+
+  //! @brief Returns the previous call location, restore it with m_call_loc
+  index_t pushCallLoc( const Location *loc )
+  {
+    const index_t outer = m_call_loc;
+    Bytecode::CallLoc call_loc;
+    call_loc.loc = loc;
+    call_loc.parent = outer;
+    m_call_loc = index_t( m_code->m_call_locs.size() );
+    m_code->m_call_locs.push_back( call_loc );
+    return outer;
+  }
+
+  void interpret( const AST::Node *node, index_t dst )
+  {
+    emit( node, Bytecode::INTERPRET, dst );
+  }
+
+  void declare( const AST::Node *node, const String &identifier, index_t value )
+  {
+    const index_t level = index_t( m_levels.size()-1 );
+    Level &l = m_levels[ level ];
+    if( l.conditional > 0 ) l.exact = false;
+
+    if( l.exact && unknown == find( l, identifier ) )
+    {
+      emit( node, Bytecode::DECLARE, value, level, intern( identifier ) );
+      l.identifiers.push_back( identifier );
+    }
+    else
+    {
+      emit( node, Bytecode::DECLARE_DYNAMIC, value, level, intern( identifier ) );
+    }
+  }
+
+  void loop( const AST::ForStatement *node, Code code, index_t container )
+  {
+    const index_t slot = m_next_loop++;
+    if( m_next_loop > m_code->m_num_loops ) m_code->m_num_loops = m_next_loop;
+
+    emit( node, code, slot, container );
+
+    const index_t level = pushLevel( true );
+    m_levels[ level ].identifiers.push_back( node->identifier );
+
+    const index_t next = emit( node, Bytecode::FOR_NEXT, slot, level );
+    statement( node->body );
+    emit( node, Bytecode::LEAVE, level );
+    emit( node, Bytecode::FOR_STEP, slot, next );
+    m_code->m_ops[ next ].c = here();
+
+    m_levels.pop_back();
+    --m_next_loop;
+  }
+
+  Bytecode *const m_code;
+  const bool m_in_function;
+  std::vector< Level > m_levels;
+  index_t m_dst; //!< register for the value of the current expression
+  index_t m_next_register;
+  index_t m_next_loop;
+  index_t m_call_loc;
+};
+
+} // namespace Bytecode_impl
+
+using namespace Bytecode_impl;
+
+//! @brief Registers, Frames and loop states of one execute()
+class Bytecode::State
+{
+public:
+  State( const Bytecode *code, Scope *scope, const Location *call_loc, index_t recursion_depth );
+  ~State( void );
+
+  bool run( Value &ret );
+
+private:
+  struct Loop
+  {
+    enum Kind { ARRAY, FRAME, SEQUENCE };
+
+    bool get( Value &value );
+    void next( void );
+    void clear( void );
+
+    Value container; //!< keeps the iterated Array, Frame or Sequence alive
+    CountPtr< Sequence::Iter > sequence;
+    CountPtr< Frame::Iterator > frame;
+    index_t index;
+    Kind kind;
+  };
+
+  enum Operator { MATH_OP1, BINARY_OP, NUM_OPERATORS };
+
+  CountPtr< const Location > getCallLoc( index_t call_loc ) const;
+  CountPtr< const Location > getCallLoc( const Op &op, const Location *loc ) const;
+
+  Frame *enter( index_t level );
+  void leave( index_t level );
+  Frame::Ref lookup( Frame *frame, const String &identifier ) const;
+
+  InterpretingASTVisitor *getHelper( void );
+  Value callOperator( const Op &op, Operator which, index_t n_args, const Value *args );
+
+  void execute( const Op &op, index_t &pc );
+
+  const Bytecode *const m_code;
+  const CountPtr< Scope > m_scope;
+  const CountPtr< const Location > m_call_loc;
+  const index_t m_rd;
+  Scope::EnterLeaveGuard m_guard;
+  std::vector< Value > m_registers;
+  std::vector< CountPtr< Frame > > m_frames; //!< by level, one more for leave()
+  std::vector< Loop > m_loops;
+  CountPtr< InterpretingASTVisitor > m_helper; //!< for the rules shared with the interpreter
+  CountPtr< Function > m_operators[ NUM_OPERATORS ];
+  bool m_returned;
+  Value *m_ret;
+};
+
+Bytecode::State::State( const Bytecode *code, Scope *scope, const Location *call_loc, index_t recursion_depth )
+: m_code( code )
+, m_scope( scope )
+, m_call_loc( call_loc )
+, m_rd( recursion_depth )
+, m_guard( scope, scope->getCurr() )
+, m_registers( code->m_num_registers )
+, m_frames( code->m_num_levels+1 )
+, m_loops( code->m_num_loops )
+, m_returned( false )
+, m_ret( 0 )
+{
+  Frame *frame = scope->getCurr();
+  for( index_t level = code->m_entry_level+1; level-- > 0 && frame; frame = frame->getParent() )
+  {
+    m_frames[ level ] = frame;
+  }
+}
+
+Bytecode::State::~State( void )
+{}
+
+bool Bytecode::State::Loop::get( Value &value )
+{
+  switch( kind )
+  {
+    case ARRAY:
+      {
+        const ArrayBase *const array = container.getArray();
+        if( index >= array->size() ) return false;
+        value = array->getValue( index );
+        return true;
+      }
+
+    case FRAME:
+      if( frame->done() ) return false;
+      value = frame->get().second;
+      return true;
+
+    case SEQUENCE:
+      if( sequence->done() ) return false;
+      value = sequence->get();
+      return true;
+  }
+
+  return false;
+}
+
+void Bytecode::State::Loop::next( void )
+{
+  switch( kind )
+  {
+    case ARRAY   : ++index; break;
+    case FRAME   : frame->next(); break;
+    case SEQUENCE: sequence->next(); break;
+  }
+}
+
+void Bytecode::State::Loop::clear( void )
+{
+  sequence.reset();
+  frame.reset();
+  container.clear();
+}
+
+CountPtr< const Location > Bytecode::State::getCallLoc( index_t call_loc ) const
+{
+  if( unknown == call_loc ) return m_call_loc;
+  const CallLoc &entry = m_code->m_call_locs[ call_loc ];
+  return new Location( entry.loc, getCallLoc( entry.parent ) );
+}
+
+CountPtr< const Location > Bytecode::State::getCallLoc( const Op &op, const Location *loc ) const
+{
+  return new Location( loc, getCallLoc( op.call_loc ) );
+}
+
+Frame *Bytecode::State::enter( index_t level )
+{
+  CountPtr< Frame > &frame = m_frames[ level ];
+  Frame *const parent = m_frames[ level-1 ];
+
+  // Frames are left empty by leave() and reused by the next iteration
+  if( frame.isNull() || frame->getParent() != parent )
+  {
+    frame = new Frame( m_scope->getGC(), parent );
+  }
+
+  m_scope->setCurr( frame );
+  return frame;
+}
+
+void Bytecode::State::leave( index_t level )
+{
+  m_scope->setCurr( m_frames[ level-1 ] );
+
+  CountPtr< Frame > &frame = m_frames[ level ];
+  const Frame *const inner = m_frames[ level+1 ];
+
+  // Only reused if nothing but m_frames refers to it, e.g. no Function defined in it
+  const refCount_t expected = ( inner && inner->getParent() == frame.get() ? 2 : 1 );
+
+  if( frame->refCount() == expected )
+  {
+    while( frame->getSize() > 0 ) frame->pop_back();
+  }
+  else
+  {
+    frame.reset();
+  }
+}
+
+Frame::Ref Bytecode::State::lookup( Frame *frame, const String &identifier ) const
+{
+  for( ; frame; frame = frame->getParent() )
+  {
+    const Frame::Ref ret = frame->load( identifier, m_scope );
+    if( !ret.isNull() ) return ret;
+  }
+
+  return Frame::Ref();
+}
+
+InterpretingASTVisitor *Bytecode::State::getHelper( void )
+{
+  if( !m_helper )
+  {
+    m_helper = new InterpretingASTVisitor( m_scope->getGC(), m_scope, m_call_loc, m_rd );
+  }
+  return m_helper;
+}
+
+Value Bytecode::State::callOperator( const Op &op, Operator which, index_t n_args, const Value *args )
+{
+  static const char *const names[ NUM_OPERATORS ] = { ".math.mathOp1", ".binaryOp" };
+
+  const CountPtr< const Location > loc = getCallLoc( op, op.node->loc );
+
+  CountPtr< Function > &function = m_operators[ which ];
+  if( !function )
+  {
+    const String name = String::Static( names[ which ] );
+    const Value *const value = m_scope->lookup( name );
+    if( !value ) throw ParseException( loc ) << "Function '" << name << "' not found";
+    if( !value->isFunction() ) throw ParseException( loc ) << "Variable '" << name << "' is not a Function";
+    function = value->getFunction();
+  }
+
+  try
+  {
+    return function->call( loc, m_rd+op.depth+1, m_scope, n_args, args );
+  }
+  catch( const ParseException & )
+  {
+    throw;
+  }
+  catch( const RPGML::Exception &e )
+  {
+    throw ParseException( loc, e );
+  }
+
+  // Never reached
+  return Value();
+}
+
+bool Bytecode::State::run( Value &ret )
+{
+  m_ret = &ret;
+
+  const index_t n = m_code->size();
+  const Op *op = 0;
+  index_t pc = 0;
+
+  try
+  {
+    while( pc < n && !m_returned )
+    {
+      op = &m_code->m_ops[ pc++ ];
+
+      if( m_rd + op->depth > AST::Visitor::max_recursion_depth )
+      {
+        throw "Maximum recursion depth reached";
+      }
+
+      execute( *op, pc );
+    }
+  }
+  catch( const AST::Visitor::CallLocException & )
+  {
+    throw;
+  }
+  catch( const RPGML::Exception &e )
+  {
+    // Includes ParseException
+    throw AST::Visitor::CallLocException( getCallLoc( *op, op->node->loc ), e );
+  }
+  catch( const char *e )
+  {
+    throw AST::Visitor::CallLocException( getCallLoc( *op, op->node->loc ) ) << e;
+  }
+  catch( const std::exception &e )
+  {
+    throw AST::Visitor::CallLocException( getCallLoc( *op, op->node->loc ) ) << e.what();
+  }
+  catch( ... )
+  {
+    throw AST::Visitor::CallLocException( getCallLoc( *op, op->node->loc ) ) << "Caught some unknown exception";
+  }
+
+  return m_returned;
+}
+
+void Bytecode::State::execute( const Op &op, index_t &pc )
+{
+  Value *const r = m_registers.data();
+  GarbageCollector *const gc = m_scope->getGC();
+
+  switch( op.code )
+  {
+    case CONST:
+      r[ op.a ] = static_cast< const AST::ConstantExpression* >( op.node )->value;
+      break;
+
+    case THIS:
+      {
+        Frame *frame = m_scope->getCurr();
+        while( frame && !frame->isThis() ) frame = frame->getParent();
+        if( !frame ) throw Exception() << "No parent Frame that qualifies as 'this'";
+        r[ op.a ] = Value( frame );
+      }
+      break;
+
+    case GET:
+      r[ op.a ] = m_frames[ op.b ]->m_values[ op.c ];
+      break;
+
+    case LOOKUP:
+    case LOOKUP_OUTER:
+      {
+        const String &identifier = m_code->m_identifiers[ op.c ];
+        Frame *const start = ( LOOKUP == op.code ? m_frames[ op.b ].get() : m_frames[ 0 ]->getParent() );
+        const Frame::Ref value = lookup( start, identifier );
+        if( value.isNull() ) throw Exception() << "Identifier '" << identifier << "' not found";
+        r[ op.a ] = *value;
+      }
+      break;
+
+    case LOOKUP_ROOT:
+      {
+        const String &identifier = m_code->m_identifiers[ op.c ];
+        const Frame::Ref value = m_scope->getRoot()->load( identifier, m_scope );
+        if( value.isNull() ) throw Exception() << "Identifier '." << identifier << "' not found";
+        r[ op.a ] = *value;
+      }
+      break;
+
+    case CALL:
+      {
+        const AST::FunctionCallExpression *const node = static_cast< const AST::FunctionCallExpression* >( op.node );
+        const Value &function = r[ op.b ];
+
+        if( !function.isFunction() )
+        {
+          throw ParseException( node->function->loc )
+            << "Is not a Function, is " << function.getTypeName()
+            ;
+        }
+
+        Function::Args args;
+        args.reserve( op.c );
+        for( index_t i=0; i<op.c; ++i )
+        {
+          args.push_back( Function::Arg( node->args->at( i )->identifier, r[ op.b+1+i ] ) );
+        }
+
+        const CountPtr< const Location > loc = getCallLoc( op, node->loc );
+        r[ op.a ] = function.getFunction()->call( loc, m_rd+op.depth+1, m_scope, &args );
+      }
+      break;
+
+    case UNARY:
+      {
+        const AST::UnaryExpression *const node = static_cast< const AST::UnaryExpression* >( op.node );
+        Value args[ 2 ];
+        args[ 0 ] = Value( String::Static( getUOPStr( node->op ) ) );
+        args[ 1 ].swap( r[ op.b ] );
+        r[ op.a ] = callOperator( op, MATH_OP1, 2, args );
+      }
+      break;
+
+    case BINARY:
+      {
+        const AST::BinaryExpression *const node = static_cast< const AST::BinaryExpression* >( op.node );
+        Value args[ 3 ];
+        args[ 0 ].swap( r[ op.b ] );
+        args[ 1 ] = Value( String::Static( getBOPStr( node->op ) ) );
+        args[ 2 ].swap( r[ op.c ] );
+        r[ op.a ] = callOperator( op, BINARY_OP, 3, args );
+      }
+      break;
+
+    case DOT:
+      {
+        const AST::DotExpression *const node = static_cast< const AST::DotExpression* >( op.node );
+        const Value &left = r[ op.b ];
+
+        if( !left.isFrame() )
+        {
+          throw ParseException( node->left->loc )
+            << "left of '.' is not a Frame, is " << left.getTypeName()
+            ;
+        }
+
+        const Value *const value = left.getFrame()->getVariable( node->member );
+        if( !value ) throw Exception() << "Member '" << node->member << "' not found";
+        r[ op.a ] = *value;
+      }
+      break;
+
+    case FRAME_ACCESS:
+      {
+        const AST::FrameAccessExpression *const node = static_cast< const AST::FrameAccessExpression* >( op.node );
+        const Value &left = r[ op.b ];
+
+        Frame::Ref value;
+        if( left.isFrame() )
+        {
+          value = left.getFrame()->load( node->identifier, m_scope );
+        }
+        else if( left.isNode() )
+        {
+          const Value *const member = left.getNode()->getVariable( node->identifier );
+          if( member )
+          {
+            r[ op.a ] = *member;
+            break;
+          }
+        }
+        else
+        {
+          throw AST::Visitor::CallLocException( getCallLoc( op, node->loc ) )
+            << "Left of '.' is not accessible via '.', is " << left.getTypeName()
+            ;
+        }
+
+        if( value.isNull() )
+        {
+          throw AST::Visitor::CallLocException( getCallLoc( op, node->loc ) )
+            << "Identifier '" << node->identifier << "' not found right of '.'"
+            ;
+        }
+
+        r[ op.a ] = *value;
+      }
+      break;
+
+    case SEQUENCE_EMPTY:
+      r[ op.a ] = Value( genSequenceFromToStep( gc, Value( 1 ), Value( -1 ), Value( 1 ) ) );
+      break;
+
+    case SEQUENCE_VALUES:
+      {
+        CountPtr< ValueArray > array = new ValueArray( gc, 1 );
+        array->resize( op.c );
+
+        for( index_t i=0; i<op.c; ++i )
+        {
+          array->at( i ).swap( r[ op.b+i ] );
+        }
+
+        r[ op.a ] = Value( new SequenceValueArray( gc, array ) );
+      }
+      break;
+
+    case SEQUENCE_RANGE:
+      {
+        const AST::FromToStepSequenceExpression *const node = static_cast< const AST::FromToStepSequenceExpression* >( op.node );
+        const Value &from = r[ op.b ];
+        const Value &to   = r[ op.b+1 ];
+
+        if( !from.isScalar() )
+        {
+          throw ParseException( node->from->loc )
+            << "'from' must be scalar, is " << from.getTypeName()
+            ;
+        }
+
+        if( !to.isScalar() )
+        {
+          throw ParseException( node->to->loc )
+            << "'to' must be scalar, is " << to.getTypeName()
+            ;
+        }
+
+        Value step;
+        if( op.c )
+        {
+          step.swap( r[ op.b+2 ] );
+          if( !step.isScalar() )
+          {
+            throw ParseException( node->step->loc )
+              << "'step' must be scalar, is " << step.getTypeName()
+              ;
+          }
+        }
+        else
+        {
+          // "smallest" possible type
+          step = Value( bool( 1 ) );
+        }
+
+        r[ op.a ].set( genSequenceFromToStep( gc, from, to, step ) );
+      }
+      break;
+
+    case SELECT:
+      {
+        const AST::IfThenElseExpression *const node = static_cast< const AST::IfThenElseExpression* >( op.node );
+        const Value &condition = r[ op.a ];
+
+        if( condition.isScalar() )
+        {
+          bool is_true;
+          try
+          {
+            is_true = condition.to( Type::Bool() ).getBool();
+          }
+          catch( const RPGML::Exception & )
+          {
+            throw ParseException( node->condition->loc )
+              << ": Unsupported type '" << condition.getType() << "' for condition"
+              ;
+          }
+
+          if( !is_true ) pc = op.b;
+        }
+        else if( condition.isString() )
+        {
+          throw ParseException( node->condition->loc )
+            << ": Cannot use string directly as condition, use a comparison instead"
+            ;
+        }
+        else if( condition.isOutput() )
+        {
+          pc = op.c;
+        }
+        else
+        {
+          throw ParseException( node->condition->loc )
+            << ": Unsupported type '" << condition.getType() << "' for condition"
+            ;
+        }
+      }
+      break;
+
+    case IF_THEN_ELSE:
+      {
+        const AST::IfThenElseExpression *const node = static_cast< const AST::IfThenElseExpression* >( op.node );
+        const index_t rd = m_rd+op.depth+1;
+
+        Value then_value;
+        then_value.set( m_scope->toOutput( getCallLoc( op, node->then_value->loc ), rd, r[ op.c ] ) );
+
+        Value else_value;
+        else_value.set( m_scope->toOutput( getCallLoc( op, node->else_value->loc ), rd, r[ op.c+1 ] ) );
+
+        const CountPtr< Node > ifthenelse = m_scope->createNode( getCallLoc( op, node->loc ), rd, String::Static( ".core.IfThenElse" ) );
+
+        r[ op.b ] .getOutput()->connect( ifthenelse->getInput( String::Static( "in_if"   ) ) );
+        then_value.getOutput()->connect( ifthenelse->getInput( String::Static( "in_then" ) ) );
+        else_value.getOutput()->connect( ifthenelse->getInput( String::Static( "in_else" ) ) );
+
+        r[ op.a ] = Value( ifthenelse->getOutput( String::Static( "out" ) ) );
+      }
+      break;
+
+    case JUMP:
+      pc = op.a;
+      break;
+
+    case BRANCH:
+      {
+        const AST::IfStatement *const node = static_cast< const AST::IfStatement* >( op.node );
+        const Value &condition = r[ op.a ];
+
+        bool condition_is_true;
+        try
+        {
+          condition_is_true = condition.to( Type::Bool() ).getBool();
+        }
+        catch( const Value::CastFailed &e )
+        {
+          throw ParseException( node->condition->loc, e )
+            << ": Unsupported type '" << condition << "' for condition"
+            ;
+        }
+
+        if( !condition_is_true ) pc = op.b;
+      }
+      break;
+
+    case ENTER:
+      enter( op.a );
+      break;
+
+    case LEAVE:
+      leave( op.a );
+      break;
+
+    case FOR_SEQUENCE:
+      {
+        const AST::ForSequenceStatement *const node = static_cast< const AST::ForSequenceStatement* >( op.node );
+        Loop &loop = m_loops[ op.a ];
+        loop.container.swap( r[ op.b ] );
+
+        if( !loop.container.isSequence() )
+        {
+          throw ParseException( node->sequence->loc )
+            << "Right of '=' is not a sequence, is " << loop.container.getTypeName()
+            ;
+        }
+
+        loop.kind = Loop::SEQUENCE;
+        loop.sequence = loop.container.getSequence()->getIter();
+      }
+      break;
+
+    case FOR_CONTAINER:
+      {
+        const AST::ForContainerStatement *const node = static_cast< const AST::ForContainerStatement* >( op.node );
+        Loop &loop = m_loops[ op.a ];
+        loop.container.swap( r[ op.b ] );
+
+        if( loop.container.isArray() )
+        {
+          loop.kind = Loop::ARRAY;
+          loop.index = 0;
+        }
+        else if( loop.container.isFrame() )
+        {
+          loop.kind = Loop::FRAME;
+          loop.frame = loop.container.getFrame()->getIterator();
+        }
+        else if( loop.container.isSequence() )
+        {
+          loop.kind = Loop::SEQUENCE;
+          loop.sequence = loop.container.getSequence()->getIter();
+        }
+        else
+        {
+          throw ParseException( node->container->loc )
+            << "Invalid type '" << loop.container.getType() << "' for container after 'in'"
+            ;
+        }
+      }
+      break;
+
+    case FOR_NEXT:
+      {
+        Loop &loop = m_loops[ op.a ];
+        Value value;
+        if( loop.get( value ) )
+        {
+          const AST::ForStatement *const node = static_cast< const AST::ForStatement* >( op.node );
+          enter( op.b )->push_back( node->identifier, value );
+        }
+        else
+        {
+          loop.clear();
+          pc = op.c;
+        }
+      }
+      break;
+
+    case FOR_STEP:
+      m_loops[ op.a ].next();
+      pc = op.b;
+      break;
+
+    case DECLARE:
+      m_frames[ op.b ]->push_back( m_code->m_identifiers[ op.c ], r[ op.a ] );
+      break;
+
+    case DECLARE_DYNAMIC:
+      {
+        Frame *const frame = m_frames[ op.b ];
+        const String &identifier = m_code->m_identifiers[ op.c ];
+
+        if( unknown != frame->getIndex( identifier ) )
+        {
+          throw Exception() << "Identifier '" << identifier << "' already exists";
+        }
+
+        frame->push_back( identifier, r[ op.a ] );
+      }
+      break;
+
+    case CREATE_VALUE:
+      {
+        const AST::VariableCreationStatement *const node = static_cast< const AST::VariableCreationStatement* >( op.node );
+        InterpretingASTVisitor *const helper = getHelper();
+
+        CountPtr< InterpretingASTVisitor::TypeDescr > type;
+        node->type->invite( helper );
+        type.swap( helper->return_value_type_descr );
+
+        if( op.b )
+        {
+          r[ op.a ] = helper->save_cast( r[ op.a ], type.get() );
+        }
+        else
+        {
+          r[ op.a ] = helper->create_default_value( type.get(), node->identifier );
+        }
+      }
+      break;
+
+    case ASSIGN:
+      {
+        const AST::AssignIdentifierStatement *const node = static_cast< const AST::AssignIdentifierStatement* >( op.node );
+        getHelper()->assign_value( node, &m_frames[ op.b ]->m_values[ op.c ], r[ op.a ] );
+      }
+      break;
+
+    case ASSIGN_LOOKUP:
+    case ASSIGN_OUTER:
+      {
+        const AST::AssignIdentifierStatement *const node = static_cast< const AST::AssignIdentifierStatement* >( op.node );
+        Frame *const start = ( ASSIGN_LOOKUP == op.code ? m_frames[ op.b ].get() : m_frames[ 0 ]->getParent() );
+        const Frame::Ref lvalue = lookup( start, node->identifier );
+        if( lvalue.isNull() ) throw Exception() << "Identifier '" << node->identifier << "' not found";
+        getHelper()->assign_value( node, lvalue, r[ op.a ] );
+      }
+      break;
+
+    case CONNECT:
+      getHelper()->connect( r[ op.a ], r[ op.b ] );
+      break;
+
+    case INTERPRET:
+      {
+        const CountPtr< InterpretingASTVisitor > interpreter =
+          new InterpretingASTVisitor( gc, m_scope, getCallLoc( op.call_loc ), m_rd+op.depth-1 );
+
+        op.node->invite( interpreter.get() );
+
+        if( interpreter->get_return_encountered() )
+        {
+          *m_ret = interpreter->get_return_value();
+          m_returned = true;
+        }
+        else if( unknown != op.a )
+        {
+          r[ op.a ] = interpreter->get_return_value();
+        }
+      }
+      break;
+
+    case RETURN:
+      m_ret->swap( r[ op.a ] );
+      m_returned = true;
+      break;
+
+    default:
+      throw Exception() << "Invalid instruction " << int( op.code );
+  }
+}
+
+Bytecode::Bytecode( void )
+: m_num_registers( 0 )
+, m_num_levels( 0 )
+, m_num_loops( 0 )
+, m_entry_level( 0 )
+{}
+
+Bytecode::~Bytecode( void )
+{}
+
+CountPtr< Bytecode > Bytecode::compileFunction( const AST::CompoundStatement *body, const Function::Args *decl_args )
+{
+  CountPtr< Bytecode > code = new Bytecode();
+  Compiler compiler( code, true );
+
+  // The Frame with the arguments, created by Function::call()
+  compiler.pushLevel( true );
+  for( index_t i=0; i<decl_args->size(); ++i )
+  {
+    compiler.declared( decl_args->at( i ).getIdentifier() );
+  }
+
+  // The Frame created by InterpretingFunction::call_impl()
+  code->m_entry_level = compiler.pushLevel( true );
+
+  try
+  {
+    compiler.statement( body );
+  }
+  catch( const RPGML::Exception & )
+  {
+    return CountPtr< Bytecode >();
+  }
+
+  return code;
+}
+
+CountPtr< Bytecode > Bytecode::compileStatement( const AST::Statement *statement )
+{
+  CountPtr< Bytecode > code = new Bytecode();
+  Compiler compiler( code, false );
+
+  // The current Frame, its variables are not known
+  code->m_entry_level = compiler.pushLevel( false );
+
+  try
+  {
+    compiler.statement( statement );
+  }
+  catch( const RPGML::Exception & )
+  {
+    return CountPtr< Bytecode >();
+  }
+
+  return code;
+}
+
+bool Bytecode::execute( Scope *scope, const Location *call_loc, index_t recursion_depth, Value &ret ) const
+{
+  if( m_ops.empty() ) return false;
+
+  State state( this, scope, call_loc, recursion_depth );
+  return state.run( ret );
+}
+
+std::ostream &Bytecode::print( std::ostream &o ) const
+{
+  for( index_t i=0; i<size(); ++i )
+  {
+    const Op &op = m_ops[ i ];
+    o
+      << std::setw( 5 ) << i << " "
+      << std::left << std::setw( 16 ) << getCodeName( op.code ) << std::right
+      << " " << std::setw( 4 ) << int32_t( op.a )
+      << " " << std::setw( 4 ) << int32_t( op.b )
+      << " " << std::setw( 4 ) << int32_t( op.c )
+      << std::endl
+      ;
+  }
+  return o;
+}
+
+const char *Bytecode::getCodeName( Code code )
+{
+  switch( code )
+  {
+    case CONST          : return "CONST";
+    case THIS           : return "THIS";
+    case GET            : return "GET";
+    case LOOKUP         : return "LOOKUP";
+    case LOOKUP_OUTER   : return "LOOKUP_OUTER";
+    case LOOKUP_ROOT    : return "LOOKUP_ROOT";
+    case CALL           : return "CALL";
+    case UNARY          : return "UNARY";
+    case BINARY         : return "BINARY";
+    case DOT            : return "DOT";
+    case FRAME_ACCESS   : return "FRAME_ACCESS";
+    case SEQUENCE_EMPTY : return "SEQUENCE_EMPTY";
+    case SEQUENCE_VALUES: return "SEQUENCE_VALUES";
+    case SEQUENCE_RANGE : return "SEQUENCE_RANGE";
+    case SELECT         : return "SELECT";
+    case IF_THEN_ELSE   : return "IF_THEN_ELSE";
+    case JUMP           : return "JUMP";
+    case BRANCH         : return "BRANCH";
+    case ENTER          : return "ENTER";
+    case LEAVE          : return "LEAVE";
+    case FOR_SEQUENCE   : return "FOR_SEQUENCE";
+    case FOR_CONTAINER  : return "FOR_CONTAINER";
+    case FOR_NEXT       : return "FOR_NEXT";
+    case FOR_STEP       : return "FOR_STEP";
+    case DECLARE        : return "DECLARE";
+    case DECLARE_DYNAMIC: return "DECLARE_DYNAMIC";
+    case CREATE_VALUE   : return "CREATE_VALUE";
+    case ASSIGN         : return "ASSIGN";
+    case ASSIGN_LOOKUP  : return "ASSIGN_LOOKUP";
+    case ASSIGN_OUTER   : return "ASSIGN_OUTER";
+    case CONNECT        : return "CONNECT";
+    case INTERPRET      : return "INTERPRET";
+    case RETURN         : return "RETURN";
+  }
+  return "<invalid>";
+}
+
+} // namespace RPGML
@@ -0,0 +1,171 @@
+/* This file is part of RPGML.
+ * 
+ * Copyright (c) 2014, Gunnar Payer, All rights reserved.
+ * 
+ * RPGML is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3.0 of the License, or (at your option) any later version.
+ * 
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ * 
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.
+ */
+/*! @file Bytecode.h
+ * @brief Register machine code for Function bodies and top-level loops
+ *
+ * The InterpretingASTVisitor dispatches through two virtual calls per AST
+ * node, passes every intermediate Value through its return_value, looks up
+ * every identifier by name and allocates a Frame per loop iteration.
+ * Bytecode is compiled once from the AST instead: intermediate Values live
+ * in numbered registers, variables of the Frames created by the compiled
+ * code are addressed by (level, index), the Functions behind operators are
+ * resolved once per execution and Frames of loop bodies are reused unless
+ * something kept a reference to them.
+ *
+ * Constructs without an instruction of their own are handed to an
+ * InterpretingASTVisitor, which also stays available for everything via
+ * Context::setCompile( false ).
+ */
+#ifndef RPGML_Bytecode_h
+#define RPGML_Bytecode_h
+
+#include "Refcounted.h"
+#include "Function.h"
+#include "Value.h"
+#include "String.h"
+#include "Exception.h"
+
+#include <vector>
+#include <iosfwd>
+
+namespace RPGML {
+
+class Scope;
+class Location;
+
+namespace AST {
+  class Node;
+  class Statement;
+  class CompoundStatement;
+} // namespace AST
+
+namespace Bytecode_impl {
+  class Compiler;
+} // namespace Bytecode_impl
+
+class Bytecode : public Refcounted
+{
+public:
+  EXCEPTION_BASE( Exception );
+
+  virtual ~Bytecode( void );
+
+  /*! @brief Compiles the body of an InterpretingFunction with the arguments decl_args
+   *
+   * Returns null if the body cannot be compiled, it has to be interpreted then.
+   * The instructions refer to the Nodes of body, which has to outlive the Bytecode.
+   */
+  static CountPtr< Bytecode > compileFunction( const AST::CompoundStatement *body, const Function::Args *decl_args );
+
+  //! @brief Compiles a top-level statement, null if it cannot be compiled, e.g. because it contains 'return'
+  static CountPtr< Bytecode > compileStatement( const AST::Statement *statement );
+
+  /*! @brief Executes the code in the current Frame of scope
+   *
+   * call_loc and recursion_depth are those an InterpretingASTVisitor would be
+   * created with. Returns whether a return statement was executed, its value
+   * is stored in ret.
+   */
+  bool execute( Scope *scope, const Location *call_loc, index_t recursion_depth, Value &ret ) const;
+
+  //! @brief Number of instructions
+  index_t size( void ) const { return index_t( m_ops.size() ); }
+
+  //! @brief Writes one instruction per line, for debugging
+  std::ostream &print( std::ostream &o ) const;
+
+private:
+  friend class Bytecode_impl::Compiler;
+  class State;
+
+  enum Code
+  {
+      CONST           //!< a = node value
+    , THIS            //!< a = first Frame that qualifies as 'this'
+    , GET             //!< a = variable c of the Frame at level b
+    , LOOKUP          //!< a = identifier c, searched from the Frame at level b
+    , LOOKUP_OUTER    //!< a = identifier c, searched from the parent of level 0
+    , LOOKUP_ROOT     //!< a = identifier c, searched in the root Frame
+    , CALL            //!< a = Function b called with the c arguments following it
+    , UNARY           //!< a = node op b
+    , BINARY          //!< a = b node op c
+    , DOT             //!< a = b.member
+    , FRAME_ACCESS    //!< a = b.identifier, also for Nodes
+    , SEQUENCE_EMPTY  //!< a = sequence()
+    , SEQUENCE_VALUES //!< a = sequence( the c values from b on )
+    , SEQUENCE_RANGE  //!< a = sequence( b to b+1 step b+2 ), no step unless c
+    , SELECT          //!< continue if scalar a is true, else jump to b, jump to c if a is an Output
+    , IF_THEN_ELSE    //!< a = IfThenElse-Node for the Outputs b ? c : c+1
+    , JUMP            //!< continue at a
+    , BRANCH          //!< continue if a is true, else jump to b
+    , ENTER           //!< enters a new or reused Frame at level a
+    , LEAVE           //!< leaves the Frame at level a
+    , FOR_SEQUENCE    //!< starts loop a over the Sequence b
+    , FOR_CONTAINER   //!< starts loop a over the Array, Frame or Sequence b
+    , FOR_NEXT        //!< enters level b with the next element of loop a, jumps to c when done
+    , FOR_STEP        //!< advances loop a and jumps to b
+    , DECLARE         //!< creates variable c with value a in the Frame at level b
+    , DECLARE_DYNAMIC //!< same, but checks whether c already exists
+    , CREATE_VALUE    //!< a = a cast to the type of the declaration, default value unless b
+    , ASSIGN          //!< assigns a to variable c of the Frame at level b
+    , ASSIGN_LOOKUP   //!< assigns a to the node identifier, searched from the Frame at level b
+    , ASSIGN_OUTER    //!< assigns a to the node identifier, searched from the parent of level 0
+    , CONNECT         //!< connects a -> b
+    , INTERPRET       //!< a = node interpreted by an InterpretingASTVisitor, unless a is unknown
+    , RETURN          //!< returns a
+  };
+
+  struct Op
+  {
+    Code code;
+    index_t a;
+    index_t b;
+    index_t c;
+    index_t depth; //!< of node in the AST, recursion depth relative to execute()
+    index_t call_loc; //!< index into m_call_locs, unknown for the one passed to execute()
+    const AST::Node *node; //!< for Locations, identifiers and operators
+  };
+
+  //! @brief Location pushed by the InterpretingASTVisitor around the evaluation of a child
+  struct CallLoc
+  {
+    const Location *loc;
+    index_t parent;
+  };
+
+  Bytecode( void );
+
+  static const char *getCodeName( Code code );
+
+  std::vector< Op > m_ops;
+  std::vector< CallLoc > m_call_locs;
+  std::vector< String > m_identifiers;
+  index_t m_num_registers;
+  index_t m_num_levels;
+  index_t m_num_loops;
+  index_t m_entry_level; //!< level of the current Frame when execute() is called
+
+  //! forbidden
+  Bytecode( const Bytecode & );
+  //! forbidden
+  Bytecode &operator=( const Bytecode & );
+};
+
+} // namespace RPGML
+
+#endif
@@ -21,15 +21,104 @@
 #include "Scope.h"
 #include "Frame.h"
 #include "StringUnifier.h"
+#include "SharedObject.h"
+#include "ScriptCache.h"
+#include "ThreadPool.h"
 
 #include <string>
 #include <cmath>
 
 namespace RPGML {
 
+namespace Context_impl {
+
+//! @brief Preparses a script or opens a plugin on a worker of the ThreadPool
+class PreloadJob : public JobQueue::Job
+{
+  typedef JobQueue::Job Base;
+public:
+  PreloadJob( GarbageCollector *_gc, const String &filename, bool is_script )
+  : Base( _gc )
+  , m_filename( filename )
+  , m_is_script( is_script )
+  , m_ok( false )
+  {}
+
+  virtual ~PreloadJob( void )
+  {}
+
+  const String &getFilename( void ) const { return m_filename; }
+  bool isScript( void ) const { return m_is_script; }
+  bool isOk( void ) const { return m_ok; }
+  std::string &getEntry( void ) { return m_entry; }
+  const CountPtr< SharedObject > &getSO( void ) const { return m_so; }
+
+protected:
+  virtual size_t doit( CountPtr< JobQueue > )
+  {
+    if( m_is_script )
+    {
+      m_ok = ScriptCache::preparse( m_filename, m_entry );
+    }
+    else
+    {
+      // Errors are reported when the plugin is actually loaded
+      String err;
+      m_so = new SharedObject( m_filename, err );
+      m_ok = m_so->isValid();
+    }
+    return 0;
+  }
+
+private:
+  const String m_filename;
+  const bool m_is_script;
+  bool m_ok;
+  std::string m_entry;
+  CountPtr< SharedObject > m_so;
+};
+
+typedef std::vector< std::pair< String, bool > > Files;
+
+//! @brief Collects the files below path that Frame::load() would load, with whether they are scripts
+static
+void collect( PluginIndex &index, const String &path, index_t depth, Files &files )
+{
+  PluginIndex::List identifiers;
+  index.list( path, identifiers );
+
+  for( PluginIndex::List::const_iterator i( identifiers.begin() ), end( identifiers.end() ); i != end; ++i )
+  {
+    const String identifier( i->first );
+    const int kinds = i->second;
+
+    if( kinds & PluginIndex::FUNCTION )
+    {
+      files.push_back( std::make_pair( path + "/libRPGML_Function_" + identifier + ".so", false ) );
+    }
+    if( kinds & PluginIndex::NODE )
+    {
+      files.push_back( std::make_pair( path + "/libRPGML_Node_" + identifier + ".so", false ) );
+    }
+    if( kinds & PluginIndex::SCRIPT )
+    {
+      files.push_back( std::make_pair( path + "/" + identifier + ".rpgml", true ) );
+    }
+    if( ( kinds & PluginIndex::DIRECTORY ) && depth < Context::preload_depth && identifier[ 0 ] != '.' )
+    {
+      collect( index, path + "/" + identifier, depth+1, files );
+    }
+  }
+}
+
+} // namespace Context_impl
+
+using namespace Context_impl;
+
 Context::Context( GarbageCollector *_gc, StringUnifier *unifier, const String &searchPath )
 : Collectable( _gc )
 , m_unifier( unifier )
+, m_compile( true )
 , m_nr( 0 )
 {
   m_root = new Frame( getGC() );
@@ -108,6 +197,92 @@ const std::vector< String > &Context::getSearchPaths( void ) const
   return m_searchPaths;
 }
 
+Context &Context::setCacheDir( const String &cacheDir )
+{
+  m_cacheDir = cacheDir;
+  return (*this);
+}
+
+const String &Context::getCacheDir( void ) const
+{
+  return m_cacheDir;
+}
+
+Context &Context::setCompile( bool compile )
+{
+  m_compile = compile;
+  return (*this);
+}
+
+bool Context::getCompile( void ) const
+{
+  return m_compile;
+}
+
+index_t Context::preload( ThreadPool *pool )
+{
+  Files files;
+  for( size_t i( 0 ), end( m_searchPaths.size() ); i < end; ++i )
+  {
+    collect( m_pluginIndex, m_searchPaths[ i ], 0, files );
+  }
+
+  const CountPtr< JobQueue > queue = pool->getQueue();
+
+  std::vector< CountPtr< PreloadJob > > jobs;
+  std::vector< CountPtr< JobQueue::Job::Token > > tokens;
+  jobs.reserve( files.size() );
+  tokens.reserve( files.size() );
+
+  for( Files::const_iterator i( files.begin() ), end( files.end() ); i != end; ++i )
+  {
+    const CountPtr< PreloadJob > job = new PreloadJob( getGC(), i->first, i->second );
+    tokens.push_back( job->getToken() );
+    jobs.push_back( job );
+    queue->addJob( job );
+  }
+
+  index_t num_preloaded = 0;
+  for( size_t i( 0 ), end( jobs.size() ); i < end; ++i )
+  {
+    tokens[ i ]->wait();
+
+    PreloadJob *const job = jobs[ i ];
+    if( !job->isOk() ) continue;
+
+    const std::string filename( job->getFilename().c_str() );
+    if( job->isScript() )
+    {
+      m_preloadedScripts[ filename ].swap( job->getEntry() );
+    }
+    else
+    {
+      m_preloadedSOs[ filename ] = job->getSO();
+    }
+    ++num_preloaded;
+  }
+
+  return num_preloaded;
+}
+
+bool Context::takePreloadedScript( const String &script, std::string &entry )
+{
+  const std::map< std::string, std::string >::iterator i = m_preloadedScripts.find( std::string( script.c_str() ) );
+  if( i == m_preloadedScripts.end() ) return false;
+  entry.swap( i->second );
+  m_preloadedScripts.erase( i );
+  return true;
+}
+
+CountPtr< SharedObject > Context::takePreloadedSO( const String &so )
+{
+  const std::map< std::string, CountPtr< SharedObject > >::iterator i = m_preloadedSOs.find( std::string( so.c_str() ) );
+  if( i == m_preloadedSOs.end() ) return CountPtr< SharedObject >();
+  const CountPtr< SharedObject > ret = i->second;
+  m_preloadedSOs.erase( i );
+  return ret;
+}
+
 CountPtr< Scope > Context::createScope( void )
 {
   return new Scope( getGC(), this );
@@ -177,7 +352,7 @@ CountPtr< Graph > Context::createGraph( void ) const
   {
     Node *const node = n->get();
     if( !node ) continue;
-    graph->addNode( node );
+    graph->addNode( node, true );
   }
 
   return graph;
@@ -20,9 +20,12 @@
 
 #include "GarbageCollector.h"
 #include "String.h"
+#include "PluginIndex.h"
 
 #include <memory>
 #include <vector>
+#include <map>
+#include <string>
 
 namespace RPGML {
 
@@ -30,6 +33,8 @@ class Graph;
 class Scope;
 class Frame;
 class StringUnifier;
+class SharedObject;
+class ThreadPool;
 
 //! Do not allocate on the stack
 class Context : public Collectable
@@ -44,6 +49,33 @@ public:
   Context &setSearchPath( const String &searchPath );
   const std::vector< String > &getSearchPaths( void ) const;
 
+  //! Directory for ScriptCache entries, empty disables caching
+  Context &setCacheDir( const String &cacheDir );
+  const String &getCacheDir( void ) const;
+
+  //! Whether Function bodies and top-level loops are compiled to Bytecode, default is true
+  Context &setCompile( bool compile );
+  bool getCompile( void ) const;
+
+  //! Directory contents of the search paths, used to resolve unknown identifiers
+  PluginIndex &getPluginIndex( void ) { return m_pluginIndex; }
+
+  /*! @brief Preparses all scripts and opens all plugins on the search paths, using the workers of pool
+   *
+   * Loading them later only interprets the preparsed statements. Namespace
+   * directories are searched up to preload_depth levels deep.
+   * Returns the number of preloaded files.
+   */
+  index_t preload( ThreadPool *pool );
+
+  //! @brief Moves the preparsed entry of script to entry, returns false if there is none
+  bool takePreloadedScript( const String &script, std::string &entry );
+
+  //! @brief Takes the preloaded plugin so, null if there is none
+  CountPtr< SharedObject > takePreloadedSO( const String &so );
+
+  static const index_t preload_depth = 3;
+
   Frame *getRoot( void ) const { return m_root; }
 
   CountPtr< Scope > createScope( void );
@@ -62,6 +94,11 @@ private:
   CountPtr< Frame > m_root;
   CountPtr< StringUnifier > m_unifier;
   std::vector< String > m_searchPaths;
+  String m_cacheDir;
+  bool m_compile;
+  PluginIndex m_pluginIndex;
+  std::map< std::string, std::string > m_preloadedScripts;
+  std::map< std::string, CountPtr< SharedObject > > m_preloadedSOs;
   size_t m_nr;
 };
 
@@ -21,9 +21,12 @@
 #include "Scanner.h"
 
 #include <cstdio>
+#include <vector>
+#include <sys/stat.h>
 
 namespace RPGML {
 
+//! @brief Reads a regular file in one chunk, so the Scanner can slice tokens without copying
 class FileSource : public Source
 {
 public:
@@ -38,15 +41,29 @@ public:
 
   virtual const char *nextChars( void )
   {
-    const size_t n = ::fread( m_buffer, 1, BUFFER_SIZE-1, m_file );
+    if( m_buffer.empty() )
+    {
+      // First call: size the buffer for the rest of a regular file
+      size_t size = BUFFER_SIZE;
+      struct stat st;
+      if( 0 == ::fstat( ::fileno( m_file ), &st ) && S_ISREG( st.st_mode ) )
+      {
+        const long pos = ::ftell( m_file );
+        const size_t rest = size_t( st.st_size ) - size_t( pos > 0 ? pos : 0 );
+        if( rest + 1 > size ) size = rest + 1;
+      }
+      m_buffer.resize( size );
+    }
+
+    const size_t n = ::fread( &m_buffer[ 0 ], 1, m_buffer.size()-1, m_file );
     if( 0 == n ) return 0;
     m_buffer[ n ] = '\0';
-    return m_buffer;
+    return &m_buffer[ 0 ];
   }
 
 private:
-  static const int BUFFER_SIZE = 4096;
-  char m_buffer[ BUFFER_SIZE ];
+  static const size_t BUFFER_SIZE = 4096;
+  std::vector< char > m_buffer;
   FILE *m_file;
 };
 
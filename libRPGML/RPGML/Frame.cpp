@@ -22,12 +22,12 @@
 #include "SharedObject.h"
 #include "Function.h"
 #include "Node.h"
-#include "InterpretingParser.h"
-#include "FileSource.h"
+#include "ScriptCache.h"
+#include "Context.h"
 #include "ParseException.h"
+#include "fnv1a.h"
 
-#include <sys/types.h>
-#include <dirent.h>
+#include <cstring>
 
 using namespace std;
 
@@ -59,7 +59,7 @@ private:
 };
 
 NodeCreator::NodeCreator( GarbageCollector *_gc, const Location *loc, Frame *parent, const String &name, create_Node_t create_Node, const SharedObject *so )
-: Function( _gc, loc, parent, 0, so )
+: Function( _gc, loc, parent, 0, false, so )
 , m_name( name )
 , m_create_Node( create_Node )
 {}
@@ -136,6 +136,7 @@ const char *NodeCreator::getName( void ) const
 
 Frame::Frame( GarbageCollector *_gc, Frame *parent, const String &path )
 : Collectable( _gc )
+, m_indexed( false )
 , m_parent( parent )
 , m_path( path )
 , m_depth( parent ? parent->getDepth()+1 : 0 )
@@ -189,8 +190,24 @@ void Frame::reserve( index_t n )
   m_identifiers.reserve( n );
 }
 
+size_t Frame::IdentifierHash::operator()( const char *identifier ) const
+{
+  return size_t( fnv1a( identifier, ::strlen( identifier ) ) );
+}
+
+bool Frame::IdentifierEqual::operator()( const char *a, const char *b ) const
+{
+  return a == b || 0 == ::strcmp( a, b );
+}
+
 index_t Frame::getIndex( const char *identifier ) const
 {
+  if( m_indexed )
+  {
+    const index_map_t::const_iterator i = m_index.find( identifier );
+    return ( i != m_index.end() ? i->second : unknown );
+  }
+
   const int n = int( m_identifiers.size() );
   for( int i = n-1; i>=0; --i )
   {
@@ -203,6 +220,61 @@ index_t Frame::getIndex( const char *identifier ) const
   return unknown;
 }
 
+void Frame::addToIndex( index_t index )
+{
+  if( m_indexed )
+  {
+    insertIntoIndex( index );
+  }
+  else if( m_identifiers.size() >= min_indexed_size )
+  {
+    m_indexed = true;
+    for( index_t i = 0, end = index_t( m_identifiers.size() ); i < end; ++i )
+    {
+      insertIntoIndex( i );
+    }
+  }
+}
+
+void Frame::insertIntoIndex( index_t index )
+{
+  m_shadowed.resize( m_identifiers.size(), unknown );
+
+  const std::pair< index_map_t::iterator, bool > ins =
+    m_index.insert( index_map_t::value_type( m_identifiers[ index ].c_str(), index ) );
+
+  if( ins.second )
+  {
+    m_shadowed[ index ] = unknown;
+  }
+  else
+  {
+    // push_back() of an existing identifier hides the previous one until pop_back()
+    m_shadowed[ index ] = ins.first->second;
+    ins.first->second = index;
+  }
+}
+
+void Frame::removeFromIndex( index_t index )
+{
+  if( !m_indexed ) return;
+
+  const index_map_t::iterator i = m_index.find( m_identifiers[ index ].c_str() );
+  if( i != m_index.end() && i->second == index )
+  {
+    const index_t shadowed = m_shadowed[ index ];
+    if( shadowed != unknown )
+    {
+      i->second = shadowed;
+    }
+    else
+    {
+      m_index.erase( i );
+    }
+  }
+  m_shadowed.resize( index );
+}
+
 index_t Frame::getCreateIndex( const String &identifier, bool *existed_p )
 {
   index_t index = getIndex( identifier );
@@ -216,6 +288,7 @@ index_t Frame::getCreateIndex( const String &identifier, bool *existed_p )
   index = index_t( m_values.size() );
   m_values     .push_back( Value() );
   m_identifiers.push_back( identifier );
+  addToIndex( index );
 
   if( existed_p ) (*existed_p) = false;
   return index;
@@ -330,6 +403,7 @@ Frame::Ref Frame::push_back( const String &identifier, const Value &value )
 
   m_identifiers.push_back( identifier );
   m_values.push_back( value );
+  addToIndex( index );
 
   return Ref( this, index );
 }
@@ -340,6 +414,7 @@ void Frame::pop_back( void )
   if( m_values.empty() ) throw Exception() << "Frame already empty";
 
   const size_t new_size = m_values.size()-1;
+  removeFromIndex( index_t( new_size ) );
   m_values.resize( new_size );
   m_identifiers.resize( new_size );
 }
@@ -585,12 +660,13 @@ Frame::Ref Frame::load( const String &path, const String &identifier, const Scop
 {
 //  std::cerr << "load( '" << path << "', '" << identifier << "', )" << std::endl;
 
+  const int kinds = scope->getContext()->getPluginIndex().lookup( path, identifier );
+  if( kinds == PluginIndex::NONE ) return Ref();
+
   // Check whether identifier refers to a directory, use it as namespace
-  String dir = path + "/" + identifier;
-  DIR *const dir_p = opendir( dir.c_str() );
-  if( dir_p )
+  if( kinds & PluginIndex::DIRECTORY )
   {
-    closedir( dir_p );
+    const String dir = path + "/" + identifier;
 //    std::cerr << "Found directory '" << dir << "'" << std::endl;
     CountPtr< Frame > ret = new Frame( getGC(), this, dir );
     const String unified = scope->unify( identifier );
@@ -599,88 +675,77 @@ Frame::Ref Frame::load( const String &path, const String &identifier, const Scop
   }
 
   // Check whether identifier refers to a Function-plugin
+  if( kinds & PluginIndex::FUNCTION )
   {
     const String so = path + "/libRPGML_Function_" + identifier + ".so";
-    FILE *so_file = fopen( so.c_str(), "rb" );
-    if( so_file )
+//    std::cerr << "Found shared object '" << so << "'" << std::endl;
+
+    String err;
+    CountPtr< SharedObject > so_p = scope->getContext()->takePreloadedSO( so );
+    if( so_p.isNull() ) so_p = new SharedObject( so, err );
+    if( so_p->isValid() )
     {
-  //    std::cerr << "Found shared object '" << so << "'" << std::endl;
-      fclose( so_file );
+//      std::cerr << "Loaded shared object '" << so << "'" << std::endl;
 
-      String err;
-      CountPtr< SharedObject > so_p = new SharedObject( so, err );
-      if( so_p->isValid() )
+      create_Function_t create_function;
+      const String symbol = identifier + "_create_Function";
+      if( so_p->getSymbol( symbol, create_function, err ) )
       {
-  //      std::cerr << "Loaded shared object '" << so << "'" << std::endl;
-
-        create_Function_t create_function;
-        const String symbol = identifier + "_create_Function";
-        if( so_p->getSymbol( symbol, create_function, err ) )
-        {
-  //        std::cerr << "Got symbol '" << symbol << " from shared object '" << so << "'" << std::endl;
-          CountPtr< Function > function = create_function( getGC(), this, so_p.get() );
-          const String unified = scope->unify( identifier );
-          return getStack( set( unified, Value( function.get() ) ) );
-        }
-      }
-      else
-      {
-        throw Exception() << "Opening shared object '" << so << "' failed: " << err;
+//        std::cerr << "Got symbol '" << symbol << " from shared object '" << so << "'" << std::endl;
+        CountPtr< Function > function = create_function( getGC(), this, so_p.get() );
+        const String unified = scope->unify( identifier );
+        return getStack( set( unified, Value( function.get() ) ) );
       }
     }
+    else
+    {
+      throw Exception() << "Opening shared object '" << so << "' failed: " << err;
+    }
   }
 
   // Check whether identifier refers to a Node-plugin
+  if( kinds & PluginIndex::NODE )
   {
     const String so = path + "/libRPGML_Node_" + identifier + ".so";
-    FILE *so_file = fopen( so.c_str(), "rb" );
-    if( so_file )
+//    std::cerr << "Found shared object '" << so << "'" << std::endl;
+
+    String err;
+    CountPtr< SharedObject > so_p = scope->getContext()->takePreloadedSO( so );
+    if( so_p.isNull() ) so_p = new SharedObject( so, err );
+    if( so_p->isValid() )
     {
-  //    std::cerr << "Found shared object '" << so << "'" << std::endl;
-      fclose( so_file );
+//      std::cerr << "Loaded shared object '" << so << "'" << std::endl;
 
-      String err;
-      CountPtr< SharedObject > so_p = new SharedObject( so, err );
-      if( so_p->isValid() )
+      create_Node_t create_Node;
+      const String symbol = identifier + "_create_Node";
+      if( so_p->getSymbol( symbol, create_Node, err ) )
       {
-  //      std::cerr << "Loaded shared object '" << so << "'" << std::endl;
-
-        create_Node_t create_Node;
-        const String symbol = identifier + "_create_Node";
-        if( so_p->getSymbol( symbol, create_Node, err ) )
-        {
-  //        std::cerr << "Got symbol '" << symbol << " from shared object '" << so << "'" << std::endl;
-          const String name = genGlobalName( identifier );
-          CountPtr< Function > node_creator(
-            new Frame_impl::NodeCreator(
-              getGC(), new Location( so ), this, name, create_Node, so_p.get()
-              )
-            );
-          const String unified = scope->unify( identifier );
-          return getStack( set( unified, Value( node_creator.get() ) ) );
-        }
-      }
-      else
-      {
-        throw Exception() << "Opening so file '" << so << "' failed: " << err;
+//        std::cerr << "Got symbol '" << symbol << " from shared object '" << so << "'" << std::endl;
+        const String name = genGlobalName( identifier );
+        CountPtr< Function > node_creator(
+          new Frame_impl::NodeCreator(
+            getGC(), new Location( so ), this, name, create_Node, so_p.get()
+            )
+          );
+        const String unified = scope->unify( identifier );
+        return getStack( set( unified, Value( node_creator.get() ) ) );
       }
     }
+    else
+    {
+      throw Exception() << "Opening so file '" << so << "' failed: " << err;
+    }
   }
 
   // Check whether identifier refers to a script
+  if( kinds & PluginIndex::SCRIPT )
   {
     const String rpgml = path + "/" + identifier + ".rpgml";
     FILE *const rpgml_p = fopen( rpgml.c_str(), "r" );
     if( rpgml_p )
     {
-      CountPtr< Source > source = new FileSource( rpgml_p );
       CountPtr< Scope > new_scope = new Scope( getGC(), scope, this );
-      CountPtr< InterpretingParser > parser = new InterpretingParser( getGC(), new_scope, source );
-
-      parser->setFilename( rpgml );
-      parser->parse();
-      parser.reset();
-      source.reset();
+      ScriptCache::interpretFile( new_scope, rpgml, rpgml_p );
 
       Frame::Ref ret = getVariable( identifier );
       if( ret.isNull() )
@@ -27,6 +27,7 @@
 
 #include <map>
 #include <vector>
+#include <unordered_map>
 
 namespace RPGML {
 
@@ -59,6 +60,12 @@ public:
   class Ref;
   class ConstRef;
 
+  /*! @brief Only used by the interpreting thread, so it counts without atomics
+   *
+   * Node derives from Frame, so a Ref may also reference a Node, which the
+   * workers reference with CountPtrs while the Graph is executed. This is
+   * safe only because interpretation never overlaps with the execution.
+   */
   class Ref
   {
   public:
@@ -74,10 +81,11 @@ public:
     Value *operator->( void ) const;
   private:
     friend class ConstRef;
-    CountPtr< Frame > m_frame;
+    LocalCountPtr< Frame > m_frame;
     index_t m_index;
   };
 
+  //! @brief Like Ref, also only safe, because interpretation and execution never overlap
   class ConstRef
   {
   public:
@@ -93,7 +101,7 @@ public:
     const Value &operator*( void ) const;
     const Value *operator->( void ) const;
   private:
-    CountPtr< const Frame > m_frame;
+    LocalCountPtr< const Frame > m_frame;
     index_t m_index;
   };
 
@@ -177,9 +185,34 @@ private:
 
   friend class Ref;
   friend class ConstRef;
+  friend class Bytecode; // addresses variables by index, see Bytecode.h
+
+  //! @brief Hashes the contents of an identifier
+  struct IdentifierHash
+  {
+    size_t operator()( const char *identifier ) const;
+  };
+
+  //! @brief Compares the contents, unified identifiers share their pointer
+  struct IdentifierEqual
+  {
+    bool operator()( const char *a, const char *b ) const;
+  };
+
+  typedef std::unordered_map< const char*, index_t, IdentifierHash, IdentifierEqual > index_map_t;
+
+  //! Frames smaller than this are searched linearly, larger ones through m_index
+  static const size_t min_indexed_size = 8;
+
+  void addToIndex( index_t index );
+  void insertIntoIndex( index_t index );
+  void removeFromIndex( index_t index );
 
   values_t m_values;
   identifiers_t m_identifiers;
+  index_map_t m_index; // identifier -> last index with that identifier, keys point into m_identifiers
+  std::vector< index_t > m_shadowed; // for each index the previous index with the same identifier, or unknown
+  bool m_indexed; // whether m_index and m_shadowed are maintained
   CountPtr< Frame > m_parent; // might create a closure, points to where the lookup continues
   String m_identifier; // might be null for anonymous Maps
   String m_path; // if this map corresponds to a directory
@@ -17,6 +17,10 @@
  */
 #include "GarbageCollector.h"
 
+#include "AllocationTracker.h"
+#include "Metrics.h"
+#include "Profiler.h"
+
 #include <cassert>
 #include <memory>
 #include <iostream>
@@ -67,6 +71,8 @@ public:
   virtual void add( const Collectable *c );
   virtual void remove( const Collectable *c );
 
+  virtual void getRetainers( std::vector< const Collectable* > &objects, std::vector< index_t > &retainers );
+
 private:
   typedef std::vector< const Collectable* > CollectableArray;
   void compact( CollectableArray &cs_new, uint8_t up_to_generation );
@@ -311,6 +317,10 @@ void GenerationalGarbageCollector::run( uint8_t up_to_generation )
 {
   if( m_cs.empty() ) return;
 
+  const bool metrics = Metrics::isEnabled();
+  const int64_t begin = ( metrics ? Profiler::now() : 0 );
+  index_t live = 0;
+
   CollectableArray cs_new;
 
   { Mutex::ScopedLock lock( &m_lock );
@@ -320,10 +330,80 @@ void GenerationalGarbageCollector::run( uint8_t up_to_generation )
 
     // make new cs current
     std::swap( cs_new, m_cs );
+    live = index_t( m_cs.size() );
   } // m_lock
 
   // cs_new now contains garbage
   sweep( cs_new );
+
+  if( metrics ) Metrics::global().gcDone( Profiler::now() - begin, live );
+}
+
+void GenerationalGarbageCollector::getRetainers( CollectableArray &objects, std::vector< index_t > &retainers )
+{
+  Mutex::ScopedLock lock( &m_lock );
+
+  // position of m_cs[ i ] in objects
+  std::vector< index_t > pos( m_cs.size(), unknown );
+  objects.clear();
+  for( size_t i=0; i<m_cs.size(); ++i )
+  {
+    if( !m_cs[ i ] ) continue;
+    pos[ i ] = index_t( objects.size() );
+    objects.push_back( m_cs[ i ] );
+  }
+
+  const size_t n = objects.size();
+  retainers.assign( n, unknown );
+
+  GenerationalGarbageCollectorChildren children;
+  children.reserve( 512 );
+
+  // Roots as in compact(), but regardless of the generation
+  vector< refCount_t > refcount( n );
+  for( size_t i=0; i<n; ++i )
+  {
+    children.clear();
+    objects[ i ]->gc_getChildren( children );
+
+    for( size_t j = 0; j < children.size(); ++j )
+    {
+      const Collectable *const child = children[ j ];
+      if( !child || child->getGC() != this ) continue;
+      ++refcount[ pos[ child->getGCIndex() ] ];
+    }
+  }
+
+  // Breadth first, so the paths from the roots are the shortest
+  vector< bool > reached( n, false );
+  vector< index_t > queue;
+  queue.reserve( n );
+  for( size_t i=0; i<n; ++i )
+  {
+    if( refcount[ i ] == objects[ i ]->refCount() ) continue;
+    reached[ i ] = true;
+    queue.push_back( index_t( i ) );
+  }
+
+  for( size_t q = 0; q < queue.size(); ++q )
+  {
+    const index_t i = queue[ q ];
+
+    children.clear();
+    objects[ i ]->gc_getChildren( children );
+
+    for( size_t j = 0; j < children.size(); ++j )
+    {
+      const Collectable *const child = children[ j ];
+      if( !child || child->getGC() != this ) continue;
+
+      const index_t c = pos[ child->getGCIndex() ];
+      if( reached[ c ] ) continue;
+      reached[ c ] = true;
+      retainers[ c ] = i;
+      queue.push_back( c );
+    }
+  }
 }
 
 void GenerationalGarbageCollector::moveObjectsTo( GarbageCollector *other )
@@ -349,6 +429,7 @@ Collectable::Collectable( GarbageCollector *gc )
 , m_gc_refCount( 0 )
 , m_gc_index( 0 )
 , m_gc_generation( 0 )
+, m_alloc_site( AllocationTracker::created() )
 {
 #ifdef GC_DEBUG
   std::cerr << "create " << this << std::endl;
@@ -360,6 +441,7 @@ Collectable::Collectable( const Collectable &other )
 : m_gc( nullptr )
 , m_gc_index( 0 )
 , m_gc_generation( 0 )
+, m_alloc_site( AllocationTracker::created() )
 {
 #ifdef GC_DEBUG
   std::cerr << "create " << this << std::endl;
@@ -377,6 +459,7 @@ Collectable &Collectable::operator=( const Collectable & )
 Collectable::~Collectable( void )
 {
   if( m_gc ) m_gc->remove( this );
+  AllocationTracker::destroyed( m_alloc_site );
 #ifdef GC_DEBUG
   std::cerr << "delete " << this << std::endl;
 #endif
@@ -390,5 +473,10 @@ void Collectable::gc_getChildren( Children &children ) const
   (void)children;
 }
 
+size_t Collectable::getAllocatedBytes( void ) const
+{
+  return 0;
+}
+
 } // namespace RPGML
 
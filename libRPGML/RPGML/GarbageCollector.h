@@ -47,6 +47,15 @@ public:
   virtual void add( const Collectable *c ) = 0;
   virtual void remove( const Collectable *c ) = 0;
 
+  /*! @brief All Collectables and the one each was first reached from, starting at the roots
+   *
+   * retainers[ i ] is the index in objects of the Collectable, that retains
+   * objects[ i ] on a shortest path from the roots, unknown for the roots and
+   * for garbage. Must only be called while no other thread changes references,
+   * e.g. while no Node is executed.
+   */
+  virtual void getRetainers( std::vector< const Collectable* > &objects, std::vector< index_t > &retainers ) = 0;
+
 protected:
   static void deactivate_deletion( const Collectable *c );
   static void setGC( const Collectable *c, GarbageCollector *gc );
@@ -85,6 +94,19 @@ public:
     return --m_gc_refCount;
   }
 
+  //! @brief Not thread-safe, for LocalCountPtr
+  refCount_t ref_local( void ) const
+  {
+    return m_gc_refCount.add_unsynchronized( 1 );
+  }
+
+  //! @brief Not thread-safe, for LocalCountPtr
+  refCount_t unref_local( void ) const
+  {
+    m_gc_generation = 0;
+    return m_gc_refCount.add_unsynchronized( -1 );
+  }
+
   refCount_t refCount( void ) const
   {
     return m_gc_refCount;
@@ -115,6 +137,12 @@ public:
   index_t getGCIndex( void ) const { return m_gc_index; }
   uint8_t getGCGeneration( void ) const { return m_gc_generation; }
 
+  //! @brief Who created this, for the AllocationTracker
+  uint16_t getAllocationSite( void ) const { return m_alloc_site; }
+
+  //! @brief Bytes held besides the object itself, e.g. the elements of an ArrayData
+  virtual size_t getAllocatedBytes( void ) const;
+
 private:
   void deactivate_deletion( void ) const throw()
   {
@@ -126,6 +154,7 @@ private:
   mutable Atomic< refCount_t > m_gc_refCount;
   mutable index_t m_gc_index;
   mutable uint8_t m_gc_generation;
+  const uint16_t m_alloc_site; //!< fits into the padding
 };
 
 static inline bool isCollectable( const Collectable * ) { return true; }
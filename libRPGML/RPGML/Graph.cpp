@@ -17,9 +17,21 @@
  */
 #include "Graph.h"
 
+#include "Log.h"
+#include "Profiler.h"
+#include "Metrics.h"
+#include "Affinity.h"
+#include "AllocationTracker.h"
+#include "Scope.h"
+#include "Location.h"
+#include "fnv1a.h"
+
 #include <iostream>
+#include <iomanip>
 #include <cstring>
 #include <algorithm>
+#include <functional>
+#include <unordered_map>
 
 using namespace std;
 
@@ -29,6 +41,9 @@ Graph::Graph( GarbageCollector *_gc )
 : Base( _gc )
 , m_nodes( new GraphNodeArray( _gc, 1 ) )
 , m_order_determined( false )
+, m_frame( 0 )
+, m_frame_limit( 0 )
+, m_frame_begin( 0 )
 {}
 
 Graph::~Graph( void )
@@ -39,10 +54,22 @@ bool Graph::empty( void ) const
   return m_nodes->empty();
 }
 
-void Graph::addNode( Node *node )
+void Graph::addNode( Node *node, bool needed )
 {
   if( !node ) return;
 
+  if( needed )
+  {
+    index_t gni = 0;
+    if( !alreadyAdded( node, &gni ) )
+    {
+      gni = m_nodes->size();
+      addNode( node );
+    }
+    (*m_nodes)[ gni ]->needed = true;
+    return;
+  }
+
   std::vector< Node* > to_be_checked;
   to_be_checked.push_back( node );
 
@@ -95,118 +122,473 @@ bool Graph::alreadyAdded( const Node *node, index_t *index ) const
 
 void Graph::merge( void )
 {
-//  cerr << "merge: starting with " << m_nodes.size() << " nodes" << endl;
+//  cerr << "merge: starting with " << m_nodes->size() << " nodes" << endl;
 
-  bool merged_one;
-  do
-  {
-    merged_one = false;
-    const index_t num_nodes = m_nodes->size();
+  const index_t num_nodes = m_nodes->size();
+
+  vector< index_t > order;
+  topological_order( order );
 
-    CountPtr< GraphNodeArray > new_nodes = new GraphNodeArray( getGC(), 1 );
-    new_nodes->reserve( num_nodes / 2 );
+  CountPtr< GraphNodeArray > new_nodes = new GraphNodeArray( getGC(), 1 );
+  new_nodes->reserve( num_nodes );
 
-    sort( m_nodes->begin(), m_nodes->end(), GraphNode::compare_less );
+  // Structural hash -> index into new_nodes of the Nodes kept so far
+  typedef unordered_multimap< size_t, index_t > kept_t;
+  kept_t kept;
+  kept.reserve( num_nodes );
 
-    // Start of first block of equivalent Nodes
-    index_t equal_first = 0;
-    index_t equal_last  = 0;
-    // Run one time more to be able to merge the last block
-    // Start comparing from 1, start first block at 0
-    for( index_t i=1; i<=num_nodes; ++i )
+  vector< bool > visited( num_nodes, false );
+  vector< index_t > into_output_index;
+
+  // When a Node is visited, all its predecessors have already been merged,
+  // so its Inputs are connected to the Outputs that remain. Merging it
+  // only rewires its successors, which have not been visited yet.
+  // Therefore one pass suffices.
+  for( size_t r = 0; r < order.size(); ++r )
+  {
+    const index_t gni = order[ r ];
+    visited[ gni ] = true;
+
+    GraphNodeArray::Element &gn_merge_node = (*m_nodes)[ gni ];
+    Node *const merge_node = gn_merge_node->node;
+    const size_t hash = gn_merge_node->hash();
+
+    bool merged = false;
+    const pair< kept_t::const_iterator, kept_t::const_iterator > candidates = kept.equal_range( hash );
+    for( kept_t::const_iterator c( candidates.first ); c != candidates.second && !merged; ++c )
     {
-      if( i < num_nodes && (*m_nodes)[ equal_first ]->equivalent( (*m_nodes)[ i ] ) )
+      GraphNode *const gn_merge_into = (*new_nodes)[ c->second ];
+      if( !gn_merge_into->equivalent( gn_merge_node ) ) continue;
+
+      Node *const merge_into = gn_merge_into->node;
+      const index_t num_outputs = merge_node->getNumOutputs();
+
+      // Check, whether all Outputs needed by the to-be-merged Node are present in the merge-into Node
+      // Remember the indeces, so the string lookup does not have to be done twice
+      bool merge_failed = false;
+      into_output_index.resize( num_outputs );
+      for( index_t o=0; o<num_outputs; ++o )
       {
-        equal_last = i;
+        Output *const merge_output = merge_node->getOutput( o );
+        if( !merge_into->tryGetOutput( merge_output->getIdentifier(), &into_output_index[ o ] ) )
+        {
+          merge_failed = true;
+          break;
+        }
       }
-      else
+      if( merge_failed ) continue;
+
+      /*
+      cerr
+        << "Merging '" << merge_node->getIdentifier() << "'"
+        << " into '" << merge_into->getIdentifier() << "'"
+        << endl
+        ;
+        */
+
+      // Do the merge:
+      // Connect all Inputs connected to the Outputs of the to-be-merged Node
+      // to the corresponding Outputs of the merge-into Node
+      for( index_t o=0; o<num_outputs; ++o )
       {
-        // Merge block of equivalent Nodes into first of that block
-        GraphNodeArray::Element &gn_merge_into = (*m_nodes)[ equal_first ];
-        Node *const merge_into = gn_merge_into->node;
+        Output *const merge_output = merge_node->getOutput( o );
+        Output *const into_output  = merge_into->getOutput( into_output_index[ o ] );
 
-        for( index_t merge_i = equal_first+1; merge_i <= equal_last; ++merge_i )
+        while( merge_output->isConnected() )
         {
-          GraphNodeArray::Element &gn_merge_node = (*m_nodes)[ merge_i ];
-          Node *const merge_node = gn_merge_node->node;
+          Input *const input = merge_output->inputs_begin()->get();
+          if( input ) input->connect( into_output );
+        }
+      }
+      if( gn_merge_node->needed ) gn_merge_into->needed = true;
+      merged = true;
+    }
 
-          /*
-          cerr
-            << "Merging '" << merge_node->getIdentifier() << "'"
-            << " into '" << merge_into->getIdentifier() << "'"
-            << endl
-            ;
-            */
+    if( !merged )
+    {
+      kept.insert( make_pair( hash, new_nodes->size() ) );
+      new_nodes->push_back( gn_merge_node );
+    }
+  }
 
-          bool merge_failed = false;
+  // Nodes not reachable in topological order (i.e. on cycles) are kept as they are
+  for( index_t gni=0; gni<num_nodes; ++gni )
+  {
+    if( !visited[ gni ] ) new_nodes->push_back( (*m_nodes)[ gni ] );
+  }
 
-          const index_t num_outputs = merge_node->getNumOutputs();
+  // Make merged Nodes current
+  m_nodes.swap( new_nodes );
 
-          // Check, whether all Outputs needed by the to-be-merged Node are present in the merge-into Node
-          // Remember the indeces, so the string lookup does not have to be done twice
-          vector< index_t > into_output_index( num_outputs );
-          for( index_t o=0; o<num_outputs; ++o )
-          {
-            Output *const merge_output = merge_node->getOutput( o );
-            try
-            {
-              // throws, if not found
-              (void)merge_into->getOutput( merge_output->getIdentifier(), &into_output_index[ o ] );
-            }
-            catch( const Node::NotFound & )
-            {
-              merge_failed = true;
-              break;
-            }
-          }
+  // Update index
+  m_Node_to_index.clear();
+  for( index_t i( 0 ), end( m_nodes->size() ); i < end; ++i )
+  {
+    Node *const node = (*m_nodes)[ i ]->node.get();
+    m_Node_to_index.insert( make_pair( node, i ) );
+  }
+  m_order_determined = false;
 
-          if( !merge_failed )
-          {
-            // Do the merge:
-            // Connect all Inputs connected to the Outputs of the to-be-merged Node
-            // to the corresponding Outputs of the merge-into Node
-            for( index_t o=0; o<num_outputs; ++o )
-            {
-              Output *const merge_output = merge_node->getOutput( o );
-              Output *const into_output  = merge_into->getOutput( into_output_index[ o ] );
-
-              while( merge_output->isConnected() )
-              {
-                Input *const input = merge_output->inputs_begin()->get();
-                if( input ) input->connect( into_output );
-              }
-            }
-            merged_one = true;
-          }
-          else
-          {
-            // Not merged, so keep it
-            new_nodes->push_back( gn_merge_node );
-          }
-        }
+//  cerr << "merge: ending with " << m_nodes->size() << " nodes" << endl;
+}
+
+void Graph::topological_order( vector< index_t > &order ) const
+{
+  const index_t num_nodes = m_nodes->size();
+
+  // Successors and number of predecessors, to visit Nodes in topological order
+  vector< vector< index_t > > successors( num_nodes );
+  vector< index_t > predecessors_left( num_nodes, 0 );
+  for( index_t gni=0; gni<num_nodes; ++gni )
+  {
+    const Node *const node = (*m_nodes)[ gni ]->node;
+    for( index_t i( 0 ), end_i( node->getNumInputs() ); i < end_i; ++i )
+    {
+      const Input *const input = node->getInput( i );
+      if( !input || !input->isConnected() ) continue;
 
-        // Add first to the new nodes array
-        new_nodes->push_back( gn_merge_into );
+      index_t pred = index_t(-1);
+      if( !alreadyAdded( input->getOutput()->getParent(), &pred ) ) continue;
 
-        // The current Node is the start of the next block
-        equal_first = equal_last = i;
+      successors[ pred ].push_back( gni );
+      ++predecessors_left[ gni ];
+    }
+  }
+
+  order.clear();
+  order.reserve( num_nodes );
+  for( index_t gni=0; gni<num_nodes; ++gni )
+  {
+    if( 0 == predecessors_left[ gni ] ) order.push_back( gni );
+  }
+
+  // Nodes on cycles never get ready and are left out
+  for( size_t r = 0; r < order.size(); ++r )
+  {
+    const vector< index_t > &succ = successors[ order[ r ] ];
+    for( size_t s=0; s<succ.size(); ++s )
+    {
+      if( 0 == --predecessors_left[ succ[ s ] ] ) order.push_back( succ[ s ] );
+    }
+  }
+}
+
+namespace Graph_impl {
+
+  static inline
+  uint64_t hash_string( const String &s )
+  {
+    return fnv1a( s.get(), s.length() );
+  }
+
+  //! Only primitive values hash the same in every run, others by type alone
+  static inline
+  uint64_t stable_hash( const Param::Setting &setting )
+  {
+    const Value &value = setting.value;
+    uint64_t h = ( value.isPrimitive() ? uint64_t( value.hash_exactly() ) : uint64_t( value.getType().getEnum() ) );
+    for( size_t i=0; i<setting.coords.size(); ++i )
+    {
+      h = h * 31 + uint64_t( setting.coords[ i ] );
+    }
+    return h;
+  }
+
+} // namespace Graph_impl
+
+void Graph::cost_keys( vector< std::string > &keys ) const
+{
+  using namespace Graph_impl;
+
+  const index_t num_nodes = m_nodes->size();
+
+  // Predecessors first, so each hash covers everything its Node depends on,
+  // Nodes on cycles follow and see the hashes known by then
+  vector< index_t > order;
+  topological_order( order );
+  vector< bool > ordered( num_nodes, false );
+  for( size_t r = 0; r < order.size(); ++r ) ordered[ order[ r ] ] = true;
+  for( index_t gni=0; gni<num_nodes; ++gni )
+  {
+    if( !ordered[ gni ] ) order.push_back( gni );
+  }
+
+  vector< uint64_t > hashes( num_nodes, 0 );
+  for( size_t r = 0; r < order.size(); ++r )
+  {
+    const index_t gni = order[ r ];
+    const Node *const node = (*m_nodes)[ gni ]->node;
+
+    const char *const name = node->getName();
+    uint64_t h = fnv1a( name, ::strlen( name ) );
+
+    // Inputs and Params are found by identifier, so their order must not matter
+    uint64_t inputs_h = 0;
+    for( index_t i( 0 ), end( node->getNumInputs() ); i < end; ++i )
+    {
+      const Input *const input = node->getInput( i );
+      uint64_t input_h = hash_string( input->getIdentifier() );
+      if( input->isConnected() )
+      {
+        const Output *const output = input->getOutput();
+        input_h = input_h * 31 + hash_string( output->getIdentifier() );
+        index_t pred = index_t(-1);
+        if( alreadyAdded( output->getParent(), &pred ) ) input_h = input_h * 31 + hashes[ pred ];
       }
+      inputs_h += input_h;
     }
 
-    // Make merged Nodes current
-    m_nodes.swap( new_nodes );
+    uint64_t params_h = 0;
+    for( index_t i( 0 ), end( node->getNumParams() ); i < end; ++i )
+    {
+      const Param *const param = node->getParam( i );
+      if( !param ) continue;
+      uint64_t param_h = hash_string( param->getIdentifier() );
+      for( CountPtr< Param::SettingsIterator > settings = param->getSettings(); !settings->done(); settings->next() )
+      {
+        param_h = param_h * 31 + stable_hash( settings->get() );
+      }
+      params_h += param_h;
+    }
+
+    hashes[ gni ] = ( h * 31 + inputs_h ) * 31 + params_h;
   }
-  while( merged_one );
 
-  // Update index
+  keys.resize( num_nodes );
+  for( index_t gni=0; gni<num_nodes; ++gni )
+  {
+    std::ostringstream key;
+    key << (*m_nodes)[ gni ]->node->getName() << ":" << std::hex << std::setw( 16 ) << std::setfill( '0' ) << hashes[ gni ];
+    keys[ gni ] = key.str();
+  }
+}
+
+index_t Graph::foldConstants( Scope *scope )
+{
+  const index_t num_nodes = m_nodes->size();
+
+  vector< index_t > order;
+  topological_order( order );
+
+  // Evaluate every pure Node, whose Inputs all come from constant Nodes
+  vector< bool > constant( num_nodes, false );
+  CountPtr< JobQueue > queue = new JobQueue( getGC() );
+  for( size_t r = 0; r < order.size(); ++r )
+  {
+    const index_t gni = order[ r ];
+    Node *const node = (*m_nodes)[ gni ]->node;
+    if( !node->isPure() ) continue;
+
+    bool inputs_constant = true;
+    for( index_t i( 0 ), end_i( node->getNumInputs() ); i < end_i && inputs_constant; ++i )
+    {
+      const Input *const input = node->getInput( i );
+      if( !input->isConnected() ) continue;
+
+      index_t pred = index_t(-1);
+      inputs_constant =
+           alreadyAdded( input->getOutput()->getParent(), &pred )
+        && constant[ pred ]
+        ;
+    }
+    if( !inputs_constant ) continue;
+
+    try
+    {
+      node->tick( queue, queue );
+    }
+    catch( const RPGML::Exception & )
+    {
+      // Leave it to the execution to report
+      continue;
+    }
+
+    // Only primitive Arrays can become ConstantArrays
+    bool outputs_primitive = true;
+    for( index_t o( 0 ), end_o( node->getNumOutputs() ); o < end_o && outputs_primitive; ++o )
+    {
+      const Output *const output = node->getOutput( o );
+      if( !output->isConnected() ) continue;
+      const ArrayBase *const data = output->getData();
+      outputs_primitive = ( data && data->getType().isPrimitive() );
+    }
+    if( !outputs_primitive ) continue;
+
+    constant[ gni ] = true;
+  }
+
+  // Decide which constant Nodes are replaced, sinks first:
+  // - computed ones, if something consumes them
+  // - sources like Constant, only if all consumers are replaced as well
+  vector< bool > replaced( num_nodes, false );
+  for( size_t r = order.size(); r > 0; --r )
+  {
+    const index_t gni = order[ r-1 ];
+    if( !constant[ gni ] ) continue;
+    const Node *const node = (*m_nodes)[ gni ]->node;
+
+    bool has_inputs = false;
+    for( index_t i( 0 ), end_i( node->getNumInputs() ); i < end_i && !has_inputs; ++i )
+    {
+      has_inputs = node->getInput( i )->isConnected();
+    }
+
+    bool has_successors = false;
+    bool all_successors_replaced = true;
+    for( index_t o( 0 ), end_o( node->getNumOutputs() ); o < end_o; ++o )
+    {
+      Output *const output = node->getOutput( o );
+      for( Output::inputs_iterator in( output->inputs_begin() ), end_in( output->inputs_end() ); in != end_in; ++in )
+      {
+        index_t succ = index_t(-1);
+        if( !in->get() || !alreadyAdded( (*in)->getParent(), &succ ) ) continue;
+        has_successors = true;
+        if( !replaced[ succ ] ) all_successors_replaced = false;
+      }
+    }
+
+    replaced[ gni ] = has_successors && ( has_inputs || all_successors_replaced );
+  }
+
+  // Connect the consumers of replaced Nodes, that stay, to new ConstantArrays
+  CountPtr< Location > loc = new Location( __FILE__, __LINE__ );
+  vector< CountPtr< Node > > new_nodes;
+  vector< Input* > to_be_connected;
+  index_t num_replaced = 0;
+  for( index_t gni=0; gni<num_nodes; ++gni )
+  {
+    if( !replaced[ gni ] ) continue;
+    ++num_replaced;
+
+    Node *const node = (*m_nodes)[ gni ]->node;
+    for( index_t o( 0 ), end_o( node->getNumOutputs() ); o < end_o; ++o )
+    {
+      Output *const output = node->getOutput( o );
+
+      to_be_connected.clear();
+      for( Output::inputs_iterator in( output->inputs_begin() ), end_in( output->inputs_end() ); in != end_in; ++in )
+      {
+        index_t succ = index_t(-1);
+        if( !in->get() || !alreadyAdded( (*in)->getParent(), &succ ) ) continue;
+        if( !replaced[ succ ] ) to_be_connected.push_back( in->get() );
+      }
+      if( to_be_connected.empty() ) continue;
+
+      CountPtr< Output > folded = scope->toOutput( loc, 0, Value( const_cast< ArrayBase* >( output->getData() ) ) );
+      folded->getParent()->setIdentifier( node->getIdentifier() + "." + output->getIdentifier() );
+      new_nodes.push_back( folded->getParent() );
+
+      for( size_t i=0; i<to_be_connected.size(); ++i )
+      {
+        to_be_connected[ i ]->connect( folded );
+      }
+    }
+  }
+
+  if( 0 == num_replaced ) return 0;
+
+  // Drop replaced Nodes
+  CountPtr< GraphNodeArray > kept_nodes = new GraphNodeArray( getGC(), 1 );
+  kept_nodes->reserve( num_nodes - num_replaced + index_t( new_nodes.size() ) );
+  for( index_t gni=0; gni<num_nodes; ++gni )
+  {
+    if( !replaced[ gni ] ) kept_nodes->push_back( (*m_nodes)[ gni ] );
+  }
+  m_nodes.swap( kept_nodes );
+
+  m_Node_to_index.clear();
+  for( index_t i( 0 ), end( m_nodes->size() ); i < end; ++i )
+  {
+    Node *const node = (*m_nodes)[ i ]->node.get();
+    m_Node_to_index.insert( make_pair( node, i ) );
+  }
+
+  for( size_t i=0; i<new_nodes.size(); ++i )
+  {
+    addNode( new_nodes[ i ] );
+  }
+  m_order_determined = false;
+
+  return num_replaced;
+}
+
+index_t Graph::prune( index_t *removed_elements )
+{
+  const index_t num_nodes = m_nodes->size();
+
+  // Mark everything, an observable Node depends on
+  vector< bool > observed( num_nodes, false );
+  vector< index_t > to_be_checked;
+  for( index_t gni=0; gni<num_nodes; ++gni )
+  {
+    const GraphNode *const gn = (*m_nodes)[ gni ];
+    if( gn->needed || !gn->node->isPure() )
+    {
+      observed[ gni ] = true;
+      to_be_checked.push_back( gni );
+    }
+  }
+
+  while( !to_be_checked.empty() )
+  {
+    const Node *const node = (*m_nodes)[ to_be_checked.back() ]->node;
+    to_be_checked.pop_back();
+
+    for( index_t i( 0 ), end_i( node->getNumInputs() ); i < end_i; ++i )
+    {
+      const Input *const input = node->getInput( i );
+      if( !input->isConnected() ) continue;
+
+      index_t pred = index_t(-1);
+      if( !alreadyAdded( input->getOutput()->getParent(), &pred ) ) continue;
+      if( observed[ pred ] ) continue;
+
+      observed[ pred ] = true;
+      to_be_checked.push_back( pred );
+    }
+  }
+
+  CountPtr< GraphNodeArray > kept_nodes = new GraphNodeArray( getGC(), 1 );
+  kept_nodes->reserve( num_nodes );
+  index_t num_removed = 0;
+  index_t num_elements = 0;
+  for( index_t gni=0; gni<num_nodes; ++gni )
+  {
+    GraphNode *const gn = (*m_nodes)[ gni ];
+    if( observed[ gni ] )
+    {
+      kept_nodes->push_back( gn );
+      continue;
+    }
+
+    ++num_removed;
+    for( index_t o( 0 ), end_o( gn->node->getNumOutputs() ); o < end_o; ++o )
+    {
+      // Not yet computed Outputs count as scalars
+      const ArrayBase *const data = gn->node->getOutput( o )->getData();
+      num_elements += ( data ? data->size() : 1 );
+    }
+  }
+
+  if( removed_elements ) (*removed_elements) = num_elements;
+  if( 0 == num_removed ) return 0;
+
+  m_nodes.swap( kept_nodes );
+
   m_Node_to_index.clear();
   for( index_t i( 0 ), end( m_nodes->size() ); i < end; ++i )
   {
     Node *const node = (*m_nodes)[ i ]->node.get();
     m_Node_to_index.insert( make_pair( node, i ) );
   }
+  m_order_determined = false;
+
+  return num_removed;
+}
 
-//  cerr << "merge: ending with " << m_nodes.size() << " nodes" << endl;
+index_t Graph::getNumNodes( void ) const
+{
+  return m_nodes->size();
 }
 
 void Graph::setEverythingChanged( bool changed )
@@ -218,10 +600,170 @@ void Graph::setEverythingChanged( bool changed )
   }
 }
 
+void Graph::setFrameLimit( uint64_t frames )
+{
+  m_frame_limit = frames;
+}
+
+void Graph::getCosts( const Profiler &profiler, Profiler::Costs &costs ) const
+{
+  Profiler::NodeCosts node_costs;
+  profiler.getNodeCosts( node_costs );
+
+  vector< std::string > keys;
+  cost_keys( keys );
+
+  // Sum and count per key
+  std::map< std::string, std::pair< int64_t, int64_t > > by_key;
+  for( index_t gni( 0 ), end( m_nodes->size() ); gni < end; ++gni )
+  {
+    const Profiler::NodeCosts::const_iterator c = node_costs.find( (*m_nodes)[ gni ]->node );
+    if( c == node_costs.end() ) continue;
+    std::pair< int64_t, int64_t > &sum = by_key[ keys[ gni ] ];
+    sum.first += c->second;
+    ++sum.second;
+  }
+
+  costs.clear();
+  for( std::map< std::string, std::pair< int64_t, int64_t > >::const_iterator i( by_key.begin() ), end( by_key.end() ); i != end; ++i )
+  {
+    costs[ i->first ] = i->second.first / i->second.second;
+  }
+}
+
+index_t Graph::setCosts( const Profiler::Costs &costs )
+{
+  vector< std::string > keys;
+  cost_keys( keys );
+
+  index_t num_missing = 0;
+  for( index_t gni( 0 ), end( m_nodes->size() ); gni < end; ++gni )
+  {
+    GraphNode *const gn = (*m_nodes)[ gni ];
+    const Profiler::Costs::const_iterator c = costs.find( keys[ gni ] );
+    if( c == costs.end() ) ++num_missing;
+    gn->cost = ( c != costs.end() && c->second > 0 ? size_t( c->second ) : 1 );
+  }
+  m_order_determined = false;
+  return num_missing;
+}
+
+void Graph::writeCriticalPath( std::ostream &o, const Profiler::Costs &costs, index_t num_threads )
+{
+  if( m_nodes->empty() ) return;
+  if( !m_order_determined ) determine_order();
+
+  const index_t num_nodes = m_nodes->size();
+
+  vector< std::string > keys;
+  cost_keys( keys );
+
+  vector< int64_t > cost( num_nodes, 0 );
+  for( index_t gni=0; gni<num_nodes; ++gni )
+  {
+    const Profiler::Costs::const_iterator c = costs.find( keys[ gni ] );
+    if( c != costs.end() ) cost[ gni ] = c->second;
+  }
+
+  // Longest path ending in each Node, remembering the predecessor on it
+  vector< index_t > order;
+  topological_order( order );
+
+  vector< int64_t > finish( num_nodes, 0 );
+  vector< index_t > critical_predecessor( num_nodes, index_t(-1) );
+  int64_t work = 0;
+  index_t last = index_t(-1);
+
+  for( size_t r = 0; r < order.size(); ++r )
+  {
+    const index_t gni = order[ r ];
+    const GraphNode *const gn = (*m_nodes)[ gni ];
+
+    int64_t start = 0;
+    for( index_t i( 0 ), end( gn->predecessors->size() ); i < end; ++i )
+    {
+      index_t pred = index_t(-1);
+      if( !alreadyAdded( gn->predecessors->at( i )->node, &pred ) ) continue;
+      if( critical_predecessor[ gni ] == index_t(-1) || finish[ pred ] > start )
+      {
+        start = finish[ pred ];
+        critical_predecessor[ gni ] = pred;
+      }
+    }
+
+    finish[ gni ] = start + cost[ gni ];
+    work += cost[ gni ];
+    if( last == index_t(-1) || finish[ gni ] > finish[ last ] ) last = gni;
+  }
+
+  vector< index_t > path;
+  for( index_t gni = last; gni != index_t(-1); gni = critical_predecessor[ gni ] )
+  {
+    path.push_back( gni );
+  }
+  std::reverse( path.begin(), path.end() );
+
+  const int64_t critical = ( last != index_t(-1) ? finish[ last ] : 0 );
+  const double threads = double( std::max( num_threads, index_t( 1 ) ) );
+  const double bound = std::max( double( critical ), double( work ) / threads );
+
+  const std::ios::fmtflags flags = o.flags();
+  o
+    << std::fixed << std::setprecision( 3 )
+    << "Critical path: " << path.size() << " of " << num_nodes << " Nodes"
+    << ", " << double( critical ) * 1e-6 << " ms of " << double( work ) * 1e-6 << " ms work per frame\n"
+    << std::setprecision( 2 )
+    << "Parallelism: " << ( critical > 0 ? double( work ) / double( critical ) : 0.0 )
+    << ", speedup bound with " << num_threads << " threads: " << ( bound > 0 ? double( work ) / bound : 0.0 ) << "\n"
+    ;
+
+  for( size_t p = 0; p < path.size(); ++p )
+  {
+    const index_t gni = path[ p ];
+    o
+      << std::setprecision( 3 )
+      << std::setw( 12 ) << double( cost[ gni ] ) * 1e-3 << " us"
+      << std::setprecision( 1 )
+      << std::setw( 7 ) << ( critical > 0 ? 100.0 * double( cost[ gni ] ) / double( critical ) : 0.0 ) << "%  "
+      << (*m_nodes)[ gni ]->node->getIdentifier() << "\n"
+      ;
+  }
+
+  // Bottlenecks: the most expensive Nodes on the critical path
+  vector< pair< int64_t, index_t > > by_cost;
+  by_cost.reserve( path.size() );
+  for( size_t p = 0; p < path.size(); ++p )
+  {
+    by_cost.push_back( make_pair( cost[ path[ p ] ], path[ p ] ) );
+  }
+  std::sort( by_cost.begin(), by_cost.end(), std::greater< pair< int64_t, index_t > >() );
+
+  o << "Bottlenecks:\n";
+  for( size_t p = 0; p < by_cost.size() && p < 5; ++p )
+  {
+    const index_t gni = by_cost[ p ].second;
+    if( 0 == cost[ gni ] ) break;
+    o
+      << std::setprecision( 1 )
+      << std::setw( 7 ) << ( critical > 0 ? 100.0 * double( cost[ gni ] ) / double( critical ) : 0.0 ) << "%  "
+      << (*m_nodes)[ gni ]->node->getIdentifier() << " (" << (*m_nodes)[ gni ]->node->getName() << ")\n"
+      ;
+  }
+  o.flags( flags );
+}
+
 void Graph::execute( const CountPtr< JobQueue > &queue )
 {
   CountPtr< JobQueue > main_thread_queue = new JobQueue( getGC() );
 
+  if( Profiler::isEnabled() )
+  {
+    for( index_t gni( 0 ), end( m_nodes->size() ); gni < end; ++gni )
+    {
+      Profiler::global().addNode( (*m_nodes)[ gni ]->node );
+    }
+  }
+
   schedule( queue, main_thread_queue );
 
   for(;;)
@@ -231,6 +773,9 @@ void Graph::execute( const CountPtr< JobQueue > &queue )
     if( JobQueue::End == job_ret ) break;
   }
 
+  // A FlushLogJob of the last frame may still be queued after the EndJob
+  Log::global().flush();
+
   getGC()->run();
 }
 
@@ -251,6 +796,8 @@ void Graph::schedule( const CountPtr< JobQueue > &queue, const CountPtr< JobQueu
   m_end_node->reset_predecessor_counter();
 
   m_end_node->main_thread = main_thread_queue;
+  ++m_frame;
+  if( Metrics::isEnabled() ) m_frame_begin = Profiler::now();
 
   for( index_t gni( 0 ), end( m_nodes->size() ); gni < end; ++gni )
   {
@@ -324,12 +871,12 @@ void Graph::determine_order( void )
     for( index_t gni( 0 ), end( m_nodes->size() ); gni < end; ++gni )
     {
       GraphNode *const gn = (*m_nodes)[ gni ];
-      if( gn->successors->empty() )
+      if( gn->successors->size() == 1 && gn->successors->at( 0 ).get() == m_end_node.get() )
       {
-        // Sink Node
+        // Sink Node, connected to the End Node above
         to_be_checked.push_back( gn );
         gn->marker = 1;
-        gn->setPriority( 0 );
+        gn->setPriority( gn->cost );
       }
       else
       {
@@ -346,11 +893,11 @@ void Graph::determine_order( void )
       gn->marker = 0;
 
       const size_t prio = gn->getPriority();
-      const size_t pred_prio = prio+1;
 
       for( index_t i( 0 ), end( gn->predecessors->size() ); i < end; ++i )
       {
         GraphNode *const predecessor = gn->predecessors->at( i );
+        const size_t pred_prio = prio + predecessor->cost;
         if( predecessor->getPriority() < pred_prio )
         {
           predecessor->setPriority( pred_prio );
@@ -517,12 +1064,16 @@ Graph::GraphNode::GraphNode( GarbageCollector *_gc, Graph *_graph, Node *_node )
 , graph( _graph )
 , node( _node )
 , marker( 0 )
+, scheduled_at( 0 )
+, cost( 1 )
+, needed( false )
 {}
 
 void Graph::GraphNode::schedule( JobQueue *queue, JobQueue *main_thread_queue )
 {
 //  if( !node.isNull() ) std::cerr << "schedule " << node->getIdentifier() << std::endl;
   main_thread = main_thread_queue;
+  if( Profiler::isEnabled() ) scheduled_at = Profiler::now();
   queue->addJob( this );
 }
 
@@ -550,6 +1101,38 @@ namespace Graph_impl {
 
 } // namespace Graph_impl
 
+size_t Graph::GraphNode::hash( void ) const
+{
+  using namespace Graph_impl;
+
+  const char *const name = node->getName();
+  size_t h = size_t( fnv1a( name, ::strlen( name ) ) );
+
+  // Inputs and Params are compared by identifier, so their order must not matter
+  size_t inputs_h = 0;
+  for( index_t i( 0 ), end( node->getNumInputs() ); i < end; ++i )
+  {
+    const Input *const input = node->getInput( i );
+    const String &identifier = input->getIdentifier();
+    inputs_h += size_t( fnv1a( identifier.get(), identifier.length() ) ) ^ size_t( input->getOutput() );
+  }
+
+  size_t params_h = 0;
+  for( index_t i( 0 ), end( node->getNumParams() ); i < end; ++i )
+  {
+    const Param *const param = node->getParam( i );
+    const String &identifier = param->getIdentifier();
+    size_t param_h = size_t( fnv1a( identifier.get(), identifier.length() ) );
+    for( CountPtr< Param::SettingsIterator > settings = param->getSettings(); !settings->done(); settings->next() )
+    {
+      param_h = param_h * 31 + settings->get().hash();
+    }
+    params_h += param_h;
+  }
+
+  return ( h * 31 + inputs_h ) * 31 + params_h;
+}
+
 bool Graph::GraphNode::equivalent( const GraphNode *other ) const
 {
   return ( 0 == compare( other ) );
@@ -587,15 +1170,7 @@ int Graph::GraphNode::compare( const GraphNode *other ) const
     const Input *const node_input = node->getInput( i );
     const String &node_input_identifier = node_input->getIdentifier();
 
-    const Input *other_input = 0;
-    try
-    {
-      other_input = other->node->getInput( node_input_identifier );
-    }
-    catch( const Node::NotFound & )
-    {
-      return 1;
-    }
+    const Input *const other_input = other->node->tryGetInput( node_input_identifier );
     if( !other_input ) return 1;
 
     const Output *const node_output = node_input->getOutput();
@@ -610,15 +1185,7 @@ int Graph::GraphNode::compare( const GraphNode *other ) const
     const Param *const node_param = node->getParam( i );
     const String &node_param_identifier = node_param->getIdentifier();
 
-    const Param *other_param = 0;
-    try
-    {
-      other_param = other->node->getParam( node_param_identifier );
-    }
-    catch( const Node::NotFound & )
-    {
-      return 1;
-    }
+    const Param *const other_param = other->node->tryGetParam( node_param_identifier );
     if( !other_param ) return 1;
 
     CountPtr< Param::SettingsIterator >
@@ -668,10 +1235,22 @@ void Graph::GraphNode::gc_getChildren( Children &children ) const
 size_t Graph::GraphNode::doit( CountPtr< JobQueue > queue )
 {
   size_t ret = 1;
+  const bool profiling = Profiler::isEnabled();
+  Profiler::Event event = Profiler::Event();
+  if( profiling )
+  {
+    event.allocations = Profiler::getAllocations();
+    event.begin = Profiler::now();
+  }
+
+  // The Outputs are allocated, and so placed, on the NUMA node of the first execution
+  if( getHome() < 0 ) setHome( Affinity::getThreadNode() );
+
   try
   {
+    const AllocationTracker::Scope allocation_scope( node );
 //    std::cerr << "executing Node " << node->getIdentifier() << std::endl;
-    node->tick( main_thread );
+    node->tick( main_thread, queue );
 //    std::cerr << "executing Node " << node->getIdentifier() << " done" << std::endl;
     ret = 0;
   }
@@ -712,6 +1291,17 @@ size_t Graph::GraphNode::doit( CountPtr< JobQueue > queue )
     ret = 0;
   }
 
+  if( profiling )
+  {
+    event.end = Profiler::now();
+    event.allocations = Profiler::getAllocations() - event.allocations;
+    event.node = node;
+    event.frame = graph->m_frame;
+    event.scheduled = scheduled_at;
+    event.bytes = Profiler::getChangedOutputBytes( node );
+    Profiler::global().record( event );
+  }
+
   if( !graph->hasErrors() ) // Must still be executed: && !graph->hasExitRequest() )
   {
     // Try to schedule successors
@@ -740,13 +1330,21 @@ size_t Graph::EndNode::doit( CountPtr< JobQueue > queue )
 {
   if( !main_thread.isNull() )
   {
+    // All Nodes of this frame are done, none of them writes to the Log now
+    Log::global().collect();
+    main_thread->addJob( new FlushLogJob( getGC() ) );
+
+    if( Profiler::isEnabled() ) Profiler::global().recordFrame( graph->m_frame );
+    if( Metrics::isEnabled() ) Metrics::global().frameDone( Profiler::now() - graph->m_frame_begin );
+    if( AllocationTracker::isEnabled() ) AllocationTracker::global().frameDone( graph->m_frame );
+
     if( graph->hasErrors() )
     {
       graph->printErrors( std::cerr );
       main_thread->addJob( new JobQueue::EndJob( getGC() ) );
       return 0;
     }
-    if( graph->hasExitRequest() )
+    if( graph->hasExitRequest() || ( graph->m_frame_limit && graph->m_frame >= graph->m_frame_limit ) )
     {
       main_thread->addJob( new JobQueue::EndJob( getGC() ) );
       return 0;
@@ -759,5 +1357,15 @@ size_t Graph::EndNode::doit( CountPtr< JobQueue > queue )
   return 0;
 }
 
+Graph::FlushLogJob::FlushLogJob( GarbageCollector *_gc )
+: Base( _gc )
+{}
+
+size_t Graph::FlushLogJob::doit( CountPtr< JobQueue > )
+{
+  Log::global().flush();
+  return 0;
+}
+
 } // namespace RPGML
 
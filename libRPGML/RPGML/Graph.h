@@ -24,14 +24,18 @@
 #include "JobQueue.h"
 #include "Mutex.h"
 #include "JobQueue.h"
+#include "Profiler.h"
 
 #include <map>
 #include <sstream>
 #include <list>
+#include <vector>
 #include <iostream>
 
 namespace RPGML {
 
+class Scope;
+
 class Graph : public Collectable
 {
   typedef Collectable Base;
@@ -45,15 +49,68 @@ public:
 
   void print() const;
 
-  void addNode( Node *node );
+  /*! @brief Adds node and everything it depends on
+   *
+   * needed Nodes, e.g. from needing(), are observable and never pruned.
+   */
+  void addNode( Node *node, bool needed = false );
   bool alreadyAdded( const Node *node, index_t *index = 0 ) const;
 
   bool empty( void ) const;
 
   void merge( void );
 
+  /*! @brief Evaluates all pure Nodes with constant Inputs once
+   *
+   * Each such subgraph is replaced by ConstantArrays created by scope.
+   * Call after merge().
+   * @return The number of removed Nodes
+   */
+  index_t foldConstants( Scope *scope );
+
+  /*! @brief Removes Nodes, from which no observable Node can be reached
+   *
+   * Nodes, that are not pure (see Node::isPure()), have side effects or state
+   * and are therefore observable, as are the Nodes added as needed.
+   * @param removed_elements [out] If not 0, the number of Output elements
+   *   the removed Nodes held, as an estimate of the work saved per frame
+   * @return The number of removed Nodes
+   */
+  index_t prune( index_t *removed_elements = 0 );
+
+  index_t getNumNodes( void ) const;
+
   void setEverythingChanged( bool changed = true );
 
+  //! @brief execute() returns after frames frames at most, 0 for no limit
+  void setFrameLimit( uint64_t frames );
+
+  /*! @brief Mean costs of the Nodes profiled by profiler, by cost key
+   *
+   * A cost key is the Node name and a hash of its Params, Input connections
+   * and everything it depends on, but not its identifier, which contains
+   * paths and counters. So keys match across runs of the same script.
+   * Equivalent Nodes share a key and their mean cost.
+   */
+  void getCosts( const Profiler &profiler, Profiler::Costs &costs ) const;
+
+  /*! @brief Schedules by measured costs instead of hop counts
+   *
+   * The priority of a Node becomes the summed cost of the most expensive
+   * path from it to a sink, so Nodes on the critical path are preferred
+   * by the JobQueue. Nodes missing in costs count 1ns.
+   * @param costs Mean ns per execution, e.g. from getCosts() of a profiled run
+   * @return The number of Nodes missing in costs
+   */
+  index_t setCosts( const Profiler::Costs &costs );
+
+  /*! @brief Writes the critical path, the bottleneck Nodes on it and the speedup bound
+   *
+   * The bound is work / max( critical path, work / num_threads ), i.e. what
+   * a perfect scheduler could achieve with the given costs.
+   */
+  void writeCriticalPath( std::ostream &o, const Profiler::Costs &costs, index_t num_threads );
+
   /*
   class ScheduleGraphJob : public JobQueue::Job
   {
@@ -108,6 +165,7 @@ public:
 private:
 
   friend class Error;
+  friend class GraphSnapshot;
   class GraphNode;
   typedef Array< CountPtr< GraphNode > > GraphNodeArray;
 
@@ -126,6 +184,8 @@ private:
     virtual void gc_getChildren( Children &children ) const;
 
     int compare( const GraphNode *other ) const;
+    //! @brief Structural hash, consistent with compare()
+    size_t hash( void ) const;
     bool equivalent( const GraphNode *other ) const;
 
     static
@@ -138,6 +198,9 @@ private:
     CountPtr< JobQueue > main_thread;
     Atomic< size_t > predecessors_to_be_executed;
     int marker;
+    int64_t scheduled_at; //!< Profiler::now() at schedule(), only while profiling
+    size_t cost; //!< weight in the priority, 1 for hop counts, see setCosts()
+    bool needed; //!< added as needed, see addNode()
 
   protected:
     virtual size_t doit( CountPtr< JobQueue > queue );
@@ -152,6 +215,21 @@ private:
     virtual size_t doit( CountPtr< JobQueue > queue );
   };
 
+  //! Writes the Log output collected by the EndNode on the main thread
+  class FlushLogJob : public JobQueue::Job
+  {
+    typedef JobQueue::Job Base;
+  public:
+    explicit
+    FlushLogJob( GarbageCollector *_gc );
+  protected:
+    virtual size_t doit( CountPtr< JobQueue > queue );
+  };
+
+  //! Indices into m_nodes, predecessors first
+  void topological_order( std::vector< index_t > &order ) const;
+  //! Cost key of each Node, indexed like m_nodes, see getCosts()
+  void cost_keys( std::vector< std::string > &keys ) const;
   void determine_order( void );
   void report( const std::string &error_text );
 
@@ -165,6 +243,9 @@ private:
   Node_to_index_t m_Node_to_index;
   CountPtr< EndNode > m_end_node;
   bool m_order_determined;
+  uint64_t m_frame; //!< number of schedule() calls, for the Profiler
+  uint64_t m_frame_limit;
+  int64_t m_frame_begin; //!< Profiler::now() at schedule(), only while Metrics are enabled
 };
 
 } // namespace RPGML
@@ -0,0 +1,429 @@
+/* This file is part of RPGML.
+ * 
+ * Copyright (c) 2014, Gunnar Payer, All rights reserved.
+ * 
+ * RPGML is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3.0 of the License, or (at your option) any later version.
+ * 
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ * 
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.
+ */
+#include "GraphSnapshot.h"
+
+#include "BinaryStream.h"
+#include "SharedObject.h"
+
+#include <map>
+#include <vector>
+#include <cstring>
+
+using namespace std;
+
+namespace RPGML {
+
+namespace GraphSnapshot_impl {
+
+static const char     magic[ 8 ]  = { 'R', 'P', 'G', 'M', 'L', 'G', 'R', 'F' };
+static const uint32_t version     = 1;
+static const uint32_t byte_order  = 0x01020304;
+
+//! @brief Marks Nodes built into libRPGML, see create_builtin()
+static const int32_t no_plugin = -1;
+
+static const char so_prefix[] = "libRPGML_Node_";
+static const char so_suffix[] = ".so";
+
+//! @brief "path/libRPGML_Node_X.so" -> "X", empty if so is no Node plugin
+static
+String getPluginIdentifier( const String &so )
+{
+  const char *const base_p = ::strrchr( so.c_str(), '/' );
+  const std::string base( base_p ? base_p+1 : so.c_str() );
+
+  const size_t prefix_len = sizeof( so_prefix ) - 1;
+  const size_t suffix_len = sizeof( so_suffix ) - 1;
+
+  if(
+       base.size() <= prefix_len + suffix_len
+    || 0 != base.compare( 0, prefix_len, so_prefix )
+    || 0 != base.compare( base.size() - suffix_len, suffix_len, so_suffix )
+    )
+  {
+    return String();
+  }
+
+  return String( base.substr( prefix_len, base.size() - prefix_len - suffix_len ) );
+}
+
+static
+CountPtr< Node > create_builtin( GarbageCollector *gc, const String &name, const String &identifier )
+{
+  if( name == "Identity" ) return new Identity( gc, identifier );
+  throw GraphSnapshot::Exception() << "Unknown built-in Node '" << name << "'";
+}
+
+static
+void put_header( BinaryWriter &w )
+{
+  w.put_raw( magic, sizeof( magic ) );
+  w.put_u32( version );
+  w.put_u32( byte_order );
+}
+
+static
+index_t getOutputIndex( const Node *node, const Output *output )
+{
+  for( index_t i( 0 ), end( node->getNumOutputs() ); i < end; ++i )
+  {
+    if( node->getOutput( i ) == output ) return i;
+  }
+  throw GraphSnapshot::Exception()
+    << "Output '" << output->getIdentifier() << "' does not belong to Node '" << node->getIdentifier() << "'"
+    ;
+}
+
+} // namespace GraphSnapshot_impl
+
+using namespace GraphSnapshot_impl;
+
+void GraphSnapshot::save( const Graph *graph, const String &filename )
+{
+  // Predecessors first, Nodes on cycles at the end
+  vector< index_t > order;
+  graph->topological_order( order );
+  {
+    vector< bool > in_order( graph->m_nodes->size(), false );
+    for( size_t i = 0; i < order.size(); ++i ) in_order[ order[ i ] ] = true;
+    for( index_t gni( 0 ), end( graph->m_nodes->size() ); gni < end; ++gni )
+    {
+      if( !in_order[ gni ] ) order.push_back( gni );
+    }
+  }
+
+  std::map< const Node*, int32_t > position;
+  for( size_t i = 0; i < order.size(); ++i )
+  {
+    position[ (*graph->m_nodes)[ order[ i ] ]->node.get() ] = int32_t( i );
+  }
+
+  std::map< std::string, int32_t > plugin_index;
+  vector< String > plugins;
+
+  BinaryWriter body;
+  body.put_size( order.size() );
+
+  for( size_t i = 0; i < order.size(); ++i )
+  {
+    const Node *const node = (*graph->m_nodes)[ order[ i ] ]->node;
+    const SharedObject *const so = node->getSO();
+
+    int32_t plugin = no_plugin;
+    if( so )
+    {
+      const String &so_path = so->getSO();
+      const std::string key( so_path.c_str() );
+      std::map< std::string, int32_t >::const_iterator const found = plugin_index.find( key );
+      if( found != plugin_index.end() )
+      {
+        plugin = found->second;
+      }
+      else
+      {
+        if( getPluginIdentifier( so_path ).empty() )
+        {
+          throw Exception()
+            << "Node '" << node->getIdentifier() << "' was created by '" << so_path << "'"
+            << ", which is no Node plugin"
+            ;
+        }
+        plugin = int32_t( plugins.size() );
+        plugins.push_back( so_path );
+        plugin_index.insert( std::make_pair( key, plugin ) );
+      }
+    }
+
+    body.put_i32( plugin );
+    body.put_string( String::Static( node->getName() ) );
+    body.put_string( node->getIdentifier() );
+
+    // Params
+    const index_t num_params = node->getNumParams();
+    body.put_size( num_params );
+    for( index_t p = 0; p < num_params; ++p )
+    {
+      const Param *const param = node->getParam( p );
+      body.put_bool( 0 != param );
+      if( !param ) continue;
+
+      vector< Param::Setting > settings;
+      for( CountPtr< Param::SettingsIterator > s( param->getSettings() ); !s->done(); s->next() )
+      {
+        settings.push_back( s->get() );
+      }
+
+      body.put_size( settings.size() );
+      for( size_t s = 0; s < settings.size(); ++s )
+      {
+        const Param::Setting &setting = settings[ s ];
+        try
+        {
+          body.put_value( setting.value );
+        }
+        catch( const BinaryWriter::Exception &e )
+        {
+          throw Exception()
+            << "Param '" << param->getIdentifier() << "' of Node '" << node->getIdentifier() << "': "
+            << e.what()
+            ;
+        }
+        body.put_size( setting.coords.size() );
+        for( size_t c = 0; c < setting.coords.size(); ++c )
+        {
+          body.put_u32( setting.coords[ c ] );
+        }
+      }
+    }
+
+    // Connections
+    const index_t num_inputs = node->getNumInputs();
+    body.put_size( num_inputs );
+    for( index_t in = 0; in < num_inputs; ++in )
+    {
+      const Input *const input = node->getInput( in );
+      const Output *const output = ( input && input->isConnected() ? input->getOutput() : 0 );
+      if( !output )
+      {
+        body.put_i32( -1 );
+        continue;
+      }
+
+      const Node *const source = output->getParent();
+      std::map< const Node*, int32_t >::const_iterator const source_pos = position.find( source );
+      if( source_pos == position.end() )
+      {
+        throw Exception()
+          << "Input '" << node->getIdentifier() << "." << input->getIdentifier() << "'"
+          << " is connected to Node '" << source->getIdentifier() << "', not belonging to the Graph"
+          ;
+      }
+      body.put_i32( source_pos->second );
+      body.put_u32( getOutputIndex( source, output ) );
+    }
+  }
+
+  BinaryWriter out;
+  put_header( out );
+
+  out.put_size( plugins.size() );
+  for( size_t i = 0; i < plugins.size(); ++i )
+  {
+    FileStamp stamp;
+    if( !stamp.stat( plugins[ i ] ) )
+    {
+      throw Exception() << "Could not stat plugin '" << plugins[ i ] << "'";
+    }
+    out.put_string( plugins[ i ] );
+    out.put( stamp.size );
+    out.put( stamp.mtime_sec );
+    out.put( stamp.mtime_nsec );
+  }
+
+  out.put_raw( body.getOut().data(), body.getOut().size() );
+  out.put( BinaryWriter::hash( out.getOut().data(), out.getOut().size() ) );
+
+  if( !out.writeFile( filename ) )
+  {
+    throw Exception() << "Could not write graph snapshot '" << filename << "'";
+  }
+}
+
+CountPtr< Graph > GraphSnapshot::load( GarbageCollector *gc, const String &filename )
+{
+  std::string in;
+  if( !BinaryReader::readFile( filename, in ) )
+  {
+    throw Exception() << "Could not read graph snapshot '" << filename << "'";
+  }
+
+  BinaryWriter expected_header;
+  put_header( expected_header );
+  const std::string &header = expected_header.getOut();
+
+  if(
+       in.size() < header.size() + sizeof( uint64_t )
+    || 0 != in.compare( 0, header.size(), header )
+    )
+  {
+    throw Exception()
+      << "'" << filename << "' is no graph snapshot of version " << version
+      << " for this architecture"
+      ;
+  }
+
+  const size_t content_size = in.size() - sizeof( uint64_t );
+  uint64_t stored_hash = 0;
+  std::memcpy( &stored_hash, in.data() + content_size, sizeof( stored_hash ) );
+  if( stored_hash != BinaryWriter::hash( in.data(), content_size ) )
+  {
+    throw Exception() << "Graph snapshot '" << filename << "' is corrupted";
+  }
+  in.resize( content_size );
+
+  try
+  {
+    BinaryReader r( in, header.size() );
+
+    // Plugins
+    const size_t num_plugins = r.get_size();
+    vector< CountPtr< SharedObject > > plugins( num_plugins );
+    vector< create_Node_t > create_Node( num_plugins, create_Node_t( 0 ) );
+    for( size_t i = 0; i < num_plugins; ++i )
+    {
+      const String so_path = r.get_string();
+      FileStamp stored;
+      stored.size       = r.get< uint64_t >();
+      stored.mtime_sec  = r.get< int64_t  >();
+      stored.mtime_nsec = r.get< int64_t  >();
+
+      FileStamp current;
+      if( !current.stat( so_path ) || current != stored )
+      {
+        throw Exception()
+          << "Plugin '" << so_path << "' changed since the graph snapshot '" << filename << "' was saved"
+          ;
+      }
+
+      String err;
+      plugins[ i ] = new SharedObject( so_path, err );
+      if( !plugins[ i ]->isValid() )
+      {
+        throw Exception() << "Opening plugin '" << so_path << "' failed: " << err;
+      }
+
+      const String symbol = getPluginIdentifier( so_path ) + "_create_Node";
+      if( !plugins[ i ]->getSymbol( symbol, create_Node[ i ], err ) )
+      {
+        throw Exception() << "Plugin '" << so_path << "': " << err;
+      }
+    }
+
+    // Nodes and Params
+    const size_t num_nodes = r.get_size();
+    vector< CountPtr< Node > > nodes;
+    nodes.reserve( num_nodes );
+    vector< vector< pair< int32_t, index_t > > > connections( num_nodes );
+
+    for( size_t i = 0; i < num_nodes; ++i )
+    {
+      const int32_t plugin = r.get_i32();
+      const String name = r.get_string();
+      const String identifier = r.get_string();
+
+      CountPtr< Node > node;
+      if( no_plugin == plugin )
+      {
+        node = create_builtin( gc, name, identifier );
+      }
+      else if( plugin >= 0 && size_t( plugin ) < num_plugins )
+      {
+        node = create_Node[ plugin ]( gc, identifier, plugins[ plugin ] );
+      }
+      else
+      {
+        throw Exception() << "Invalid plugin index " << plugin;
+      }
+
+      if( name != node->getName() )
+      {
+        throw Exception()
+          << "Node '" << identifier << "' was saved as '" << name << "'"
+          << ", but its plugin created a '" << node->getName() << "'"
+          ;
+      }
+
+      // Setting a Param may create further Params, therefore in order
+      const size_t num_params = r.get_size();
+      for( size_t p = 0; p < num_params; ++p )
+      {
+        if( !r.get_bool() ) continue;
+        Param *const param = node->getParam( index_t( p ) );
+
+        const size_t num_settings = r.get_size();
+        for( size_t s = 0; s < num_settings; ++s )
+        {
+          Param::Setting setting;
+          setting.value = r.get_value();
+          const size_t num_coords = r.get_size();
+          setting.coords.resize( num_coords );
+          for( size_t c = 0; c < num_coords; ++c )
+          {
+            setting.coords[ c ] = r.get_u32();
+          }
+          param->set( setting );
+        }
+      }
+
+      const size_t num_inputs = r.get_size();
+      if( num_inputs != size_t( node->getNumInputs() ) )
+      {
+        throw Exception()
+          << "Node '" << identifier << "' has " << node->getNumInputs() << " Inputs"
+          << ", the graph snapshot " << num_inputs
+          ;
+      }
+
+      for( size_t in_i = 0; in_i < num_inputs; ++in_i )
+      {
+        const int32_t source = r.get_i32();
+        const index_t output = ( source >= 0 ? index_t( r.get_u32() ) : 0 );
+        connections[ i ].push_back( make_pair( source, output ) );
+      }
+
+      nodes.push_back( node );
+    }
+
+    if( !r.atEnd() )
+    {
+      throw Exception() << "Trailing data";
+    }
+
+    // Connections, sources may come later for Nodes on cycles
+    for( size_t i = 0; i < num_nodes; ++i )
+    {
+      for( size_t in_i = 0; in_i < connections[ i ].size(); ++in_i )
+      {
+        const int32_t source = connections[ i ][ in_i ].first;
+        if( source < 0 ) continue;
+        if( size_t( source ) >= num_nodes )
+        {
+          throw Exception() << "Invalid Node index " << source;
+        }
+        nodes[ i ]->getInput( index_t( in_i ) )->connect( nodes[ source ]->getOutput( connections[ i ][ in_i ].second ) );
+      }
+    }
+
+    CountPtr< Graph > graph = new Graph( gc );
+    for( size_t i = 0; i < num_nodes; ++i )
+    {
+      graph->addNode( nodes[ i ] );
+    }
+    return graph;
+  }
+  catch( const GraphSnapshot::Exception & )
+  {
+    throw;
+  }
+  catch( const RPGML::Exception &e )
+  {
+    throw Exception() << "Loading graph snapshot '" << filename << "' failed: " << e.what();
+  }
+}
+
+} // namespace RPGML
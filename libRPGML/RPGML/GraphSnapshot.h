@@ -0,0 +1,61 @@
+/* This file is part of RPGML.
+ * 
+ * Copyright (c) 2014, Gunnar Payer, All rights reserved.
+ * 
+ * RPGML is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3.0 of the License, or (at your option) any later version.
+ * 
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ * 
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.
+ */
+/*! @file GraphSnapshot.h
+ * @brief Stores a merged Graph, to execute it without the script
+ *
+ * Building a Graph interprets the script, creates every Node and merges
+ * equivalent Nodes. A snapshot stores the result: For every Node the
+ * plugin it was created from, its Param settings (which include the
+ * contents of constant arrays) and the connections of its Inputs. The
+ * Nodes are stored in topological order. Loading recreates the Nodes
+ * through their plugins and replays the settings, the order and
+ * priorities are derived from the connections as usual.
+ *
+ * Plugins are identified by path, size and modification time. Loading
+ * fails, if any of them changed since the snapshot was saved.
+ */
+#ifndef RPGML_GraphSnapshot_h
+#define RPGML_GraphSnapshot_h
+
+#include "Graph.h"
+#include "String.h"
+
+namespace RPGML {
+
+class GraphSnapshot
+{
+public:
+  EXCEPTION_BASE( Exception );
+
+  /*! @brief Writes graph to filename
+   *
+   * Throws Exception, if a Node cannot be recreated from its plugin,
+   * e.g. if it has Param settings, that are no primitive Values.
+   */
+  static void save( const Graph *graph, const String &filename );
+
+  /*! @brief Recreates a Graph saved with save()
+   *
+   * Throws Exception, if filename is no valid snapshot or if a plugin changed.
+   */
+  static CountPtr< Graph > load( GarbageCollector *gc, const String &filename );
+};
+
+} // namespace RPGML
+
+#endif
@@ -956,6 +956,11 @@ void InterpretingASTVisitor::assign_impl( const AST::AssignmentStatementBase *no
   node->value->invite( this );
   Value value; value.swap( return_value );
 
+  assign_value( node, lvalue, value );
+}
+
+void InterpretingASTVisitor::assign_value( const AST::AssignmentStatementBase *node, Value *lvalue, const Value &value )
+{
   const Type lvalue_type = lvalue->getType();
 
   if( node->op == ID_ASSIGN )
@@ -94,8 +94,12 @@ public:
   };
 
 private:
+  //! Compiled code uses the same assignment, conversion and connection rules
+  friend class Bytecode;
+
   void dot_access_impl( Value &left, const String &identifier, Value *&value );
   void assign_impl( const AST::AssignmentStatementBase *node, Value *lvalue );
+  void assign_value( const AST::AssignmentStatementBase *node, Value *lvalue, const Value &value );
 
   Value create_default_value( const TypeDescr *of, const String &identifier = String() );
   CountPtr< ArrayBase > create_array( const TypeDescr *of, const ValueArray *dims );
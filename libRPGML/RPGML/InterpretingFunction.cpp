@@ -20,6 +20,7 @@
 #include "InterpretingASTVisitor.h"
 #include "Frame.h"
 #include "Scope.h"
+#include "Context.h"
 
 namespace RPGML {
 
@@ -35,6 +36,7 @@ InterpretingFunction::InterpretingFunction(
 : Function( _gc, loc, parent, decl_args, is_method )
 , m_body( body )
 , m_name( name )
+, m_compiled( false )
 {}
 
 InterpretingFunction::~InterpretingFunction( void )
@@ -44,6 +46,7 @@ void InterpretingFunction::gc_clear( void )
 {
   Base::gc_clear();
   m_body.reset();
+  m_bytecode.reset();
 }
 
 void InterpretingFunction::gc_getChildren( Children &children )
@@ -61,6 +64,22 @@ Value InterpretingFunction::call_impl( const Location *loc, index_t recursion_de
 
   Scope::EnterLeaveGuard guard( scope, frame );
 
+  if( !m_compiled && scope->getContext()->getCompile() )
+  {
+    m_bytecode = Bytecode::compileFunction( m_body, getDecl() );
+    m_compiled = true;
+  }
+
+  if( m_bytecode )
+  {
+    Value ret;
+    if( !m_bytecode->execute( scope, loc, recursion_depth+1, ret ) )
+    {
+      throw ParseException( loc ) << "Function '" << getName() << "': No return statement";
+    }
+    return ret;
+  }
+
   CountPtr< InterpretingASTVisitor > interpreter = new InterpretingASTVisitor( getGC(), scope, loc, recursion_depth+1 );
   m_body->invite( interpreter.get() );
 
@@ -20,6 +20,7 @@
 
 #include "Function.h"
 #include "AST.h"
+#include "Bytecode.h"
 
 namespace RPGML {
 
@@ -49,6 +50,8 @@ public:
 private:
   CountPtr< const AST::CompoundStatement > m_body;
   const String m_name;
+  CountPtr< const Bytecode > m_bytecode; //!< null if m_body has to be interpreted
+  bool m_compiled; //!< whether compiling m_body was tried
 };
 
 
@@ -24,6 +24,7 @@
 #include "Context.h"
 #include "Scope.h"
 #include "InterpretingASTVisitor.h"
+#include "Bytecode.h"
 #include "GarbageCollector.h"
 
 namespace RPGML {
@@ -36,6 +37,7 @@ public:
   InterpretingParser( GarbageCollector *_gc, Scope *scope, Source *source )
   : Collectable( _gc )
   , Parser( _gc, scope->getUnifier(), source )
+  , m_scope( scope )
   , interpreter( new InterpretingASTVisitor( _gc, scope ) )
   {}
 
@@ -44,20 +46,36 @@ public:
 
   virtual void gc_clear( void )
   {
+    m_scope.reset();
     interpreter.reset();
   }
 
   virtual void gc_getChildren( Children &children ) const
   {
     Base::gc_getChildren( children );
-    children << interpreter;
+    children << m_scope << interpreter;
   }
 
   virtual void append( const CountPtr< Statement > &statement )
   {
     try
     {
-      statement->invite( interpreter );
+      // Loops are worth compiling, everything else runs once
+      CountPtr< const Bytecode > code;
+      if( m_scope->getContext()->getCompile() && dynamic_cast< const AST::ForStatement* >( statement.get() ) )
+      {
+        code = Bytecode::compileStatement( statement );
+      }
+
+      if( code )
+      {
+        Value ret;
+        code->execute( m_scope, interpreter->getCallLoc(), interpreter->getRD(), ret );
+      }
+      else
+      {
+        statement->invite( interpreter );
+      }
       getGC()->run( 2 );
     }
     catch( const char *e )
@@ -67,6 +85,7 @@ public:
   }
 
 private:
+  CountPtr< Scope > m_scope;
   CountPtr< InterpretingASTVisitor > interpreter;
 };
 
@@ -18,12 +18,32 @@
 #include "JobQueue.h"
 
 #include "Thread.h"
+#include "Profiler.h"
+#include "Affinity.h"
+
+#include <unistd.h>
 
 namespace RPGML {
 
+namespace JobQueue_impl {
+
+  //! Spinning only helps, when the thread adding the Job runs on another CPU
+  static
+  unsigned int default_max_spins( void )
+  {
+    return ( ::sysconf( _SC_NPROCESSORS_ONLN ) > 1 ? JobQueue::DefaultMaxSpins : 0 );
+  }
+
+} // namespace JobQueue_impl
+
+const unsigned int JobQueue::DefaultMaxSpins;
+
 JobQueue::JobQueue( GarbageCollector *_gc )
 : Collectable( _gc )
 , m_queue( new Queue( _gc ) )
+, m_length_gauge( 0 )
+, m_max_spins( JobQueue_impl::default_max_spins() )
+, m_spins( 0 )
 {}
 
 JobQueue::~JobQueue( void )
@@ -52,6 +72,7 @@ void JobQueue::addJob( Job *job )
 {
   Mutex::ScopedLock lock( &m_lock );
   m_queue->push( job );
+  if( m_length_gauge && Metrics::isEnabled() ) m_length_gauge->set( int64_t( m_queue->size() ) );
   ++m_fill;
 }
 
@@ -59,12 +80,12 @@ CountPtr< JobQueue::Job > JobQueue::getJob( void )
 {
   for(;;)
   {
-    --m_fill;
+    wait_fill();
     Mutex::ScopedLock lock( &m_lock );
     if( !m_queue->empty() )
     {
-      CountPtr< Job > ret( m_queue->top() );
-      m_queue->pop();
+      CountPtr< Job > ret( m_queue->take( m_queue->findHome( Affinity::getThreadNode() ) ) );
+      if( m_length_gauge && Metrics::isEnabled() ) m_length_gauge->set( int64_t( m_queue->size() ) );
       return ret;
     }
     // was deleted
@@ -78,9 +99,56 @@ CountPtr< JobQueue::Job > JobQueue::getJob( void )
 size_t JobQueue::doJob( Job *_job )
 {
   CountPtr< Job > job( _job );
-  CountPtr< Job::Token > token( job->getToken() );
+  WaitLock::LocalToken token( &job->m_wait_lock );
   addJob( job );
-  return token->wait();
+  token.wait( spin_budget() );
+  return job->getReturnValue();
+}
+
+void JobQueue::setMaxSpins( unsigned int max_spins )
+{
+  m_max_spins = max_spins;
+  m_spins = 0;
+}
+
+unsigned int JobQueue::spin_budget( void ) const
+{
+  // Some more than recently needed, so that the estimate can grow
+  return std::min( m_max_spins, 2 * m_spins.get() + 16 );
+}
+
+void JobQueue::wait_fill( void )
+{
+  // Blocking for less than this could have been spinning
+  static const int64_t short_wait_ns = 50000;
+
+  const unsigned int budget = spin_budget();
+  const int64_t begin = ( budget > 0 ? Profiler::now() : 0 );
+  const unsigned int tries = m_fill.lock( budget );
+  if( 0 == budget ) return;
+
+  const unsigned int spins = m_spins.get();
+  if( tries < budget )
+  {
+    // Got a Job while spinning: move the estimate towards the tries needed
+    m_spins = unsigned( int( spins ) + ( int( tries ) - int( spins ) ) / 8 );
+  }
+  else if( Profiler::now() - begin < short_wait_ns )
+  {
+    // Blocked only shortly: spin longer next time
+    m_spins = std::min( m_max_spins, 2 * spins + 16 );
+  }
+  else
+  {
+    // Blocked long: Jobs arrive too late for spinning, e.g. between frames
+    m_spins = spins / 2;
+  }
+}
+
+void JobQueue::setLengthGauge( Metrics::Gauge *gauge )
+{
+  Mutex::ScopedLock lock( &m_lock );
+  m_length_gauge = gauge;
 }
 
 void JobQueue::gc_clear( void )
@@ -106,6 +174,7 @@ bool JobQueue::cmp_priority_less( const CountPtr< Job > &x, const CountPtr< Job
 JobQueue::Job::Job( GarbageCollector *_gc, size_t priority )
 : Collectable( _gc )
 , m_priority( priority )
+, m_home( -1 )
 {}
 
 JobQueue::Job::~Job( void )
@@ -257,6 +326,41 @@ CountPtr< JobQueue::Job > JobQueue::Queue::top( void ) const
   return m_heap->front();
 }
 
+index_t JobQueue::Queue::findHome( int node ) const
+{
+  // Nodes of the first levels of the heap, giving up little priority
+  static const index_t search = 7;
+
+  if( node < 0 ) return 0;
+  const int home = m_heap->front()->getHome();
+  if( home < 0 || home == node ) return 0;
+
+  const index_t n = std::min( index_t( m_heap->size() ), search );
+  for( index_t i = 1; i < n; ++i )
+  {
+    const int h = (*m_heap)[ i ]->getHome();
+    if( h < 0 || h == node ) return i;
+  }
+  return 0;
+}
+
+CountPtr< JobQueue::Job > JobQueue::Queue::take( index_t index )
+{
+  CountPtr< Job > ret( (*m_heap)[ index ] );
+  if( 0 == index )
+  {
+    pop();
+  }
+  else
+  {
+    // Few Jobs are queued, rebuilding is cheaper than sifting for them
+    (*m_heap)[ index ] = m_heap->back();
+    m_heap->pop_back();
+    std::make_heap( m_heap->begin(), m_heap->end(), cmp_priority_less );
+  }
+  return ret;
+}
+
 void JobQueue::Queue::clear( void )
 {
   m_heap->clear();
@@ -21,8 +21,10 @@
 #include "GarbageCollector.h"
 #include "Semaphore.h"
 #include "Mutex.h"
+#include "Atomic.h"
 #include "Array.h"
 #include "WaitLock.h"
+#include "Metrics.h"
 
 #include <algorithm>
 
@@ -57,6 +59,10 @@ public:
     size_t getPriority( void ) const;
     void setPriority( size_t priority );
 
+    //! NUMA node whose workers are preferred for this Job, -1 for any, atomic, because doit() may set it while queues read it
+    int getHome( void ) const { return m_home.load_relaxed(); }
+    void setHome( int node ) { m_home = node; }
+
     //! Only valid after done() has been called
     size_t getReturnValue( void ) const;
 
@@ -97,6 +103,7 @@ public:
     WaitLock m_wait_lock;
     size_t m_priority;
     size_t m_return_value;
+    Atomic< int > m_home;
   };
 
   class EndJob : public Job
@@ -110,15 +117,38 @@ public:
   };
 
   void addJob( Job *job );
+
+  /*! Blocks until a Job is available, returns the one with the highest priority
+   *
+   * On a pinned worker, one of the next few Jobs is preferred, when the
+   * first one has its home on another NUMA node, see Affinity.
+   */
   CountPtr< Job > getJob( void );
 
-  //! Blocks until job is done
+  //! Blocks until job is done, without allocation
   size_t doJob( Job *job );
 
+  //! Default for setMaxSpins(), 0 on a single CPU
+  static const unsigned int DefaultMaxSpins = 1000;
+
+  /*! Limits how often getJob() and doJob() poll before they block
+   *
+   * getJob() adapts its spinning to how soon Jobs arrived recently, up to
+   * max_spins. 0 always blocks right away.
+   */
+  void setMaxSpins( unsigned int max_spins );
+
+  //! Set to the number of queued Jobs on every change while Metrics are enabled
+  void setLengthGauge( Metrics::Gauge *gauge );
+
   virtual void gc_clear( void );
   virtual void gc_getChildren( Children &children ) const;
 
 private:
+  //! Spins before blocking on m_fill
+  unsigned int spin_budget( void ) const;
+  void wait_fill( void );
+
   static bool cmp_priority_less( const CountPtr< Job > &x, const CountPtr< Job > &y );
 
   class Queue : public Collectable
@@ -132,6 +162,10 @@ private:
     void push( Job *job );
     void pop( void );
     CountPtr< Job > top( void ) const;
+    //! Index of a Job near the top with its home on node or none, 0 if there is none
+    index_t findHome( int node ) const;
+    //! Removes the Job at index
+    CountPtr< Job > take( index_t index );
     void clear( void );
     virtual void gc_clear( void );
     virtual void gc_getChildren( Children &children ) const;
@@ -143,6 +177,9 @@ private:
   CountPtr< Queue > m_queue;
   Semaphore m_fill;
   Mutex m_lock;
+  Metrics::Gauge *m_length_gauge;
+  unsigned int m_max_spins;
+  Atomic< unsigned int > m_spins; //!< recently needed to get a Job without blocking
 };
 
 } // namespace RPGML
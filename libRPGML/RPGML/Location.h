@@ -66,6 +66,10 @@ public:
     return parent;
   }
 
+  const String &getFilename( void ) const { return filename; }
+  const Position &getBegin( void ) const { return begin; }
+  const Position &getEnd  ( void ) const { return end; }
+
   std::ostream &print( std::ostream &o, bool with_filename=true, bool is_parent=false ) const;
 
   class WithoutFilename
@@ -0,0 +1,279 @@
+/* This file is part of RPGML.
+ * 
+ * Copyright (c) 2014, Gunnar Payer, All rights reserved.
+ * 
+ * RPGML is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3.0 of the License, or (at your option) any later version.
+ * 
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ * 
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.
+ */
+#include "Log.h"
+
+#include <streambuf>
+#include <algorithm>
+#include <cstring>
+#include <time.h>
+
+namespace RPGML {
+
+//! Appends everything written to a std::string, which keeps its capacity across frames
+class Log::StringStreambuf : public std::streambuf
+{
+public:
+  explicit StringStreambuf( std::string &str )
+  : m_str( str )
+  {}
+
+protected:
+  virtual int_type overflow( int_type c )
+  {
+    if( !traits_type::eq_int_type( c, traits_type::eof() ) )
+    {
+      m_str.push_back( traits_type::to_char_type( c ) );
+    }
+    return traits_type::not_eof( c );
+  }
+
+  virtual std::streamsize xsputn( const char *s, std::streamsize n )
+  {
+    m_str.append( s, size_t( n ) );
+    return n;
+  }
+
+private:
+  std::string &m_str;
+};
+
+//! Written only by its thread, read and cleared only by collect()
+class Log::Buffer
+{
+public:
+  Buffer( void )
+  : streambuf( text )
+  , stream( &streambuf )
+  , next( 0 )
+  {}
+
+  std::string text;
+  StringStreambuf streambuf;
+  std::ostream stream;
+  std::vector< Record > records;
+  Buffer *next;
+};
+
+__thread Log::Buffer *Log::s_thread_buffer = 0;
+
+Log &Log::global( void )
+{
+  static Log log( std::cout );
+  return log;
+}
+
+Log::FlushPolicy Log::parseFlushPolicy( const char *name )
+{
+  if( !name ) throw Exception() << "No flush policy specified";
+  if( !strcmp( name, "frame" ) ) return FLUSH_FRAME;
+  if( !strcmp( name, "buffered" ) ) return FLUSH_BUFFERED;
+  if( !strcmp( name, "immediate" ) ) return FLUSH_IMMEDIATE;
+  throw Exception()
+    << "Invalid flush policy '" << name << "'"
+    << ", must be one of 'frame', 'buffered' or 'immediate'"
+    ;
+}
+
+Log::Log( std::ostream &sink )
+: m_sink( sink )
+, m_seq( 0 )
+, m_buffers( 0 )
+, m_flush_policy( FLUSH_FRAME )
+, m_rate_limit( 0 )
+, m_rate_window( -1 )
+, m_rate_count( 0 )
+, m_suppressed( 0 )
+{}
+
+Log::~Log( void )
+{
+  // Worker threads have been joined by now
+  collect();
+  flush();
+  m_sink.flush();
+
+  for( Buffer *b = m_buffers.get(); b; )
+  {
+    Buffer *const next = b->next;
+    delete b;
+    b = next;
+  }
+}
+
+void Log::setFlushPolicy( FlushPolicy policy )
+{
+  m_flush_policy = policy;
+}
+
+Log::FlushPolicy Log::getFlushPolicy( void ) const
+{
+  return m_flush_policy;
+}
+
+void Log::setRateLimit( size_t messages_per_second )
+{
+  m_rate_limit = messages_per_second;
+}
+
+size_t Log::getRateLimit( void ) const
+{
+  return m_rate_limit;
+}
+
+Log::Buffer *Log::getThreadBuffer( void )
+{
+  Buffer *buffer = s_thread_buffer;
+  if( buffer ) return buffer;
+
+  buffer = new Buffer();
+
+  // Lock-free push to the front, Buffers are never removed before ~Log()
+  for(;;)
+  {
+    Buffer *const head = m_buffers.get();
+    buffer->next = head;
+    if( m_buffers.compare_and_swap( head, buffer ) ) break;
+  }
+
+  s_thread_buffer = buffer;
+  return buffer;
+}
+
+void Log::finish( Buffer *buffer, uint64_t seq, size_t begin )
+{
+  if( FLUSH_IMMEDIATE == m_flush_policy )
+  {
+    Mutex::ScopedLock lock( &m_immediate_lock );
+    if( !rateLimited() )
+    {
+      m_sink.write( buffer->text.data() + begin, std::streamsize( buffer->text.size() - begin ) );
+      m_sink.flush();
+    }
+    else
+    {
+      Mutex::ScopedLock pending_lock( &m_pending_lock );
+      ++m_suppressed;
+    }
+    buffer->text.resize( begin );
+    return;
+  }
+
+  Record record;
+  record.seq = seq;
+  record.begin = begin;
+  record.end = buffer->text.size();
+  record.buffer = buffer;
+  buffer->records.push_back( record );
+}
+
+bool Log::rateLimited( void )
+{
+  if( 0 == m_rate_limit ) return false;
+
+  timespec now;
+  ::clock_gettime( CLOCK_MONOTONIC, &now );
+  const int64_t window = int64_t( now.tv_sec );
+
+  if( window != m_rate_window )
+  {
+    m_rate_window = window;
+    m_rate_count = 0;
+  }
+
+  return ( m_rate_count++ >= m_rate_limit );
+}
+
+void Log::collect( void )
+{
+  if( FLUSH_IMMEDIATE == m_flush_policy ) return;
+
+  m_records.clear();
+  for( Buffer *b = m_buffers.get(); b; b = b->next )
+  {
+    m_records.insert( m_records.end(), b->records.begin(), b->records.end() );
+  }
+  if( m_records.empty() ) return;
+
+  std::sort( m_records.begin(), m_records.end() );
+
+  {
+    Mutex::ScopedLock lock( &m_pending_lock );
+    for( size_t i( 0 ), end( m_records.size() ); i < end; ++i )
+    {
+      const Record &r = m_records[ i ];
+      if( rateLimited() )
+      {
+        ++m_suppressed;
+        continue;
+      }
+      m_pending.append( r.buffer->text, r.begin, r.end - r.begin );
+    }
+  }
+
+  for( Buffer *b = m_buffers.get(); b; b = b->next )
+  {
+    b->text.clear();
+    b->records.clear();
+  }
+}
+
+void Log::flush( void )
+{
+  size_t suppressed = 0;
+  {
+    Mutex::ScopedLock lock( &m_pending_lock );
+    m_writing.swap( m_pending );
+    std::swap( suppressed, m_suppressed );
+  }
+
+  if( !m_writing.empty() )
+  {
+    m_sink.write( m_writing.data(), std::streamsize( m_writing.size() ) );
+    if( FLUSH_BUFFERED != m_flush_policy ) m_sink.flush();
+    m_writing.clear();
+  }
+
+  if( suppressed )
+  {
+    std::cerr
+      << "Log: suppressed " << suppressed << " messages"
+      << " exceeding " << m_rate_limit << " per second"
+      << std::endl
+      ;
+  }
+}
+
+Log::Entry::Entry( Log &log )
+: m_log( log )
+, m_buffer( log.getThreadBuffer() )
+, m_seq( log.m_seq++ )
+, m_begin( m_buffer->text.size() )
+{}
+
+Log::Entry::~Entry( void )
+{
+  m_log.finish( m_buffer, m_seq, m_begin );
+}
+
+std::ostream &Log::Entry::stream( void )
+{
+  return m_buffer->stream;
+}
+
+} // namespace RPGML
+
@@ -0,0 +1,150 @@
+/* This file is part of RPGML.
+ * 
+ * Copyright (c) 2014, Gunnar Payer, All rights reserved.
+ * 
+ * RPGML is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3.0 of the License, or (at your option) any later version.
+ * 
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ * 
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.
+ */
+/*! @file Log.h
+ * @brief Batched output sink for messages written by Nodes
+ *
+ * Nodes run on arbitrary worker threads. Writing to std::cout directly
+ * serializes them on the stream lock and interleaves the output of one
+ * frame. Instead, every thread appends to its own buffer without locking,
+ * each message tagged with a global sequence number. At the end of a frame,
+ * when no Node of that frame is running any more, collect() moves all
+ * messages in sequence order into a pending batch, which flush() writes to
+ * the sink on the main thread.
+ */
+#ifndef RPGML_Log_h
+#define RPGML_Log_h
+
+#include "Atomic.h"
+#include "Mutex.h"
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+namespace RPGML {
+
+class Log
+{
+private:
+  class Buffer;
+  class StringStreambuf;
+
+public:
+  EXCEPTION_BASE( Exception );
+
+  enum FlushPolicy
+  {
+      FLUSH_FRAME     //!< Collect per frame, write and flush the sink on the main thread
+    , FLUSH_BUFFERED  //!< Like FLUSH_FRAME, but leave flushing to the sink stream
+    , FLUSH_IMMEDIATE //!< Write every message directly, serialized by a Mutex
+  };
+
+  //! @brief The process wide Log, writing to std::cout
+  static Log &global( void );
+
+  //! @brief Parses "frame", "buffered" or "immediate"
+  static FlushPolicy parseFlushPolicy( const char *name );
+
+  void setFlushPolicy( FlushPolicy policy );
+  FlushPolicy getFlushPolicy( void ) const;
+
+  /*! @brief Limits the number of messages written per second
+   *
+   * Excess messages are dropped, their number is reported on std::cerr.
+   * 0 means unlimited.
+   */
+  void setRateLimit( size_t messages_per_second );
+  size_t getRateLimit( void ) const;
+
+  /*! @brief One message, written to the buffer of the calling thread
+   *
+   * The message is complete, when the Entry is destroyed.
+   */
+  class Entry
+  {
+  public:
+    explicit Entry( Log &log = Log::global() );
+    ~Entry( void );
+    std::ostream &stream( void );
+    template< class T > Entry &operator<<( const T &x ) { stream() << x; return (*this); }
+  private:
+    Entry( const Entry & );
+    Entry &operator=( const Entry & );
+    Log &m_log;
+    Buffer *m_buffer;
+    uint64_t m_seq;
+    size_t m_begin;
+  };
+
+  /*! @brief Moves all buffered messages into the pending batch in sequence order
+   *
+   * Must only be called while no thread writes an Entry, e.g. by the EndNode
+   * of a Graph.
+   */
+  void collect( void );
+
+  //! @brief Writes the pending batch to the sink, should be called by the main thread
+  void flush( void );
+
+private:
+  friend class Entry;
+
+  struct Record
+  {
+    uint64_t seq;
+    size_t begin;
+    size_t end;
+    const Buffer *buffer;
+    bool operator<( const Record &other ) const { return seq < other.seq; }
+  };
+
+  explicit Log( std::ostream &sink );
+  ~Log( void );
+  Log( const Log & );
+  Log &operator=( const Log & );
+
+  static __thread Buffer *s_thread_buffer;
+
+  Buffer *getThreadBuffer( void );
+  void finish( Buffer *buffer, uint64_t seq, size_t begin );
+  bool rateLimited( void );
+
+  std::ostream &m_sink;
+  Atomic< uint64_t > m_seq;
+  Atomic< Buffer* > m_buffers;
+  FlushPolicy m_flush_policy;
+  size_t m_rate_limit;
+
+  // Only used by collect()
+  std::vector< Record > m_records;
+  int64_t m_rate_window;
+  size_t m_rate_count;
+
+  Mutex m_pending_lock;
+  std::string m_pending;
+  std::string m_writing;
+  size_t m_suppressed;
+
+  Mutex m_immediate_lock;
+};
+
+} // namespace RPGML
+
+#endif
+
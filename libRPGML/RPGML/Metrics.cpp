@@ -0,0 +1,406 @@
+/* This file is part of RPGML.
+ *
+ * Copyright (c) 2014, Gunnar Payer, All rights reserved.
+ *
+ * RPGML is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3.0 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.
+ */
+#include "Metrics.h"
+
+#include "Thread.h"
+#include "AllocationCounter.h"
+
+#include <ostream>
+#include <sstream>
+#include <fstream>
+#include <iomanip>
+#include <cstring>
+#include <cerrno>
+#include <cstdio>
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+namespace RPGML {
+
+namespace Metrics_impl {
+
+  static
+  void write_seconds( std::ostream &o, uint64_t ns )
+  {
+    o << std::setprecision( 9 ) << double( ns ) * 1e-9;
+  }
+
+  static
+  void write_header( std::ostream &o, const char *name, const char *type, const char *help )
+  {
+    o
+      << "# HELP " << name << " " << help << "\n"
+      << "# TYPE " << name << " " << type << "\n"
+      ;
+  }
+
+  //! Writes all of s, false on errors other than EINTR
+  static
+  bool send_all( int fd, const std::string &s )
+  {
+    const char *p = s.c_str();
+    size_t left = s.size();
+    while( left > 0 )
+    {
+      const ssize_t n = ::send( fd, p, left, MSG_NOSIGNAL );
+      if( n < 0 )
+      {
+        if( EINTR == errno ) continue;
+        return false;
+      }
+      p += n;
+      left -= size_t( n );
+    }
+    return true;
+  }
+
+} // namespace Metrics_impl
+
+using namespace Metrics_impl;
+
+//! Writes the Metrics to a file periodically or serves them on a Unix socket
+class Metrics::Exporter : public Thread
+{
+  typedef Thread Base;
+public:
+  Exporter( Metrics *metrics, const std::string &target, double interval_seconds )
+  : Base( 0, false )
+  , m_metrics( metrics )
+  , m_interval_ms( int( interval_seconds * 1000.0 ) )
+  , m_listen( -1 )
+  {
+    m_stop[ 0 ] = -1;
+    m_stop[ 1 ] = -1;
+
+    if( m_interval_ms < 1 ) m_interval_ms = 1;
+
+    static const char unix_prefix[] = "unix:";
+    if( 0 == target.compare( 0, sizeof( unix_prefix )-1, unix_prefix ) )
+    {
+      m_socket = target.substr( sizeof( unix_prefix )-1 );
+      listen();
+    }
+    else
+    {
+      m_file = target;
+    }
+
+    if( 0 != ::pipe( m_stop ) )
+    {
+      const int err = errno;
+      close();
+      throw Exception() << "Could not create pipe: " << std::strerror( err );
+    }
+
+    start();
+  }
+
+  virtual ~Exporter( void )
+  {
+    close();
+  }
+
+  //! Called once, joins the thread
+  void stop( void )
+  {
+    const char c = 0;
+    while( ::write( m_stop[ 1 ], &c, 1 ) < 0 && EINTR == errno ) {}
+    join();
+  }
+
+protected:
+  virtual size_t run( void )
+  {
+    pollfd fds[ 2 ];
+    fds[ 0 ].fd = m_stop[ 0 ];
+    fds[ 0 ].events = POLLIN;
+    fds[ 1 ].fd = m_listen;
+    fds[ 1 ].events = POLLIN;
+    const nfds_t nfds = ( m_listen >= 0 ? 2 : 1 );
+
+    for(;;)
+    {
+      fds[ 0 ].revents = 0;
+      fds[ 1 ].revents = 0;
+      const int ret = ::poll( fds, nfds, ( m_listen >= 0 ? -1 : m_interval_ms ) );
+      if( ret < 0 && EINTR != errno ) return size_t( -1 );
+
+      if( fds[ 0 ].revents )
+      {
+        if( !m_file.empty() ) writeFile();
+        return 0;
+      }
+
+      if( m_listen >= 0 )
+      {
+        if( fds[ 1 ].revents ) serve();
+      }
+      else if( 0 == ret )
+      {
+        writeFile();
+      }
+    }
+  }
+
+private:
+  void listen( void )
+  {
+    sockaddr_un addr;
+    std::memset( &addr, 0, sizeof( addr ) );
+    addr.sun_family = AF_UNIX;
+    if( m_socket.empty() || m_socket.size() >= sizeof( addr.sun_path ) )
+    {
+      throw Exception() << "Invalid Unix socket path '" << m_socket << "'";
+    }
+    std::strcpy( addr.sun_path, m_socket.c_str() );
+
+    m_listen = ::socket( AF_UNIX, SOCK_STREAM, 0 );
+    if( m_listen < 0 )
+    {
+      throw Exception() << "Could not create socket: " << std::strerror( errno );
+    }
+
+    ::unlink( m_socket.c_str() );
+    if(
+         0 != ::bind( m_listen, reinterpret_cast< const sockaddr* >( &addr ), sizeof( addr ) )
+      || 0 != ::listen( m_listen, 8 )
+      )
+    {
+      const int err = errno;
+      close();
+      throw Exception() << "Could not listen on '" << m_socket << "': " << std::strerror( err );
+    }
+  }
+
+  void serve( void )
+  {
+    const int client = ::accept( m_listen, 0, 0 );
+    if( client < 0 ) return;
+
+    std::ostringstream s;
+    m_metrics->write( s );
+    send_all( client, s.str() );
+    ::close( client );
+  }
+
+  //! Replaces the file atomically, readers never see a partial dump
+  void writeFile( void )
+  {
+    const std::string tmp = m_file + ".tmp";
+    {
+      std::ofstream f( tmp.c_str() );
+      if( !f ) return;
+      m_metrics->write( f );
+      if( !f ) return;
+    }
+    std::rename( tmp.c_str(), m_file.c_str() );
+  }
+
+  void close( void )
+  {
+    if( m_listen >= 0 )
+    {
+      ::close( m_listen );
+      ::unlink( m_socket.c_str() );
+      m_listen = -1;
+    }
+    for( int i=0; i<2; ++i )
+    {
+      if( m_stop[ i ] >= 0 ) ::close( m_stop[ i ] );
+      m_stop[ i ] = -1;
+    }
+  }
+
+  Metrics *const m_metrics;
+  std::string m_file;
+  std::string m_socket;
+  int m_interval_ms;
+  int m_listen;
+  int m_stop[ 2 ]; //!< self-pipe to wake up poll() for stop()
+};
+
+Metrics::Histogram::Histogram( void )
+: m_sum_ns( 0 )
+{
+  for( int b=0; b<=NumBuckets; ++b ) m_buckets[ b ] = 0;
+}
+
+void Metrics::Histogram::observe( int64_t ns )
+{
+  if( ns < 0 ) ns = 0;
+
+  // Bucket b holds durations up to 2^(b+10) ns
+  int b = 0;
+  while( b < NumBuckets && uint64_t( ns ) > ( uint64_t( 1 ) << ( b+10 ) ) ) ++b;
+
+  ++m_buckets[ b ];
+  m_sum_ns += uint64_t( ns );
+}
+
+void Metrics::Histogram::write( std::ostream &o, const char *name, const char *help ) const
+{
+  write_header( o, name, "histogram", help );
+
+  uint64_t cumulative = 0;
+  for( int b=0; b<NumBuckets; ++b )
+  {
+    cumulative += m_buckets[ b ].get();
+    o << name << "_bucket{le=\"";
+    write_seconds( o, uint64_t( 1 ) << ( b+10 ) );
+    o << "\"} " << cumulative << "\n";
+  }
+  cumulative += m_buckets[ NumBuckets ].get();
+  o << name << "_bucket{le=\"+Inf\"} " << cumulative << "\n";
+
+  o << name << "_sum ";
+  write_seconds( o, m_sum_ns.get() );
+  o << "\n";
+  // The count is that of +Inf, even while observe() is called concurrently
+  o << name << "_count " << cumulative << "\n";
+}
+
+bool Metrics::s_enabled = false;
+__thread Metrics::ThreadSlot *Metrics::s_thread_slot = 0;
+
+Metrics &Metrics::global( void )
+{
+  static Metrics metrics;
+  return metrics;
+}
+
+Metrics::Metrics( void )
+: m_num_threads( 0 )
+, m_last_allocated_bytes( 0 )
+{}
+
+Metrics::~Metrics( void )
+{
+  stopExporter();
+}
+
+void Metrics::enable( bool enabled )
+{
+  if( enabled ) AllocationCounter::enable();
+  s_enabled = enabled;
+}
+
+Metrics::ThreadSlot *Metrics::getThreadSlot( void )
+{
+  if( m_num_threads.get() >= MaxThreads ) return 0;
+  const index_t i = m_num_threads++;
+  if( i >= MaxThreads ) return 0;
+  return ( s_thread_slot = &m_threads[ i ] );
+}
+
+index_t Metrics::getNumThreads( void ) const
+{
+  const index_t n = m_num_threads.get();
+  return ( n < MaxThreads ? n : MaxThreads );
+}
+
+void Metrics::frameDone( int64_t frame_ns )
+{
+  m_frame_time.observe( frame_ns );
+  m_frames.add( 1 );
+
+  const uint64_t allocated_bytes = AllocationCounter::getAllocatedBytes();
+  m_frame_allocated_bytes.set( int64_t( allocated_bytes - m_last_allocated_bytes ) );
+  m_last_allocated_bytes = allocated_bytes;
+}
+
+void Metrics::gcDone( int64_t pause_ns, index_t live_collectables )
+{
+  m_gc_pause.observe( pause_ns );
+  m_collectables.set( int64_t( live_collectables ) );
+}
+
+void Metrics::workerDone( int64_t idle_ns, int64_t busy_ns )
+{
+  ThreadSlot *slot = s_thread_slot;
+  if( !slot ) slot = getThreadSlot();
+  if( !slot ) return;
+
+  if( !slot->worker.load_relaxed() ) slot->worker = true;
+  slot->idle_ns.add_relaxed( uint64_t( idle_ns ) );
+  slot->busy_ns.add_relaxed( uint64_t( busy_ns ) );
+}
+
+void Metrics::write( std::ostream &o ) const
+{
+  const std::ios_base::fmtflags flags = o.flags();
+  const std::streamsize precision = o.precision();
+  const index_t n = getNumThreads();
+
+  m_frame_time.write( o, "rpgml_frame_seconds", "Time from scheduling a frame until all of its Nodes are done" );
+
+  write_header( o, "rpgml_frames_total", "counter", "Frames done" );
+  o << "rpgml_frames_total " << m_frames.get() << "\n";
+
+  write_header( o, "rpgml_worker_busy_seconds_total", "counter", "Time workers spent executing Jobs" );
+  for( index_t i=0; i<n; ++i )
+  {
+    if( !m_threads[ i ].worker.load_relaxed() ) continue;
+    o << "rpgml_worker_busy_seconds_total{worker=\"" << i << "\"} ";
+    write_seconds( o, m_threads[ i ].busy_ns.load_relaxed() );
+    o << "\n";
+  }
+
+  write_header( o, "rpgml_worker_idle_seconds_total", "counter", "Time workers spent waiting for Jobs" );
+  for( index_t i=0; i<n; ++i )
+  {
+    if( !m_threads[ i ].worker.load_relaxed() ) continue;
+    o << "rpgml_worker_idle_seconds_total{worker=\"" << i << "\"} ";
+    write_seconds( o, m_threads[ i ].idle_ns.load_relaxed() );
+    o << "\n";
+  }
+
+  write_header( o, "rpgml_jobqueue_length", "gauge", "Jobs waiting in the JobQueue of the ThreadPool" );
+  o << "rpgml_jobqueue_length " << m_jobqueue_length.get() << "\n";
+
+  write_header( o, "rpgml_collectables", "gauge", "Live Collectables after the last garbage collection" );
+  o << "rpgml_collectables " << m_collectables.get() << "\n";
+
+  m_gc_pause.write( o, "rpgml_gc_pause_seconds", "Duration of garbage collections" );
+
+  write_header( o, "rpgml_allocated_bytes_total", "counter", "Bytes allocated with operator new" );
+  o << "rpgml_allocated_bytes_total " << AllocationCounter::getAllocatedBytes() << "\n";
+
+  write_header( o, "rpgml_frame_allocated_bytes", "gauge", "Bytes allocated during the last frame" );
+  o << "rpgml_frame_allocated_bytes " << m_frame_allocated_bytes.get() << "\n";
+
+  o.flags( flags );
+  o.precision( precision );
+}
+
+void Metrics::startExporter( const std::string &target, double interval_seconds )
+{
+  stopExporter();
+  m_exporter = new Exporter( this, target, interval_seconds );
+}
+
+void Metrics::stopExporter( void )
+{
+  if( m_exporter.isNull() ) return;
+  m_exporter->stop();
+  m_exporter.reset();
+}
+
+} // namespace RPGML
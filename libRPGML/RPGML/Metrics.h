@@ -0,0 +1,161 @@
+/* This file is part of RPGML.
+ *
+ * Copyright (c) 2014, Gunnar Payer, All rights reserved.
+ *
+ * RPGML is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3.0 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.
+ */
+/*! @file Metrics.h
+ * @brief Runtime counters of a long running Graph, in Prometheus text format
+ *
+ * Frame times, GC pauses, the JobQueue length, the number of live
+ * Collectables, per worker busy and idle time and the allocated bytes are
+ * updated without locks: shared values are Atomic, per thread values live in
+ * a slot of their own, written only by that thread. Any thread can read them
+ * at any time with write(), e.g. the exporter thread started by
+ * startExporter().
+ *
+ * When disabled, the instrumented code only tests isEnabled().
+ */
+#ifndef RPGML_Metrics_h
+#define RPGML_Metrics_h
+
+#include "Atomic.h"
+#include "Exception.h"
+#include "Refcounted.h"
+#include "types.h"
+
+#include <iosfwd>
+#include <string>
+#include <stdint.h>
+
+namespace RPGML {
+
+class Metrics
+{
+private:
+  class Exporter;
+
+public:
+  EXCEPTION_BASE( Exception );
+
+  //! @brief The process wide Metrics, disabled by default
+  static Metrics &global( void );
+
+  static bool isEnabled( void ) { return s_enabled; }
+  void enable( bool enabled = true );
+
+  //! @brief Monotonically increasing
+  class Counter
+  {
+  public:
+    Counter( void ) : m_value( 0 ) {}
+    void add( uint64_t x ) { m_value += x; }
+    uint64_t get( void ) const { return m_value.get(); }
+  private:
+    Atomic< uint64_t > m_value;
+  };
+
+  //! @brief Current value
+  class Gauge
+  {
+  public:
+    Gauge( void ) : m_value( 0 ) {}
+    void set( int64_t x ) { m_value = x; }
+    int64_t get( void ) const { return m_value.get(); }
+  private:
+    Atomic< int64_t > m_value;
+  };
+
+  //! @brief Durations in power of two buckets from 1us to about 137s
+  class Histogram
+  {
+  public:
+    static const int NumBuckets = 28;
+
+    Histogram( void );
+    void observe( int64_t ns );
+    //! @brief Cumulative buckets in seconds, sum and count
+    void write( std::ostream &o, const char *name, const char *help ) const;
+  private:
+    Atomic< uint64_t > m_buckets[ NumBuckets+1 ]; //!< last one is +Inf
+    Atomic< uint64_t > m_sum_ns;
+  };
+
+  //! @brief Called by the Graph at the end of every frame
+  void frameDone( int64_t frame_ns );
+
+  //! @brief Called by the GarbageCollector after every run()
+  void gcDone( int64_t pause_ns, index_t live_collectables );
+
+  //! @brief Called by workers after each Job, for the calling thread
+  void workerDone( int64_t idle_ns, int64_t busy_ns );
+
+  //! @brief Set by the JobQueue of the ThreadPool
+  Gauge *getJobQueueLength( void ) { return &m_jobqueue_length; }
+
+  //! @brief All metrics in Prometheus text exposition format
+  void write( std::ostream &o ) const;
+
+  /*! @brief Starts a thread, that exports write() every interval_seconds
+   *
+   * target is either a file, that is replaced atomically, or
+   * "unix:<path>", a Unix socket, to which write() is sent on every connect.
+   */
+  void startExporter( const std::string &target, double interval_seconds );
+
+  //! @brief Stops the exporter, a file gets a last update
+  void stopExporter( void );
+
+private:
+  Metrics( void );
+  ~Metrics( void );
+  Metrics( const Metrics & );
+  Metrics &operator=( const Metrics & );
+
+  //! Written only by its thread, one cache line each
+  struct ThreadSlot
+  {
+    Atomic< uint64_t > busy_ns;
+    Atomic< uint64_t > idle_ns;
+    Atomic< bool > worker;
+    char padding[ 64 - 2*sizeof( Atomic< uint64_t > ) - sizeof( Atomic< bool > ) ];
+  };
+
+  static const index_t MaxThreads = 256;
+
+  static bool s_enabled;
+  static __thread ThreadSlot *s_thread_slot;
+
+  //! 0, if all slots are taken
+  ThreadSlot *getThreadSlot( void );
+  //! Slots in use
+  index_t getNumThreads( void ) const;
+
+  ThreadSlot m_threads[ MaxThreads ];
+  Atomic< index_t > m_num_threads;
+
+  Histogram m_frame_time;
+  Histogram m_gc_pause;
+  Counter m_frames;
+  Gauge m_jobqueue_length;
+  Gauge m_collectables;
+  Gauge m_frame_allocated_bytes;
+  uint64_t m_last_allocated_bytes; //!< only used by frameDone(), frames never overlap
+
+  CountPtr< Exporter > m_exporter;
+};
+
+} // namespace RPGML
+
+#endif
@@ -26,6 +26,44 @@ using namespace std;
 
 namespace RPGML {
 
+namespace Node_impl {
+
+static inline Input  *getPort( const Value &value, const Input  * ) { return ( value.isInput () ? value.getInput () : 0 ); }
+static inline Output *getPort( const Value &value, const Output * ) { return ( value.isOutput() ? value.getOutput() : 0 ); }
+static inline Param  *getPort( const Value &value, const Param  * ) { return ( value.isParam () ? value.getParam () : 0 ); }
+
+//! @brief Position of the port named identifier in ports, unknown if there is none
+template< class PortType, class PortArray, class PortIndices >
+index_t findPort( const Frame *node, const PortArray &ports, const PortIndices &port_indices, const char *identifier )
+{
+  const index_t n = ports.size();
+
+  // Ports are members of the Node's Frame as well, try its hashed lookup first
+  const index_t frame_index = node->getIndex( identifier );
+  if( frame_index != unknown )
+  {
+    const PortType *const port = getPort( *node->getStack( frame_index ), (const PortType*)0 );
+    if( port && port->getIdentifier() == identifier )
+    {
+      const typename PortIndices::const_iterator i = port_indices.find( port );
+      if( i != port_indices.end() && i->second < n && ports[ i->second ].get() == port ) return i->second;
+    }
+  }
+
+  // Not a member, e.g. hidden by a script variable of the same name
+  for( index_t i = 0; i < n; ++i )
+  {
+    const PortType *const port = ports[ i ].get();
+    if( port && port->getIdentifier() == identifier ) return i;
+  }
+
+  return unknown;
+}
+
+} // namespace Node_impl
+
+using namespace Node_impl;
+
 Port::Port( GarbageCollector *_gc, Node *parent )
 : Collectable( _gc )
 , m_parent( parent )
@@ -334,12 +372,23 @@ bool Node::tick( CountPtr< JobQueue > )
   return tick();
 }
 
+bool Node::tick( CountPtr< JobQueue > main_thread, CountPtr< JobQueue > )
+{
+  return tick( main_thread );
+}
+
+bool Node::isPure( void ) const
+{
+  return false;
+}
+
 void Node::gc_clear( void )
 {
   Base::gc_clear();
   m_inputs.reset();
   m_outputs.reset();
   m_params.reset();
+  m_port_indices.clear();
 }
 
 void Node::gc_getChildren( Children &children ) const
@@ -368,13 +417,17 @@ Input *Node::getInput( int i ) const
 
 Input *Node::getInput( const char *identifier, index_t *index ) const
 {
-  if( index ) (*index) = 0;
-  for( InputArray::const_iterator i( m_inputs->begin() ), end( m_inputs->end() ); i != end; ++i )
-  {
-    if( (*i)->getIdentifier() == identifier ) return (*i);
-    if( index ) ++(*index);
-  }
-  throw InputNotFound() << "Input '" << identifier << "' not found";
+  Input *const ret = tryGetInput( identifier, index );
+  if( !ret ) throw InputNotFound() << "Input '" << identifier << "' not found";
+  return ret;
+}
+
+Input *Node::tryGetInput( const char *identifier, index_t *index ) const
+{
+  const index_t i = findPort< Input >( this, *m_inputs, m_port_indices, identifier );
+  if( i == unknown ) return 0;
+  if( index ) (*index) = i;
+  return (*m_inputs)[ i ];
 }
 
 Output *Node::getOutput( index_t i ) const
@@ -393,13 +446,17 @@ Output *Node::getOutput( int i ) const
 
 Output *Node::getOutput( const char *identifier, index_t *index ) const
 {
-  if( index ) (*index) = 0;
-  for( OutputArray::const_iterator i( m_outputs->begin() ), end( m_outputs->end() ); i != end; ++i )
-  {
-    if( (*i)->getIdentifier() == identifier ) return (*i);
-    if( index ) ++(*index);
-  }
-  throw OutputNotFound() << "Output '" << identifier << "' not found";
+  Output *const ret = tryGetOutput( identifier, index );
+  if( !ret ) throw OutputNotFound() << "Output '" << identifier << "' not found";
+  return ret;
+}
+
+Output *Node::tryGetOutput( const char *identifier, index_t *index ) const
+{
+  const index_t i = findPort< Output >( this, *m_outputs, m_port_indices, identifier );
+  if( i == unknown ) return 0;
+  if( index ) (*index) = i;
+  return (*m_outputs)[ i ];
 }
 
 Param *Node::getParam( index_t i ) const
@@ -418,19 +475,25 @@ Param *Node::getParam( int i ) const
 
 Param *Node::getParam( const char *identifier, index_t *index ) const
 {
-  if( index ) (*index) = 0;
-  for( ParamArray::const_iterator i( m_params->begin() ), end( m_params->end() ); i != end; ++i )
-  {
-    if( !(*i).isNull() && (*i)->getIdentifier() == identifier ) return (*i);
-    if( index ) ++(*index);
-  }
-  throw ParamNotFound() << "Param '" << identifier << "' not found";
+  Param *const ret = tryGetParam( identifier, index );
+  if( !ret ) throw ParamNotFound() << "Param '" << identifier << "' not found";
+  return ret;
+}
+
+Param *Node::tryGetParam( const char *identifier, index_t *index ) const
+{
+  const index_t i = findPort< Param >( this, *m_params, m_port_indices, identifier );
+  if( i == unknown ) return 0;
+  if( index ) (*index) = i;
+  return (*m_params)[ i ];
 }
 
 Param *Node::setParam( index_t i, CountPtr< Param > param )
 {
   if( i < m_params->size() )
   {
+    m_port_indices.erase( (*m_params)[ i ].get() );
+    if( !param.isNull() ) m_port_indices[ param.get() ] = i;
     return ( (*m_params)[ i ] = param );
   }
   throw ParamNotFound() << "Param index " << i << " out of bounds";
@@ -440,10 +503,12 @@ void Node::setNumInputs( index_t n )
 {
   index_t old_n = m_inputs->size();
 
+  for( index_t i = n; i < old_n; ++i ) m_port_indices.erase( (*m_inputs)[ i ].get() );
   m_inputs->resize( n );
   for( index_t i = old_n; i < n; ++i )
   {
     (*m_inputs)[ i ] = new Input( getGC(), this );
+    m_port_indices[ (*m_inputs)[ i ].get() ] = i;
   }
 }
 
@@ -451,15 +516,18 @@ void Node::setNumOutputs( index_t n )
 {
   index_t old_n = m_outputs->size();
 
+  for( index_t i = n; i < old_n; ++i ) m_port_indices.erase( (*m_outputs)[ i ].get() );
   m_outputs->resize( n );
   for( index_t i = old_n; i < n; ++i )
   {
     (*m_outputs)[ i ] = new Output( getGC(), this );
+    m_port_indices[ (*m_outputs)[ i ].get() ] = i;
   }
 }
 
 void Node::setNumParams( index_t n )
 {
+  for( index_t i = n; i < m_params->size(); ++i ) m_port_indices.erase( (*m_params)[ i ].get() );
   m_params->resize( n );
 }
 
@@ -671,6 +739,11 @@ bool Identity::tick( CountPtr< JobQueue > )
   return true;
 }
 
+bool Identity::isPure( void ) const
+{
+  return true;
+}
+
 InOut::InOut( GarbageCollector *_gc, const String &identifier )
 : Collectable( _gc )
 , m_id( new Identity( _gc, identifier ) )
@@ -786,6 +859,16 @@ int Param::Setting::compare( const Setting &other ) const
   return 0;
 }
 
+size_t Param::Setting::hash( void ) const
+{
+  size_t h = value.hash_exactly();
+  for( size_t i=0; i<coords.size(); ++i )
+  {
+    h = h * 31 + size_t( coords[ i ] );
+  }
+  return h;
+}
+
 bool Param::Setting::operator<( const Setting &other ) const
 {
   return ( 0 > compare( other ) );
@@ -25,6 +25,7 @@
 #include "JobQueue.h"
 
 #include <vector>
+#include <unordered_map>
 
 #define DEFINE_INPUT( INPUT_ENUM, identifier ) \
   getInput( INPUT_ENUM )->setIdentifier( String::Static( identifier ) ); \
@@ -368,6 +369,8 @@ public:
     Setting( void ) {}
     Setting( const Value &_value, int n_coords, const index_t *_coords );
     int compare( const Setting &other ) const;
+    //! @brief Consistent with compare()
+    size_t hash( void ) const;
     bool operator<( const Setting &other ) const;
     bool operator==( const Setting &other ) const;
     bool operator!=( const Setting &other ) const;
@@ -427,9 +430,14 @@ public:
   virtual const char *getName( void ) const = 0;
   const SharedObject *getSO( void ) const;
 
+  //! Called by the Graph, workers is the queue of the ThreadPool running it, e.g. for sub-jobs, calls tick( main_thread ) by default
+  virtual bool tick( CountPtr< JobQueue > main_thread, CountPtr< JobQueue > workers );
   virtual bool tick( CountPtr< JobQueue > main_thread );
   virtual bool tick( void );
 
+  //! Whether the Outputs only depend on the Inputs and Params, without state or side effects. Evaluated once by Graph::foldConstants(), if all Inputs are constant.
+  virtual bool isPure( void ) const;
+
   virtual void gc_clear( void );
   virtual void gc_getChildren( Children &children ) const;
 
@@ -443,6 +451,11 @@ public:
   Param *getParam( int     i ) const;
   Param *getParam( const char *identifier, index_t *index=0 ) const;
 
+  //! @brief Like getInput(), getOutput() and getParam(), but return 0 instead of throwing NotFound
+  Input *tryGetInput( const char *identifier, index_t *index=0 ) const;
+  Output *tryGetOutput( const char *identifier, index_t *index=0 ) const;
+  Param *tryGetParam( const char *identifier, index_t *index=0 ) const;
+
   Param *setParam( index_t i, CountPtr< Param > param );
 
   void setNumInputs( index_t n );
@@ -544,6 +557,8 @@ private:
   CountPtr< OutputArray > m_outputs;
   CountPtr< ParamArray  > m_params;
   CountPtr< const SharedObject > m_so;
+  //! Index of each Input, Output and Param in its array, for tryGetInput() etc.
+  std::unordered_map< const void*, index_t > m_port_indices;
 };
 
 class Identity : public Node
@@ -554,6 +569,7 @@ public:
   virtual ~Identity( void );
   virtual const char *getName( void ) const;
   virtual bool tick( CountPtr< JobQueue > );
+  virtual bool isPure( void ) const;
 };
 
 class InOut : public Collectable
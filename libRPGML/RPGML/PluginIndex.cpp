@@ -0,0 +1,136 @@
+/* This file is part of RPGML.
+ * 
+ * Copyright (c) 2014, Gunnar Payer, All rights reserved.
+ * 
+ * RPGML is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3.0 of the License, or (at your option) any later version.
+ * 
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ * 
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.
+ */
+#include "PluginIndex.h"
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <dirent.h>
+#include <cstring>
+
+namespace RPGML {
+
+namespace PluginIndex_impl {
+
+static const char function_prefix[] = "libRPGML_Function_";
+static const char node_prefix[] = "libRPGML_Node_";
+static const char so_suffix[] = ".so";
+static const char script_suffix[] = ".rpgml";
+
+//! @brief Whether name is "<prefix>identifier<suffix>" with non-empty identifier, stores identifier
+static
+bool match( const std::string &name, const char *prefix, const char *suffix, std::string &identifier )
+{
+  const size_t prefix_len = ::strlen( prefix );
+  const size_t suffix_len = ::strlen( suffix );
+  if( name.size() <= prefix_len + suffix_len ) return false;
+  if( 0 != name.compare( 0, prefix_len, prefix ) ) return false;
+  if( 0 != name.compare( name.size() - suffix_len, suffix_len, suffix ) ) return false;
+  identifier = name.substr( prefix_len, name.size() - prefix_len - suffix_len );
+  return true;
+}
+
+//! @brief Whether the entry is a directory, following symbolic links like opendir() does
+static
+bool isDirectory( const std::string &path, const struct dirent *entry )
+{
+#ifdef _DIRENT_HAVE_D_TYPE
+  if( entry->d_type == DT_DIR ) return true;
+  if( entry->d_type != DT_LNK && entry->d_type != DT_UNKNOWN ) return false;
+#endif
+  struct stat st;
+  const std::string full = path + "/" + entry->d_name;
+  return 0 == ::stat( full.c_str(), &st ) && S_ISDIR( st.st_mode );
+}
+
+} // namespace PluginIndex_impl
+
+using namespace PluginIndex_impl;
+
+PluginIndex::PluginIndex( void )
+{}
+
+PluginIndex::~PluginIndex( void )
+{}
+
+int PluginIndex::lookup( const String &path, const String &identifier )
+{
+  Mutex::ScopedLock lock( &m_lock );
+
+  const Entries &entries = getEntries( std::string( path.c_str() ) );
+  const Entries::const_iterator entry = entries.find( std::string( identifier.c_str() ) );
+  return ( entry != entries.end() ? entry->second : int( NONE ) );
+}
+
+void PluginIndex::list( const String &path, List &identifiers )
+{
+  Mutex::ScopedLock lock( &m_lock );
+
+  const Entries &entries = getEntries( std::string( path.c_str() ) );
+  identifiers.assign( entries.begin(), entries.end() );
+}
+
+PluginIndex::Entries &PluginIndex::getEntries( const std::string &path )
+{
+  Directories::iterator dir = m_directories.find( path );
+  if( dir == m_directories.end() )
+  {
+    dir = m_directories.insert( Directories::value_type( path, Entries() ) ).first;
+    scan( path, dir->second );
+  }
+  return dir->second;
+}
+
+void PluginIndex::clear( void )
+{
+  Mutex::ScopedLock lock( &m_lock );
+  m_directories.clear();
+}
+
+void PluginIndex::scan( const std::string &path, Entries &entries )
+{
+  DIR *const dir_p = ::opendir( path.c_str() );
+  if( !dir_p ) return;
+
+  std::string identifier;
+  for( const struct dirent *entry = ::readdir( dir_p ); entry; entry = ::readdir( dir_p ) )
+  {
+    const std::string name( entry->d_name );
+    if( name == "." || name == ".." ) continue;
+
+    if( isDirectory( path, entry ) )
+    {
+      entries[ name ] |= DIRECTORY;
+    }
+    else if( match( name, function_prefix, so_suffix, identifier ) )
+    {
+      entries[ identifier ] |= FUNCTION;
+    }
+    else if( match( name, node_prefix, so_suffix, identifier ) )
+    {
+      entries[ identifier ] |= NODE;
+    }
+    else if( match( name, "", script_suffix, identifier ) )
+    {
+      entries[ identifier ] |= SCRIPT;
+    }
+  }
+
+  ::closedir( dir_p );
+}
+
+} // namespace RPGML
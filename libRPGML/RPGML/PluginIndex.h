@@ -0,0 +1,89 @@
+/* This file is part of RPGML.
+ * 
+ * Copyright (c) 2014, Gunnar Payer, All rights reserved.
+ * 
+ * RPGML is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3.0 of the License, or (at your option) any later version.
+ * 
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ * 
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.
+ */
+/*! @file PluginIndex.h
+ * @brief Maps identifiers to the plugins, scripts and namespaces of a directory
+ *
+ * Resolving an unknown identifier checks every search path for a
+ * namespace directory, a Function plugin, a Node plugin and a script.
+ * Doing this with one probe per candidate file costs several failing
+ * system calls per identifier and path, which is slow on network file
+ * systems. The PluginIndex reads each directory once and answers all
+ * further lookups from memory.
+ */
+#ifndef RPGML_PluginIndex_h
+#define RPGML_PluginIndex_h
+
+#include "String.h"
+#include "Mutex.h"
+
+#include <map>
+#include <string>
+#include <vector>
+
+namespace RPGML {
+
+class PluginIndex
+{
+public:
+  //! @brief What an identifier refers to in a directory, may be combined
+  enum Kind
+  {
+      NONE      = 0
+    , DIRECTORY = 1 //!< "identifier/"
+    , FUNCTION  = 2 //!< "libRPGML_Function_identifier.so"
+    , NODE      = 4 //!< "libRPGML_Node_identifier.so"
+    , SCRIPT    = 8 //!< "identifier.rpgml"
+  };
+
+  PluginIndex( void );
+  ~PluginIndex( void );
+
+  /*! @brief Returns the Kind bits of identifier in directory path
+   *
+   * The directory is read on the first lookup, a missing directory
+   * contains nothing. Thread-safe.
+   */
+  int lookup( const String &path, const String &identifier );
+
+  typedef std::vector< std::pair< std::string, int > > List;
+
+  //! @brief All identifiers in directory path with their Kind bits, reads it if necessary
+  void list( const String &path, List &identifiers );
+
+  //! @brief Forgets all directories read so far, e.g. after installing plugins
+  void clear( void );
+
+private:
+  typedef std::map< std::string, int > Entries;
+  typedef std::map< std::string, Entries > Directories;
+
+  static void scan( const std::string &path, Entries &entries );
+  Entries &getEntries( const std::string &path );
+
+  Directories m_directories;
+  Mutex m_lock;
+
+  //! forbidden
+  PluginIndex &operator=( const PluginIndex & );
+  //! forbidden
+  PluginIndex( const PluginIndex & );
+};
+
+} // namespace RPGML
+
+#endif
@@ -0,0 +1,616 @@
+/* This file is part of RPGML.
+ *
+ * Copyright (c) 2014, Gunnar Payer, All rights reserved.
+ *
+ * RPGML is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3.0 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.
+ */
+#include "Profiler.h"
+
+#include "Node.h"
+#include "ArrayBase.h"
+#include "Value.h"
+
+#include <ostream>
+#include <istream>
+#include <sstream>
+#include <iomanip>
+#include <algorithm>
+#include <map>
+#include <time.h>
+#include <stdlib.h>
+#include <sys/resource.h>
+
+namespace RPGML {
+
+//! Written only by its thread, read only while no Node is executed
+class Profiler::Buffer
+{
+public:
+  explicit
+  Buffer( index_t _thread )
+  : thread( _thread )
+  , next( 0 )
+  {
+    events.reserve( 4096 );
+  }
+
+  std::vector< Event > events;
+  const index_t thread;
+  Buffer *next;
+};
+
+namespace Profiler_impl {
+
+  static
+  size_t element_bytes( Type type )
+  {
+    switch( type.getEnum() )
+    {
+      case Type::BOOL  : return sizeof( bool );
+      case Type::UINT8 : return sizeof( uint8_t );
+      case Type::INT8  : return sizeof( int8_t );
+      case Type::UINT16: return sizeof( uint16_t );
+      case Type::INT16 : return sizeof( int16_t );
+      case Type::UINT32: return sizeof( uint32_t );
+      case Type::INT32 : return sizeof( int32_t );
+      case Type::UINT64: return sizeof( uint64_t );
+      case Type::INT64 : return sizeof( int64_t );
+      case Type::FLOAT : return sizeof( float );
+      case Type::DOUBLE: return sizeof( double );
+      default          : return sizeof( Value );
+    }
+  }
+
+  static
+  void write_json_string( std::ostream &o, const char *s )
+  {
+    o << '"';
+    for( ; *s; ++s )
+    {
+      const unsigned char c = (unsigned char)(*s);
+      if( c == '"' || c == '\\' )
+      {
+        o << '\\' << char( c );
+      }
+      else if( c < 0x20 )
+      {
+        o << "\\u00" << "0123456789abcdef"[ c >> 4 ] << "0123456789abcdef"[ c & 15 ];
+      }
+      else
+      {
+        o << char( c );
+      }
+    }
+    o << '"';
+  }
+
+  static
+  double to_us( int64_t ns )
+  {
+    return double( ns ) * 1e-3;
+  }
+
+  //! Backslash and newline escaped, so that every entry is one line
+  static
+  void write_escaped( std::ostream &o, const std::string &s )
+  {
+    for( std::string::const_iterator c( s.begin() ), end( s.end() ); c != end; ++c )
+    {
+      switch( *c )
+      {
+        case '\\': o << "\\\\"; break;
+        case '\n': o << "\\n"; break;
+        default  : o << (*c); break;
+      }
+    }
+  }
+
+  static
+  std::string unescape( const std::string &s, size_t begin, size_t end )
+  {
+    std::string ret;
+    ret.reserve( end - begin );
+    for( size_t c = begin; c < end; ++c )
+    {
+      if( s[ c ] == '\\' && c+1 < end )
+      {
+        ++c;
+        ret += ( s[ c ] == 'n' ? '\n' : s[ c ] );
+      }
+      else
+      {
+        ret += s[ c ];
+      }
+    }
+    return ret;
+  }
+
+  //! Relative change in percent, positive if x is greater than base
+  static
+  double change_percent( double x, double base )
+  {
+    return ( base != 0 ? 100.0 * ( x - base ) / base : 0.0 );
+  }
+
+  struct NodeStats
+  {
+    NodeStats( void )
+    : node( 0 )
+    , total( 0 )
+    , wait( 0 )
+    , bytes( 0 )
+    , allocations( 0 )
+    {}
+
+    const Node *node;
+    std::vector< int64_t > durations;
+    int64_t total;
+    int64_t wait;
+    uint64_t bytes;
+    uint64_t allocations;
+
+    bool operator<( const NodeStats &other ) const { return total > other.total; }
+  };
+
+  struct Cost
+  {
+    Cost( void ) : total( 0 ), count( 0 ) {}
+    int64_t total;
+    int64_t count;
+  };
+
+} // namespace Profiler_impl
+
+using namespace Profiler_impl;
+
+bool Profiler::s_enabled = false;
+__thread Profiler::Buffer *Profiler::s_thread_buffer = 0;
+
+Profiler &Profiler::global( void )
+{
+  static Profiler profiler;
+  return profiler;
+}
+
+Profiler::Profiler( void )
+: m_buffers( 0 )
+, m_num_buffers( 0 )
+, m_start( now() )
+, m_warmup( 0 )
+, m_last_frame( 0 )
+, m_warmup_end( m_start )
+, m_last_frame_end( m_start )
+{}
+
+Profiler::~Profiler( void )
+{
+  for( Buffer *b = m_buffers.get(); b; )
+  {
+    Buffer *const next = b->next;
+    delete b;
+    b = next;
+  }
+}
+
+void Profiler::enable( bool enabled )
+{
+  m_start = now();
+  m_warmup_end = m_start;
+  m_last_frame_end = m_start;
+  if( enabled ) AllocationCounter::enable();
+  s_enabled = enabled;
+}
+
+void Profiler::setWarmup( uint64_t frames )
+{
+  m_warmup = frames;
+}
+
+int64_t Profiler::now( void )
+{
+  timespec t;
+  ::clock_gettime( CLOCK_MONOTONIC, &t );
+  return int64_t( t.tv_sec ) * 1000000000 + int64_t( t.tv_nsec );
+}
+
+void Profiler::addNode( const Node *node )
+{
+  Mutex::ScopedLock lock( &m_nodes_lock );
+  m_nodes.push_back( node );
+}
+
+Profiler::Buffer *Profiler::getThreadBuffer( void )
+{
+  Buffer *buffer = s_thread_buffer;
+  if( buffer ) return buffer;
+
+  buffer = new Buffer( m_num_buffers++ );
+
+  // Lock-free push to the front, Buffers are never removed before ~Profiler()
+  for(;;)
+  {
+    Buffer *const head = m_buffers.get();
+    buffer->next = head;
+    if( m_buffers.compare_and_swap( head, buffer ) ) break;
+  }
+
+  s_thread_buffer = buffer;
+  return buffer;
+}
+
+void Profiler::record( const Event &event )
+{
+  if( event.frame <= m_warmup ) return;
+  getThreadBuffer()->events.push_back( event );
+}
+
+void Profiler::recordFrame( uint64_t frame )
+{
+  if( frame <= m_warmup )
+  {
+    m_warmup_end = now();
+  }
+  else
+  {
+    m_last_frame = frame;
+    m_last_frame_end = now();
+  }
+}
+
+uint64_t Profiler::getChangedOutputBytes( const Node *node )
+{
+  uint64_t bytes = 0;
+  for( index_t i( 0 ), end( node->getNumOutputs() ); i < end; ++i )
+  {
+    const Output *const output = node->getOutput( i );
+    if( !output->hasChanged() ) continue;
+
+    const ArrayBase *const data = output->getData();
+    if( data ) bytes += uint64_t( data->size() ) * element_bytes( data->getType() );
+  }
+  return bytes;
+}
+
+void Profiler::writeTrace( std::ostream &o ) const
+{
+  o << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+
+  bool first = true;
+  for( const Buffer *b = m_buffers.get(); b; b = b->next )
+  {
+    // Thread names, workers are numbered in the order they executed their first Node
+    o << ( first ? "\n" : ",\n" );
+    first = false;
+    o
+      << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << b->thread
+      << ",\"args\":{\"name\":\"worker " << b->thread << "\"}}"
+      ;
+
+    for( size_t i( 0 ), end( b->events.size() ); i < end; ++i )
+    {
+      const Event &e = b->events[ i ];
+      o << ",\n{\"name\":";
+      write_json_string( o, e.node->getIdentifier() );
+      o << ",\"cat\":";
+      write_json_string( o, e.node->getName() );
+      o
+        << std::fixed << std::setprecision( 3 )
+        << ",\"ph\":\"X\",\"pid\":1,\"tid\":" << b->thread
+        << ",\"ts\":" << to_us( e.begin - m_start )
+        << ",\"dur\":" << to_us( e.end - e.begin )
+        << ",\"args\":{\"frame\":" << e.frame
+        << ",\"wait_us\":" << to_us( e.begin - e.scheduled )
+        << ",\"bytes\":" << e.bytes
+        << ",\"allocations\":" << e.allocations
+        << "}}"
+        ;
+    }
+  }
+
+  o << "\n]}\n";
+}
+
+void Profiler::writeSummary( std::ostream &o ) const
+{
+  std::map< const Node*, NodeStats > by_node;
+  for( const Buffer *b = m_buffers.get(); b; b = b->next )
+  {
+    for( size_t i( 0 ), end( b->events.size() ); i < end; ++i )
+    {
+      const Event &e = b->events[ i ];
+      NodeStats &s = by_node[ e.node ];
+      s.node = e.node;
+      s.durations.push_back( e.end - e.begin );
+      s.total += e.end - e.begin;
+      s.wait += e.begin - e.scheduled;
+      s.bytes += e.bytes;
+      s.allocations += e.allocations;
+    }
+  }
+
+  std::vector< NodeStats > stats;
+  stats.reserve( by_node.size() );
+  for( std::map< const Node*, NodeStats >::iterator i( by_node.begin() ), end( by_node.end() ); i != end; ++i )
+  {
+    stats.push_back( NodeStats() );
+    std::swap( stats.back(), i->second );
+  }
+  std::sort( stats.begin(), stats.end() );
+
+  o
+    << std::left << std::setw( 40 ) << "Node" << std::right
+    << std::setw( 8 ) << "count"
+    << std::setw( 12 ) << "total ms"
+    << std::setw( 12 ) << "mean us"
+    << std::setw( 12 ) << "p99 us"
+    << std::setw( 12 ) << "wait us"
+    << std::setw( 14 ) << "bytes/exec"
+    << std::setw( 14 ) << "allocs/exec"
+    << "\n"
+    ;
+
+  for( size_t i( 0 ), end( stats.size() ); i < end; ++i )
+  {
+    NodeStats &s = stats[ i ];
+    const size_t n = s.durations.size();
+
+    std::sort( s.durations.begin(), s.durations.end() );
+    const size_t p99 = ( n * 99 + 99 ) / 100 - 1;
+
+    const std::string identifier = s.node->getIdentifier().get();
+    const std::string name = identifier + " (" + s.node->getName() + ")";
+
+    o
+      << std::left << std::setw( 40 ) << name << std::right
+      << std::fixed << std::setprecision( 3 )
+      << std::setw( 8 ) << n
+      << std::setw( 12 ) << to_us( s.total ) * 1e-3
+      << std::setw( 12 ) << to_us( s.total ) / double( n )
+      << std::setw( 12 ) << to_us( s.durations[ p99 ] )
+      << std::setw( 12 ) << to_us( s.wait ) / double( n )
+      << std::setw( 14 ) << s.bytes / n
+      << std::setw( 14 ) << double( s.allocations ) / double( n )
+      << "\n"
+      ;
+  }
+}
+
+void Profiler::getNodeCosts( NodeCosts &costs ) const
+{
+  std::map< const Node*, Cost > by_node;
+  for( const Buffer *b = m_buffers.get(); b; b = b->next )
+  {
+    for( size_t i( 0 ), end( b->events.size() ); i < end; ++i )
+    {
+      const Event &e = b->events[ i ];
+      Cost &c = by_node[ e.node ];
+      c.total += e.end - e.begin;
+      ++c.count;
+    }
+  }
+
+  costs.clear();
+  for( std::map< const Node*, Cost >::const_iterator i( by_node.begin() ), end( by_node.end() ); i != end; ++i )
+  {
+    costs[ i->first ] = i->second.total / i->second.count;
+  }
+}
+
+void Profiler::writeCosts( std::ostream &o, const Costs &costs )
+{
+  for( Costs::const_iterator i( costs.begin() ), end( costs.end() ); i != end; ++i )
+  {
+    o << i->second << " ";
+    write_escaped( o, i->first );
+    o << "\n";
+  }
+}
+
+void Profiler::readCosts( std::istream &i, Costs &costs )
+{
+  std::string line;
+  for( size_t line_nr = 1; std::getline( i, line ); ++line_nr )
+  {
+    if( line.empty() ) continue;
+
+    const size_t space = line.find( ' ' );
+    char *cost_end = 0;
+    const long long cost = ::strtoll( line.c_str(), &cost_end, 10 );
+    if( std::string::npos == space || cost_end != line.c_str() + space || cost < 0 )
+    {
+      throw Exception() << "Malformed costs in line " << line_nr << ": expected '<ns> <key>'";
+    }
+
+    costs[ unescape( line, space+1, line.size() ) ] = int64_t( cost );
+  }
+}
+
+Profiler::Bench::Bench( void )
+: frames( 0 )
+, frames_per_second( 0 )
+, allocations_per_frame( 0 )
+, peak_rss_kb( 0 )
+{}
+
+void Profiler::getBench( Bench &bench ) const
+{
+  bench = Bench();
+  bench.frames = ( m_last_frame > m_warmup ? m_last_frame - m_warmup : 0 );
+
+  const int64_t duration = m_last_frame_end - m_warmup_end;
+  if( bench.frames > 0 && duration > 0 )
+  {
+    bench.frames_per_second = double( bench.frames ) / ( double( duration ) * 1e-9 );
+  }
+
+  uint64_t allocations = 0;
+  std::map< const Node*, Cost > by_node;
+  for( const Buffer *b = m_buffers.get(); b; b = b->next )
+  {
+    for( size_t i( 0 ), end( b->events.size() ); i < end; ++i )
+    {
+      const Event &e = b->events[ i ];
+      Cost &c = by_node[ e.node ];
+      c.total += e.end - e.begin;
+      ++c.count;
+      allocations += e.allocations;
+    }
+  }
+
+  if( bench.frames > 0 )
+  {
+    bench.allocations_per_frame = double( allocations ) / double( bench.frames );
+  }
+
+  for( std::map< const Node*, Cost >::const_iterator i( by_node.begin() ), end( by_node.end() ); i != end; ++i )
+  {
+    bench.node_us[ i->first->getIdentifier().get() ] = to_us( i->second.total ) / double( i->second.count );
+  }
+
+  rusage usage;
+  if( 0 == ::getrusage( RUSAGE_SELF, &usage ) )
+  {
+    bench.peak_rss_kb = int64_t( usage.ru_maxrss );
+  }
+}
+
+void Profiler::writeBench( std::ostream &o, const Bench &bench )
+{
+  o
+    << std::fixed << std::setprecision( 3 )
+    << "kind,name,value\n"
+    << "total,frames," << bench.frames << "\n"
+    << "total,frames_per_second," << bench.frames_per_second << "\n"
+    << "total,allocations_per_frame," << bench.allocations_per_frame << "\n"
+    << "total,peak_rss_kb," << bench.peak_rss_kb << "\n"
+    ;
+
+  for( std::map< std::string, double >::const_iterator i( bench.node_us.begin() ), end( bench.node_us.end() ); i != end; ++i )
+  {
+    std::ostringstream name;
+    write_escaped( name, i->first );
+
+    // CSV quoting, quotes are doubled
+    o << "node,\"";
+    const std::string &n = name.str();
+    for( size_t c = 0; c < n.size(); ++c )
+    {
+      if( n[ c ] == '"' ) o << '"';
+      o << n[ c ];
+    }
+    o << "\"," << i->second << "\n";
+  }
+}
+
+void Profiler::readBench( std::istream &i, Bench &bench )
+{
+  bench = Bench();
+
+  std::string line;
+  for( size_t line_nr = 1; std::getline( i, line ); ++line_nr )
+  {
+    if( line.empty() || 1 == line_nr ) continue;
+
+    const size_t first = line.find( ',' );
+    const size_t last = line.rfind( ',' );
+    if( std::string::npos == first || first == last )
+    {
+      throw Exception() << "Malformed benchmark in line " << line_nr << ": expected 'kind,name,value'";
+    }
+
+    const std::string kind = line.substr( 0, first );
+    const double value = ::strtod( line.c_str() + last + 1, 0 );
+
+    size_t name_begin = first+1;
+    size_t name_end = last;
+    if( name_end - name_begin >= 2 && line[ name_begin ] == '"' && line[ name_end-1 ] == '"' )
+    {
+      ++name_begin;
+      --name_end;
+    }
+
+    std::string name;
+    name.reserve( name_end - name_begin );
+    for( size_t c = name_begin; c < name_end; ++c )
+    {
+      name += line[ c ];
+      if( line[ c ] == '"' && c+1 < name_end && line[ c+1 ] == '"' ) ++c;
+    }
+
+    if( kind == "node" )
+    {
+      bench.node_us[ unescape( name, 0, name.size() ) ] = value;
+    }
+    else if( kind == "total" )
+    {
+      if     ( name == "frames"                ) bench.frames = uint64_t( value );
+      else if( name == "frames_per_second"     ) bench.frames_per_second = value;
+      else if( name == "allocations_per_frame" ) bench.allocations_per_frame = value;
+      else if( name == "peak_rss_kb"           ) bench.peak_rss_kb = int64_t( value );
+    }
+    else
+    {
+      throw Exception() << "Malformed benchmark in line " << line_nr << ": unknown kind '" << kind << "'";
+    }
+  }
+}
+
+index_t Profiler::compareBench( std::ostream &o, const Bench &bench, const Bench &baseline, double threshold_percent )
+{
+  index_t regressions = 0;
+
+  const char *const names[ 3 ] = { "frames_per_second", "allocations_per_frame", "peak_rss_kb" };
+  const double values[ 3 ] = { bench.frames_per_second, bench.allocations_per_frame, double( bench.peak_rss_kb ) };
+  const double bases[ 3 ] = { baseline.frames_per_second, baseline.allocations_per_frame, double( baseline.peak_rss_kb ) };
+  const double sign[ 3 ] = { -1, 1, 1 }; // frames_per_second regresses when lower
+
+  o << std::fixed;
+  for( int m = 0; m < 3; ++m )
+  {
+    const double change = change_percent( values[ m ], bases[ m ] );
+    const bool regression = ( sign[ m ] * change > threshold_percent );
+    if( regression ) ++regressions;
+
+    o
+      << ( regression ? "REGRESSION " : "           " )
+      << std::left << std::setw( 22 ) << names[ m ] << std::right
+      << std::setprecision( 3 ) << std::setw( 14 ) << values[ m ]
+      << " (baseline " << bases[ m ] << ", "
+      << std::showpos << std::setprecision( 1 ) << change << std::noshowpos << "%)\n"
+      ;
+  }
+
+  // Below 1us per execution, the differences are mostly noise
+  for( std::map< std::string, double >::const_iterator i( bench.node_us.begin() ), end( bench.node_us.end() ); i != end; ++i )
+  {
+    const std::map< std::string, double >::const_iterator base = baseline.node_us.find( i->first );
+    if( base == baseline.node_us.end() ) continue;
+
+    const double change = change_percent( i->second, base->second );
+    if( change > threshold_percent && i->second - base->second >= 1.0 )
+    {
+      o
+        << "slower     "
+        << std::setprecision( 3 ) << std::setw( 12 ) << i->second << " us"
+        << " (baseline " << base->second << ", "
+        << std::showpos << std::setprecision( 1 ) << change << std::noshowpos << "%) "
+        << i->first << "\n"
+        ;
+    }
+  }
+
+  return regressions;
+}
+
+} // namespace RPGML
@@ -0,0 +1,193 @@
+/* This file is part of RPGML.
+ *
+ * Copyright (c) 2014, Gunnar Payer, All rights reserved.
+ *
+ * RPGML is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3.0 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.
+ */
+/*! @file Profiler.h
+ * @brief Per Node and frame timing of Graph execution
+ *
+ * When enabled, every execution of a Node records when it was scheduled,
+ * when it started and ended, on which thread, and how many bytes its
+ * changed Outputs hold. Like the Log, each thread appends to its own
+ * buffer without locking. The events are read only after the Graph is
+ * done, as a Chrome trace-event JSON file (chrome://tracing, Perfetto) and
+ * as a summary table per Node.
+ *
+ * For benchmarks, the first frames can be excluded as warmup, the end of
+ * each frame is recorded for the frame rate, and the allocations of each
+ * Node execution are taken from the AllocationCounter.
+ *
+ * When disabled, the Graph only tests isEnabled() per Node execution.
+ */
+#ifndef RPGML_Profiler_h
+#define RPGML_Profiler_h
+
+#include "Refcounted.h"
+#include "Atomic.h"
+#include "AllocationCounter.h"
+#include "Mutex.h"
+#include "Exception.h"
+
+#include <iosfwd>
+#include <vector>
+#include <string>
+#include <map>
+#include <stdint.h>
+
+namespace RPGML {
+
+class Node;
+
+class Profiler
+{
+private:
+  class Buffer;
+
+public:
+  EXCEPTION_BASE( Exception );
+
+  //! @brief The process wide Profiler, disabled by default
+  static Profiler &global( void );
+
+  static bool isEnabled( void ) { return s_enabled; }
+
+  //! @brief Must be called before the Graph is executed
+  void enable( bool enabled = true );
+
+  //! @brief Events of the first frames are not recorded
+  void setWarmup( uint64_t frames );
+  uint64_t getWarmup( void ) const { return m_warmup; }
+
+  //! @brief Monotonic time in nanoseconds
+  static int64_t now( void );
+
+  //! @brief Allocations counted on the calling thread so far
+  static uint64_t getAllocations( void ) { return AllocationCounter::getThreadAllocations(); }
+
+  //! @brief One execution of a Node
+  struct Event
+  {
+    const Node *node;
+    uint64_t frame;
+    int64_t scheduled; //!< now() when the Node was added to the JobQueue
+    int64_t begin;
+    int64_t end;
+    uint64_t bytes; //!< held by the Outputs that changed
+    uint64_t allocations;
+  };
+
+  /*! @brief Keeps node alive for the export, events refer to it by address
+   *
+   * Called for every Node of the Graph before it is executed.
+   */
+  void addNode( const Node *node );
+
+  //! @brief Appends to the buffer of the calling thread
+  void record( const Event &event );
+
+  /*! @brief Called when all Nodes of frame are done
+   *
+   * Frames are done one after another, never concurrently.
+   */
+  void recordFrame( uint64_t frame );
+
+  //! @brief Bytes held by the changed Outputs of node
+  static uint64_t getChangedOutputBytes( const Node *node );
+
+  /*! @brief Writes all events as Chrome trace-event JSON
+   *
+   * Must only be called while no Node is executed.
+   */
+  void writeTrace( std::ostream &o ) const;
+
+  /*! @brief Writes count, total, mean and p99 duration and the mean queue wait per Node
+   *
+   * Must only be called while no Node is executed.
+   */
+  void writeSummary( std::ostream &o ) const;
+
+  /*! @brief Mean duration per execution in nanoseconds, by Graph cost key
+   *
+   * Node identifiers contain paths and counters, see Graph::getCosts() for
+   * keys that stay valid across runs.
+   */
+  typedef std::map< std::string, int64_t > Costs;
+
+  //! @brief Mean duration per execution in nanoseconds, by Node
+  typedef std::map< const Node*, int64_t > NodeCosts;
+
+  //! @brief Must only be called while no Node is executed
+  void getNodeCosts( NodeCosts &costs ) const;
+
+  //! @brief One line "<ns> <key>" per Node, backslash and newline escaped
+  static void writeCosts( std::ostream &o, const Costs &costs );
+  static void readCosts( std::istream &i, Costs &costs );
+
+  //! @brief Measured frames after the warmup
+  struct Bench
+  {
+    Bench( void );
+
+    uint64_t frames;
+    double frames_per_second;
+    double allocations_per_frame;
+    int64_t peak_rss_kb;
+    std::map< std::string, double > node_us; //!< mean per execution, by Node identifier
+  };
+
+  //! @brief Must only be called while no Node is executed
+  void getBench( Bench &bench ) const;
+
+  /*! @brief CSV with the columns kind, name, value
+   *
+   * kind is "total" or "node", name is the metric or the Node identifier.
+   */
+  static void writeBench( std::ostream &o, const Bench &bench );
+  static void readBench( std::istream &i, Bench &bench );
+
+  /*! @brief Writes the differences to baseline and flags regressions
+   *
+   * A regression is a frame rate lower, or allocations or peak RSS higher
+   * by more than threshold_percent. Slower Nodes are listed but not counted.
+   * @return The number of regressions
+   */
+  static index_t compareBench( std::ostream &o, const Bench &bench, const Bench &baseline, double threshold_percent );
+
+private:
+  Profiler( void );
+  ~Profiler( void );
+  Profiler( const Profiler & );
+  Profiler &operator=( const Profiler & );
+
+  static bool s_enabled;
+  static __thread Buffer *s_thread_buffer;
+
+  Buffer *getThreadBuffer( void );
+
+  Atomic< Buffer* > m_buffers;
+  Atomic< index_t > m_num_buffers;
+  int64_t m_start;
+  uint64_t m_warmup;
+  uint64_t m_last_frame;
+  int64_t m_warmup_end; //!< end of the last warmup frame, or m_start
+  int64_t m_last_frame_end;
+
+  Mutex m_nodes_lock;
+  std::vector< CountPtr< const Node > > m_nodes;
+};
+
+} // namespace RPGML
+
+#endif
@@ -47,6 +47,18 @@ public:
     return --m_refCount;
   }
 
+  //! @brief Not thread-safe, for LocalCountPtr
+  refCount_t ref_local( void ) const
+  {
+    return m_refCount.add_unsynchronized( 1 );
+  }
+
+  //! @brief Not thread-safe, for LocalCountPtr
+  refCount_t unref_local( void ) const
+  {
+    return m_refCount.add_unsynchronized( -1 );
+  }
+
   refCount_t refCount( void ) const
   {
     return m_refCount;
@@ -194,6 +206,125 @@ private:
   RefcountedType *m_p;
 };
 
+/*! @brief CountPtr for objects used by only one thread at a time
+ *
+ * Counts with plain increments instead of atomic ones, which are full
+ * memory barriers. Only for objects no other thread references or
+ * unreferences meanwhile, e.g. the Frames of the interpreting thread or
+ * the Blocks of one Node execution. Can be mixed with CountPtrs to the same
+ * object on that thread.
+ */
+template< class _RefcountedType >
+class LocalCountPtr
+{
+public:
+  typedef _RefcountedType RefcountedType;
+
+  LocalCountPtr( void )
+  : m_p( 0 )
+  {}
+
+  template< class CompatibleRefcountedType >
+  LocalCountPtr( CompatibleRefcountedType *p )
+  : m_p( p )
+  {
+    if( m_p ) m_p->ref_local();
+  }
+
+  LocalCountPtr( const LocalCountPtr &other )
+  : m_p( other.get() )
+  {
+    if( m_p ) m_p->ref_local();
+  }
+
+  template< class CompatibleRefcountedType >
+  LocalCountPtr( const LocalCountPtr< CompatibleRefcountedType > &other )
+  : m_p( other.get() )
+  {
+    if( m_p ) m_p->ref_local();
+  }
+
+  template< class CompatibleRefcountedType >
+  LocalCountPtr( const CountPtr< CompatibleRefcountedType > &other )
+  : m_p( other.get() )
+  {
+    if( m_p ) m_p->ref_local();
+  }
+
+  ~LocalCountPtr( void )
+  {
+    clear();
+  }
+
+  void clear( void )
+  {
+    if( m_p )
+    {
+      if( !m_p->unref_local() ) delete m_p;
+      m_p = 0;
+    }
+  }
+
+  LocalCountPtr &operator=( const LocalCountPtr &cp )
+  {
+    LocalCountPtr tmp( cp );
+    this->swap( tmp );
+    return (*this);
+  }
+
+  template< class CompatibleRefcountedType >
+  LocalCountPtr &operator=( CompatibleRefcountedType *p )
+  {
+    return this->reset( p );
+  }
+
+  template< class CompatibleRefcountedType >
+  LocalCountPtr &reset( CompatibleRefcountedType *p )
+  {
+    LocalCountPtr tmp( p );
+    this->swap( tmp );
+    return (*this);
+  }
+
+  LocalCountPtr &reset( void )
+  {
+    return reset( (RefcountedType*)0 );
+  }
+
+  void swap( LocalCountPtr &cp )
+  {
+    std::swap( m_p, cp.m_p );
+  }
+
+  RefcountedType *get( void ) const
+  {
+    return m_p;
+  }
+
+  RefcountedType &operator*( void ) const
+  {
+    return *get();
+  }
+
+  RefcountedType *operator->( void ) const
+  {
+    return get();
+  }
+
+  operator RefcountedType*( void ) const
+  {
+    return get();
+  }
+
+  bool isNull( void ) const
+  {
+    return !get();
+  }
+
+private:
+  RefcountedType *m_p;
+};
+
 } // namespace RPGML
 
 namespace std {
@@ -22,6 +22,7 @@
 #include "ParseException.h"
 
 #include <ctype.h>
+#include <cstring>
 #include <iostream>
 
 namespace RPGML {
@@ -32,6 +33,7 @@ typedef _Parser::semantic_type semantic_type;
 Scanner::ScannerSource::ScannerSource( Source *source )
 : m_source( source )
 , m_chars( 0 )
+, m_sliceBegin( 0 )
 , m_pos( 0 )
 , m_prevChar( '\0' )
 , m_putBackChar( '\0' )
@@ -54,14 +56,47 @@ char Scanner::ScannerSource::next( location_type *loc )
 
   if( 0 == m_chars || '\0' == m_chars[ m_pos ] )
   {
+    if( m_sliceBegin )
+    {
+      // The chunk may be overwritten by the Source, keep the recorded part
+      m_sliceSpill.append( m_sliceBegin, m_chars + m_pos );
+    }
+
     m_chars = m_source->nextChars();
-    if( !m_chars ) return ( m_prevChar = '\0' );
     m_pos = 0;
+    if( m_sliceBegin ) m_sliceBegin = m_chars;
+    if( !m_chars ) return ( m_prevChar = '\0' );
   }
 
   return ( m_prevChar = m_chars[ m_pos++ ] );
 }
 
+void Scanner::ScannerSource::sliceBegin( void )
+{
+  // The char last returned by next() is always the one before m_pos
+  m_sliceSpill.clear();
+  m_sliceBegin = m_chars + m_pos - 1;
+}
+
+void Scanner::ScannerSource::sliceEnd( const char *&begin, size_t &length )
+{
+  const char *const end = ( m_chars && m_pos > 0 ? m_chars + m_pos - 1 : m_sliceBegin );
+
+  if( m_sliceSpill.empty() )
+  {
+    begin = m_sliceBegin;
+    length = size_t( end - m_sliceBegin );
+  }
+  else
+  {
+    if( m_sliceBegin ) m_sliceSpill.append( m_sliceBegin, end );
+    begin = m_sliceSpill.data();
+    length = m_sliceSpill.size();
+  }
+
+  m_sliceBegin = 0;
+}
+
 void Scanner::ScannerSource::putBackChar( void )
 {
   m_putBackChar = m_prevChar;
@@ -254,14 +289,13 @@ static
 int parse_identifier( char c, Scanner::ScannerSource *s, StringUnifier *u, semantic_type *token, location_type *loc )
 {
   s->tokenBegin( loc );
+  s->sliceBegin();
 
-  std::string str; str.reserve( 8 );
+  while( isalnum( c = s->next( loc ) ) || '_' == c ) {}
 
-  do
-  {
-    str += c;
-  }
-  while( isalnum( c = s->next( loc ) ) || '_' == c );
+  const char *str = 0;
+  size_t length = 0;
+  s->sliceEnd( str, length );
 
   s->putBackChar();
 
@@ -270,7 +304,7 @@ int parse_identifier( char c, Scanner::ScannerSource *s, StringUnifier *u, seman
   // Check for keywords
   for( const Keyword *i = keywords; i->token != _Parser::token::END; ++i )
   {
-    if( str == i->keyword )
+    if( i->keyword[ 0 ] == str[ 0 ] && 0 == ::strncmp( i->keyword, str, length ) && '\0' == i->keyword[ length ] )
     {
       if( i->type_enum )
       {
@@ -281,7 +315,7 @@ int parse_identifier( char c, Scanner::ScannerSource *s, StringUnifier *u, seman
   }
 
   // Not a keyword
-  token->str = u->unify_move( str );
+  token->str = u->unify( str, length );
   return _Parser::token::IDENTIFIER;
 }
 
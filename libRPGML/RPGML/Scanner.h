@@ -65,11 +65,23 @@ public:
     void tokenBegin( location_type *loc );
     void tokenEnd( location_type *loc );
 
+    //! @brief Starts recording the text of a token with the char last returned by next()
+    void sliceBegin( void );
+
+    /*! @brief Stops recording, the text ends before the char last returned by next()
+     *
+     * Points into the chunk of the Source, if the text does not cross a
+     * chunk boundary, otherwise into a copy. Valid until the next call to next().
+     */
+    void sliceEnd( const char *&begin, size_t &length );
+
   private:
     char trackLocation( char c, location_type *loc );
 
     CountPtr< Source > m_source;
     const char *m_chars;
+    const char *m_sliceBegin; // 0, if not recording
+    std::string m_sliceSpill; // text of the recorded token from previous chunks
     size_t m_pos;
     char m_prevChar;
     char m_putBackChar;
@@ -147,6 +147,7 @@ public:
 
 private:
   friend class EnterLeaveGuard;
+  friend class Bytecode;
 
   Scope( const Scope & );
   Scope &operator=( const Scope & );
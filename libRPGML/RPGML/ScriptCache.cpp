@@ -0,0 +1,1149 @@
+/* This file is part of RPGML.
+ * 
+ * Copyright (c) 2014, Gunnar Payer, All rights reserved.
+ * 
+ * RPGML is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3.0 of the License, or (at your option) any later version.
+ * 
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ * 
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.
+ */
+#include "ScriptCache.h"
+
+#include "AST.h"
+#include "Scope.h"
+#include "Context.h"
+#include "StringUnifier.h"
+#include "InterpretingParser.h"
+#include "FileSource.h"
+#include "BinaryStream.h"
+
+#include <map>
+#include <sstream>
+#include <iomanip>
+#include <cstring>
+#include <cstdlib>
+
+namespace RPGML {
+
+namespace ScriptCache_impl {
+
+using namespace AST;
+
+static const char     magic[ 8 ]  = { 'R', 'P', 'G', 'M', 'L', 'A', 'S', 'T' };
+static const uint32_t version     = 1;
+static const uint32_t byte_order  = 0x01020304;
+
+enum Tag
+{
+    T_NULL = 0
+  , T_CONSTANT
+  , T_THIS
+  , T_ARRAY_CONSTANT
+  , T_FRAME_CONSTANT
+  , T_PARENTHIS_SEQUENCE
+  , T_EXPRESSION_SEQUENCE
+  , T_FROM_TO_STEP_SEQUENCE
+  , T_LOOKUP_VARIABLE
+  , T_FUNCTION_CALL
+  , T_DOT
+  , T_FRAME_ACCESS
+  , T_ARRAY_ACCESS
+  , T_UNARY
+  , T_BINARY
+  , T_IF_THEN_ELSE
+  , T_TYPE
+  , T_DIMENSIONS
+  , T_CAST
+  , T_COMPOUND
+  , T_FUNCTION_DEFINITION
+  , T_CONNECT
+  , T_ASSIGN_IDENTIFIER
+  , T_ASSIGN_DOT
+  , T_ASSIGN_BRACKET
+  , T_IF
+  , T_NOP
+  , T_FOR_SEQUENCE
+  , T_FOR_CONTAINER
+  , T_EXPRESSION
+  , T_VARIABLE_CREATION
+  , T_VARIABLE_CONSTRUCTION
+  , T_RETURN
+};
+
+//! @brief Tags of the description arrays of ArrayConstantExpression
+enum ArrayTag
+{
+    A_SEQUENCES = 1
+  , A_ARRAYS
+};
+
+/*! @brief Serializes AST Nodes into a byte string
+ *
+ * Strings are written as indices into a table, so each identifier is
+ * stored and unified only once per entry.
+ */
+class Writer : public Visitor, public BinaryWriter
+{
+public:
+  Writer( void ) {}
+  virtual ~Writer( void ) {}
+
+  //! @brief 0 is the Null-String, otherwise 1 + index into the string table
+  virtual void put_string( const String &s )
+  {
+    if( !s.get() )
+    {
+      put_u32( 0 );
+      return;
+    }
+
+    const std::string str( s.get(), s.length() );
+    std::map< std::string, uint32_t >::const_iterator const found = m_string_index.find( str );
+    if( found != m_string_index.end() )
+    {
+      put_u32( found->second + 1 );
+      return;
+    }
+
+    const uint32_t index = uint32_t( m_strings.size() );
+    m_strings.push_back( s );
+    m_string_index.insert( std::make_pair( str, index ) );
+    put_u32( index + 1 );
+  }
+
+  void put_loc( const Location *loc )
+  {
+    if( !loc )
+    {
+      put_bool( false );
+      return;
+    }
+    put_bool( true );
+    put_string( loc->getFilename() );
+    put_i32( loc->getBegin().line );
+    put_i32( loc->getBegin().column );
+    put_i32( loc->getEnd().line );
+    put_i32( loc->getEnd().column );
+    put_loc( loc->getParent() );
+  }
+
+  void put_node( const AST::Node *node )
+  {
+    if( !node )
+    {
+      put_u8( T_NULL );
+      return;
+    }
+    node->invite( this );
+  }
+
+  void put_head( Tag tag, const AST::Node *node )
+  {
+    put_u8( uint8_t( tag ) );
+    put_loc( node->loc );
+  }
+
+  void put_descr_array( const ArrayBase *descr_array )
+  {
+    const ArrayConstantExpression::SequenceExpressionArray *sequences = 0;
+    const ArrayConstantExpression::ArrayBaseArray *arrays = 0;
+
+    if( descr_array->getAs( sequences ) )
+    {
+      put_u8( A_SEQUENCES );
+      put_size( size_t( sequences->size() ) );
+      for( index_t i = 0, end = sequences->size(); i < end; ++i )
+      {
+        put_node( sequences->at( i ) );
+      }
+    }
+    else if( descr_array->getAs( arrays ) )
+    {
+      put_u8( A_ARRAYS );
+      put_size( size_t( arrays->size() ) );
+      for( index_t i = 0, end = arrays->size(); i < end; ++i )
+      {
+        put_descr_array( arrays->at( i ) );
+      }
+    }
+    else
+    {
+      throw ScriptCache::Exception() << "Unexpected description array of ArrayConstantExpression";
+    }
+  }
+
+  virtual void visit( const ConstantExpression *node )
+  {
+    put_head( T_CONSTANT, node );
+    put_value( node->value );
+  }
+
+  virtual void visit( const ThisExpression *node )
+  {
+    put_head( T_THIS, node );
+  }
+
+  virtual void visit( const ArrayConstantExpression *node )
+  {
+    put_head( T_ARRAY_CONSTANT, node );
+    put_i32( node->dims );
+    put_descr_array( node->descr_array );
+  }
+
+  virtual void visit( const FrameConstantExpression *node )
+  {
+    put_head( T_FRAME_CONSTANT, node );
+    put_node( node->body );
+  }
+
+  virtual void visit( const ParenthisSequenceExpression *node )
+  {
+    put_head( T_PARENTHIS_SEQUENCE, node );
+    put_node( node->sequence );
+  }
+
+  virtual void visit( const ExpressionSequenceExpression *node )
+  {
+    put_head( T_EXPRESSION_SEQUENCE, node );
+    put_size( node->expressions.size() );
+    for( size_t i = 0; i < node->expressions.size(); ++i )
+    {
+      put_node( node->expressions[ i ] );
+    }
+  }
+
+  virtual void visit( const FromToStepSequenceExpression *node )
+  {
+    put_head( T_FROM_TO_STEP_SEQUENCE, node );
+    put_node( node->from );
+    put_node( node->to );
+    put_node( node->step );
+  }
+
+  virtual void visit( const LookupVariableExpression *node )
+  {
+    put_head( T_LOOKUP_VARIABLE, node );
+    put_string( node->identifier );
+    put_bool( node->at_root );
+  }
+
+  virtual void visit( const FunctionCallExpression *node )
+  {
+    put_head( T_FUNCTION_CALL, node );
+    put_node( node->function );
+    const FunctionCallExpression::Args *const args = node->args;
+    put_bool( 0 != args );
+    if( !args ) return;
+    put_size( size_t( args->size() ) );
+    for( index_t i = 0, end = args->size(); i < end; ++i )
+    {
+      const FunctionCallExpression::Arg *const arg = args->at( i );
+      put_loc( arg->loc );
+      put_node( arg->value );
+      put_string( arg->identifier );
+    }
+  }
+
+  virtual void visit( const DotExpression *node )
+  {
+    put_head( T_DOT, node );
+    put_node( node->left );
+    put_string( node->member );
+  }
+
+  virtual void visit( const FrameAccessExpression *node )
+  {
+    put_head( T_FRAME_ACCESS, node );
+    put_node( node->left );
+    put_string( node->identifier );
+  }
+
+  virtual void visit( const ArrayAccessExpression *node )
+  {
+    put_head( T_ARRAY_ACCESS, node );
+    put_node( node->left );
+    put_node( node->coord );
+  }
+
+  virtual void visit( const UnaryExpression *node )
+  {
+    put_head( T_UNARY, node );
+    put_i32( int32_t( node->op ) );
+    put_node( node->arg );
+  }
+
+  virtual void visit( const BinaryExpression *node )
+  {
+    put_head( T_BINARY, node );
+    put_i32( int32_t( node->op ) );
+    put_node( node->left );
+    put_node( node->right );
+  }
+
+  virtual void visit( const IfThenElseExpression *node )
+  {
+    put_head( T_IF_THEN_ELSE, node );
+    put_node( node->condition );
+    put_node( node->then_value );
+    put_node( node->else_value );
+  }
+
+  virtual void visit( const TypeExpression *node )
+  {
+    put_head( T_TYPE, node );
+    put_i32( int32_t( node->type.getEnum() ) );
+    put_node( node->of );
+    put_node( node->dims );
+  }
+
+  virtual void visit( const DimensionsExpression *node )
+  {
+    put_head( T_DIMENSIONS, node );
+    put_size( node->dims.size() );
+    for( size_t i = 0; i < node->dims.size(); ++i )
+    {
+      put_node( node->dims[ i ] );
+    }
+  }
+
+  virtual void visit( const CastExpression *node )
+  {
+    put_head( T_CAST, node );
+    put_i32( int32_t( node->to.getEnum() ) );
+    put_node( node->arg );
+  }
+
+  virtual void visit( const CompoundStatement *node )
+  {
+    put_head( T_COMPOUND, node );
+    put_bool( node->creates_own_frame );
+    put_size( node->statements.size() );
+    for( size_t i = 0; i < node->statements.size(); ++i )
+    {
+      put_node( node->statements[ i ] );
+    }
+  }
+
+  virtual void visit( const FunctionDefinitionStatement *node )
+  {
+    put_head( T_FUNCTION_DEFINITION, node );
+    put_node( node->ret );
+    put_string( node->identifier );
+    put_bool( node->is_method );
+    put_node( node->body );
+    const FunctionDefinitionStatement::ArgDeclList *const args = node->args;
+    put_bool( 0 != args );
+    if( !args ) return;
+    put_size( size_t( args->size() ) );
+    for( index_t i = 0, end = args->size(); i < end; ++i )
+    {
+      const FunctionDefinitionStatement::ArgDecl *const decl = args->at( i );
+      put_loc( decl->loc );
+      put_string( decl->identifier );
+      put_node( decl->default_value );
+    }
+  }
+
+  virtual void visit( const ConnectStatement *node )
+  {
+    put_head( T_CONNECT, node );
+    put_node( node->output );
+    put_node( node->input );
+  }
+
+  virtual void visit( const AssignIdentifierStatement *node )
+  {
+    put_head( T_ASSIGN_IDENTIFIER, node );
+    put_i32( int32_t( node->op ) );
+    put_node( node->value );
+    put_string( node->identifier );
+  }
+
+  virtual void visit( const AssignDotStatement *node )
+  {
+    put_head( T_ASSIGN_DOT, node );
+    put_i32( int32_t( node->op ) );
+    put_node( node->value );
+    put_node( node->left );
+    put_string( node->identifier );
+  }
+
+  virtual void visit( const AssignBracketStatement *node )
+  {
+    put_head( T_ASSIGN_BRACKET, node );
+    put_i32( int32_t( node->op ) );
+    put_node( node->value );
+    put_node( node->left );
+    put_node( node->coord );
+  }
+
+  virtual void visit( const IfStatement *node )
+  {
+    put_head( T_IF, node );
+    put_node( node->condition );
+    put_node( node->then_body );
+    put_node( node->else_body );
+  }
+
+  virtual void visit( const NOPStatement *node )
+  {
+    put_head( T_NOP, node );
+  }
+
+  virtual void visit( const ForSequenceStatement *node )
+  {
+    put_head( T_FOR_SEQUENCE, node );
+    put_string( node->identifier );
+    put_node( node->sequence );
+    put_node( node->body );
+  }
+
+  virtual void visit( const ForContainerStatement *node )
+  {
+    put_head( T_FOR_CONTAINER, node );
+    put_string( node->identifier );
+    put_node( node->container );
+    put_node( node->body );
+  }
+
+  virtual void visit( const ExpressionStatement *node )
+  {
+    put_head( T_EXPRESSION, node );
+    put_node( node->expr );
+  }
+
+  virtual void visit( const VariableCreationStatement *node )
+  {
+    put_head( T_VARIABLE_CREATION, node );
+    put_node( node->type );
+    put_string( node->identifier );
+    put_node( node->value );
+  }
+
+  virtual void visit( const VariableConstructionStatement *node )
+  {
+    put_head( T_VARIABLE_CONSTRUCTION, node );
+    put_string( node->identifier );
+    put_node( node->value );
+  }
+
+  virtual void visit( const ReturnStatement *node )
+  {
+    put_head( T_RETURN, node );
+    put_node( node->value );
+  }
+
+  //! @brief Appends the string table and then the output of body
+  void put_table_and_body( const Writer &body )
+  {
+    put_size( body.m_strings.size() );
+    for( size_t i = 0; i < body.m_strings.size(); ++i )
+    {
+      BinaryWriter::put_string( body.m_strings[ i ] );
+    }
+    put_raw( body.getOut().data(), body.getOut().size() );
+  }
+
+private:
+  std::vector< String > m_strings;
+  std::map< std::string, uint32_t > m_string_index;
+};
+
+/*! @brief Recreates AST Nodes written by Writer
+ *
+ * Throws on truncated or inconsistent entries.
+ */
+class Reader : public BinaryReader
+{
+public:
+  Reader( GarbageCollector *gc, StringUnifier *unifier, const std::string &in, size_t pos )
+  : BinaryReader( in, pos, unifier )
+  , m_gc( gc )
+  {}
+
+  void get_strings( void )
+  {
+    const size_t n = get_size();
+    m_strings.reserve( n );
+    for( size_t i = 0; i < n; ++i )
+    {
+      m_strings.push_back( BinaryReader::get_string() );
+    }
+  }
+
+  virtual String get_string( void )
+  {
+    const uint32_t index = get_u32();
+    if( 0 == index ) return String();
+    if( index > m_strings.size() )
+    {
+      throw ScriptCache::Exception() << "Invalid string index " << index;
+    }
+    return m_strings[ index-1 ];
+  }
+
+  CountPtr< const Location > get_loc( void )
+  {
+    if( !get_bool() ) return CountPtr< const Location >();
+    const String filename = get_string();
+    const int begin_line   = int( get_i32() );
+    const int begin_column = int( get_i32() );
+    const int end_line     = int( get_i32() );
+    const int end_column   = int( get_i32() );
+    const CountPtr< const Location > parent = get_loc();
+    return new Location( filename, begin_line, begin_column, end_line, end_column, parent );
+  }
+
+  template< class NodeType >
+  CountPtr< NodeType > get_node( void )
+  {
+    const CountPtr< AST::Node > node = get_any_node();
+    if( node.isNull() ) return CountPtr< NodeType >();
+    NodeType *const ret = dynamic_cast< NodeType* >( node.get() );
+    if( !ret )
+    {
+      throw ScriptCache::Exception() << "Unexpected AST Node in cache entry";
+    }
+    return ret;
+  }
+
+  CountPtr< const ArrayBase > get_descr_array( void )
+  {
+    const uint8_t tag = get_u8();
+    const size_t n = get_size();
+    if( A_SEQUENCES == tag )
+    {
+      CountPtr< ArrayConstantExpression::SequenceExpressionArray > ret =
+        new ArrayConstantExpression::SequenceExpressionArray( m_gc, 1 );
+      for( size_t i = 0; i < n; ++i )
+      {
+        ret->push_back( get_node< SequenceExpression >() );
+      }
+      return ret;
+    }
+    else if( A_ARRAYS == tag )
+    {
+      CountPtr< ArrayConstantExpression::ArrayBaseArray > ret =
+        new ArrayConstantExpression::ArrayBaseArray( m_gc, 1 );
+      for( size_t i = 0; i < n; ++i )
+      {
+        ret->push_back( get_descr_array() );
+      }
+      return ret;
+    }
+    throw ScriptCache::Exception() << "Invalid array description tag " << int( tag );
+  }
+
+  CountPtr< AST::Node > get_any_node( void )
+  {
+    const uint8_t tag = get_u8();
+    if( T_NULL == tag ) return CountPtr< AST::Node >();
+
+    GarbageCollector *const gc = m_gc;
+    const CountPtr< const Location > loc = get_loc();
+
+    switch( Tag( tag ) )
+    {
+      case T_CONSTANT:
+        {
+          const Value value = get_value();
+          return new ConstantExpression( gc, loc, value );
+        }
+
+      case T_THIS:
+        return new ThisExpression( gc, loc );
+
+      case T_ARRAY_CONSTANT:
+        {
+          const int dims = int( get_i32() );
+          const CountPtr< const ArrayBase > descr_array = get_descr_array();
+          return new ArrayConstantExpression( gc, loc, descr_array, dims );
+        }
+
+      case T_FRAME_CONSTANT:
+        {
+          const CountPtr< CompoundStatement > body = get_node< CompoundStatement >();
+          return new FrameConstantExpression( gc, loc, body );
+        }
+
+      case T_PARENTHIS_SEQUENCE:
+        {
+          const CountPtr< SequenceExpression > sequence = get_node< SequenceExpression >();
+          return new ParenthisSequenceExpression( gc, loc, sequence );
+        }
+
+      case T_EXPRESSION_SEQUENCE:
+        {
+          CountPtr< ExpressionSequenceExpression > ret = new ExpressionSequenceExpression( gc, loc );
+          const size_t n = get_size();
+          for( size_t i = 0; i < n; ++i )
+          {
+            ret->append( get_node< Expression >() );
+          }
+          return ret;
+        }
+
+      case T_FROM_TO_STEP_SEQUENCE:
+        {
+          const CountPtr< Expression > from = get_node< Expression >();
+          const CountPtr< Expression > to   = get_node< Expression >();
+          const CountPtr< Expression > step = get_node< Expression >();
+          return new FromToStepSequenceExpression( gc, loc, from, to, step );
+        }
+
+      case T_LOOKUP_VARIABLE:
+        {
+          const String identifier = get_string();
+          const bool at_root = get_bool();
+          return new LookupVariableExpression( gc, loc, identifier, at_root );
+        }
+
+      case T_FUNCTION_CALL:
+        {
+          const CountPtr< Expression > function = get_node< Expression >();
+          CountPtr< FunctionCallExpression::Args > args;
+          if( get_bool() )
+          {
+            args = new FunctionCallExpression::Args( gc );
+            const size_t n = get_size();
+            for( size_t i = 0; i < n; ++i )
+            {
+              const CountPtr< const Location > arg_loc = get_loc();
+              const CountPtr< Expression > value = get_node< Expression >();
+              const String identifier = get_string();
+              args->append( new FunctionCallExpression::Arg( gc, arg_loc, value, identifier ) );
+            }
+          }
+          return new FunctionCallExpression( gc, loc, function, args );
+        }
+
+      case T_DOT:
+        {
+          const CountPtr< Expression > left = get_node< Expression >();
+          const String member = get_string();
+          return new DotExpression( gc, loc, left, member );
+        }
+
+      case T_FRAME_ACCESS:
+        {
+          const CountPtr< Expression > left = get_node< Expression >();
+          const String identifier = get_string();
+          return new FrameAccessExpression( gc, loc, left, identifier );
+        }
+
+      case T_ARRAY_ACCESS:
+        {
+          const CountPtr< Expression > left = get_node< Expression >();
+          const CountPtr< CoordinatesExpression > coord = get_node< CoordinatesExpression >();
+          return new ArrayAccessExpression( gc, loc, left, coord );
+        }
+
+      case T_UNARY:
+        {
+          const UOP op = UOP( get_i32() );
+          const CountPtr< Expression > arg = get_node< Expression >();
+          return new UnaryExpression( gc, loc, op, arg );
+        }
+
+      case T_BINARY:
+        {
+          const BOP op = BOP( get_i32() );
+          const CountPtr< Expression > left  = get_node< Expression >();
+          const CountPtr< Expression > right = get_node< Expression >();
+          return new BinaryExpression( gc, loc, left, op, right );
+        }
+
+      case T_IF_THEN_ELSE:
+        {
+          const CountPtr< Expression > condition  = get_node< Expression >();
+          const CountPtr< Expression > then_value = get_node< Expression >();
+          const CountPtr< Expression > else_value = get_node< Expression >();
+          return new IfThenElseExpression( gc, loc, condition, then_value, else_value );
+        }
+
+      case T_TYPE:
+        {
+          const Type type = Type( Type::Enum( get_i32() ) );
+          const CountPtr< TypeExpression > of = get_node< TypeExpression >();
+          const CountPtr< DimensionsExpression > dims = get_node< DimensionsExpression >();
+          return new TypeExpression( gc, loc, type, of, dims );
+        }
+
+      case T_DIMENSIONS:
+        {
+          CountPtr< DimensionsExpression > ret = new DimensionsExpression( gc, loc );
+          const size_t n = get_size();
+          for( size_t i = 0; i < n; ++i )
+          {
+            ret->push_back( get_node< Expression >() );
+          }
+          return ret;
+        }
+
+      case T_CAST:
+        {
+          const Type to = Type( Type::Enum( get_i32() ) );
+          const CountPtr< Expression > arg = get_node< Expression >();
+          return new CastExpression( gc, loc, to, arg );
+        }
+
+      case T_COMPOUND:
+        {
+          CountPtr< CompoundStatement > ret = new CompoundStatement( gc, loc );
+          ret->creates_own_frame = get_bool();
+          const size_t n = get_size();
+          for( size_t i = 0; i < n; ++i )
+          {
+            ret->append( get_node< Statement >() );
+          }
+          return ret;
+        }
+
+      case T_FUNCTION_DEFINITION:
+        {
+          const CountPtr< TypeExpression > ret = get_node< TypeExpression >();
+          const String identifier = get_string();
+          const bool is_method = get_bool();
+          const CountPtr< CompoundStatement > body = get_node< CompoundStatement >();
+          CountPtr< FunctionDefinitionStatement::ArgDeclList > args;
+          if( get_bool() )
+          {
+            args = new FunctionDefinitionStatement::ArgDeclList( gc );
+            const size_t n = get_size();
+            for( size_t i = 0; i < n; ++i )
+            {
+              const CountPtr< const Location > decl_loc = get_loc();
+              const String decl_identifier = get_string();
+              const CountPtr< Expression > default_value = get_node< Expression >();
+              args->append( new FunctionDefinitionStatement::ArgDecl( gc, decl_loc, decl_identifier, default_value ) );
+            }
+          }
+          return new FunctionDefinitionStatement( gc, loc, ret, identifier, args, body, is_method );
+        }
+
+      case T_CONNECT:
+        {
+          const CountPtr< Expression > output = get_node< Expression >();
+          const CountPtr< Expression > input  = get_node< Expression >();
+          return new ConnectStatement( gc, loc, output, input );
+        }
+
+      case T_ASSIGN_IDENTIFIER:
+        {
+          const ASSIGN op = ASSIGN( get_i32() );
+          const CountPtr< Expression > value = get_node< Expression >();
+          const String identifier = get_string();
+          return new AssignIdentifierStatement( gc, loc, identifier, op, value );
+        }
+
+      case T_ASSIGN_DOT:
+        {
+          const ASSIGN op = ASSIGN( get_i32() );
+          const CountPtr< Expression > value = get_node< Expression >();
+          const CountPtr< Expression > left  = get_node< Expression >();
+          const String identifier = get_string();
+          return new AssignDotStatement( gc, loc, left, identifier, op, value );
+        }
+
+      case T_ASSIGN_BRACKET:
+        {
+          const ASSIGN op = ASSIGN( get_i32() );
+          const CountPtr< Expression > value = get_node< Expression >();
+          const CountPtr< Expression > left  = get_node< Expression >();
+          const CountPtr< CoordinatesExpression > coord = get_node< CoordinatesExpression >();
+          return new AssignBracketStatement( gc, loc, left, coord, op, value );
+        }
+
+      case T_IF:
+        {
+          const CountPtr< Expression > condition = get_node< Expression >();
+          const CountPtr< Statement > then_body = get_node< Statement >();
+          const CountPtr< Statement > else_body = get_node< Statement >();
+          return new IfStatement( gc, loc, condition, then_body, else_body );
+        }
+
+      case T_NOP:
+        return new NOPStatement( gc, loc );
+
+      case T_FOR_SEQUENCE:
+        {
+          const String identifier = get_string();
+          const CountPtr< SequenceExpression > sequence = get_node< SequenceExpression >();
+          const CountPtr< Statement > body = get_node< Statement >();
+          return new ForSequenceStatement( gc, loc, identifier, sequence, body );
+        }
+
+      case T_FOR_CONTAINER:
+        {
+          const String identifier = get_string();
+          const CountPtr< Expression > container = get_node< Expression >();
+          const CountPtr< Statement > body = get_node< Statement >();
+          return new ForContainerStatement( gc, loc, identifier, container, body );
+        }
+
+      case T_EXPRESSION:
+        {
+          const CountPtr< Expression > expr = get_node< Expression >();
+          return new ExpressionStatement( gc, loc, expr );
+        }
+
+      case T_VARIABLE_CREATION:
+        {
+          const CountPtr< TypeExpression > type = get_node< TypeExpression >();
+          const String identifier = get_string();
+          const CountPtr< Expression > value = get_node< Expression >();
+          return new VariableCreationStatement( gc, loc, type, identifier, value );
+        }
+
+      case T_VARIABLE_CONSTRUCTION:
+        {
+          const String identifier = get_string();
+          const CountPtr< FunctionCallExpression > value = get_node< FunctionCallExpression >();
+          return new VariableConstructionStatement( gc, loc, identifier, value );
+        }
+
+      case T_RETURN:
+        {
+          const CountPtr< Expression > value = get_node< Expression >();
+          return new ReturnStatement( gc, loc, value );
+        }
+
+      case T_NULL:
+      default:
+        throw ScriptCache::Exception() << "Invalid AST Node tag " << int( tag );
+    }
+  }
+
+private:
+  GarbageCollector *const m_gc;
+  std::vector< String > m_strings;
+};
+
+//! @brief Writes the header identifying script and its contents
+static
+void put_header( Writer &w, const String &script, const FileStamp &info, const std::string &source )
+{
+  w.put_raw( magic, sizeof( magic ) );
+  w.put_u32( version );
+  w.put_u32( byte_order );
+  w.put( info.size );
+  w.put( info.mtime_sec );
+  w.put( info.mtime_nsec );
+  w.put( BinaryWriter::hash( source.data(), source.size() ) );
+  w.put_size( script.length() );
+  w.put_raw( script.get(), script.length() );
+}
+
+static
+String canonical( const String &filename )
+{
+  char *const resolved = realpath( filename.c_str(), 0 );
+  if( !resolved ) return filename;
+  const String ret( resolved );
+  free( resolved );
+  return ret;
+}
+
+/*! @brief Serializes each top-level statement before interpreting it
+ *
+ * Statements are written as soon as they are parsed, so they do not have to
+ * be kept alive until the whole script is parsed.
+ */
+class RecordingParser : public InterpretingParser
+{
+public:
+  RecordingParser( GarbageCollector *_gc, Scope *scope, Source *source, Writer *writer )
+  : InterpretingParser( _gc, scope, source )
+  , m_writer( writer )
+  {}
+
+  virtual ~RecordingParser( void )
+  {}
+
+  virtual void append( const CountPtr< Statement > &statement )
+  {
+    if( m_writer )
+    {
+      try
+      {
+        m_writer->put_node( statement );
+      }
+      catch( const RPGML::Exception & )
+      {
+        // Not cacheable, but still valid
+        m_writer = 0;
+      }
+      catch( const char * )
+      {
+        m_writer = 0;
+      }
+    }
+    InterpretingParser::append( statement );
+  }
+
+  using InterpretingParser::error;
+
+  //! @brief Scripts with syntax errors are not cached, the errors must be reported again
+  virtual void error( const location &loc, const std::string &msg )
+  {
+    m_writer = 0;
+    InterpretingParser::error( loc, msg );
+  }
+
+  //! @brief Whether all statements were recorded
+  bool isComplete( void ) const
+  {
+    return 0 != m_writer;
+  }
+
+private:
+  Writer *m_writer;
+};
+
+/*! @brief Serializes each top-level statement without interpreting it
+ *
+ * Needs no Scope, used by ScriptCache::preparse(). Syntax errors are not
+ * reported, the script is parsed again when it is actually loaded.
+ */
+class PreparsingParser : public Parser
+{
+public:
+  PreparsingParser( GarbageCollector *_gc, StringUnifier *unifier, Source *source, Writer *writer )
+  : Parser( _gc, unifier, source )
+  , m_writer( writer )
+  {}
+
+  virtual ~PreparsingParser( void )
+  {}
+
+  virtual void append( const CountPtr< Statement > &statement )
+  {
+    if( !m_writer ) return;
+    try
+    {
+      m_writer->put_node( statement );
+    }
+    catch( const RPGML::Exception & )
+    {
+      m_writer = 0;
+    }
+    catch( const char * )
+    {
+      m_writer = 0;
+    }
+  }
+
+  using Parser::error;
+
+  virtual void error( const location &, const std::string & )
+  {
+    m_writer = 0;
+  }
+
+  bool isComplete( void ) const
+  {
+    return 0 != m_writer;
+  }
+
+private:
+  Writer *m_writer;
+};
+
+//! @brief Completes the entry of script from its recorded statements in body
+static
+void put_entry( Writer &entry, const String &script, const FileStamp &info, const std::string &source, Writer &body )
+{
+  body.put_u8( T_NULL );
+
+  Writer table_and_body;
+  table_and_body.put_table_and_body( body );
+  const std::string &rest = table_and_body.getOut();
+
+  put_header( entry, script, info, source );
+  entry.put( BinaryWriter::hash( rest.data(), rest.size() ) );
+  entry.put_raw( rest.data(), rest.size() );
+}
+
+} // namespace ScriptCache_impl
+
+using namespace ScriptCache_impl;
+
+ScriptCache::ScriptCache( const String &cache_dir )
+: m_cache_dir( cache_dir )
+{}
+
+ScriptCache::~ScriptCache( void )
+{}
+
+bool ScriptCache::isEnabled( void ) const
+{
+  return !m_cache_dir.empty();
+}
+
+String ScriptCache::getEntryFilename( const String &script ) const
+{
+  const String path = canonical( script );
+  std::ostringstream o;
+  o
+    << m_cache_dir << "/"
+    << std::hex << std::setw( 16 ) << std::setfill( '0' ) << BinaryWriter::hash( path.get(), path.length() )
+    << ".rpgmlc"
+    ;
+  return String( o.str() );
+}
+
+bool ScriptCache::interpretEntry( Scope *scope, const String &script, const FileStamp &info, const std::string &source, const std::string &entry )
+{
+  GarbageCollector *const gc = scope->getGC();
+
+  // The header must match byte by byte, the rest is covered by a hash
+  Writer expected;
+  put_header( expected, script, info, source );
+  const std::string &header = expected.getOut();
+  const size_t body_pos = header.size() + sizeof( uint64_t );
+
+  if(
+       entry.size() < body_pos
+    || 0 != entry.compare( 0, header.size(), header )
+    )
+  {
+    return false;
+  }
+
+  uint64_t body_hash = 0;
+  std::memcpy( &body_hash, entry.data() + header.size(), sizeof( body_hash ) );
+
+  if( body_hash != BinaryWriter::hash( entry.data() + body_pos, entry.size() - body_pos ) )
+  {
+    return false;
+  }
+
+  Reader r( gc, scope->getUnifier(), entry, body_pos );
+  r.get_strings();
+
+  CountPtr< InterpretingParser > parser = new InterpretingParser( gc, scope, 0 );
+  parser->setFilename( script );
+
+  for(;;)
+  {
+    const CountPtr< AST::Statement > statement = r.get_node< AST::Statement >();
+    if( statement.isNull() ) break;
+    parser->append( statement );
+  }
+
+  if( !r.atEnd() )
+  {
+    throw Exception() << "Trailing data in cache entry of '" << script << "'";
+  }
+  return true;
+}
+
+void ScriptCache::interpret( Scope *scope, const String &script, const std::string &source, const std::string *preloaded ) const
+{
+  GarbageCollector *const gc = scope->getGC();
+
+  FileStamp info;
+  const bool stamped = info.stat( script );
+
+  if( stamped && preloaded && interpretEntry( scope, script, info, source, *preloaded ) )
+  {
+    return;
+  }
+
+  const bool cached = isEnabled() && stamped;
+
+  if( cached )
+  {
+    std::string entry;
+    if(
+         BinaryReader::readFile( getEntryFilename( script ), entry )
+      && interpretEntry( scope, script, info, source, entry )
+      )
+    {
+      return;
+    }
+  }
+
+  Writer body;
+  CountPtr< Source > cstring_source = new CStringSource( source.c_str() );
+  CountPtr< RecordingParser > parser = new RecordingParser( gc, scope, cstring_source, ( cached ? &body : 0 ) );
+  parser->setFilename( script );
+  const int parse_result = parser->parse();
+
+  if( !cached || 0 != parse_result || !parser->isComplete() ) return;
+
+  Writer entry;
+  put_entry( entry, script, info, source, body );
+
+  // The cache is only an optimization, failing to write it is not an error
+  entry.writeFile( getEntryFilename( script ) );
+}
+
+bool ScriptCache::preparse( const String &script, std::string &entry )
+{
+  FileStamp info;
+  std::string source;
+  if( !info.stat( script ) || !BinaryReader::readFile( script, source ) ) return false;
+
+  // Independent of the Context, so scripts can be preparsed in parallel
+  CountPtr< GarbageCollector > gc = newGenerationalGarbageCollector();
+  CountPtr< StringUnifier > unifier = new StringUnifier();
+
+  Writer body;
+  try
+  {
+    CountPtr< Source > cstring_source = new CStringSource( source.c_str() );
+    PreparsingParser parser( gc, unifier, cstring_source, &body );
+    parser.setFilename( script );
+    if( 0 != parser.parse() || !parser.isComplete() ) return false;
+  }
+  catch( const RPGML::Exception & )
+  {
+    return false;
+  }
+  catch( const char * )
+  {
+    return false;
+  }
+
+  Writer w;
+  put_entry( w, script, info, source, body );
+  entry = w.getOut();
+  return true;
+}
+
+void ScriptCache::interpretFile( Scope *scope, const String &script, FILE *file )
+{
+  Context *const context = scope->getContext();
+  const ScriptCache cache( context->getCacheDir() );
+
+  std::string preloaded;
+  const bool has_preloaded = context->takePreloadedScript( script, preloaded );
+
+  if( !cache.isEnabled() && !has_preloaded )
+  {
+    CountPtr< Source > source = new FileSource( file );
+    CountPtr< InterpretingParser > parser = new InterpretingParser( scope->getGC(), scope, source );
+    parser->setFilename( script );
+    parser->parse();
+    return;
+  }
+
+  std::string contents;
+  if( !BinaryReader::readAll( file, contents ) )
+  {
+    throw Exception() << "Could not read file '" << script << "'";
+  }
+
+  cache.interpret( scope, script, contents, ( has_preloaded ? &preloaded : 0 ) );
+}
+
+} // namespace RPGML
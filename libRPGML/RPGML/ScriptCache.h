@@ -0,0 +1,91 @@
+/* This file is part of RPGML.
+ * 
+ * Copyright (c) 2014, Gunnar Payer, All rights reserved.
+ * 
+ * RPGML is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3.0 of the License, or (at your option) any later version.
+ * 
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ * 
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.
+ */
+/*! @file ScriptCache.h
+ * @brief Binary cache of parsed scripts
+ *
+ * Scanning and parsing the scripts a program loads dominates the startup
+ * time of short runs. The ScriptCache stores the top-level AST statements
+ * of a script in a binary file inside a cache directory. An entry is keyed
+ * by the path of the script and is only used, if size, modification time
+ * and a hash of the contents of the script still match. Loading an entry
+ * bypasses Scanner and Parser, the statements are interpreted as if they
+ * had just been parsed.
+ *
+ * preparse() creates the same entry in memory without a Scope, so the
+ * Context can preparse library scripts in parallel before they are loaded.
+ */
+#ifndef RPGML_ScriptCache_h
+#define RPGML_ScriptCache_h
+
+#include "String.h"
+
+#include <string>
+#include <cstdio>
+
+namespace RPGML {
+
+class Scope;
+struct FileStamp;
+
+class ScriptCache
+{
+public:
+  EXCEPTION_BASE( Exception );
+
+  //! @brief Empty cache_dir disables the cache
+  explicit
+  ScriptCache( const String &cache_dir );
+  ~ScriptCache( void );
+
+  bool isEnabled( void ) const;
+
+  //! @brief File of the cache entry for script
+  String getEntryFilename( const String &script ) const;
+
+  /*! @brief Interprets source, the contents of script, in scope
+   *
+   * Uses preloaded (an entry from preparse()) or the stored entry of script
+   * if it is up to date, otherwise parses source and stores a new entry.
+   * Failing to store is not an error.
+   */
+  void interpret( Scope *scope, const String &script, const std::string &source, const std::string *preloaded = 0 ) const;
+
+  /*! @brief Parses and interprets the script file in scope
+   *
+   * Uses the cache directory of the Context of scope, if set.
+   * Takes ownership of file.
+   */
+  static void interpretFile( Scope *scope, const String &script, FILE *file );
+
+  /*! @brief Scans and parses script into an entry, without interpreting it
+   *
+   * Thread-safe, uses its own GarbageCollector and StringUnifier.
+   * Returns false, if script cannot be read or has errors.
+   */
+  static bool preparse( const String &script, std::string &entry );
+
+private:
+  //! @brief Interprets entry, returns false if it does not match script and source
+  static bool interpretEntry( Scope *scope, const String &script, const FileStamp &info, const std::string &source, const std::string &entry );
+
+  String m_cache_dir;
+};
+
+} // namespace RPGML
+
+#endif
@@ -26,6 +26,19 @@
 
 namespace RPGML {
 
+namespace Semaphore_impl {
+
+  //! @brief Tells the CPU that this is a spin-wait loop
+  static inline
+  void cpu_relax( void )
+  {
+#if defined( __i386__ ) || defined( __x86_64__ )
+    __builtin_ia32_pause();
+#endif
+  }
+
+} // namespace Semaphore_impl
+
 EXCEPTION_DERIVED_DEFINE_FIXED_TEXT( Semaphore, ValueExceedsMax, "Semaphore value exceeds SEM_VALUE_MAX" );
 
 Semaphore::Semaphore( value_t initial_value )
@@ -61,6 +74,17 @@ void Semaphore::lock( void )
   while( -1 == sem_wait( &m_sem ) && EINTR == errno ) {}
 }
 
+unsigned int Semaphore::lock( unsigned int spins )
+{
+  for( unsigned int i=0; i<spins; ++i )
+  {
+    if( trylock() ) return i;
+    Semaphore_impl::cpu_relax();
+  }
+  lock();
+  return spins;
+}
+
 void Semaphore::unlock( void )
 {
   if( -1 == sem_post( &m_sem ) )
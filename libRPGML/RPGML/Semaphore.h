@@ -72,6 +72,15 @@ public:
    */
   void lock( void );
 
+  /*! @brief decrement the semaphore by 1, spinning before blocking
+   *
+   * Tries up to spins times without blocking, then blocks like lock().
+   * Spinning avoids the sleep and wakeup of the thread, when the value is
+   * incremented soon.
+   * @return The number of failed tries, spins if it blocked
+   */
+  unsigned int lock( unsigned int spins );
+
   /*! @brief increment the semaphore by 1
    *
    * This operation does not block, incrementing is always permitted
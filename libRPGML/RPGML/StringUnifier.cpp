@@ -17,6 +17,8 @@
  */
 #include "StringUnifier.h"
 
+#include "fnv1a.h"
+
 #include <iostream>
 #include <vector>
 
@@ -33,28 +35,44 @@ StringUnifier::~StringUnifier( void )
   clear();
 }
 
+StringUnifier::Key::Key( const char *_str, size_t _length )
+: str( _str )
+, length( _length )
+, hash( size_t( fnv1a( _str, _length ) ) )
+{}
+
+const StringUnifier::Unified *StringUnifier::insert( const Key &key, CountPtr< Unified > unified )
+{
+  // Same chars and hash, but owned by unified
+  Key stored( key );
+  stored.str = unified->get();
+  m_map.insert( map_t::value_type( stored, unified ) );
+  return unified;
+}
+
 const StringUnifier::Unified *StringUnifier::unify_impl( const char *c_in )
 {
-  const Unified *const ret1 = get( c_in );
-  if( ret1 ) return ret1;
+  return unify( c_in, ::strlen( c_in ) );
+}
+
+const StringUnifier::Unified *StringUnifier::unify( const char *begin, size_t length )
+{
+  const Key key( begin, length );
+  const map_t::const_iterator found = m_map.find( key );
+  if( found != m_map.end() ) return found->second;
 
-  CountPtr< Unified > ret2 = new Unified( this, c_in );
-  const char *const c_out = ret2->get();
-  m_map.insert( std::make_pair( c_out, ret2 ) );
-  return ret2;
+  return insert( key, new Unified( this, std::string( begin, length ) ) );
 }
 
 const StringUnifier::Unified *StringUnifier::unify_move( std::string &s )
 {
-  const char *const c_in = getCharPtr( s );
-  const Unified *const ret1 = get( c_in );
-  if( ret1 ) return ret1;
+  const Key key( s.c_str(), s.length() );
+  const map_t::const_iterator found = m_map.find( key );
+  if( found != m_map.end() ) return found->second;
 
-  CountPtr< Unified > ret2 = new Unified();
-  ret2->moveFrom( s );
-  const char *const c_out = ret2->get();
-  m_map.insert( std::make_pair( c_out, ret2 ) );
-  return ret2;
+  CountPtr< Unified > unified = new Unified( this );
+  unified->moveFrom( s );
+  return insert( key, unified );
 }
 
 void StringUnifier::clear( void )
@@ -92,7 +110,7 @@ void StringUnifier::cleanup( void )
 
 void StringUnifier::remove_impl( const char *s )
 {
-  m_map.erase( s );
+  m_map.erase( Key( s, ::strlen( s ) ) );
 }
 
 const char *StringUnifier::getCharPtr( const StringData *s )
@@ -117,7 +135,7 @@ const char *StringUnifier::getCharPtr( const std::string &s )
 
 const StringUnifier::Unified *StringUnifier::get_impl( const char *c_in )
 {
-  map_t::const_iterator found = m_map.find( c_in );
+  const map_t::const_iterator found = m_map.find( Key( c_in, ::strlen( c_in ) ) );
   if( found != m_map.end() )
   {
     return found->second;
@@ -142,8 +160,8 @@ StringUnifier::Unified::Unified( StringUnifier *unifier, const std::string &s )
 //  std::cerr << "create Unified " << (void*)this << std::endl;
 }
 
-StringUnifier::Unified::Unified( void )
-: m_unifier( 0 )
+StringUnifier::Unified::Unified( StringUnifier *unifier )
+: m_unifier( unifier )
 {
 //  std::cerr << "create Unified " << (void*)this << std::endl;
 }
@@ -21,7 +21,7 @@
 #include "Refcounted.h"
 #include "String.h"
 
-#include <map>
+#include <unordered_map>
 #include <cstring>
 #include <memory>
 
@@ -42,7 +42,7 @@ public:
     friend class StringUnifier;
     Unified( StringUnifier *unifier, const char *s );
     Unified( StringUnifier *unifier, const std::string &s );
-    Unified( void );
+    explicit Unified( StringUnifier *unifier );
   public:
     virtual ~Unified( void );
     virtual const void *getUnifier( void ) const;
@@ -58,6 +58,9 @@ public:
     return unify_impl( getCharPtr( s ) );
   }
 
+  //! @brief Unifies the length chars at begin, which need not be null-terminated
+  const Unified *unify( const char *begin, size_t length );
+
   const Unified *unify_move( std::string &s );
 
   template< class S >
@@ -82,16 +85,32 @@ private:
     return get_impl( getCharPtr( s ) );
   }
 
-  struct compare
+  //! @brief Refers to the chars of a string, the hash is computed once on construction
+  struct Key
+  {
+    Key( const char *_str, size_t _length );
+    const char *str;
+    size_t length;
+    size_t hash;
+  };
+
+  struct KeyHash
   {
-    inline
-    bool operator()( const char *x, const char *y )
+    size_t operator()( const Key &key ) const { return key.hash; }
+  };
+
+  struct KeyEqual
+  {
+    bool operator()( const Key &x, const Key &y ) const
     {
-      return 0 > ::strcmp( x, y );
+      return x.hash == y.hash && x.length == y.length && 0 == ::memcmp( x.str, y.str, x.length );
     }
   };
 
-  typedef std::map< const char*, CountPtr< Unified >, compare > map_t;
+  const Unified *insert( const Key &key, CountPtr< Unified > unified );
+
+  // Keys point into the chars of their Unified
+  typedef std::unordered_map< Key, CountPtr< Unified >, KeyHash, KeyEqual > map_t;
   map_t m_map;
 };
 
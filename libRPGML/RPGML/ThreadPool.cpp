@@ -17,6 +17,11 @@
  */
 #include "ThreadPool.h"
 
+#include "Profiler.h"
+#include "Affinity.h"
+
+#include <iostream>
+
 namespace RPGML {
 
 ThreadPool::ThreadPool( GarbageCollector *_gc, index_t num_threads )
@@ -26,8 +31,21 @@ ThreadPool::ThreadPool( GarbageCollector *_gc, index_t num_threads )
 {
   for( index_t i=0; i<num_threads; ++i )
   {
-    (*m_workers)[ i ] = new Worker( _gc, m_queue );
+    (*m_workers)[ i ] = new Worker( _gc, m_queue, -1 );
+  }
+  m_queue->setLengthGauge( Metrics::global().getJobQueueLength() );
+}
+
+ThreadPool::ThreadPool( GarbageCollector *_gc, const std::vector< int > &cpus )
+: Base( _gc )
+, m_workers( new WorkersArray( _gc, 1, index_t( cpus.size() ) ) )
+, m_queue( new JobQueue( _gc ) )
+{
+  for( index_t i=0; i<cpus.size(); ++i )
+  {
+    (*m_workers)[ i ] = new Worker( _gc, m_queue, cpus[ i ] );
   }
+  m_queue->setLengthGauge( Metrics::global().getJobQueueLength() );
 }
 
 ThreadPool::~ThreadPool( void )
@@ -86,9 +104,10 @@ size_t ThreadPool::EndWorker::doit( CountPtr< JobQueue > )
   return JobQueue::End;
 }
 
-ThreadPool::Worker::Worker( GarbageCollector *_gc, JobQueue *queue )
+ThreadPool::Worker::Worker( GarbageCollector *_gc, JobQueue *queue, int cpu )
 : Thread( _gc, false )
 , m_queue( queue )
+, m_cpu( cpu )
 {
   start();
 }
@@ -98,10 +117,26 @@ ThreadPool::Worker::~Worker( void )
 
 size_t ThreadPool::Worker::run( void )
 {
+  if( m_cpu >= 0 )
+  {
+    try
+    {
+      Affinity::pinCurrentThread( m_cpu );
+    }
+    catch( const Affinity::Exception &e )
+    {
+      std::cerr << "Warning: " << e.what() << std::endl;
+    }
+  }
+
   for(;;)
   {
+    const bool metrics = Metrics::isEnabled();
+    const int64_t waiting = ( metrics ? Profiler::now() : 0 );
     CountPtr< JobQueue::Job > job = m_queue->getJob();
+    const int64_t working = ( metrics ? Profiler::now() : 0 );
     const size_t ret = job->work( m_queue );
+    if( metrics ) Metrics::global().workerDone( working - waiting, Profiler::now() - working );
     if( JobQueue::End == ret ) return 0;
   }
 }
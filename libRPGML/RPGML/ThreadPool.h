@@ -23,6 +23,8 @@
 #include "GarbageCollector.h"
 #include "Array.h"
 
+#include <vector>
+
 namespace RPGML {
 
 class ThreadPool : public Collectable
@@ -34,6 +36,9 @@ public:
   explicit
   ThreadPool( GarbageCollector *_gc, index_t num_threads );
 
+  //! @brief Pins worker i to cpus[ i ], see Affinity::getCpus()
+  ThreadPool( GarbageCollector *_gc, const std::vector< int > &cpus );
+
   virtual ~ThreadPool( void );
 
   CountPtr< JobQueue > getQueue( void ) const;
@@ -58,8 +63,8 @@ private:
   {
     typedef Thread Base;
   public:
-    explicit
-    Worker( GarbageCollector *_gc, JobQueue *queue );
+    //! cpu -1 for no pinning
+    Worker( GarbageCollector *_gc, JobQueue *queue, int cpu );
 
     virtual ~Worker( void );
     virtual size_t run( void );
@@ -68,6 +73,7 @@ private:
 
   private:
     CountPtr< JobQueue > m_queue;
+    int m_cpu;
   };
 
   typedef Array< CountPtr< Worker > > WorkersArray;
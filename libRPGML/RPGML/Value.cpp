@@ -26,9 +26,12 @@
 #include "StringUnifier.h"
 #include "ParseException.h"
 #include "make_printable.h"
+#include "fnv1a.h"
 
 #include <sstream>
 #include <cmath>
+#include <cstring>
+#include <algorithm>
 
 namespace RPGML {
 
@@ -1330,6 +1333,17 @@ namespace Value_impl {
     return 1;
   }
 
+  template< class T >
+  static inline
+  size_t hash_bits( const T &x )
+  {
+    // -0.0 and 0.0 compare equal
+    if( x == T( 0 ) ) return 0;
+    size_t ret = 0;
+    ::memcpy( &ret, &x, std::min( sizeof( ret ), sizeof( x ) ) );
+    return ret;
+  }
+
 } // namespace Value_impl
 
 int Value::compare_exactly( const Value &other ) const
@@ -1367,6 +1381,31 @@ int Value::compare_exactly( const Value &other ) const
   }
 }
 
+size_t Value::hash_exactly( void ) const
+{
+  using namespace Value_impl;
+
+  const size_t type_hash = size_t( m_type.getEnum() ) * size_t( 0x9E3779B97F4A7C15ULL );
+
+  switch( m_type.getEnum() )
+  {
+    case Type::NIL     : return type_hash;
+    case Type::BOOL    : return type_hash ^ size_t( b );
+    case Type::UINT8   : return type_hash ^ size_t( ui8  );
+    case Type::INT8    : return type_hash ^ size_t(  i8  );
+    case Type::UINT16  : return type_hash ^ size_t( ui16 );
+    case Type::INT16   : return type_hash ^ size_t(  i16 );
+    case Type::UINT32  : return type_hash ^ size_t( ui32 );
+    case Type::INT32   : return type_hash ^ size_t(  i32 );
+    case Type::UINT64  : return type_hash ^ size_t( ui64 );
+    case Type::INT64   : return type_hash ^ size_t(  i64 );
+    case Type::FLOAT   : return type_hash ^ hash_bits( f );
+    case Type::DOUBLE  : return type_hash ^ hash_bits( d );
+    case Type::STRING  : return type_hash ^ size_t( fnv1a( str->get(), ::strlen( str->get() ) ) );
+    default: return type_hash ^ size_t( p );
+  }
+}
+
 std::ostream &Value::print_Type( std::ostream &o ) const
 {
   if( isArray() )
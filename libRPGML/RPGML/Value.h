@@ -101,6 +101,8 @@ public:
   Value operator% ( const Value &right ) const;
 
   int compare_exactly( const Value &other ) const;
+  //! @brief Consistent with compare_exactly(): equal Values have equal hashes
+  size_t hash_exactly( void ) const;
 
   void clear( void );
   void swap( Value &other );
@@ -60,5 +60,25 @@ void WaitLock::Token::wait( void )
   }
 }
 
+WaitLock::LocalToken::LocalToken( WaitLock *lock )
+: m_lock( lock )
+{
+  ++m_lock->m_num_waiting;
+}
+
+WaitLock::LocalToken::~LocalToken( void )
+{
+  wait();
+}
+
+void WaitLock::LocalToken::wait( unsigned int spins )
+{
+  if( m_lock )
+  {
+    m_lock->m_wait_sem.lock( spins );
+    m_lock = 0;
+  }
+}
+
 } // namespace RPGML
 
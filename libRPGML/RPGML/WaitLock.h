@@ -33,8 +33,25 @@ public:
 
   CountPtr< Token > getToken( void );
 
+  //! @brief Like Token, but without allocation, for waiting on the stack
+  class LocalToken
+  {
+  public:
+    //! @brief Must be constructed before done() can be called
+    explicit LocalToken( WaitLock *lock );
+    //! @brief Waits, if wait() was not called
+    ~LocalToken( void );
+    //! @brief Spins up to spins times before blocking
+    void wait( unsigned int spins = 0 );
+  private:
+    WaitLock *m_lock;
+    LocalToken( const LocalToken & );
+    LocalToken &operator=( const LocalToken & );
+  };
+
 protected:
   friend class Token;
+  friend class LocalToken;
   Semaphore m_wait_sem;
   Atomic< int > m_num_waiting;
 };
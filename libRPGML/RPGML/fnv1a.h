@@ -0,0 +1,41 @@
+/* This file is part of RPGML.
+ *
+ * Copyright (c) 2014, Gunnar Payer, All rights reserved.
+ *
+ * RPGML is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3.0 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.
+ */
+#ifndef RPGML_fnv1a_h
+#define RPGML_fnv1a_h
+
+#include <cstddef>
+#include <stdint.h>
+
+namespace RPGML {
+
+//! @brief 64 bit FNV-1a of the n chars at s, also stored in cache files, so it must never change
+static inline
+uint64_t fnv1a( const char *s, size_t n )
+{
+  uint64_t h = 14695981039346656037ULL;
+  for( size_t i = 0; i < n; ++i )
+  {
+    h ^= uint64_t( (unsigned char)s[ i ] );
+    h *= 1099511628211ULL;
+  }
+  return h;
+}
+
+} // namespace RPGML
+
+#endif
@@ -0,0 +1,118 @@
+/* This file is part of RPGML.
+ *
+ * Copyright (c) 2014, Gunnar Payer, All rights reserved.
+ *
+ * RPGML is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3.0 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.
+ */
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <RPGML/Frame.h>
+#include <RPGML/GarbageCollector.h>
+
+#include <iostream>
+
+using namespace RPGML;
+using namespace std;
+
+class utest_Frame : public CppUnit::TestFixture
+{
+  CPPUNIT_TEST_SUITE( utest_Frame );
+
+  CPPUNIT_TEST( test_shadowing );
+
+  CPPUNIT_TEST_SUITE_END();
+
+public:
+  void setUp() {}
+  void tearDown() {}
+
+  // Copies, so lookups cannot rely on pointer identity
+  static
+  int lookup( const Frame *frame, const char *identifier )
+  {
+    const Frame::ConstRef ref = frame->getVariable( String( identifier ).c_str() );
+    return ( ref.isNull() ? -1 : ref->getInt() );
+  }
+
+  void test_shadowing( void )
+  {
+    static const char *const names[] = { "a", "b", "c", "d", "e", "f", "g", "h", "i", "j" };
+    static const int num_names = int( sizeof( names ) / sizeof( names[ 0 ] ) );
+
+    CountPtr< GarbageCollector > gc( newGenerationalGarbageCollector() );
+    CountPtr< Frame > frame( new Frame( gc ) );
+
+    // Shadowed while still searched linearly
+    frame->push_back( String( "a" ), Value( int32_t( 100 ) ) );
+    frame->push_back( String( "a" ), Value( int32_t( 101 ) ) );
+    CPPUNIT_ASSERT_EQUAL( index_t( 1 ), frame->getIndex( "a" ) );
+    CPPUNIT_ASSERT_EQUAL( 101, lookup( frame, "a" ) );
+
+    // Grows beyond min_indexed_size, the shadowed "a" must be indexed as well
+    for( int i = 0; i < num_names; ++i )
+    {
+      frame->push_back( String( names[ i ] ), Value( int32_t( i ) ) );
+    }
+    CPPUNIT_ASSERT_EQUAL( index_t( num_names + 2 ), frame->getSize() );
+    for( int i = 0; i < num_names; ++i )
+    {
+      CPPUNIT_ASSERT_EQUAL( index_t( i + 2 ), frame->getIndex( names[ i ] ) );
+      CPPUNIT_ASSERT_EQUAL( i, lookup( frame, names[ i ] ) );
+    }
+    CPPUNIT_ASSERT_EQUAL( -1, lookup( frame, "k" ) );
+
+    // Shadow some of them again, also an identifier that was not there yet
+    frame->push_back( String( "d" ), Value( int32_t( 200 ) ) );
+    frame->push_back( String( "k" ), Value( int32_t( 201 ) ) );
+    frame->push_back( String( "d" ), Value( int32_t( 202 ) ) );
+    CPPUNIT_ASSERT_EQUAL( 202, lookup( frame, "d" ) );
+    CPPUNIT_ASSERT_EQUAL( 201, lookup( frame, "k" ) );
+
+    frame->pop_back();
+    CPPUNIT_ASSERT_EQUAL( 200, lookup( frame, "d" ) );
+    frame->pop_back();
+    CPPUNIT_ASSERT_EQUAL( -1, lookup( frame, "k" ) );
+    frame->pop_back();
+    CPPUNIT_ASSERT_EQUAL( 3, lookup( frame, "d" ) );
+    CPPUNIT_ASSERT_EQUAL( index_t( 5 ), frame->getIndex( "d" ) );
+
+    // set() writes the visible one
+    frame->set( String( "d" ), Value( int32_t( 300 ) ) );
+    CPPUNIT_ASSERT_EQUAL( index_t( num_names + 2 ), frame->getSize() );
+    CPPUNIT_ASSERT_EQUAL( 300, lookup( frame, "d" ) );
+
+    // Popping everything restores each shadowed entry down to the empty Frame
+    for( int i = num_names-1; i >= 0; --i )
+    {
+      frame->pop_back();
+      if( 0 == i )
+      {
+        CPPUNIT_ASSERT_EQUAL( 101, lookup( frame, "a" ) );
+      }
+      else
+      {
+        CPPUNIT_ASSERT_EQUAL( unknown, frame->getIndex( names[ i ] ) );
+      }
+    }
+    frame->pop_back();
+    CPPUNIT_ASSERT_EQUAL( 100, lookup( frame, "a" ) );
+    CPPUNIT_ASSERT_EQUAL( index_t( 0 ), frame->getIndex( "a" ) );
+    frame->pop_back();
+    CPPUNIT_ASSERT_EQUAL( unknown, frame->getIndex( "a" ) );
+    CPPUNIT_ASSERT_THROW( frame->pop_back(), Frame::Exception );
+  }
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION( utest_Frame );
+
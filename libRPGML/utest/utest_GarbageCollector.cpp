@@ -30,6 +30,8 @@ class utest_GarbageCollector : public CppUnit::TestFixture
 
   CPPUNIT_TEST( test_isCollectable );
   CPPUNIT_TEST( test_ring );
+  CPPUNIT_TEST( test_retainers );
+  CPPUNIT_TEST( test_LocalCountPtr );
 
   CPPUNIT_TEST_SUITE_END();
 
@@ -176,6 +178,119 @@ public:
     node1.clear();
     CPPUNIT_ASSERT_EQUAL( true, deleted1 );
   }
+
+  static index_t find( const std::vector< const Collectable* > &objects, const Collectable *c )
+  {
+    for( size_t i=0; i<objects.size(); ++i )
+    {
+      if( objects[ i ] == c ) return index_t( i );
+    }
+    return unknown;
+  }
+
+  void test_retainers( void )
+  {
+    CountPtr< GarbageCollector > gc( newGenerationalGarbageCollector() );
+
+    bool deleted1;
+    bool deleted2;
+    bool deleted3;
+    bool deleted4;
+
+    CountPtr< TestNode > node1( new TestNode( gc, &deleted1 ) ); // root
+    CountPtr< TestNode > node2( new TestNode( gc, &deleted2 ) );
+    CountPtr< TestNode > node3( new TestNode( gc, &deleted3 ) );
+    CountPtr< TestNode > node4( new TestNode( gc, &deleted4 ) ); // garbage
+
+    // 1 -> 2 -> 3 -> 1, 4 -> 3
+    node1->connectTo( node2 );
+    node2->connectTo( node3 );
+    node3->connectTo( node1 );
+    node4->connectTo( node3 );
+
+    const Collectable *const c1 = node1.get();
+    const Collectable *const c2 = node2.get();
+    const Collectable *const c3 = node3.get();
+    const Collectable *const c4 = node4.get();
+    node2.clear();
+    node3.clear();
+
+    std::vector< const Collectable* > objects;
+    std::vector< index_t > retainers;
+    gc->getRetainers( objects, retainers );
+
+    CPPUNIT_ASSERT_EQUAL( size_t( 4 ), objects.size() );
+    CPPUNIT_ASSERT_EQUAL( objects.size(), retainers.size() );
+
+    const index_t i1 = find( objects, c1 );
+    const index_t i2 = find( objects, c2 );
+    const index_t i3 = find( objects, c3 );
+    const index_t i4 = find( objects, c4 );
+
+    // node4 is referenced from outside, so it is a root, too
+    CPPUNIT_ASSERT_EQUAL( unknown, retainers[ i1 ] );
+    CPPUNIT_ASSERT_EQUAL( i1, retainers[ i2 ] );
+    CPPUNIT_ASSERT_EQUAL( i4, retainers[ i3 ] );
+    CPPUNIT_ASSERT_EQUAL( unknown, retainers[ i4 ] );
+
+    node4->disconnect();
+    node4.clear();
+    gc->getRetainers( objects, retainers );
+
+    CPPUNIT_ASSERT_EQUAL( size_t( 3 ), objects.size() );
+    CPPUNIT_ASSERT_EQUAL( find( objects, c2 ), retainers[ find( objects, c3 ) ] );
+
+    node1.clear();
+    gc->run();
+    CPPUNIT_ASSERT_EQUAL( true, deleted1 );
+    CPPUNIT_ASSERT_EQUAL( true, deleted2 );
+    CPPUNIT_ASSERT_EQUAL( true, deleted3 );
+    CPPUNIT_ASSERT_EQUAL( true, deleted4 );
+  }
+
+  void test_LocalCountPtr( void )
+  {
+    CountPtr< GarbageCollector > gc( newGenerationalGarbageCollector() );
+
+    bool deleted1;
+    bool deleted2;
+
+    // Last reference is a CountPtr
+    {
+      CountPtr< TestNode > node1( new TestNode( gc, &deleted1 ) );
+      CPPUNIT_ASSERT_EQUAL( refCount_t( 1 ), node1->refCount() );
+      {
+        LocalCountPtr< TestNode > local1( node1 );
+        CPPUNIT_ASSERT_EQUAL( refCount_t( 2 ), node1->refCount() );
+
+        LocalCountPtr< const TestNode > local2( local1 );
+        CPPUNIT_ASSERT_EQUAL( refCount_t( 3 ), node1->refCount() );
+
+        CountPtr< TestNode > node1_2( local1.get() );
+        CPPUNIT_ASSERT_EQUAL( refCount_t( 4 ), node1->refCount() );
+
+        local1.clear();
+        CPPUNIT_ASSERT_EQUAL( refCount_t( 3 ), node1->refCount() );
+        CPPUNIT_ASSERT( local2.get() == node1.get() );
+      }
+      CPPUNIT_ASSERT_EQUAL( refCount_t( 1 ), node1->refCount() );
+      CPPUNIT_ASSERT_EQUAL( false, deleted1 );
+    }
+    CPPUNIT_ASSERT_EQUAL( true, deleted1 );
+
+    // Last reference is a LocalCountPtr
+    {
+      LocalCountPtr< TestNode > local( new TestNode( gc, &deleted2 ) );
+      CPPUNIT_ASSERT_EQUAL( refCount_t( 1 ), local->refCount() );
+      {
+        CountPtr< TestNode > node2( local.get() );
+        CPPUNIT_ASSERT_EQUAL( refCount_t( 2 ), local->refCount() );
+      }
+      CPPUNIT_ASSERT_EQUAL( refCount_t( 1 ), local->refCount() );
+      CPPUNIT_ASSERT_EQUAL( false, deleted2 );
+    }
+    CPPUNIT_ASSERT_EQUAL( true, deleted2 );
+  }
 };
 
 CPPUNIT_TEST_SUITE_REGISTRATION( utest_GarbageCollector );
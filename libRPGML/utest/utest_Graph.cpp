@@ -18,8 +18,13 @@
 #include <cppunit/extensions/HelperMacros.h>
 
 #include <RPGML/Graph.h>
+#include <RPGML/Context.h>
+#include <RPGML/Scope.h>
+#include <RPGML/Function.h>
+#include <RPGML/StringUnifier.h>
 #include <RPGML/Thread.h>
 #include <RPGML/Array.h>
+#include <RPGML/Profiler.h>
 
 #include <iostream>
 
@@ -31,6 +36,10 @@ class utest_Graph : public CppUnit::TestFixture
   CPPUNIT_TEST_SUITE( utest_Graph );
 
   CPPUNIT_TEST( test_addNode );
+  CPPUNIT_TEST( test_prune );
+  CPPUNIT_TEST( test_merge );
+  CPPUNIT_TEST( test_foldConstants );
+  CPPUNIT_TEST( test_costs );
 
   CPPUNIT_TEST_SUITE_END();
 
@@ -60,6 +69,7 @@ public:
 
     virtual ~ConstNode( void ) {}
     virtual const char *getName( void ) const { return "ConstNode"; }
+    virtual bool isPure( void ) const { return true; }
 
     virtual bool tick( void )
     {
@@ -90,6 +100,7 @@ public:
 
     virtual ~AddNode( void ) {}
     virtual const char *getName( void ) const { return "AddNode"; }
+    virtual bool isPure( void ) const { return true; }
 
     virtual bool tick( void )
     {
@@ -112,6 +123,113 @@ public:
     }
   };
 
+  class ScaleNode : public Node
+  {
+  public:
+    ScaleNode(
+        GarbageCollector *_gc
+      , const String &identifier
+      )
+    : Node( _gc, identifier, 0, 1, 1, 1 )
+    , m_factor( 1 )
+    {
+      DEFINE_INPUT( 0, "in" );
+      DEFINE_OUTPUT_INIT( 0, "out", int, 0 );
+      DEFINE_PARAM( 0, "factor", ScaleNode::set_factor );
+    }
+
+    void set_factor( const Value &value, index_t, int, const index_t* )
+    {
+      CPPUNIT_ASSERT_NO_THROW( m_factor = value.getInt() );
+    }
+
+    virtual ~ScaleNode( void ) {}
+    virtual const char *getName( void ) const { return "ScaleNode"; }
+    virtual bool isPure( void ) const { return true; }
+
+    virtual bool tick( void )
+    {
+      const Array< int > *in = 0;
+      CPPUNIT_ASSERT( getInput( 0 )->isConnected() );
+      CPPUNIT_ASSERT( 0 != getInput( 0 )->getOutput()->getAs( in ) );
+
+      Array< int > *out = 0;
+      CPPUNIT_ASSERT( 0 != getOutput( 0 )->getAs( out ) );
+
+      (**out) = (**in) * m_factor;
+      return true;
+    }
+
+  private:
+    typedef NodeParam< ScaleNode > NParam;
+    int m_factor;
+  };
+
+  //! Stand-in for .core.ConstantArray, which Scope::toOutput() creates, only for scalar int
+  class ConstantArrayNode : public Node
+  {
+  public:
+    ConstantArrayNode(
+        GarbageCollector *_gc
+      , const String &identifier
+      )
+    : Node( _gc, identifier, 0, 0, 1, 3 )
+    , m_value( 0 )
+    {
+      DEFINE_OUTPUT_INIT( 0, "out", int, 0 );
+      DEFINE_PARAM( 0, "type", ConstantArrayNode::set_type );
+      DEFINE_PARAM( 1, "dims", ConstantArrayNode::set_dims );
+      DEFINE_PARAM_ARRAY( 2, "in", ConstantArrayNode::set_in );
+    }
+
+    void set_type( const Value &value, index_t, int, const index_t* )
+    {
+      CPPUNIT_ASSERT_EQUAL( std::string( "int32" ), std::string( value.getString().get() ) );
+    }
+
+    void set_dims( const Value &value, index_t, int, const index_t* )
+    {
+      CPPUNIT_ASSERT_EQUAL( 0, value.getInt() );
+    }
+
+    void set_in( const Value &value, index_t, int, const index_t* )
+    {
+      CPPUNIT_ASSERT_NO_THROW( m_value = value.getInt() );
+    }
+
+    virtual ~ConstantArrayNode( void ) {}
+    virtual const char *getName( void ) const { return "ConstantArray"; }
+    virtual bool isPure( void ) const { return true; }
+
+    virtual bool tick( void )
+    {
+      Array< int > *out = 0;
+      CPPUNIT_ASSERT( 0 != getOutput( 0 )->getAs( out ) );
+      (**out) = m_value;
+      return true;
+    }
+
+  private:
+    typedef NodeParam< ConstantArrayNode > NParam;
+    int m_value;
+  };
+
+  class CreateConstantArray : public Function
+  {
+  public:
+    CreateConstantArray( GarbageCollector *_gc, Frame *parent )
+    : Function( _gc, 0, parent, new Args() )
+    {}
+
+    virtual ~CreateConstantArray( void ) {}
+    virtual const char *getName( void ) const { return "ConstantArray"; }
+
+    virtual Value call_impl( const Location *, index_t, Scope *, index_t, const Value * )
+    {
+      return Value( new ConstantArrayNode( getGC(), String::Static( "ConstantArray" ) ) );
+    }
+  };
+
   class ExitNode : public Node
   {
   public:
@@ -225,6 +343,195 @@ public:
     for( index_t i=0; i<num_workers; ++i ) queue->addJob( end );
     for( index_t i=0; i<num_workers; ++i ) (*workers)[ i ]->join();
   }
+
+  void test_prune( void )
+  {
+    CountPtr< GarbageCollector > gc( newGenerationalGarbageCollector() );
+
+    CountPtr< ConstNode > c1( new ConstNode( gc, String::Static( "c1" ), 1 ) );
+    CountPtr< ConstNode > c2( new ConstNode( gc, String::Static( "c2" ), 2 ) );
+    CountPtr< AddNode   > add( new AddNode( gc, String::Static( "add" ) ) );
+    CountPtr< Identity  > id( new Identity( gc, String::Static( "id" ) ) );
+    CountPtr< ExitNode  > ex ( new ExitNode( gc ) );
+
+    c1->getOutput( "out" )->connect( add->getInput( "in1" ) );
+    c2->getOutput( "out" )->connect( add->getInput( "in2" ) );
+    c1->getOutput( "out" )->connect( id->getInput( "in" ) );
+
+    // add is pure and nothing observes it, id is pure, but needed
+    CountPtr< Graph > graph( new Graph( gc ) );
+    CPPUNIT_ASSERT_NO_THROW( graph->addNode( add ) );
+    CPPUNIT_ASSERT_NO_THROW( graph->addNode( id, true ) );
+    CPPUNIT_ASSERT_NO_THROW( graph->addNode( ex ) );
+    CPPUNIT_ASSERT_EQUAL( index_t( 5 ), graph->getNumNodes() );
+
+    CPPUNIT_ASSERT_EQUAL( index_t( 2 ), graph->prune() );
+    CPPUNIT_ASSERT_EQUAL( index_t( 3 ), graph->getNumNodes() );
+    CPPUNIT_ASSERT_EQUAL( false, graph->alreadyAdded( add ) );
+    CPPUNIT_ASSERT_EQUAL( false, graph->alreadyAdded( c2 ) );
+    CPPUNIT_ASSERT_EQUAL( true, graph->alreadyAdded( c1 ) );
+    CPPUNIT_ASSERT_EQUAL( true, graph->alreadyAdded( id ) );
+    CPPUNIT_ASSERT_EQUAL( true, graph->alreadyAdded( ex ) );
+
+    // Adding an already added Node as needed marks it
+    CPPUNIT_ASSERT_NO_THROW( graph->addNode( c1, true ) );
+    CPPUNIT_ASSERT_NO_THROW( graph->addNode( add ) );
+    CPPUNIT_ASSERT_EQUAL( index_t( 2 ), graph->prune() );
+    CPPUNIT_ASSERT_EQUAL( index_t( 3 ), graph->getNumNodes() );
+    CPPUNIT_ASSERT_EQUAL( index_t( 0 ), graph->prune() );
+  }
+
+  void test_merge( void )
+  {
+    CountPtr< GarbageCollector > gc( newGenerationalGarbageCollector() );
+
+    // Without Params, all ConstNodes would be equivalent, so there is only one
+    CountPtr< ConstNode > c( new ConstNode( gc, String::Static( "c" ), 1 ) );
+
+    // Identical
+    CountPtr< AddNode > add1( new AddNode( gc, String::Static( "add1" ) ) );
+    CountPtr< AddNode > add2( new AddNode( gc, String::Static( "add2" ) ) );
+    c->getOutput( "out" )->connect( add1->getInput( "in1" ) );
+    c->getOutput( "out" )->connect( add1->getInput( "in2" ) );
+    c->getOutput( "out" )->connect( add2->getInput( "in1" ) );
+    c->getOutput( "out" )->connect( add2->getInput( "in2" ) );
+
+    // Only the Param settings differ
+    CountPtr< ScaleNode > c_2( new ScaleNode( gc, String::Static( "c_2" ) ) );
+    CountPtr< ScaleNode > c_3( new ScaleNode( gc, String::Static( "c_3" ) ) );
+    c->getOutput( "out" )->connect( c_2->getInput( "in" ) );
+    c->getOutput( "out" )->connect( c_3->getInput( "in" ) );
+    CPPUNIT_ASSERT_NO_THROW( c_2->getParam( "factor" )->set( Value( 2 ) ) );
+    CPPUNIT_ASSERT_NO_THROW( c_3->getParam( "factor" )->set( Value( 3 ) ) );
+
+    // Identical, once add1 and add2 are merged, but only the Input connection differs from c_2
+    CountPtr< ScaleNode > add1_2( new ScaleNode( gc, String::Static( "add1_2" ) ) );
+    CountPtr< ScaleNode > add2_2( new ScaleNode( gc, String::Static( "add2_2" ) ) );
+    add1->getOutput( "out" )->connect( add1_2->getInput( "in" ) );
+    add2->getOutput( "out" )->connect( add2_2->getInput( "in" ) );
+    CPPUNIT_ASSERT_NO_THROW( add1_2->getParam( "factor" )->set( Value( 2 ) ) );
+    CPPUNIT_ASSERT_NO_THROW( add2_2->getParam( "factor" )->set( Value( 2 ) ) );
+
+    // A cycle
+    CountPtr< AddNode > x( new AddNode( gc, String::Static( "x" ) ) );
+    CountPtr< AddNode > y( new AddNode( gc, String::Static( "y" ) ) );
+    y->getOutput( "out" )->connect( x->getInput( "in1" ) );
+    x->getOutput( "out" )->connect( y->getInput( "in1" ) );
+    c->getOutput( "out" )->connect( x->getInput( "in2" ) );
+    c->getOutput( "out" )->connect( y->getInput( "in2" ) );
+
+    CountPtr< Graph > graph( new Graph( gc ) );
+    CPPUNIT_ASSERT_NO_THROW( graph->addNode( c_2 ) );
+    CPPUNIT_ASSERT_NO_THROW( graph->addNode( c_3 ) );
+    CPPUNIT_ASSERT_NO_THROW( graph->addNode( add1_2 ) );
+    CPPUNIT_ASSERT_NO_THROW( graph->addNode( add2_2 ) );
+    CPPUNIT_ASSERT_NO_THROW( graph->addNode( x ) );
+    CPPUNIT_ASSERT_EQUAL( index_t( 9 ), graph->getNumNodes() );
+
+    CPPUNIT_ASSERT_NO_THROW( graph->merge() );
+    CPPUNIT_ASSERT_EQUAL( index_t( 7 ), graph->getNumNodes() );
+
+    CPPUNIT_ASSERT_EQUAL( true, graph->alreadyAdded( c ) );
+    CPPUNIT_ASSERT( graph->alreadyAdded( add1 ) != graph->alreadyAdded( add2 ) );
+    CPPUNIT_ASSERT( graph->alreadyAdded( add1_2 ) != graph->alreadyAdded( add2_2 ) );
+    CPPUNIT_ASSERT_EQUAL( add1_2->getInput( "in" )->getOutput(), add2_2->getInput( "in" )->getOutput() );
+    CPPUNIT_ASSERT_EQUAL( true, graph->alreadyAdded( c_2 ) );
+    CPPUNIT_ASSERT_EQUAL( true, graph->alreadyAdded( c_3 ) );
+    CPPUNIT_ASSERT_EQUAL( true, graph->alreadyAdded( x ) );
+    CPPUNIT_ASSERT_EQUAL( true, graph->alreadyAdded( y ) );
+
+    // Nothing left to merge
+    CPPUNIT_ASSERT_NO_THROW( graph->merge() );
+    CPPUNIT_ASSERT_EQUAL( index_t( 7 ), graph->getNumNodes() );
+  }
+
+  void test_foldConstants( void )
+  {
+    CountPtr< GarbageCollector > gc( newGenerationalGarbageCollector() );
+
+    CountPtr< Context > context( new Context( gc, new StringUnifier(), String() ) );
+    CountPtr< Frame > core( new Frame( gc, context->getRoot() ) );
+    core->push_back( String::Static( "ConstantArray" ), Value( new CreateConstantArray( gc, core ) ) );
+    context->getRoot()->push_back( String::Static( "core" ), Value( core ) );
+    CountPtr< Scope > scope( new Scope( gc, context ) );
+
+    // c -> c_3 -> add -> sink, everything is constant, sinks are kept
+    CountPtr< ConstNode > c( new ConstNode( gc, String::Static( "c" ), 2 ) );
+    CountPtr< ScaleNode > c_3( new ScaleNode( gc, String::Static( "c_3" ) ) );
+    CountPtr< AddNode   > add( new AddNode( gc, String::Static( "add" ) ) );
+    CountPtr< ScaleNode > sink( new ScaleNode( gc, String::Static( "sink" ) ) );
+    c->getOutput( "out" )->connect( c_3->getInput( "in" ) );
+    CPPUNIT_ASSERT_NO_THROW( c_3->getParam( "factor" )->set( Value( 3 ) ) );
+    c_3->getOutput( "out" )->connect( add->getInput( "in1" ) );
+    c_3->getOutput( "out" )->connect( add->getInput( "in2" ) );
+    add->getOutput( "out" )->connect( sink->getInput( "in" ) );
+
+    CountPtr< Graph > graph( new Graph( gc ) );
+    CPPUNIT_ASSERT_NO_THROW( graph->addNode( sink, true ) );
+    CPPUNIT_ASSERT_EQUAL( index_t( 4 ), graph->getNumNodes() );
+
+    index_t num_folded = 0;
+    CPPUNIT_ASSERT_NO_THROW( num_folded = graph->foldConstants( scope ) );
+    CPPUNIT_ASSERT_EQUAL( index_t( 3 ), num_folded );
+
+    // sink and the ConstantArray replacing add
+    CPPUNIT_ASSERT_EQUAL( index_t( 2 ), graph->getNumNodes() );
+    CPPUNIT_ASSERT_EQUAL( true, graph->alreadyAdded( sink ) );
+    CPPUNIT_ASSERT_EQUAL( false, graph->alreadyAdded( add ) );
+
+    Node *const folded = sink->getInput( "in" )->getOutput()->getParent();
+    CPPUNIT_ASSERT_EQUAL( std::string( "ConstantArray" ), std::string( folded->getName() ) );
+    CPPUNIT_ASSERT_EQUAL( true, graph->alreadyAdded( folded ) );
+
+    const Array< int > *out = 0;
+    CPPUNIT_ASSERT( 0 != sink->getOutput( "out" )->getAs( out ) );
+    CPPUNIT_ASSERT_EQUAL( true, folded->tick() );
+    CPPUNIT_ASSERT_EQUAL( true, sink->tick() );
+    CPPUNIT_ASSERT_EQUAL( 12, (**out) );
+
+    // Nothing left to fold
+    CPPUNIT_ASSERT_EQUAL( index_t( 0 ), graph->foldConstants( scope ) );
+  }
+
+  void test_costs( void )
+  {
+    CountPtr< GarbageCollector > gc( newGenerationalGarbageCollector() );
+
+    // The same script run twice, only the Node counters in the identifiers differ
+    CountPtr< ConstNode > c1( new ConstNode( gc, String::Static( "c#1" ), 1 ) );
+    CountPtr< ScaleNode > s1( new ScaleNode( gc, String::Static( "s#2" ) ) );
+    c1->getOutput( "out" )->connect( s1->getInput( "in" ) );
+    CPPUNIT_ASSERT_NO_THROW( s1->getParam( "factor" )->set( Value( 2 ) ) );
+
+    CountPtr< ConstNode > c2( new ConstNode( gc, String::Static( "c#3" ), 1 ) );
+    CountPtr< ScaleNode > s2( new ScaleNode( gc, String::Static( "s#4" ) ) );
+    c2->getOutput( "out" )->connect( s2->getInput( "in" ) );
+    CPPUNIT_ASSERT_NO_THROW( s2->getParam( "factor" )->set( Value( 2 ) ) );
+
+    CountPtr< Graph > graph1( new Graph( gc ) );
+    CountPtr< Graph > graph2( new Graph( gc ) );
+    CPPUNIT_ASSERT_NO_THROW( graph1->addNode( s1, true ) );
+    CPPUNIT_ASSERT_NO_THROW( graph2->addNode( s2, true ) );
+
+    Profiler &profiler = Profiler::global();
+    Profiler::Event event = Profiler::Event();
+    event.frame = profiler.getWarmup() + 1;
+    event.node = c1;
+    event.end = 100;
+    profiler.record( event );
+    event.node = s1;
+    event.end = 300;
+    profiler.record( event );
+
+    Profiler::Costs costs;
+    CPPUNIT_ASSERT_NO_THROW( graph1->getCosts( profiler, costs ) );
+    CPPUNIT_ASSERT_EQUAL( size_t( 2 ), costs.size() );
+    CPPUNIT_ASSERT_EQUAL( index_t( 0 ), graph2->setCosts( costs ) );
+
+    // Another factor is another Node
+    CPPUNIT_ASSERT_NO_THROW( s2->getParam( "factor" )->set( Value( 3 ) ) );
+    CPPUNIT_ASSERT_EQUAL( index_t( 1 ), graph2->setCosts( costs ) );
+  }
 };
 
 CPPUNIT_TEST_SUITE_REGISTRATION( utest_Graph );
@@ -31,6 +31,7 @@ class utest_Node : public CppUnit::TestFixture
   CPPUNIT_TEST( test_Port );
   CPPUNIT_TEST( test_Input_Output );
   CPPUNIT_TEST( test_Output_Data );
+  CPPUNIT_TEST( test_tryGet );
 
   CPPUNIT_TEST_SUITE_END();
 
@@ -60,6 +61,28 @@ public:
     }
   };
 
+  class PortNode : public Node
+  {
+  public:
+    explicit
+    PortNode( GarbageCollector *_gc )
+    : Node( _gc, String::Static( "ports" ), 0, 2, 1, 1 )
+    {
+      DEFINE_INPUT( 0, "in" );
+      DEFINE_INPUT( 1, "in2" );
+      DEFINE_OUTPUT_INIT( 0, "out", int, 0 );
+      DEFINE_PARAM( 0, "p", PortNode::set_p );
+    }
+
+    virtual ~PortNode( void ) {}
+    virtual const char *getName( void ) const { return "PortNode"; }
+
+    void set_p( const Value &, index_t, int, const index_t* ) {}
+
+  private:
+    typedef NodeParam< PortNode > NParam;
+  };
+
   void test_Port( void )
   {
     CountPtr< GarbageCollector > gc( newGenerationalGarbageCollector() );
@@ -196,6 +219,53 @@ public:
     CPPUNIT_ASSERT_EQUAL( static_cast<       ArrayBase* >( data.get() ), out->getAs( base ) );
     CPPUNIT_ASSERT_EQUAL( static_cast< const ArrayBase* >( data.get() ), in->getOutput()->getAs( base_const ) );
   }
+
+  //! Lookup by identifier, node->getSize() decides whether its Frame is searched linearly or hashed
+  static
+  void check_tryGet( const Node *node )
+  {
+    index_t index = unknown;
+    CPPUNIT_ASSERT_EQUAL( node->getInput( 1 ), node->tryGetInput( "in2", &index ) );
+    CPPUNIT_ASSERT_EQUAL( index_t( 1 ), index );
+    CPPUNIT_ASSERT_EQUAL( node->getInput( 0 ), node->tryGetInput( "in" ) );
+    CPPUNIT_ASSERT_EQUAL( node->getOutput( 0 ), node->tryGetOutput( "out" ) );
+    CPPUNIT_ASSERT_EQUAL( node->getParam( 0 ), node->tryGetParam( "p" ) );
+
+    // Unknown names, and names of another kind of port, leave index untouched
+    index = 42;
+    CPPUNIT_ASSERT_EQUAL( (Input*)0, node->tryGetInput( "foo", &index ) );
+    CPPUNIT_ASSERT_EQUAL( (Output*)0, node->tryGetOutput( "foo", &index ) );
+    CPPUNIT_ASSERT_EQUAL( (Param*)0, node->tryGetParam( "foo", &index ) );
+    CPPUNIT_ASSERT_EQUAL( (Input*)0, node->tryGetInput( "out", &index ) );
+    CPPUNIT_ASSERT_EQUAL( (Output*)0, node->tryGetOutput( "p", &index ) );
+    CPPUNIT_ASSERT_EQUAL( (Param*)0, node->tryGetParam( "in", &index ) );
+    CPPUNIT_ASSERT_EQUAL( index_t( 42 ), index );
+
+    CPPUNIT_ASSERT_THROW( node->getInput( "foo" ), Node::InputNotFound );
+    CPPUNIT_ASSERT_THROW( node->getOutput( "foo" ), Node::OutputNotFound );
+    CPPUNIT_ASSERT_THROW( node->getParam( "foo" ), Node::ParamNotFound );
+  }
+
+  void test_tryGet( void )
+  {
+    CountPtr< GarbageCollector > gc( newGenerationalGarbageCollector() );
+    CountPtr< Node > node( new PortNode( gc ) );
+    check_tryGet( node );
+
+    // A variable hiding a port must not hide it from the port lookup
+    node->push_back( String( "out" ), Value( int32_t( 1 ) ) );
+    check_tryGet( node );
+
+    static const char *const names[] = { "a", "b", "c", "d", "e", "f", "g", "h" };
+    for( size_t i = 0; i < sizeof( names ) / sizeof( names[ 0 ] ); ++i )
+    {
+      node->push_back( String( names[ i ] ), Value( int32_t( i ) ) );
+    }
+    check_tryGet( node );
+
+    node->push_back( String( "in2" ), Value( int32_t( 2 ) ) );
+    check_tryGet( node );
+  }
 };
 
 CPPUNIT_TEST_SUITE_REGISTRATION( utest_Node );
@@ -0,0 +1,168 @@
+/* This file is part of RPGML.
+ *
+ * Copyright (c) 2014, Gunnar Payer, All rights reserved.
+ *
+ * RPGML is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3.0 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.
+ */
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <RPGML/ScriptCache.h>
+#include <RPGML/Context.h>
+#include <RPGML/Scope.h>
+#include <RPGML/StringUnifier.h>
+#include <RPGML/BinaryStream.h>
+
+#include <fstream>
+#include <string>
+#include <cstdio>
+#include <cstdlib>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+
+using namespace RPGML;
+using namespace std;
+
+class utest_ScriptCache : public CppUnit::TestFixture
+{
+  CPPUNIT_TEST_SUITE( utest_ScriptCache );
+
+  CPPUNIT_TEST( test_fallback );
+
+  CPPUNIT_TEST_SUITE_END();
+
+public:
+  void setUp()
+  {
+    char dir[] = "/tmp/utest_ScriptCache.XXXXXX";
+    CPPUNIT_ASSERT( 0 != mkdtemp( dir ) );
+    m_dir = dir;
+    m_script = m_dir + "/script.rpgml";
+    m_cache_dir = m_dir + "/cache";
+    CPPUNIT_ASSERT_EQUAL( 0, mkdir( m_cache_dir.c_str(), 0755 ) );
+  }
+
+  void tearDown()
+  {
+    const std::string cmd = "rm -rf '" + m_dir + "'";
+    CPPUNIT_ASSERT_EQUAL( 0, system( cmd.c_str() ) );
+  }
+
+  //! Interprets the script in a new Context and returns the value of a
+  int interpret( void )
+  {
+    CountPtr< GarbageCollector > gc( newGenerationalGarbageCollector() );
+    CountPtr< Context > context( new Context( gc, new StringUnifier(), String() ) );
+    context->setCacheDir( String( m_cache_dir ) );
+    CountPtr< Scope > scope( context->createScope() );
+
+    FILE *const file = fopen( m_script.c_str(), "r" );
+    CPPUNIT_ASSERT( 0 != file );
+    CPPUNIT_ASSERT_NO_THROW( ScriptCache::interpretFile( scope, String( m_script ), file ) );
+
+    const Frame::Ref a = scope->lookup( "a" );
+    CPPUNIT_ASSERT( !a.isNull() );
+    return a->getInt();
+  }
+
+  void writeScript( const char *source, long mtime )
+  {
+    {
+      std::ofstream out( m_script.c_str() );
+      out << source;
+    }
+    struct timeval times[ 2 ];
+    times[ 0 ].tv_sec = times[ 1 ].tv_sec = mtime;
+    times[ 0 ].tv_usec = times[ 1 ].tv_usec = 0;
+    CPPUNIT_ASSERT_EQUAL( 0, utimes( m_script.c_str(), times ) );
+  }
+
+  std::string readEntry( void ) const
+  {
+    std::string entry;
+    CPPUNIT_ASSERT( BinaryReader::readFile( ScriptCache( String( m_cache_dir ) ).getEntryFilename( String( m_script ) ), entry ) );
+    return entry;
+  }
+
+  void writeEntry( const std::string &entry ) const
+  {
+    const String filename = ScriptCache( String( m_cache_dir ) ).getEntryFilename( String( m_script ) );
+    std::ofstream out( filename.c_str(), std::ios::binary | std::ios::trunc );
+    out.write( entry.data(), std::streamsize( entry.size() ) );
+  }
+
+  void test_fallback( void )
+  {
+    writeScript( "int a = 23;\n", 1000000000 );
+    CPPUNIT_ASSERT_EQUAL( 23, interpret() );
+    const std::string entry = readEntry();
+
+    // Up to date entry is used and left as it is
+    CPPUNIT_ASSERT_EQUAL( 23, interpret() );
+    CPPUNIT_ASSERT( entry == readEntry() );
+
+    // Same stamp, other contents
+    writeScript( "int a = 42;\n", 1000000000 );
+    CPPUNIT_ASSERT_EQUAL( 42, interpret() );
+    CPPUNIT_ASSERT( entry != readEntry() );
+
+    writeScript( "int a = 23;\n", 1000000000 );
+    CPPUNIT_ASSERT_EQUAL( 23, interpret() );
+    CPPUNIT_ASSERT( entry == readEntry() );
+
+    // Other stamp, same contents: parsed again and stored with the new stamp
+    writeScript( "int a = 23;\n", 1000000001 );
+    CPPUNIT_ASSERT_EQUAL( 23, interpret() );
+    CPPUNIT_ASSERT( entry != readEntry() );
+
+    writeScript( "int a = 23;\n", 1000000000 );
+    CPPUNIT_ASSERT_EQUAL( 23, interpret() );
+    CPPUNIT_ASSERT( entry == readEntry() );
+
+    // The body hash follows the header, which ends with the script name
+    const size_t hash_pos = entry.rfind( m_script ) + m_script.size();
+    CPPUNIT_ASSERT( hash_pos + sizeof( uint64_t ) < entry.size() );
+
+    // Tampered body hash
+    std::string tampered = entry;
+    tampered[ hash_pos ] = char( tampered[ hash_pos ] ^ 1 );
+    writeEntry( tampered );
+    CPPUNIT_ASSERT_EQUAL( 23, interpret() );
+    CPPUNIT_ASSERT( entry == readEntry() );
+
+    // Tampered body
+    tampered = entry;
+    tampered[ entry.size()-1 ] = char( tampered[ entry.size()-1 ] ^ 1 );
+    writeEntry( tampered );
+    CPPUNIT_ASSERT_EQUAL( 23, interpret() );
+    CPPUNIT_ASSERT( entry == readEntry() );
+
+    // Tampered stamp in the header, stored as raw int64_t
+    const int64_t mtime_sec = 1000000000;
+    const size_t stamp_pos = entry.find( std::string( reinterpret_cast< const char* >( &mtime_sec ), sizeof( mtime_sec ) ) );
+    CPPUNIT_ASSERT( stamp_pos < hash_pos );
+    tampered = entry;
+    tampered[ stamp_pos ] = char( tampered[ stamp_pos ] ^ 1 );
+    writeEntry( tampered );
+    CPPUNIT_ASSERT_EQUAL( 23, interpret() );
+    CPPUNIT_ASSERT( entry == readEntry() );
+  }
+
+private:
+  std::string m_dir;
+  std::string m_script;
+  std::string m_cache_dir;
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION( utest_ScriptCache );
@@ -18,6 +18,7 @@
 #include <cppunit/extensions/HelperMacros.h>
 
 #include <RPGML/String.h>
+#include <RPGML/StringUnifier.h>
 
 #include <iostream>
 
@@ -32,6 +33,7 @@ class utest_String : public CppUnit::TestFixture
   CPPUNIT_TEST( test_MallocString );
   CPPUNIT_TEST( test_StdString );
   CPPUNIT_TEST( test_String );
+  CPPUNIT_TEST( test_StringUnifier );
 
   CPPUNIT_TEST_SUITE_END();
 
@@ -258,6 +260,55 @@ public:
       CPPUNIT_ASSERT_EQUAL( String::npos, ABC.find( 'a', 1 ) );
     }
   }
+
+  void test_StringUnifier( void )
+  {
+    CountPtr< StringUnifier > unifier( new StringUnifier() );
+
+    // Slices of a buffer that is not null-terminated after them
+    const char buf[] = { 'f', 'o', 'o', 'b', 'a', 'r', '!' };
+    const String foo = unifier->unify( buf, 3 );
+    const String bar = unifier->unify( buf+3, 3 );
+    CPPUNIT_ASSERT_EQUAL( size_t(3), foo.length() );
+    CPPUNIT_ASSERT_EQUAL( String( "foo" ), foo );
+    CPPUNIT_ASSERT_EQUAL( String( "bar" ), bar );
+    CPPUNIT_ASSERT_EQUAL( (const void*)unifier.get(), foo.getData()->getUnifier() );
+
+    // Same chars, same Unified, no matter how they were passed
+    CPPUNIT_ASSERT_EQUAL( foo.c_str(), unifier->unify( "foo" )->get() );
+    CPPUNIT_ASSERT_EQUAL( foo.c_str(), unifier->unify( std::string( "foo" ) )->get() );
+    CPPUNIT_ASSERT_EQUAL( foo.c_str(), unifier->unify( buf, 3 )->get() );
+    CPPUNIT_ASSERT( foo.c_str() != unifier->unify( buf, 2 )->get() );
+    CPPUNIT_ASSERT( foo.c_str() != unifier->unify( buf, 4 )->get() );
+    CPPUNIT_ASSERT_EQUAL( bar.c_str(), unifier->unify( "bar" )->get() );
+
+    // Empty slice
+    const String empty = unifier->unify( buf, 0 );
+    CPPUNIT_ASSERT_EQUAL( size_t(0), empty.length() );
+    CPPUNIT_ASSERT_EQUAL( empty.c_str(), unifier->unify( "" )->get() );
+
+    // unify_move() of known chars returns the existing Unified
+    {
+      std::string s( "bar" );
+      CPPUNIT_ASSERT_EQUAL( bar.c_str(), unifier->unify_move( s )->get() );
+    }
+
+    // unify_move() of new chars takes them over, with the unifier set
+    {
+      std::string s( "a string too long for any small string buffer" );
+      const char *const chars = s.c_str();
+      const String moved = unifier->unify_move( s );
+      CPPUNIT_ASSERT_EQUAL( String( "a string too long for any small string buffer" ), moved );
+      CPPUNIT_ASSERT_EQUAL( chars, moved.c_str() );
+      CPPUNIT_ASSERT_EQUAL( (const void*)unifier.get(), moved.getData()->getUnifier() );
+      CPPUNIT_ASSERT_EQUAL( moved.c_str(), unifier->unify( "a string too long for any small string buffer" )->get() );
+    }
+
+    // clear() detaches the Unified still referenced
+    unifier->clear();
+    CPPUNIT_ASSERT_EQUAL( (const void*)0, foo.getData()->getUnifier() );
+    CPPUNIT_ASSERT( foo.c_str() != unifier->unify( "foo" )->get() );
+  }
 };
 
 CPPUNIT_TEST_SUITE_REGISTRATION( utest_String );
@@ -23,10 +23,18 @@
 #include <RPGML/JobQueue.h>
 #include <RPGML/Thread.h>
 #include <RPGML/Graph.h>
+#include <RPGML/Log.h>
+#include <RPGML/Profiler.h>
+#include <RPGML/Metrics.h>
+#include <RPGML/AllocationCounter.h>
+#include <RPGML/AllocationTracker.h>
 #include <RPGML/Frame.h>
 #include <RPGML/FileSource.h>
 #include <RPGML/InterpretingParser.h>
+#include <RPGML/ScriptCache.h>
+#include <RPGML/GraphSnapshot.h>
 #include <RPGML/ThreadPool.h>
+#include <RPGML/Affinity.h>
 #include <RPGML/Guard.h>
 #include <RPGML/make_printable.h>
 
@@ -38,6 +46,8 @@
 #include <cstring>
 #include <cstdio>
 #include <cstdlib>
+#include <fstream>
+#include <new>
 #include <unistd.h>
 
 // RPGML_CXXFLAGS=
@@ -45,6 +55,22 @@
 
 using namespace RPGML;
 
+// Counts the allocations of each Node execution for --bench and --profile,
+// and the allocated bytes for --metrics,
+// the default operator new[] and the sized and nothrow variants call these
+void *operator new( size_t size )
+{
+  AllocationCounter::count( size );
+  void *const p = ::malloc( size ? size : 1 );
+  if( !p ) throw std::bad_alloc();
+  return p;
+}
+
+void operator delete( void *p ) noexcept
+{
+  ::free( p );
+}
+
 class ReadlineSource : public Source
 {
 public:
@@ -93,7 +119,26 @@ static CountPtr< GarbageCollector > gc( newGenerationalGarbageCollector( 5 ) );
 
 static const char *rpgml_file = 0;
 static int         num_threads = -1;
+static std::string affinity;
 static std::string searchPath;
+static std::string cacheDir;
+static std::string saveGraph;
+static std::string loadGraph;
+static std::string profileFile;
+static std::string loadCosts;
+static std::string saveCosts;
+static std::string benchFile;
+static std::string baselineFile;
+static double      threshold = 10;
+static std::string metricsTarget;
+static double      metricsInterval = 1;
+static std::string allocReport;
+static long        frames = 0;
+static long        warmup = 0;
+static bool        fold_constants = true;
+static bool        compile = true;
+static bool        preload = false;
+static bool        verbose = false;
 static CountPtr< StringArray > rpgml_argv;
 
 static
@@ -102,10 +147,32 @@ void parse_argv( int argc, char **argv )
   static struct option long_options[] =
   {
     { "num_threads", 1, 0, 'j' },
+    { "affinity"   , 1, 0, 'a' },
     { "path"       , 1, 0, 'p' },
+    { "log_flush"  , 1, 0, 'F' },
+    { "log_rate"   , 1, 0, 'R' },
+    { "no_fold"    , 0, 0, 'N' },
+    { "no_compile" , 0, 0, 'I' },
+    { "cache_dir"  , 1, 0, 'C' },
+    { "save_graph" , 1, 0, 'S' },
+    { "load_graph" , 1, 0, 'L' },
+    { "preload"    , 0, 0, 'P' },
+    { "profile"    , 1, 0, 'T' },
+    { "costs"      , 1, 0, 'c' },
+    { "save_costs" , 1, 0, 's' },
+    { "frames"     , 1, 0, 'f' },
+    { "warmup"     , 1, 0, 'w' },
+    { "bench"      , 1, 0, 'b' },
+    { "baseline"   , 1, 0, 'B' },
+    { "threshold"  , 1, 0, 't' },
+    { "metrics"    , 1, 0, 'M' },
+    { "metrics_interval", 1, 0, 'm' },
+    { "alloc_report", 1, 0, 'A' },
+    { "backtrace"  , 0, 0, 'D' },
+    { "verbose"    , 0, 0, 'v' },
     { 0            , 0, 0, 0   }
   };
-  static const char *options = "j:p:";
+  static const char *options = "j:a:p:F:R:NIC:S:L:PT:c:s:f:w:b:B:t:M:m:A:Dv";
 
   int c = 0;
   int option_index = 0;
@@ -124,11 +191,132 @@ void parse_argv( int argc, char **argv )
         }
         break;
 
+      case 'a':
+        affinity = optarg;
+        break;
+
       case 'p':
         if( !searchPath.empty() ) searchPath += ":";
         searchPath += optarg;
         break;
 
+      case 'F':
+        Log::global().setFlushPolicy( Log::parseFlushPolicy( optarg ) );
+        break;
+
+      case 'R':
+        {
+          const int log_rate = atoi( optarg );
+          if( log_rate < 0 )
+          {
+            throw Exception()
+              << "Option --log_rate must not be negative, is " << log_rate
+              ;
+          }
+          Log::global().setRateLimit( size_t( log_rate ) );
+        }
+        break;
+
+      case 'N':
+        fold_constants = false;
+        break;
+
+      case 'I':
+        compile = false;
+        break;
+
+      case 'C':
+        cacheDir = optarg;
+        break;
+
+      case 'S':
+        saveGraph = optarg;
+        break;
+
+      case 'L':
+        loadGraph = optarg;
+        break;
+
+      case 'P':
+        preload = true;
+        break;
+
+      case 'T':
+        profileFile = optarg;
+        break;
+
+      case 'c':
+        loadCosts = optarg;
+        break;
+
+      case 's':
+        saveCosts = optarg;
+        break;
+
+      case 'f':
+        frames = atol( optarg );
+        if( frames < 1 )
+        {
+          throw Exception()
+            << "Option --frames must be greater than 0, is " << frames
+            ;
+        }
+        break;
+
+      case 'w':
+        warmup = atol( optarg );
+        if( warmup < 0 )
+        {
+          throw Exception()
+            << "Option --warmup must not be negative, is " << warmup
+            ;
+        }
+        break;
+
+      case 'b':
+        benchFile = optarg;
+        break;
+
+      case 'B':
+        baselineFile = optarg;
+        break;
+
+      case 't':
+        threshold = atof( optarg );
+        if( threshold < 0 )
+        {
+          throw Exception()
+            << "Option --threshold must not be negative, is " << threshold
+            ;
+        }
+        break;
+
+      case 'M':
+        metricsTarget = optarg;
+        break;
+
+      case 'm':
+        metricsInterval = atof( optarg );
+        if( !( metricsInterval > 0 ) )
+        {
+          throw Exception()
+            << "Option --metrics_interval must be greater than 0, is " << metricsInterval
+            ;
+        }
+        break;
+
+      case 'A':
+        allocReport = optarg;
+        break;
+
+      case 'D':
+        Backtrace::setEnabled();
+        break;
+
+      case 'v':
+        verbose = true;
+        break;
+
       case '?':
       case ':':
       default:
@@ -167,6 +355,12 @@ int main( int argc, char **argv )
       searchPath = ".";
     }
 
+    if( cacheDir.empty() )
+    {
+      const char *cacheDir_env = getenv( "RPGML_CACHE_DIR" );
+      if( cacheDir_env ) cacheDir = cacheDir_env;
+    }
+
     if( num_threads < 1 )
     {
       const char *num_threads_env = getenv( "RPGML_NUM_THREADS" );
@@ -174,57 +368,239 @@ int main( int argc, char **argv )
       if( num_threads < 1 ) num_threads = 1;
     }
 
-    CountPtr< Source > source;
-    String filename;
+    if( affinity.empty() )
+    {
+      const char *affinity_env = getenv( "RPGML_AFFINITY" );
+      if( affinity_env ) affinity = affinity_env;
+    }
 
-    if( rpgml_file )
+    std::vector< int > cpus;
+    Affinity::getCpus( affinity, index_t( num_threads ), cpus );
+
+    CountPtr< ThreadPool > pool;
+    if( cpus.empty() )
     {
-      filename = rpgml_file;
-      FILE *file = fopen( filename, "r" );
-      if( !file )
+      pool = new ThreadPool( gc, index_t( num_threads ) );
+    }
+    else
+    {
+      pool = new ThreadPool( gc, cpus );
+      if( verbose )
       {
-        throw Exception() << "Could not open file '" << filename << "': " << strerror( errno );
+        std::cerr << "ThreadPool: Pinned " << cpus.size() << " workers to CPUs";
+        for( size_t i = 0; i < cpus.size(); ++i ) std::cerr << " " << cpus[ i ];
+        std::cerr << " on " << Affinity::getNumNodes() << " NUMA node(s)" << std::endl;
       }
-      source = new FileSource( file );
     }
-    else
+
+    if( !metricsTarget.empty() )
+    {
+      Metrics::global().enable();
+      Metrics::global().startExporter( metricsTarget, metricsInterval );
+      if( verbose ) std::cerr << "Metrics: Exporting to '" << metricsTarget << "' every " << metricsInterval << " s" << std::endl;
+    }
+
+    // Growth per frame while executing, the retention report at the end
+    std::ofstream allocReportOut;
+    if( !allocReport.empty() )
     {
-      filename = "stdin";
-//      source = new FileSource( stdin );
-      source = new ReadlineSource;
+      allocReportOut.open( allocReport.c_str() );
+      if( !allocReportOut ) throw Exception() << "Could not open file '" << allocReport << "': " << strerror( errno );
+      AllocationTracker::global().setGrowthReport( &allocReportOut );
+      AllocationTracker::global().enable();
     }
 
-    CountPtr< StringUnifier > unifier = new StringUnifier();
-    CountPtr< Context > context = new Context( gc, unifier, searchPath );
-    CountPtr< Scope > scope = context->createScope();
+    CountPtr< Context > context;
+    CountPtr< Graph > graph;
+
+    if( !loadGraph.empty() )
+    {
+      // Merged, folded and pruned before it was saved
+      graph = GraphSnapshot::load( gc, String( loadGraph ) );
+      if( verbose ) std::cerr << "Graph: Loaded " << graph->getNumNodes() << " Nodes from '" << loadGraph << "'" << std::endl;
+    }
+    else
+    {
+      CountPtr< StringUnifier > unifier = new StringUnifier();
+      context = new Context( gc, unifier, searchPath );
+      context->setCacheDir( cacheDir );
+      context->setCompile( compile );
+
+      if( preload )
+      {
+        const index_t num_preloaded = context->preload( pool );
+        if( verbose ) std::cerr << "Context: Preloaded " << num_preloaded << " scripts and plugins" << std::endl;
+      }
+
+      CountPtr< Scope > scope = context->createScope();
 
-    scope->create( String::Static( "argc" ), Value( int( rpgml_argv->size() ) ) );
-    scope->create( String::Static( "argv" ), Value( rpgml_argv ) );
+      scope->create( String::Static( "argc" ), Value( int( rpgml_argv->size() ) ) );
+      scope->create( String::Static( "argv" ), Value( rpgml_argv ) );
 
-    CountPtr< InterpretingParser >  parser = new InterpretingParser( gc, scope, source );
-    parser->setFilename( filename );
+      if( rpgml_file )
+      {
+        const String filename = rpgml_file;
+        FILE *file = fopen( filename, "r" );
+        if( !file )
+        {
+          throw Exception() << "Could not open file '" << filename << "': " << strerror( errno );
+        }
+        ScriptCache::interpretFile( scope, filename, file );
+      }
+      else
+      {
+//        source = new FileSource( stdin );
+        CountPtr< Source > source = new ReadlineSource;
+        CountPtr< InterpretingParser >  parser = new InterpretingParser( gc, scope, source );
+        parser->setFilename( String::Static( "stdin" ) );
 
-    parser->parse();
+        parser->parse();
+      }
 
-//    std::cerr << "Parsing done." << std::endl;
+//      std::cerr << "Parsing done." << std::endl;
 
-    parser.reset();
-    source.reset();
-    scope.reset();
+      scope.reset();
 
-    gc->run();
+      gc->run();
 
-    CountPtr< Graph > graph = context->createGraph();
-    if( graph->empty() ) return 0;
+      graph = context->createGraph();
+      if( graph->empty() ) return 0;
+
+      graph->merge();
+      gc->run();
+      if( verbose ) std::cerr << "Graph: " << graph->getNumNodes() << " Nodes after merging" << std::endl;
+
+      if( fold_constants )
+      {
+        const index_t num_folded = graph->foldConstants( context->createScope() );
+        gc->run();
+        if( verbose ) std::cerr << "Graph: Folded " << num_folded << " constant Nodes" << std::endl;
+      }
+
+      index_t pruned_elements = 0;
+      const index_t num_pruned = graph->prune( &pruned_elements );
+      gc->run();
+      if( verbose )
+      {
+        std::cerr
+          << "Graph: Pruned " << num_pruned << " unobservable Nodes"
+          << ", about " << pruned_elements << " Output elements per frame"
+          << std::endl
+          ;
+      }
+    }
+
+    if( !saveGraph.empty() )
+    {
+      GraphSnapshot::save( graph, String( saveGraph ) );
+      if( verbose ) std::cerr << "Graph: Saved " << graph->getNumNodes() << " Nodes to '" << saveGraph << "'" << std::endl;
+    }
 
-    graph->merge();
-    gc->run();
+    if( verbose ) std::cerr << "Graph: Executing " << graph->getNumNodes() << " Nodes" << std::endl;
+    if( graph->empty() ) return 0;
 
-    CountPtr< ThreadPool > pool = new ThreadPool( gc, num_threads );
     CountPtr< JobQueue > main_thread_queue = new JobQueue( gc );
 
+    if( !loadCosts.empty() )
+    {
+      std::ifstream in( loadCosts.c_str() );
+      if( !in ) throw Exception() << "Could not open file '" << loadCosts << "': " << strerror( errno );
+      Profiler::Costs costs;
+      Profiler::readCosts( in, costs );
+      const index_t num_missing = graph->setCosts( costs );
+      if( num_missing > 0 )
+      {
+        std::cerr
+          << "warning: " << num_missing << " of " << graph->getNumNodes() << " Nodes have no cost in '" << loadCosts << "'"
+          << ", they count 1ns, was it saved for a different script?"
+          << std::endl
+          ;
+      }
+      if( verbose ) std::cerr << "Graph: Scheduling by " << costs.size() << " Node costs from '" << loadCosts << "'" << std::endl;
+    }
+
+    // --frames counts the frames after the warmup
+    if( frames > 0 ) graph->setFrameLimit( uint64_t( warmup + frames ) );
+
+    const bool reporting = !profileFile.empty() || !saveCosts.empty();
+    const bool benchmarking = !benchFile.empty() || !baselineFile.empty();
+    const bool profiling = reporting || benchmarking;
+    if( profiling )
+    {
+      Profiler::global().setWarmup( uint64_t( warmup ) );
+      Profiler::global().enable();
+    }
+
     graph->execute( pool->getQueue() );
 
+    if( !metricsTarget.empty() )
+    {
+      Metrics::global().stopExporter();
+    }
+
+    if( !allocReport.empty() )
+    {
+      AllocationTracker::global().setGrowthReport( 0 );
+      AllocationTracker::global().writeReport( allocReportOut, gc );
+      if( verbose ) std::cerr << "AllocationTracker: Wrote report to '" << allocReport << "'" << std::endl;
+    }
+
+    if( profiling )
+    {
+      if( !profileFile.empty() )
+      {
+        std::ofstream trace( profileFile.c_str() );
+        if( !trace ) throw Exception() << "Could not open file '" << profileFile << "': " << strerror( errno );
+        Profiler::global().writeTrace( trace );
+        if( verbose ) std::cerr << "Profiler: Wrote trace to '" << profileFile << "'" << std::endl;
+      }
+
+      Profiler::Costs costs;
+      graph->getCosts( Profiler::global(), costs );
+      if( reporting )
+      {
+        Profiler::global().writeSummary( std::cerr );
+        graph->writeCriticalPath( std::cerr, costs, index_t( num_threads ) );
+      }
+
+      if( !saveCosts.empty() )
+      {
+        std::ofstream out( saveCosts.c_str() );
+        if( !out ) throw Exception() << "Could not open file '" << saveCosts << "': " << strerror( errno );
+        Profiler::writeCosts( out, costs );
+        if( verbose ) std::cerr << "Profiler: Wrote " << costs.size() << " Node costs to '" << saveCosts << "'" << std::endl;
+      }
+
+      if( benchmarking )
+      {
+        Profiler::Bench bench;
+        Profiler::global().getBench( bench );
+
+        if( !benchFile.empty() )
+        {
+          std::ofstream out( benchFile.c_str() );
+          if( !out ) throw Exception() << "Could not open file '" << benchFile << "': " << strerror( errno );
+          Profiler::writeBench( out, bench );
+          if( verbose ) std::cerr << "Profiler: Wrote benchmark of " << bench.frames << " frames to '" << benchFile << "'" << std::endl;
+        }
+
+        if( !baselineFile.empty() )
+        {
+          std::ifstream in( baselineFile.c_str() );
+          if( !in ) throw Exception() << "Could not open file '" << baselineFile << "': " << strerror( errno );
+          Profiler::Bench baseline;
+          Profiler::readBench( in, baseline );
+
+          const index_t regressions = Profiler::compareBench( std::cerr, bench, baseline, threshold );
+          if( regressions > 0 )
+          {
+            std::cerr << regressions << " regressions against '" << baselineFile << "'" << std::endl;
+            return -1;
+          }
+        }
+      }
+    }
+
     if( graph->hasErrors() )
     {
       graph->printErrors( std::cerr );
@@ -237,8 +613,9 @@ int main( int argc, char **argv )
   }
   catch( const RPGML::Exception &e )
   {
+    // Only captured with --backtrace or RPGML_BACKTRACE
+    if( !e.getBacktrace().empty() ) std::cerr << e.getBacktrace() << "\n";
     std::cerr
-//      << e.getBacktrace() << "\n"
       << e.what()
       << std::endl
       ;
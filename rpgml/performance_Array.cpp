@@ -1,11 +1,41 @@
+/* This file is part of RPGML.
+ *
+ * Copyright (c) 2014, Gunnar Payer, All rights reserved.
+ *
+ * RPGML is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3.0 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.
+ */
+/*! @file performance_Array.cpp
+ * @brief Micro-benchmarks of the Array layer
+ *
+ * Every test is repeated until it took at least the minimum time, given in
+ * milliseconds as the only argument (default 200). Results are written per
+ * element type as ns/element and GB/s, where the bytes are those read plus
+ * those written. Tests with a fixed cost per call (copy(), resize_v())
+ * report ns/op instead.
+ */
 #include <RPGML/Array.h>
-//#include <RPGML/Array2.h>
+#include <RPGML/String.h>
+#include <RPGML/Value.h>
+#include "../ROOT/core/RPGML_Block.h"
 
 #include <cstdlib>
 #include <ctime>
 #include <cerrno>
 #include <algorithm>
 #include <iostream>
+#include <iomanip>
+#include <vector>
 
 // RPGML_LDFLAGS =
 // RPGML_CXXFLAGS =-O3 -DNDEBUG
@@ -13,9 +43,114 @@
 using namespace RPGML;
 using namespace std;
 
-template< class A >
+static uint64_t min_ns = 200000000;
+
+// Results are added here, so that no test can be optimized away
+static volatile double sink = 0;
+
 static
-void access_random( A &a, int dims )
+uint64_t getNanoSeconds( void )
+{
+  struct timespec tp;
+  if( -1 == clock_gettime( CLOCK_THREAD_CPUTIME_ID, &tp ) )
+  {
+    switch( errno )
+    {
+      case EFAULT: throw Exception() << "tp points outside the accessible address space";
+      case EINVAL: throw Exception() << "The clk_id specified is not supported on this system";
+      default    : throw Exception() << "clock_gettime failed for some reason";
+    }
+  }
+
+  return uint64_t( tp.tv_sec ) * 1000000000ull + uint64_t( tp.tv_nsec );
+}
+
+//! elements 0 means per call, bytes 0 means no throughput
+static
+void report( const char *test, const char *type, uint64_t repetitions, uint64_t ns, double elements, double bytes )
+{
+  const double ns_per_rep = double( ns ) / double( repetitions );
+
+  cout
+    << left << setw( 28 ) << test << setw( 10 ) << type << right
+    << fixed << setprecision( 3 )
+    << setw( 12 ) << ( elements > 0 ? ns_per_rep / elements : ns_per_rep )
+    << ( elements > 0 ? " ns/element" : " ns/op     " )
+    ;
+  if( bytes > 0 )
+  {
+    cout << setw( 10 ) << bytes / ns_per_rep << " GB/s";
+  }
+  cout << endl;
+}
+
+//! Runs STATEMENT once to warm up, then repeatedly for at least min_ns
+#define MEASURE( TEST, ELEMENTS, BYTES, STATEMENT ) \
+  do \
+  { \
+    STATEMENT; \
+    uint64_t repetitions = 0; \
+    const uint64_t t1 = getNanoSeconds(); \
+    uint64_t t2 = t1; \
+    do \
+    { \
+      STATEMENT; \
+      ++repetitions; \
+      t2 = getNanoSeconds(); \
+    } \
+    while( t2 - t1 < min_ns ); \
+    report( TEST, type_name, repetitions, t2 - t1, ELEMENTS, BYTES ); \
+  } \
+  while( 0 )
+
+template< class T > static double element_bytes( void ) { return double( sizeof( T ) ); }
+template<> double element_bytes< bool >( void ) { return 1.0 / 8.0; } // one bit each
+
+template< class T >
+static
+double sum( const Array< T > &a )
+{
+  double s = 0;
+  for( typename Array< T >::const_iterator i( a.begin() ), end( a.end() ); i != end; ++i )
+  {
+    s += double( *i );
+  }
+  return s;
+}
+
+//! getValue_v() boxes every element into a Value
+template< class T >
+static
+double sum_values( const Array< T > &a )
+{
+  double s = 0;
+  index_t x[ 2 ];
+  for( x[ 1 ] = 0; x[ 1 ] < a.getSizeY(); ++x[ 1 ] )
+  for( x[ 0 ] = 0; x[ 0 ] < a.getSizeX(); ++x[ 0 ] )
+  {
+    const Value v = a.getValue_v( 2, x );
+    if( !v.isNil() ) s += 1;
+  }
+  return s;
+}
+
+template< class T >
+static
+double drain( core::Block< T > *block, vector< T > &buffer )
+{
+  CountPtr< core::Block< T > > guard( block );
+  double s = 0;
+  index_t n = 0;
+  while( block->next( n, index_t( buffer.size() ), &buffer[ 0 ] ) )
+  {
+    s += double( buffer[ 0 ] );
+  }
+  return s;
+}
+
+template< class T >
+static
+void access_random( Array< T > &a, int dims, index_t swaps )
 {
   unsigned int seed = 0;
 
@@ -32,60 +167,168 @@ void access_random( A &a, int dims )
     }
   }
 
-  for( int i=0; i<10000000; ++i )
+  for( index_t i=0; i<swaps; ++i )
   {
     swap( a.at_v( dims, x1[ i % 8 ] ), a.at_v( dims, x2[ i % 8 ] ) );
   }
 }
 
+//! Alternates between two sizes, so that every call reallocates
+template< class T >
 static
-uint64_t getNanoSeconds( void )
+void resize_churn( Array< T > &a )
 {
-  struct timespec tp;
-  if( -1 == clock_gettime( CLOCK_THREAD_CPUTIME_ID, &tp ) )
+  static const index_t s1[ 2 ] = { 64, 64 };
+  static const index_t s2[ 2 ] = { 128, 96 };
+  a.resize_v( 2, ( a.getSizeX() == s1[ 0 ] ) ? s2 : s1 );
+}
+
+//! Tests common to all element types, on a sx*sy image
+template< class T >
+static
+void run_common( GarbageCollector *gc, const char *type_name, index_t sx, index_t sy )
+{
+  const double n = double( sx ) * double( sy );
+  const double b = n * element_bytes< T >();
+
+  CountPtr< Array< T > > a = new Array< T >( gc, 2, sx, sy );
+  a->fill( T( 1 ) );
+
+  // Iteration in the different layouts, read only
+  MEASURE( "iterate dense", n, b, sink += sum( *a ) );
+
   {
-    switch( errno )
-    {
-      case EFAULT: throw Exception() << "tp points outside the accessible address space";
-      case EINVAL: throw Exception() << "The clk_id specified is not supported on this system";
-      default    : throw Exception() << "clock_gettime failed for some reason";
-    }
+    CountPtr< Array< T > > roi = a->getROI( 1, 1, sx-2, sy-2 );
+    const double roi_n = double( sx-2 ) * double( sy-2 );
+    MEASURE( "iterate ROI", roi_n, roi_n * element_bytes< T >(), sink += sum( *roi ) );
+  }
+  {
+    CountPtr< Array< T > > mirrored = a->copy( nullptr );
+    mirrored->setMirrored( 0 );
+    MEASURE( "iterate mirrored", n, b, sink += sum( *mirrored ) );
+  }
+  {
+    CountPtr< Array< T > > rotated = a->copy( nullptr );
+    rotated->setRotated( 1 );
+    MEASURE( "iterate rotated", n, b, sink += sum( *rotated ) );
+  }
+  {
+    CountPtr< Array< T > > sparse = a->copy( nullptr );
+    sparse->setSparse( 0, 2 );
+    MEASURE( "iterate sparse", n / 2, b / 2, sink += sum( *sparse ) );
   }
 
-  return uint64_t( tp.tv_sec ) * 1000000000ull + uint64_t( tp.tv_nsec );
+  // Whole Array operations
+  MEASURE( "clone", n, 2 * b, sink += double( a->clone()->size() ) );
+  MEASURE( "copy", 0, 0, sink += double( a->copy( nullptr )->size() ) );
+  MEASURE( "fill", n, b, a->fill( T( 0 ) ) );
+
+  {
+    CountPtr< Array< int32_t > > src = new Array< int32_t >( gc, 2, sx, sy );
+    src->fill( 1 );
+    CountPtr< Array< T > > dst = new Array< T >( gc, 2, sx, sy );
+    MEASURE( "assign from int32", n, b + n * 4, dst->assign( src ) );
+  }
+
+  // Value boxing
+  MEASURE( "getValue_v", n, b, sink += sum_values( *a ) );
+
+  // Reallocation
+  {
+    CountPtr< Array< T > > r = new Array< T >( gc, 2 );
+    MEASURE( "resize_v churn", 0, 0, resize_churn( *r ) );
+  }
 }
 
-template< int Dims >
+//! Tests for types with plain pointers, not for the bit packed Array< bool >
+template< class T >
 static
-void compare_random( void )
+void run_type( GarbageCollector *gc, const char *type_name, index_t sx, index_t sy )
 {
-  GarbageCollector *gc = 0;
+  run_common< T >( gc, type_name, sx, sy );
+
+  const double n = double( sx ) * double( sy );
+  const double b = n * element_bytes< T >();
+
+  CountPtr< Array< T > > a = new Array< T >( gc, 2, sx, sy );
+  a->fill( T( 1 ) );
+  CountPtr< Array< int32_t > > src = new Array< int32_t >( gc, 2, sx, sy );
+  src->fill( 1 );
+
+  // Block throughput, as used by the core Nodes
+  vector< T > buffer( 4096 );
+  MEASURE( "CopyBlock", n, 2 * b, sink += drain( new core::CopyBlock< T >( a.get() ), buffer ) );
+  MEASURE( "CastBlock from int32", n, b + n * 4, sink += drain( new core::CastBlock< int32_t, T >( src.get() ), buffer ) );
+}
+
+static
+void run_bool( GarbageCollector *gc, index_t sx, index_t sy )
+{
+  const char *const type_name = "bool";
+  run_common< bool >( gc, type_name, sx, sy );
+
+  const double n = double( sx ) * double( sy );
+  CountPtr< Array< bool > > a = new Array< bool >( gc, 2, sx, sy );
+  a->fill( false );
+
+  // Single bit read-modify-write through at()
+  MEASURE( "at() bit toggle", n, n / 4,
+    for( index_t y=0; y<sy; ++y )
+    for( index_t x=0; x<sx; ++x )
+    {
+      a->at( x, y ) = !a->at( x, y );
+    }
+  );
+}
+
+//! The former performance_Array test, random swaps through at_v() in 1-4 dimensions
+static
+void run_random_swaps( GarbageCollector *gc )
+{
+  const char *const type_name = "int32";
   const index_t size[ 4 ] = { 123, 67, 31, 51 };
-//  Array< int, Dims > a1( gc, Dims, size );
-  Array< int > a1( gc, Dims, size );
-
-  const uint64_t t1 = getNanoSeconds();
-  access_random( a1, Dims );
-  const uint64_t t2 = getNanoSeconds();
-//  access_random( a2, Dims );
-//  const uint64_t t3 = getNanoSeconds();
-
-  std::cerr
-    << "access_random Array < int  , " << Dims << " > took " << double( t2-t1 )/1000000 << "ms" << endl
-//    << "access_random Array2< int >( " << Dims << " ) took " << double( t3-t2 )/1000000 << "ms" << endl
-    ;
+  const index_t swaps = 100000;
+  const double b = double( swaps ) * 4 * sizeof( int32_t );
+
+  for( int dims = 1; dims <= 4; ++dims )
+  {
+    Array< int32_t > a( gc, dims, size );
+    const char *const names[ 4 ] = { "at_v random swap 1D", "at_v random swap 2D", "at_v random swap 3D", "at_v random swap 4D" };
+    MEASURE( names[ dims-1 ], 2 * double( swaps ), b, access_random( a, dims, swaps ) );
+  }
 }
 
 int main( int argc, char **argv )
 {
-  (void)argc;
-  (void)argv;
+  if( argc > 1 )
+  {
+    const long min_ms = atol( argv[ 1 ] );
+    if( min_ms < 1 )
+    {
+      cerr << "Usage: " << argv[ 0 ] << " [minimum milliseconds per test]" << endl;
+      return -1;
+    }
+    min_ns = uint64_t( min_ms ) * 1000000;
+  }
 
-  compare_random< 1 >();
-  compare_random< 2 >();
-  compare_random< 3 >();
-  compare_random< 4 >();
+  try
+  {
+    GarbageCollector *gc = 0;
+    const index_t sx = 1024;
+    const index_t sy = 1024;
+
+    run_type< uint8_t >( gc, "uint8", sx, sy );
+    run_type< int32_t >( gc, "int32", sx, sy );
+    run_type< float   >( gc, "float", sx, sy );
+    run_type< double  >( gc, "double", sx, sy );
+    run_bool( gc, sx, sy );
+    run_random_swaps( gc );
+  }
+  catch( const RPGML::Exception &e )
+  {
+    cerr << e.what() << endl;
+    return -1;
+  }
 
   return 0;
 }
-
@@ -0,0 +1,205 @@
+/* This file is part of RPGML.
+ *
+ * Copyright (c) 2014, Gunnar Payer, All rights reserved.
+ *
+ * RPGML is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3.0 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.
+ */
+/*! @file performance_JobQueue.cpp
+ * @brief Latency of handing Jobs to the workers of a ThreadPool
+ *
+ * "doJob round trip" is the time of JobQueue::doJob() with an empty Job,
+ * from the calling thread to a worker and back, like the main thread Jobs
+ * of the SDL Window. "worker handoff" is the time from addJob() on one
+ * worker until another worker starts the Job, like a Node scheduling its
+ * successors. Both are measured with blocking workers (max spins 0) and with
+ * the default spinning, the number of repetitions is the only argument
+ * (default 100000).
+ */
+#include <RPGML/JobQueue.h>
+#include <RPGML/ThreadPool.h>
+#include <RPGML/Profiler.h>
+#include <RPGML/Semaphore.h>
+#include <RPGML/Atomic.h>
+
+#include <cstdlib>
+#include <algorithm>
+#include <iostream>
+#include <iomanip>
+#include <new>
+#include <vector>
+
+// RPGML_LDFLAGS =
+// RPGML_CXXFLAGS =-O3 -DNDEBUG
+
+using namespace RPGML;
+using namespace std;
+
+static Atomic< uint64_t > allocations( 0 );
+
+void *operator new( size_t size )
+{
+  ++allocations;
+  void *const p = ::malloc( size ? size : 1 );
+  if( !p ) throw std::bad_alloc();
+  return p;
+}
+
+void operator delete( void *p ) noexcept
+{
+  ::free( p );
+}
+
+class EmptyJob : public JobQueue::Job
+{
+public:
+  EmptyJob( void ) : JobQueue::Job( 0 ) {}
+protected:
+  virtual size_t doit( CountPtr< JobQueue > ) { return 0; }
+};
+
+//! Adds itself again until all hops are done, measures from addJob() until doit()
+class RelayJob : public JobQueue::Job
+{
+public:
+  explicit
+  RelayJob( index_t hops )
+  : JobQueue::Job( 0 )
+  , m_latencies( hops )
+  , m_hop( 0 )
+  , m_added( 0 )
+  {}
+
+  void start( JobQueue *queue )
+  {
+    m_hop = 0;
+    m_added = Profiler::now();
+    queue->addJob( this );
+    m_finished.lock();
+  }
+
+  vector< int64_t > &getLatencies( void ) { return m_latencies; }
+
+protected:
+  virtual size_t doit( CountPtr< JobQueue > queue )
+  {
+    m_latencies[ m_hop ] = Profiler::now() - m_added;
+    if( ++m_hop < m_latencies.size() )
+    {
+      m_added = Profiler::now();
+      queue->addJob( this );
+    }
+    else
+    {
+      m_finished.unlock();
+    }
+    return 0;
+  }
+
+private:
+  vector< int64_t > m_latencies;
+  index_t m_hop;
+  int64_t m_added;
+  Semaphore m_finished;
+};
+
+static
+void report( const char *test, unsigned int max_spins, vector< int64_t > &ns, double allocations_per_op )
+{
+  std::sort( ns.begin(), ns.end() );
+  double sum = 0;
+  for( size_t i = 0; i < ns.size(); ++i ) sum += double( ns[ i ] );
+
+  cout
+    << left << setw( 20 ) << test
+    << "max spins " << setw( 6 ) << max_spins << right
+    << fixed << setprecision( 0 )
+    << " mean " << setw( 8 ) << sum / double( ns.size() ) << " ns"
+    << "  p50 " << setw( 8 ) << ns[ ns.size() / 2 ] << " ns"
+    << "  p99 " << setw( 8 ) << ns[ ns.size() * 99 / 100 ] << " ns"
+    << setprecision( 3 )
+    << "  " << allocations_per_op << " allocations/op"
+    << endl
+    ;
+}
+
+static
+void run_doJob( JobQueue *queue, unsigned int max_spins, index_t repetitions )
+{
+  queue->setMaxSpins( max_spins );
+
+  CountPtr< EmptyJob > job = new EmptyJob();
+  vector< int64_t > ns( repetitions );
+
+  queue->doJob( job ); // warm up
+
+  const uint64_t allocations_before = allocations.get();
+  for( index_t i = 0; i < repetitions; ++i )
+  {
+    const int64_t begin = Profiler::now();
+    queue->doJob( job );
+    ns[ i ] = Profiler::now() - begin;
+  }
+  const uint64_t allocations_after = allocations.get();
+
+  report( "doJob round trip", max_spins, ns, double( allocations_after - allocations_before ) / double( repetitions ) );
+}
+
+static
+void run_handoff( JobQueue *queue, unsigned int max_spins, index_t repetitions )
+{
+  queue->setMaxSpins( max_spins );
+
+  CountPtr< RelayJob > job = new RelayJob( repetitions );
+
+  const uint64_t allocations_before = allocations.get();
+  job->start( queue );
+  const uint64_t allocations_after = allocations.get();
+
+  report( "worker handoff", max_spins, job->getLatencies(), double( allocations_after - allocations_before ) / double( repetitions ) );
+}
+
+int main( int argc, char **argv )
+{
+  index_t repetitions = 100000;
+  if( argc > 1 )
+  {
+    const long n = atol( argv[ 1 ] );
+    if( n < 1 )
+    {
+      cerr << "Usage: " << argv[ 0 ] << " [repetitions]" << endl;
+      return -1;
+    }
+    repetitions = index_t( n );
+  }
+
+  try
+  {
+    CountPtr< ThreadPool > pool = new ThreadPool( 0, 2 );
+    JobQueue *const queue = pool->getQueue();
+
+    const unsigned int max_spins[ 2 ] = { 0, JobQueue::DefaultMaxSpins };
+    for( int s = 0; s < 2; ++s )
+    {
+      run_doJob( queue, max_spins[ s ], repetitions );
+      run_handoff( queue, max_spins[ s ], repetitions );
+    }
+  }
+  catch( const RPGML::Exception &e )
+  {
+    cerr << e.what() << endl;
+    return -1;
+  }
+
+  return 0;
+}